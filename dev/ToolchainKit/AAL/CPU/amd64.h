@@ -7,50 +7,669 @@
 #pragma once
 
 #include <ToolchainKit/Defines.h>
+#include <algorithm>
+#include <array>
+#include <initializer_list>
+#include <string_view>
 
 // @brief AMD64 support.
 // @file CPU/amd64.hpp
 
-#define kAsmOpcodeDecl(__NAME, __OPCODE) {.fName = __NAME, .fOpcode = __OPCODE},
+// The encoding forms are generated at compile time from the description in
+// amd64_describe(), then sorted by name: the forms of a mnemonic are a run of
+// kOpcodesAMD64, tried in the order they are described.
 
 typedef char	 i64_character_t;
 typedef uint8_t	 i64_byte_t;
 typedef uint16_t i64_hword_t;
 typedef uint32_t i64_word_t;
 
+#define kAsmNameLenAMD64 (16)
+
+/// @brief fModReg when ModRM.reg holds the register operand (/r).
+#define kAsmModRegR (0xFE)
+
+/// @brief fModReg when the form has no ModRM byte.
+#define kAsmModRegNone (0xFF)
+
+/// form flags.
+#define kAsmFormByte	  (1U << 0) // 8-bit operation, its imm8 goes up to 255.
+#define kAsmFormPlusReg	  (1U << 1) // the register is in the low bits of the opcode (+r).
+#define kAsmFormDefault64 (1U << 2) // 64-bit without REX.W, no 32-bit form (push, pop, near branches).
+#define kAsmFormNo64	  (1U << 3) // no 64-bit operation.
+#define kAsmFormOnly64	  (1U << 4) // 64-bit operation only.
+#define kAsmFormRexW	  (1U << 5) // always REX.W (cqo, iretq).
+#define kAsmFormOp16	  (1U << 6) // always 0x66 (cwd, movsw).
+#define kAsmFormVex		  (1U << 7) // VEX prefix, fPrefix is its pp and fOpcode starts with the map.
+#define kAsmFormEvex	  (1U << 8) // EVEX prefix, the same.
+#define kAsmFormL256	  (1U << 9) // 256-bit vectors (ymm).
+#define kAsmFormL512	  (1U << 10) // 512-bit vectors (zmm), EVEX only.
+#define kAsmFormW1		  (1U << 11) // VEX.W or EVEX.W set (64-bit elements of EVEX).
+
+/// @brief operands of an encoding form.
+enum
+{
+	kAsmOpNone,
+	kAsmOpR,	 // general register of the operation size.
+	kAsmOpAcc,	 // al, ax, eax or rax.
+	kAsmOpRM,	 // general register or memory of the operation size.
+	kAsmOpRM8,	 // byte register or memory, whatever the operation size (movzx).
+	kAsmOpRM16,	 // word register or memory.
+	kAsmOpRM32,	 // dword register or memory (movsxd).
+	kAsmOpM,	 // memory only (lea).
+	kAsmOpImm8,	 // sign extended, a byte operation takes 0 to 255 as well.
+	kAsmOpImm16, // ret, unsigned.
+	kAsmOpImm,	 // of the operation size, 32 bits at most, sign extended to 64.
+	kAsmOpImm64, // mov r64, imm64.
+	kAsmOpOne,	 // the constant 1 (shifts).
+	kAsmOpCL,	 // the cl register (shifts).
+	kAsmOpRel8,
+	kAsmOpRel32,
+	kAsmOpV,	 // vector register of the form's length (xmm, ymm or zmm).
+	kAsmOpVV,	 // the same, in VEX.vvvv: the first source of a three operand form.
+	kAsmOpVM,	 // vector register or memory of the form's length.
+	kAsmOpX,	 // xmm register, whatever the length (broadcasts).
+	kAsmOpXM32,	 // xmm register or dword memory (scalar single).
+	kAsmOpXM64,	 // xmm register or qword memory (scalar double, movq).
+};
+
 struct CpuOpcodeAMD64
 {
-	std::string fName;
-	i64_byte_t	fPrefixBytes[4];
-	i64_hword_t fOpcode;
-	i64_hword_t fModReg;
-	i64_word_t	fDisplacment;
-	i64_word_t	fImmediate;
+	i64_character_t fName[kAsmNameLenAMD64];
+	i64_byte_t		fPrefix; // mandatory prefix (0xF3 of popcnt, 0x67 of jecxz), 0 if none.
+	i64_byte_t		fOpcode[3];
+	i64_byte_t		fOpcodeLen;
+	i64_byte_t		fModReg; // the /digit of ModRM.reg, kAsmModRegR or kAsmModRegNone.
+	i64_byte_t		fOperands[3];
+	i64_hword_t		fFlags;
+
+	constexpr std::string_view Name() const
+	{
+		return std::string_view(fName);
+	}
+
+	/// @brief bits of the vector operands.
+	constexpr Int32 VectorSize() const
+	{
+		return (fFlags & kAsmFormL512) ? 512 : ((fFlags & kAsmFormL256) ? 256 : 128);
+	}
+
+	constexpr SizeType Arity() const
+	{
+		SizeType arity = 0;
+
+		while (arity < 3 && fOperands[arity] != kAsmOpNone)
+			++arity;
+
+		return arity;
+	}
 };
 
-/// these two are edge cases
-#define kAsmIntOpcode	 0xCC
-#define kasmIntOpcodeAlt 0xCD
-
-#define kAsmJumpOpcode			0x0F80
-#define kJumpLimit				30
-#define kJumpLimitStandard		0xE3
-#define kJumpLimitStandardLimit 0xEB
-
-inline std::vector<CpuOpcodeAMD64> kOpcodesAMD64 = {
-	kAsmOpcodeDecl("int", 0xCD)
-		kAsmOpcodeDecl("into", 0xCE)
-			kAsmOpcodeDecl("intd", 0xF1)
-				kAsmOpcodeDecl("int3", 0xC3)
-					kAsmOpcodeDecl("iret", 0xCF)
-						kAsmOpcodeDecl("retf", 0xCB)
-							kAsmOpcodeDecl("retn", 0xC3)
-								kAsmOpcodeDecl("ret", 0xC3)
-									kAsmOpcodeDecl("sti", 0xfb)
-										kAsmOpcodeDecl("cli", 0xfa)
-											kAsmOpcodeDecl("hlt", 0xf4)
-												kAsmOpcodeDecl("nop", 0x90)
-													kAsmOpcodeDecl("mov", 0x48)
-														kAsmOpcodeDecl("call", 0xFF)};
+namespace Details
+{
+	/// @brief one form, name is prefix + suffix (j + ne).
+	constexpr CpuOpcodeAMD64 amd64_form(std::string_view prefix, std::string_view suffix, std::initializer_list<i64_byte_t> opcode,
+										i64_byte_t mod_reg, std::initializer_list<i64_byte_t> operands, i64_hword_t flags = 0,
+										i64_byte_t mandatory = 0)
+	{
+		CpuOpcodeAMD64 form{};
+
+		SizeType at = 0;
+
+		for (auto ch : prefix)
+			form.fName[at++] = ch;
+
+		for (auto ch : suffix)
+			form.fName[at++] = ch;
+
+		form.fPrefix	 = mandatory;
+		form.fOpcodeLen	 = opcode.size();
+		form.fModReg	 = mod_reg;
+		form.fFlags		 = flags;
+
+		at = 0;
+
+		for (auto byte : opcode)
+			form.fOpcode[at++] = byte;
+
+		at = 0;
+
+		for (auto operand : operands)
+			form.fOperands[at++] = operand;
+
+		return form;
+	}
+
+	/// @brief the condition codes, the low nibble of jcc, setcc and cmovcc.
+	struct amd64_condition final
+	{
+		std::string_view fSuffix;
+		i64_byte_t		 fCode;
+	};
+
+	inline constexpr amd64_condition kAmd64Conditions[] = {
+		{"o", 0x0}, {"no", 0x1}, {"b", 0x2}, {"c", 0x2}, {"nae", 0x2}, {"ae", 0x3}, {"nb", 0x3}, {"nc", 0x3},
+		{"e", 0x4}, {"z", 0x4}, {"ne", 0x5}, {"nz", 0x5}, {"be", 0x6}, {"na", 0x6}, {"a", 0x7}, {"nbe", 0x7},
+		{"s", 0x8}, {"ns", 0x9}, {"p", 0xA}, {"pe", 0xA}, {"np", 0xB}, {"po", 0xB}, {"l", 0xC}, {"nge", 0xC},
+		{"ge", 0xD}, {"nl", 0xD}, {"le", 0xE}, {"ng", 0xE}, {"g", 0xF}, {"nle", 0xF}};
+
+	/// @brief SSE, AVX, AVX2 and AVX-512 (F, BW and DQ) without masking or broadcast.
+	/// An SSE instruction is named like its legacy form, the AVX ones take a v and
+	/// the first source in VEX.vvvv. The VEX forms come first, the EVEX ones then
+	/// encode zmm and the registers 16 to 31.
+	template <typename Emit>
+	constexpr void amd64_describe_vector(Emit&& emit)
+	{
+		constexpr i64_byte_t R = kAsmModRegR;
+		constexpr i64_byte_t N = kAsmModRegNone;
+
+		constexpr i64_hword_t cNoEvex = 0;
+		constexpr i64_hword_t cEvexW0 = kAsmFormEvex;
+		constexpr i64_hword_t cEvexW1 = kAsmFormEvex | kAsmFormW1;
+
+		// the legacy form when sse isn't empty, VEX.128 and VEX.256, then EVEX.128, .256 and .512.
+		// a scalar instruction only has its 128-bit forms.
+		auto vector = [&](std::string_view name, i64_byte_t pp, std::initializer_list<i64_byte_t> opcode,
+						  std::initializer_list<i64_byte_t> sse, std::initializer_list<i64_byte_t> avx, i64_hword_t evex,
+						  Bool scalar = false) {
+			if (sse.size() > 0)
+				emit(amd64_form("", name, opcode, R, sse, 0, pp));
+
+			emit(amd64_form("v", name, opcode, R, avx, kAsmFormVex, pp));
+
+			if (!scalar)
+				emit(amd64_form("v", name, opcode, R, avx, kAsmFormVex | kAsmFormL256, pp));
+
+			if (evex == cNoEvex)
+				return;
+
+			emit(amd64_form("v", name, opcode, R, avx, evex, pp));
+
+			if (!scalar)
+			{
+				emit(amd64_form("v", name, opcode, R, avx, evex | kAsmFormL256, pp));
+				emit(amd64_form("v", name, opcode, R, avx, evex | kAsmFormL512, pp));
+			}
+		};
+
+		// dst = dst op src, or dst = src1 op src2.
+		auto arith = [&](std::string_view name, i64_byte_t pp, std::initializer_list<i64_byte_t> opcode, i64_hword_t evex) {
+			vector(name, pp, opcode, {kAsmOpV, kAsmOpVM}, {kAsmOpV, kAsmOpVV, kAsmOpVM}, evex);
+		};
+
+		// the instructions AVX-512 only has, EVEX.128, .256 and .512.
+		auto evex_only = [&](std::string_view name, i64_byte_t pp, std::initializer_list<i64_byte_t> opcode,
+							 std::initializer_list<i64_byte_t> operands, i64_hword_t evex) {
+			emit(amd64_form("v", name, opcode, R, operands, evex, pp));
+			emit(amd64_form("v", name, opcode, R, operands, evex | kAsmFormL256, pp));
+			emit(amd64_form("v", name, opcode, R, operands, evex | kAsmFormL512, pp));
+		};
+
+		// loads come first, a register to register move takes them.
+		constexpr std::string_view cFloatMoves[] = {"movups", "movaps", "movupd", "movapd"};
+		constexpr i64_byte_t	   cFloatMoveOp[] = {0x10, 0x28, 0x10, 0x28};
+
+		for (SizeType n = 0; n < 4; ++n)
+		{
+			i64_byte_t	pp	 = n < 2 ? 0 : 0x66;
+			i64_hword_t evex = n < 2 ? cEvexW0 : cEvexW1;
+
+			vector(cFloatMoves[n], pp, {0x0F, cFloatMoveOp[n]}, {kAsmOpV, kAsmOpVM}, {kAsmOpV, kAsmOpVM}, evex);
+			vector(cFloatMoves[n], pp, {0x0F, i64_byte_t(cFloatMoveOp[n] + 1)}, {kAsmOpVM, kAsmOpV}, {kAsmOpVM, kAsmOpV}, evex);
+		}
+
+		vector("movdqu", 0xF3, {0x0F, 0x6F}, {kAsmOpV, kAsmOpVM}, {kAsmOpV, kAsmOpVM}, cNoEvex);
+		vector("movdqu", 0xF3, {0x0F, 0x7F}, {kAsmOpVM, kAsmOpV}, {kAsmOpVM, kAsmOpV}, cNoEvex);
+		vector("movdqa", 0x66, {0x0F, 0x6F}, {kAsmOpV, kAsmOpVM}, {kAsmOpV, kAsmOpVM}, cNoEvex);
+		vector("movdqa", 0x66, {0x0F, 0x7F}, {kAsmOpVM, kAsmOpV}, {kAsmOpVM, kAsmOpV}, cNoEvex);
+
+		// the element size of an AVX-512 integer move is in its name and in pp and W.
+		constexpr std::string_view cIntMoves[] = {"movdqa32", "movdqa64", "movdqu8", "movdqu16", "movdqu32", "movdqu64"};
+		constexpr i64_byte_t	   cIntMovePP[] = {0x66, 0x66, 0xF2, 0xF2, 0xF3, 0xF3};
+
+		for (SizeType n = 0; n < 6; ++n)
+		{
+			i64_hword_t evex = n % 2 == 0 ? cEvexW0 : cEvexW1;
+
+			evex_only(cIntMoves[n], cIntMovePP[n], {0x0F, 0x6F}, {kAsmOpV, kAsmOpVM}, evex);
+			evex_only(cIntMoves[n], cIntMovePP[n], {0x0F, 0x7F}, {kAsmOpVM, kAsmOpV}, evex);
+		}
+
+		// movd, movq: general register (W of the operation size) or memory.
+		vector("movd", 0x66, {0x0F, 0x6E}, {kAsmOpV, kAsmOpRM32}, {kAsmOpV, kAsmOpRM32}, cNoEvex, true);
+		vector("movd", 0x66, {0x0F, 0x7E}, {kAsmOpRM32, kAsmOpV}, {kAsmOpRM32, kAsmOpV}, cNoEvex, true);
+		vector("movq", 0xF3, {0x0F, 0x7E}, {kAsmOpV, kAsmOpXM64}, {kAsmOpV, kAsmOpXM64}, cNoEvex, true);
+		vector("movq", 0x66, {0x0F, 0xD6}, {kAsmOpXM64, kAsmOpV}, {kAsmOpXM64, kAsmOpV}, cNoEvex, true);
+		emit(amd64_form("", "movq", {0x0F, 0x6E}, R, {kAsmOpV, kAsmOpRM}, kAsmFormOnly64, 0x66));
+		emit(amd64_form("", "movq", {0x0F, 0x7E}, R, {kAsmOpRM, kAsmOpV}, kAsmFormOnly64, 0x66));
+		emit(amd64_form("v", "movq", {0x0F, 0x6E}, R, {kAsmOpV, kAsmOpRM}, kAsmFormOnly64 | kAsmFormVex, 0x66));
+		emit(amd64_form("v", "movq", {0x0F, 0x7E}, R, {kAsmOpRM, kAsmOpV}, kAsmFormOnly64 | kAsmFormVex, 0x66));
+
+		emit(amd64_form("", "movss", {0x0F, 0x10}, R, {kAsmOpV, kAsmOpXM32}, 0, 0xF3));
+		emit(amd64_form("", "movss", {0x0F, 0x11}, R, {kAsmOpXM32, kAsmOpV}, 0, 0xF3));
+		emit(amd64_form("", "movsd", {0x0F, 0x10}, R, {kAsmOpV, kAsmOpXM64}, 0, 0xF2));
+		emit(amd64_form("", "movsd", {0x0F, 0x11}, R, {kAsmOpXM64, kAsmOpV}, 0, 0xF2));
+
+		// floating point: packed single and double, scalar single and double.
+		constexpr std::string_view cFloat[][4] = {
+			{"addps", "addpd", "addss", "addsd"},
+			{"mulps", "mulpd", "mulss", "mulsd"},
+			{"subps", "subpd", "subss", "subsd"},
+			{"minps", "minpd", "minss", "minsd"},
+			{"divps", "divpd", "divss", "divsd"},
+			{"maxps", "maxpd", "maxss", "maxsd"},
+			{"sqrtps", "sqrtpd", "sqrtss", "sqrtsd"},
+		};
+		constexpr i64_byte_t cFloatOp[] = {0x58, 0x59, 0x5C, 0x5D, 0x5E, 0x5F, 0x51};
+
+		for (SizeType n = 0; n < 7; ++n)
+		{
+			i64_byte_t op = cFloatOp[n];
+
+			// a packed square root has one source, no vvvv.
+			if (op == 0x51)
+			{
+				vector(cFloat[n][0], 0, {0x0F, op}, {kAsmOpV, kAsmOpVM}, {kAsmOpV, kAsmOpVM}, cEvexW0);
+				vector(cFloat[n][1], 0x66, {0x0F, op}, {kAsmOpV, kAsmOpVM}, {kAsmOpV, kAsmOpVM}, cEvexW1);
+			}
+			else
+			{
+				arith(cFloat[n][0], 0, {0x0F, op}, cEvexW0);
+				arith(cFloat[n][1], 0x66, {0x0F, op}, cEvexW1);
+			}
+
+			vector(cFloat[n][2], 0xF3, {0x0F, op}, {kAsmOpV, kAsmOpXM32}, {kAsmOpV, kAsmOpVV, kAsmOpXM32}, cEvexW0, true);
+			vector(cFloat[n][3], 0xF2, {0x0F, op}, {kAsmOpV, kAsmOpXM64}, {kAsmOpV, kAsmOpVV, kAsmOpXM64}, cEvexW1, true);
+		}
+
+		// the EVEX forms of the logic are AVX512DQ.
+		constexpr std::string_view cFloatLogic[][2] = {{"andps", "andpd"}, {"andnps", "andnpd"}, {"orps", "orpd"}, {"xorps", "xorpd"}};
+
+		for (i64_byte_t n = 0; n < 4; ++n)
+		{
+			arith(cFloatLogic[n][0], 0, {0x0F, i64_byte_t(0x54 + n)}, cEvexW0);
+			arith(cFloatLogic[n][1], 0x66, {0x0F, i64_byte_t(0x54 + n)}, cEvexW1);
+		}
+
+		vector("comiss", 0, {0x0F, 0x2F}, {kAsmOpV, kAsmOpXM32}, {kAsmOpV, kAsmOpXM32}, cEvexW0, true);
+		vector("comisd", 0x66, {0x0F, 0x2F}, {kAsmOpV, kAsmOpXM64}, {kAsmOpV, kAsmOpXM64}, cEvexW1, true);
+		vector("ucomiss", 0, {0x0F, 0x2E}, {kAsmOpV, kAsmOpXM32}, {kAsmOpV, kAsmOpXM32}, cEvexW0, true);
+		vector("ucomisd", 0x66, {0x0F, 0x2E}, {kAsmOpV, kAsmOpXM64}, {kAsmOpV, kAsmOpXM64}, cEvexW1, true);
+
+		// conversions, the general register sets W.
+		vector("cvtsi2ss", 0xF3, {0x0F, 0x2A}, {kAsmOpV, kAsmOpRM}, {kAsmOpV, kAsmOpVV, kAsmOpRM}, cNoEvex, true);
+		vector("cvtsi2sd", 0xF2, {0x0F, 0x2A}, {kAsmOpV, kAsmOpRM}, {kAsmOpV, kAsmOpVV, kAsmOpRM}, cNoEvex, true);
+		vector("cvttss2si", 0xF3, {0x0F, 0x2C}, {kAsmOpR, kAsmOpXM32}, {kAsmOpR, kAsmOpXM32}, cNoEvex, true);
+		vector("cvttsd2si", 0xF2, {0x0F, 0x2C}, {kAsmOpR, kAsmOpXM64}, {kAsmOpR, kAsmOpXM64}, cNoEvex, true);
+		vector("cvtss2sd", 0xF3, {0x0F, 0x5A}, {kAsmOpV, kAsmOpXM32}, {kAsmOpV, kAsmOpVV, kAsmOpXM32}, cNoEvex, true);
+		vector("cvtsd2ss", 0xF2, {0x0F, 0x5A}, {kAsmOpV, kAsmOpXM64}, {kAsmOpV, kAsmOpVV, kAsmOpXM64}, cNoEvex, true);
+
+		// packed integers, W follows the element size in EVEX.
+		struct amd64_packed final
+		{
+			std::string_view fName;
+			i64_byte_t		 fOpcode[2];
+			i64_hword_t		 fEvex;
+		};
+
+		constexpr amd64_packed cPacked[] = {
+			{"paddb", {0xFC}, cEvexW0},
+			{"paddw", {0xFD}, cEvexW0},
+			{"paddd", {0xFE}, cEvexW0},
+			{"paddq", {0xD4}, cEvexW1},
+			{"psubb", {0xF8}, cEvexW0},
+			{"psubw", {0xF9}, cEvexW0},
+			{"psubd", {0xFA}, cEvexW0},
+			{"psubq", {0xFB}, cEvexW1},
+			{"paddsb", {0xEC}, cEvexW0},
+			{"paddsw", {0xED}, cEvexW0},
+			{"paddusb", {0xDC}, cEvexW0},
+			{"paddusw", {0xDD}, cEvexW0},
+			{"psubsb", {0xE8}, cEvexW0},
+			{"psubsw", {0xE9}, cEvexW0},
+			{"psubusb", {0xD8}, cEvexW0},
+			{"psubusw", {0xD9}, cEvexW0},
+			{"pmullw", {0xD5}, cEvexW0},
+			{"pmulhw", {0xE5}, cEvexW0},
+			{"pmulhuw", {0xE4}, cEvexW0},
+			{"pmuludq", {0xF4}, cEvexW1},
+			{"pmaddwd", {0xF5}, cEvexW0},
+			{"psadbw", {0xF6}, cEvexW0},
+			{"pavgb", {0xE0}, cEvexW0},
+			{"pavgw", {0xE3}, cEvexW0},
+			{"pminub", {0xDA}, cEvexW0},
+			{"pmaxub", {0xDE}, cEvexW0},
+			{"pminsw", {0xEA}, cEvexW0},
+			{"pmaxsw", {0xEE}, cEvexW0},
+			{"punpcklbw", {0x60}, cEvexW0},
+			{"punpcklwd", {0x61}, cEvexW0},
+			{"punpckldq", {0x62}, cEvexW0},
+			{"punpcklqdq", {0x6C}, cEvexW1},
+			{"punpckhbw", {0x68}, cEvexW0},
+			{"punpckhwd", {0x69}, cEvexW0},
+			{"punpckhdq", {0x6A}, cEvexW0},
+			{"punpckhqdq", {0x6D}, cEvexW1},
+			{"packsswb", {0x63}, cEvexW0},
+			{"packuswb", {0x67}, cEvexW0},
+			{"packssdw", {0x6B}, cEvexW0},
+			// AVX-512 compares write a mask register, they are VEX only.
+			{"pcmpeqb", {0x74}, cNoEvex},
+			{"pcmpeqw", {0x75}, cNoEvex},
+			{"pcmpeqd", {0x76}, cNoEvex},
+			{"pcmpgtb", {0x64}, cNoEvex},
+			{"pcmpgtw", {0x65}, cNoEvex},
+			{"pcmpgtd", {0x66}, cNoEvex},
+			// AVX-512 has pandd, pandq and the like instead.
+			{"pand", {0xDB}, cNoEvex},
+			{"pandn", {0xDF}, cNoEvex},
+			{"por", {0xEB}, cNoEvex},
+			{"pxor", {0xEF}, cNoEvex},
+			// SSSE3 and SSE4.1, in the 0F 38 map.
+			{"pshufb", {0x38, 0x00}, cEvexW0},
+			{"pmulld", {0x38, 0x40}, cEvexW0},
+			{"pminsd", {0x38, 0x39}, cEvexW0},
+			{"pmaxsd", {0x38, 0x3D}, cEvexW0},
+			{"pminud", {0x38, 0x3B}, cEvexW0},
+			{"pmaxud", {0x38, 0x3F}, cEvexW0},
+			{"pcmpeqq", {0x38, 0x29}, cNoEvex},
+			{"pcmpgtq", {0x38, 0x37}, cNoEvex},
+		};
+
+		for (auto& packed : cPacked)
+		{
+			if (packed.fOpcode[0] == 0x38)
+				arith(packed.fName, 0x66, {0x0F, 0x38, packed.fOpcode[1]}, packed.fEvex);
+			else
+				arith(packed.fName, 0x66, {0x0F, packed.fOpcode[0]}, packed.fEvex);
+		}
+
+		constexpr std::string_view cLogic[][2] = {{"pandd", "pandq"}, {"pandnd", "pandnq"}, {"pord", "porq"}, {"pxord", "pxorq"}};
+		constexpr i64_byte_t	   cLogicOp[]  = {0xDB, 0xDF, 0xEB, 0xEF};
+
+		for (SizeType n = 0; n < 4; ++n)
+		{
+			evex_only(cLogic[n][0], 0x66, {0x0F, cLogicOp[n]}, {kAsmOpV, kAsmOpVV, kAsmOpVM}, cEvexW0);
+			evex_only(cLogic[n][1], 0x66, {0x0F, cLogicOp[n]}, {kAsmOpV, kAsmOpVV, kAsmOpVM}, cEvexW1);
+		}
+
+		emit(amd64_form("", "pmovmskb", {0x0F, 0xD7}, R, {kAsmOpR, kAsmOpV}, 0, 0x66));
+		emit(amd64_form("v", "pmovmskb", {0x0F, 0xD7}, R, {kAsmOpR, kAsmOpV}, kAsmFormVex, 0x66));
+		emit(amd64_form("v", "pmovmskb", {0x0F, 0xD7}, R, {kAsmOpR, kAsmOpV}, kAsmFormVex | kAsmFormL256, 0x66));
+
+		vector("pshufd", 0x66, {0x0F, 0x70}, {kAsmOpV, kAsmOpVM, kAsmOpImm8}, {kAsmOpV, kAsmOpVM, kAsmOpImm8}, cEvexW0);
+
+		// AVX2 broadcasts of the low element, VEX.W is 0 for all of them.
+		vector("pbroadcastb", 0x66, {0x0F, 0x38, 0x78}, {}, {kAsmOpV, kAsmOpX}, cEvexW0);
+		vector("pbroadcastw", 0x66, {0x0F, 0x38, 0x79}, {}, {kAsmOpV, kAsmOpX}, cEvexW0);
+		vector("pbroadcastd", 0x66, {0x0F, 0x38, 0x58}, {}, {kAsmOpV, kAsmOpXM32}, cEvexW0);
+		vector("pbroadcastq", 0x66, {0x0F, 0x38, 0x59}, {}, {kAsmOpV, kAsmOpXM64}, cEvexW1);
+		vector("broadcastss", 0x66, {0x0F, 0x38, 0x18}, {}, {kAsmOpV, kAsmOpXM32}, cEvexW0);
+
+		// a double fills no less than a ymm, and only EVEX sets W for it.
+		emit(amd64_form("v", "broadcastsd", {0x0F, 0x38, 0x19}, R, {kAsmOpV, kAsmOpXM64}, kAsmFormVex | kAsmFormL256, 0x66));
+		emit(amd64_form("v", "broadcastsd", {0x0F, 0x38, 0x19}, R, {kAsmOpV, kAsmOpXM64}, cEvexW1 | kAsmFormL256, 0x66));
+		emit(amd64_form("v", "broadcastsd", {0x0F, 0x38, 0x19}, R, {kAsmOpV, kAsmOpXM64}, cEvexW1 | kAsmFormL512, 0x66));
+
+		emit(amd64_form("v", "zeroupper", {0x0F, 0x77}, N, {}, kAsmFormVex));
+		emit(amd64_form("v", "zeroall", {0x0F, 0x77}, N, {}, kAsmFormVex | kAsmFormL256));
+	}
+
+	/// @brief The integer instruction set, each emit() is one encoding form.
+	/// Shorter forms come first, the encoder takes the first that fits.
+	template <typename Emit>
+	constexpr void amd64_describe(Emit&& emit)
+	{
+		constexpr i64_byte_t R = kAsmModRegR;
+		constexpr i64_byte_t N = kAsmModRegNone;
+
+		// add, or, adc, sbb, and, sub, xor and cmp: opcodes 8 * n to 8 * n + 5, then the 0x80 group.
+		constexpr std::string_view cAlu[] = {"add", "or", "adc", "sbb", "and", "sub", "xor", "cmp"};
+
+		for (i64_byte_t n = 0; n < 8; ++n)
+		{
+			emit(amd64_form(cAlu[n], "", {i64_byte_t(8 * n)}, R, {kAsmOpRM, kAsmOpR}, kAsmFormByte));
+			emit(amd64_form(cAlu[n], "", {i64_byte_t(8 * n + 1)}, R, {kAsmOpRM, kAsmOpR}));
+			emit(amd64_form(cAlu[n], "", {i64_byte_t(8 * n + 2)}, R, {kAsmOpR, kAsmOpRM}, kAsmFormByte));
+			emit(amd64_form(cAlu[n], "", {i64_byte_t(8 * n + 3)}, R, {kAsmOpR, kAsmOpRM}));
+			emit(amd64_form(cAlu[n], "", {i64_byte_t(8 * n + 4)}, N, {kAsmOpAcc, kAsmOpImm8}, kAsmFormByte));
+			emit(amd64_form(cAlu[n], "", {0x80}, n, {kAsmOpRM, kAsmOpImm8}, kAsmFormByte));
+			emit(amd64_form(cAlu[n], "", {0x83}, n, {kAsmOpRM, kAsmOpImm8}));
+			emit(amd64_form(cAlu[n], "", {i64_byte_t(8 * n + 5)}, N, {kAsmOpAcc, kAsmOpImm}));
+			emit(amd64_form(cAlu[n], "", {0x81}, n, {kAsmOpRM, kAsmOpImm}));
+		}
+
+		emit(amd64_form("test", "", {0x84}, R, {kAsmOpRM, kAsmOpR}, kAsmFormByte));
+		emit(amd64_form("test", "", {0x85}, R, {kAsmOpRM, kAsmOpR}));
+		emit(amd64_form("test", "", {0xA8}, N, {kAsmOpAcc, kAsmOpImm8}, kAsmFormByte));
+		emit(amd64_form("test", "", {0xA9}, N, {kAsmOpAcc, kAsmOpImm}));
+		emit(amd64_form("test", "", {0xF6}, 0, {kAsmOpRM, kAsmOpImm8}, kAsmFormByte));
+		emit(amd64_form("test", "", {0xF7}, 0, {kAsmOpRM, kAsmOpImm}));
+
+		// mov r64, imm64 is the last resort, C7 sign extends 32 bits.
+		emit(amd64_form("mov", "", {0x88}, R, {kAsmOpRM, kAsmOpR}, kAsmFormByte));
+		emit(amd64_form("mov", "", {0x89}, R, {kAsmOpRM, kAsmOpR}));
+		emit(amd64_form("mov", "", {0x8A}, R, {kAsmOpR, kAsmOpRM}, kAsmFormByte));
+		emit(amd64_form("mov", "", {0x8B}, R, {kAsmOpR, kAsmOpRM}));
+		emit(amd64_form("mov", "", {0xB0}, N, {kAsmOpR, kAsmOpImm8}, kAsmFormByte | kAsmFormPlusReg));
+		emit(amd64_form("mov", "", {0xB8}, N, {kAsmOpR, kAsmOpImm}, kAsmFormPlusReg | kAsmFormNo64));
+		emit(amd64_form("mov", "", {0xC6}, 0, {kAsmOpRM, kAsmOpImm8}, kAsmFormByte));
+		emit(amd64_form("mov", "", {0xC7}, 0, {kAsmOpRM, kAsmOpImm}));
+		emit(amd64_form("mov", "", {0xB8}, N, {kAsmOpR, kAsmOpImm64}, kAsmFormPlusReg | kAsmFormOnly64));
+
+		emit(amd64_form("movzx", "", {0x0F, 0xB6}, R, {kAsmOpR, kAsmOpRM8}));
+		emit(amd64_form("movzx", "", {0x0F, 0xB7}, R, {kAsmOpR, kAsmOpRM16}));
+		emit(amd64_form("movsx", "", {0x0F, 0xBE}, R, {kAsmOpR, kAsmOpRM8}));
+		emit(amd64_form("movsx", "", {0x0F, 0xBF}, R, {kAsmOpR, kAsmOpRM16}));
+		emit(amd64_form("movsxd", "", {0x63}, R, {kAsmOpR, kAsmOpRM32}, kAsmFormOnly64));
+		emit(amd64_form("lea", "", {0x8D}, R, {kAsmOpR, kAsmOpM}));
+
+		emit(amd64_form("xchg", "", {0x90}, N, {kAsmOpAcc, kAsmOpR}, kAsmFormPlusReg));
+		emit(amd64_form("xchg", "", {0x90}, N, {kAsmOpR, kAsmOpAcc}, kAsmFormPlusReg));
+		emit(amd64_form("xchg", "", {0x86}, R, {kAsmOpRM, kAsmOpR}, kAsmFormByte));
+		emit(amd64_form("xchg", "", {0x87}, R, {kAsmOpRM, kAsmOpR}));
+		emit(amd64_form("xchg", "", {0x86}, R, {kAsmOpR, kAsmOpRM}, kAsmFormByte));
+		emit(amd64_form("xchg", "", {0x87}, R, {kAsmOpR, kAsmOpRM}));
+		emit(amd64_form("xadd", "", {0x0F, 0xC0}, R, {kAsmOpRM, kAsmOpR}, kAsmFormByte));
+		emit(amd64_form("xadd", "", {0x0F, 0xC1}, R, {kAsmOpRM, kAsmOpR}));
+		emit(amd64_form("cmpxchg", "", {0x0F, 0xB0}, R, {kAsmOpRM, kAsmOpR}, kAsmFormByte));
+		emit(amd64_form("cmpxchg", "", {0x0F, 0xB1}, R, {kAsmOpRM, kAsmOpR}));
+
+		// the F6/F7 and FE/FF groups, one operand.
+		constexpr std::string_view cUnary[] = {"", "", "not", "neg", "mul", "imul", "div", "idiv"};
+
+		for (i64_byte_t n = 2; n < 8; ++n)
+		{
+			emit(amd64_form(cUnary[n], "", {0xF6}, n, {kAsmOpRM}, kAsmFormByte));
+			emit(amd64_form(cUnary[n], "", {0xF7}, n, {kAsmOpRM}));
+		}
+
+		emit(amd64_form("inc", "", {0xFE}, 0, {kAsmOpRM}, kAsmFormByte));
+		emit(amd64_form("inc", "", {0xFF}, 0, {kAsmOpRM}));
+		emit(amd64_form("dec", "", {0xFE}, 1, {kAsmOpRM}, kAsmFormByte));
+		emit(amd64_form("dec", "", {0xFF}, 1, {kAsmOpRM}));
+
+		emit(amd64_form("imul", "", {0x0F, 0xAF}, R, {kAsmOpR, kAsmOpRM}));
+		emit(amd64_form("imul", "", {0x6B}, R, {kAsmOpR, kAsmOpRM, kAsmOpImm8}));
+		emit(amd64_form("imul", "", {0x69}, R, {kAsmOpR, kAsmOpRM, kAsmOpImm}));
+
+		// the shift group, /6 is unused.
+		constexpr std::string_view cShift[] = {"rol", "ror", "rcl", "rcr", "shl", "shr", "sal", "sar"};
+
+		for (i64_byte_t n = 0; n < 8; ++n)
+		{
+			i64_byte_t digit = n == 6 ? 4 : n;
+
+			emit(amd64_form(cShift[n], "", {0xD0}, digit, {kAsmOpRM, kAsmOpOne}, kAsmFormByte));
+			emit(amd64_form(cShift[n], "", {0xD1}, digit, {kAsmOpRM, kAsmOpOne}));
+			emit(amd64_form(cShift[n], "", {0xD2}, digit, {kAsmOpRM, kAsmOpCL}, kAsmFormByte));
+			emit(amd64_form(cShift[n], "", {0xD3}, digit, {kAsmOpRM, kAsmOpCL}));
+			emit(amd64_form(cShift[n], "", {0xC0}, digit, {kAsmOpRM, kAsmOpImm8}, kAsmFormByte));
+			emit(amd64_form(cShift[n], "", {0xC1}, digit, {kAsmOpRM, kAsmOpImm8}));
+		}
+
+		// bt, bts, btr and btc.
+		constexpr std::string_view cBit[] = {"bt", "bts", "btr", "btc"};
+
+		for (i64_byte_t n = 0; n < 4; ++n)
+		{
+			emit(amd64_form(cBit[n], "", {0x0F, i64_byte_t(0xA3 + 8 * n)}, R, {kAsmOpRM, kAsmOpR}));
+			emit(amd64_form(cBit[n], "", {0x0F, 0xBA}, i64_byte_t(4 + n), {kAsmOpRM, kAsmOpImm8}));
+		}
+
+		emit(amd64_form("bsf", "", {0x0F, 0xBC}, R, {kAsmOpR, kAsmOpRM}));
+		emit(amd64_form("bsr", "", {0x0F, 0xBD}, R, {kAsmOpR, kAsmOpRM}));
+		emit(amd64_form("tzcnt", "", {0x0F, 0xBC}, R, {kAsmOpR, kAsmOpRM}, 0, 0xF3));
+		emit(amd64_form("lzcnt", "", {0x0F, 0xBD}, R, {kAsmOpR, kAsmOpRM}, 0, 0xF3));
+		emit(amd64_form("popcnt", "", {0x0F, 0xB8}, R, {kAsmOpR, kAsmOpRM}, 0, 0xF3));
+		emit(amd64_form("bswap", "", {0x0F, 0xC8}, N, {kAsmOpR}, kAsmFormPlusReg));
+
+		emit(amd64_form("push", "", {0x50}, N, {kAsmOpR}, kAsmFormPlusReg | kAsmFormDefault64));
+		emit(amd64_form("push", "", {0xFF}, 6, {kAsmOpRM}, kAsmFormDefault64));
+		emit(amd64_form("push", "", {0x6A}, N, {kAsmOpImm8}, kAsmFormDefault64));
+		emit(amd64_form("push", "", {0x68}, N, {kAsmOpImm}, kAsmFormDefault64));
+		emit(amd64_form("pop", "", {0x58}, N, {kAsmOpR}, kAsmFormPlusReg | kAsmFormDefault64));
+		emit(amd64_form("pop", "", {0x8F}, 0, {kAsmOpRM}, kAsmFormDefault64));
+
+		// branches, rel8 is only taken when the target is known and close.
+		emit(amd64_form("call", "", {0xE8}, N, {kAsmOpRel32}));
+		emit(amd64_form("call", "", {0xFF}, 2, {kAsmOpRM}, kAsmFormDefault64));
+		emit(amd64_form("jmp", "", {0xEB}, N, {kAsmOpRel8}));
+		emit(amd64_form("jmp", "", {0xE9}, N, {kAsmOpRel32}));
+		emit(amd64_form("jmp", "", {0xFF}, 4, {kAsmOpRM}, kAsmFormDefault64));
+
+		for (auto& cond : kAmd64Conditions)
+		{
+			emit(amd64_form("j", cond.fSuffix, {i64_byte_t(0x70 + cond.fCode)}, N, {kAsmOpRel8}));
+			emit(amd64_form("j", cond.fSuffix, {0x0F, i64_byte_t(0x80 + cond.fCode)}, N, {kAsmOpRel32}));
+			emit(amd64_form("set", cond.fSuffix, {0x0F, i64_byte_t(0x90 + cond.fCode)}, 0, {kAsmOpRM}, kAsmFormByte));
+			emit(amd64_form("cmov", cond.fSuffix, {0x0F, i64_byte_t(0x40 + cond.fCode)}, R, {kAsmOpR, kAsmOpRM}));
+		}
+
+		emit(amd64_form("jrcxz", "", {0xE3}, N, {kAsmOpRel8}));
+		emit(amd64_form("jecxz", "", {0xE3}, N, {kAsmOpRel8}, 0, 0x67));
+		emit(amd64_form("loop", "", {0xE2}, N, {kAsmOpRel8}));
+		emit(amd64_form("loope", "", {0xE1}, N, {kAsmOpRel8}));
+		emit(amd64_form("loopz", "", {0xE1}, N, {kAsmOpRel8}));
+		emit(amd64_form("loopne", "", {0xE0}, N, {kAsmOpRel8}));
+		emit(amd64_form("loopnz", "", {0xE0}, N, {kAsmOpRel8}));
+
+		emit(amd64_form("ret", "", {0xC3}, N, {}));
+		emit(amd64_form("ret", "", {0xC2}, N, {kAsmOpImm16}));
+		emit(amd64_form("retn", "", {0xC3}, N, {}));
+		emit(amd64_form("retf", "", {0xCB}, N, {}));
+		emit(amd64_form("leave", "", {0xC9}, N, {}));
+		emit(amd64_form("int", "", {0xCD}, N, {kAsmOpImm8}, kAsmFormByte));
+		emit(amd64_form("int3", "", {0xCC}, N, {}));
+		emit(amd64_form("int1", "", {0xF1}, N, {}));
+		emit(amd64_form("iret", "", {0xCF}, N, {}));
+		emit(amd64_form("iretq", "", {0xCF}, N, {}, kAsmFormRexW));
+		emit(amd64_form("syscall", "", {0x0F, 0x05}, N, {}));
+		emit(amd64_form("sysret", "", {0x0F, 0x07}, N, {}));
+		emit(amd64_form("sysretq", "", {0x0F, 0x07}, N, {}, kAsmFormRexW));
+
+		// sign extension of the accumulator.
+		emit(amd64_form("cbw", "", {0x98}, N, {}, kAsmFormOp16));
+		emit(amd64_form("cwde", "", {0x98}, N, {}));
+		emit(amd64_form("cdqe", "", {0x98}, N, {}, kAsmFormRexW));
+		emit(amd64_form("cwd", "", {0x99}, N, {}, kAsmFormOp16));
+		emit(amd64_form("cdq", "", {0x99}, N, {}));
+		emit(amd64_form("cqo", "", {0x99}, N, {}, kAsmFormRexW));
+
+		// string operations, rep and lock are line prefixes.
+		constexpr std::string_view cString[] = {"movs", "cmps", "stos", "lods", "scas"};
+		constexpr i64_byte_t	   cStringOp[] = {0xA4, 0xA6, 0xAA, 0xAC, 0xAE};
+
+		for (SizeType n = 0; n < 5; ++n)
+		{
+			emit(amd64_form(cString[n], "b", {cStringOp[n]}, N, {}));
+			emit(amd64_form(cString[n], "w", {i64_byte_t(cStringOp[n] + 1)}, N, {}, kAsmFormOp16));
+			emit(amd64_form(cString[n], "d", {i64_byte_t(cStringOp[n] + 1)}, N, {}));
+			emit(amd64_form(cString[n], "q", {i64_byte_t(cStringOp[n] + 1)}, N, {}, kAsmFormRexW));
+		}
+
+		// flags and the system.
+		emit(amd64_form("nop", "", {0x90}, N, {}));
+		emit(amd64_form("pause", "", {0x90}, N, {}, 0, 0xF3));
+		emit(amd64_form("hlt", "", {0xF4}, N, {}));
+		emit(amd64_form("cmc", "", {0xF5}, N, {}));
+		emit(amd64_form("clc", "", {0xF8}, N, {}));
+		emit(amd64_form("stc", "", {0xF9}, N, {}));
+		emit(amd64_form("cli", "", {0xFA}, N, {}));
+		emit(amd64_form("sti", "", {0xFB}, N, {}));
+		emit(amd64_form("cld", "", {0xFC}, N, {}));
+		emit(amd64_form("std", "", {0xFD}, N, {}));
+		emit(amd64_form("lahf", "", {0x9F}, N, {}));
+		emit(amd64_form("sahf", "", {0x9E}, N, {}));
+		emit(amd64_form("pushfq", "", {0x9C}, N, {}));
+		emit(amd64_form("popfq", "", {0x9D}, N, {}));
+		emit(amd64_form("ud2", "", {0x0F, 0x0B}, N, {}));
+		emit(amd64_form("cpuid", "", {0x0F, 0xA2}, N, {}));
+		emit(amd64_form("rdtsc", "", {0x0F, 0x31}, N, {}));
+		emit(amd64_form("rdtscp", "", {0x0F, 0x01, 0xF9}, N, {}));
+		emit(amd64_form("rdmsr", "", {0x0F, 0x32}, N, {}));
+		emit(amd64_form("wrmsr", "", {0x0F, 0x30}, N, {}));
+		emit(amd64_form("swapgs", "", {0x0F, 0x01, 0xF8}, N, {}));
+		emit(amd64_form("lfence", "", {0x0F, 0xAE, 0xE8}, N, {}));
+		emit(amd64_form("mfence", "", {0x0F, 0xAE, 0xF0}, N, {}));
+		emit(amd64_form("sfence", "", {0x0F, 0xAE, 0xF8}, N, {}));
+		emit(amd64_form("invlpg", "", {0x0F, 0x01}, 7, {kAsmOpM}));
+
+		amd64_describe_vector(emit);
+	}
+
+	/// @brief orders the forms by name, to look a mnemonic up.
+	struct amd64_form_less final
+	{
+		constexpr bool operator()(const CpuOpcodeAMD64& lhs, std::string_view rhs) const
+		{
+			return lhs.Name() < rhs;
+		}
+
+		constexpr bool operator()(std::string_view lhs, const CpuOpcodeAMD64& rhs) const
+		{
+			return lhs < rhs.Name();
+		}
+	};
+
+	consteval SizeType amd64_count()
+	{
+		SizeType count = 0;
+		amd64_describe([&count](const CpuOpcodeAMD64&) { ++count; });
+
+		return count;
+	}
+
+	consteval auto amd64_table()
+	{
+		std::array<CpuOpcodeAMD64, amd64_count()> forms{};
+		std::array<SizeType, amd64_count()>		  order{};
+		SizeType								  at = 0;
+
+		amd64_describe([&](const CpuOpcodeAMD64& form) { forms[at++] = form; });
+
+		for (SizeType index = 0; index < order.size(); ++index)
+			order[index] = index;
+
+		// the forms of a name keep the order they are described in.
+		std::sort(order.begin(), order.end(), [&](SizeType lhs, SizeType rhs) {
+			return forms[lhs].Name() < forms[rhs].Name() || (forms[lhs].Name() == forms[rhs].Name() && lhs < rhs);
+		});
+
+		std::array<CpuOpcodeAMD64, amd64_count()> table{};
+
+		for (SizeType index = 0; index < order.size(); ++index)
+			table[index] = forms[order[index]];
+
+		return table;
+	}
+} // namespace Details
+
+inline constexpr auto kOpcodesAMD64 = Details::amd64_table();
+
+/// @brief The forms of a mnemonic, empty if there is no such instruction.
+inline std::pair<const CpuOpcodeAMD64*, const CpuOpcodeAMD64*> amd64_find_forms(std::string_view name)
+{
+	return std::equal_range(kOpcodesAMD64.data(), kOpcodesAMD64.data() + kOpcodesAMD64.size(), name, Details::amd64_form_less{});
+}
 
 #define kAsmRegisterLimit 15
@@ -0,0 +1,81 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+#pragma once
+
+#include <ToolchainKit/Defines.h>
+#include <ToolchainKit/AAL/AssemblyInterface.h>
+
+/// @file Peephole.h
+/// @brief Peephole optimizer, runs over the generated assembly before it is written.
+
+namespace ToolchainKit
+{
+	/// @brief One line of generated assembly, split into mnemonic and operands.
+	struct PeepholeInstr final
+	{
+		std::string				 fIndent;
+		std::string				 fMnemonic;
+		std::vector<std::string> fOperands;
+		std::string				 fText;			   // original line, emitted as is when untouched.
+		Bool					 fBarrier{false};  // label, directive, comment or control flow.
+		Bool					 fDead{false};	   // removed by a rule.
+		Bool					 fChanged{false};  // rewritten by a rule.
+	};
+
+	typedef std::vector<PeepholeInstr> PeepholeList;
+
+	/// @brief A rule looks at the instruction at index and its live successor.
+	/// @return true if it changed the list.
+	typedef Bool (*PeepholeRuleFn)(PeepholeList& list, SizeType index);
+
+	/// @brief Named peephole rule, see the per-target tables in Peephole.cc.
+	struct PeepholeRule final
+	{
+		const CharType* fName;
+		PeepholeRuleFn	fRule;
+		Bool			fLowering{false}; // the target can't take the input as is, runs even when not optimizing.
+	};
+
+	/// @brief Peephole optimizer over a structured instruction list.
+	/// @note arch is one of AssemblyFactory::kArch*.
+	class PeepholeOptimizer final
+	{
+	public:
+		explicit PeepholeOptimizer(Int32 arch) noexcept;
+		~PeepholeOptimizer() = default;
+
+		TOOLCHAINKIT_COPY_DEFAULT(PeepholeOptimizer);
+
+		/// @brief Parse, optimize and emit the assembly text.
+		std::string Run(const std::string& text);
+
+		/// @brief Split assembly text into instructions.
+		PeepholeList Parse(const std::string& text);
+
+		/// @brief Apply the rule table until nothing changes.
+		void Optimize(PeepholeList& list);
+
+		/// @brief Apply only the lowering rules, for builds without the optimizer.
+		void Lower(PeepholeList& list);
+
+		/// @brief Turn the list back into text.
+		std::string Emit(const PeepholeList& list);
+
+		/// @brief How many instructions were dropped by the last run.
+		SizeType Removed() const noexcept
+		{
+			return fRemoved;
+		}
+
+	private:
+		void Apply(PeepholeList& list, Bool lowering_only);
+
+		Int32							 fArch{AssemblyFactory::kArchUnknown};
+		const std::vector<PeepholeRule>* fRules{nullptr};
+		SizeType						 fRemoved{0UL};
+	};
+} // namespace ToolchainKit
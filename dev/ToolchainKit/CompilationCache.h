@@ -0,0 +1,73 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+#pragma once
+
+#include <ToolchainKit/Defines.h>
+
+/// @file CompilationCache.h
+/// @brief Content addressed cache of compiler outputs, keyed on the preprocessed
+/// source, the toolchain version and the flags. Least recently used entries are
+/// evicted past a size limit.
+
+namespace ToolchainKit
+{
+	struct CompilationCacheStats final
+	{
+		UInt64 fHits{0UL};
+		UInt64 fMisses{0UL};
+		UInt64 fStores{0UL};
+		UInt64 fEvictions{0UL};
+		UInt64 fEntries{0UL};
+		UInt64 fBytes{0UL};
+	};
+
+	/// @brief An output of a cached job, its kind (extension) and where it goes.
+	struct CompilationCacheOutput final
+	{
+		std::string fKind; // e.g ".masm", ".obj"
+		std::string fPath;
+	};
+
+	class CompilationCache final
+	{
+	public:
+		static constexpr UInt64 kDefaultLimit = 512UL * 1024UL * 1024UL;
+
+		explicit CompilationCache(const std::string& dir, UInt64 limit = kDefaultLimit);
+		~CompilationCache() = default;
+
+		TOOLCHAINKIT_COPY_DEFAULT(CompilationCache);
+
+		/// @brief $TOOLCHAINKIT_CACHE, $XDG_CACHE_HOME/toolchainkit or ~/.cache/toolchainkit.
+		static std::string DefaultDirectory();
+
+		/// @brief Key of a translation unit.
+		/// @param source the preprocessed file.
+		/// @param flags whatever changes the output besides the source.
+		/// @return the key, empty if source can't be read.
+		static std::string Key(const std::string& source, const std::vector<std::string>& flags);
+
+		/// @brief Copy the outputs of key to their paths, and count a hit or a miss.
+		/// @return false on a miss, nothing is written then.
+		Bool Fetch(const std::string& key, const std::vector<CompilationCacheOutput>& outputs);
+
+		/// @brief Keep the outputs under key, then evict past the limit.
+		Bool Store(const std::string& key, const std::vector<CompilationCacheOutput>& outputs);
+
+		/// @brief Counters, entries and size of the cache.
+		CompilationCacheStats Stats() const;
+
+	private:
+		std::string EntryPath(const std::string& key, const std::string& kind) const;
+		void		Count(UInt64 CompilationCacheStats::*counter, UInt64 by = 1UL);
+		void		Evict();
+
+	private:
+		std::string fDir;
+		UInt64		fLimit;
+	};
+} // namespace ToolchainKit
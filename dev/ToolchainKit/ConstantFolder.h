@@ -0,0 +1,64 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+#pragma once
+
+#include <ToolchainKit/Defines.h>
+#include <ToolchainKit/SymbolTable.h>
+#include <unordered_map>
+
+/// @file ConstantFolder.h
+/// @brief Source level constant folding for the C front ends, runs on the
+/// preprocessed lines before they reach CompilerFrontend::Compile.
+
+namespace ToolchainKit
+{
+	/// @brief Folds literal expressions, propagates constant locals, removes
+	/// branches of folded ifs and unused constant locals.
+	/// @note Expects one statement per line, the way the C front ends read them.
+	class ConstantFolder final
+	{
+	public:
+		/// @param types the type names of the front end (int, long...).
+		explicit ConstantFolder(const std::vector<std::string>& types);
+		~ConstantFolder() = default;
+
+		TOOLCHAINKIT_COPY_DEFAULT(ConstantFolder);
+
+		/// @brief Fold a translation unit.
+		/// @return the new lines, the removed ones are gone.
+		std::vector<std::string> Run(const std::vector<std::string>& lines);
+
+		/// @brief Evaluate an integer constant expression.
+		/// @param env known constants, by name.
+		/// @param as_int as C ints do, an unsigned or wider operand or an overflow isn't constant.
+		/// Otherwise every value is an Int64 and wraps.
+		/// @return false if the expression isn't constant.
+		static Bool Evaluate(const std::string& expr, const std::unordered_map<std::string, Int64>& env, Int64& result, Bool as_int = true);
+
+		/// @brief How many expressions were folded by the last run.
+		SizeType Folded() const noexcept
+		{
+			return fFolded;
+		}
+
+		/// @brief How many lines were removed by the last run.
+		SizeType Removed() const noexcept
+		{
+			return fRemoved;
+		}
+
+	private:
+		Bool IsType(const std::string& word) const;
+
+	private:
+		std::vector<std::string>			   fTypes;
+		SymbolTable							   fSymbols;
+		std::unordered_map<UInt64, Int64>	   fConstants; // by scope and name of the declaration.
+		SizeType							   fFolded{0UL};
+		SizeType							   fRemoved{0UL};
+	};
+} // namespace ToolchainKit
@@ -0,0 +1,43 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+#pragma once
+
+#include <ToolchainKit/Defines.h>
+
+/// @file Daemon.h
+/// @brief tkd, a local server running the toolchain modules in one long lived process.
+/// Tables, opcode lists and the header cache stay warm between jobs, and the
+/// dylib is loaded once.
+///
+/// A job is a module name, a working directory and an argv. The client also hands
+/// over its stdout and stderr, so the job prints where a local run would.
+/// Jobs run one at a time, the modules keep their state in globals.
+
+namespace ToolchainKit
+{
+	/// @brief Entry point of a module, see TOOLCHAINKIT_MODULE.
+	typedef int (*DaemonModuleFn)(int argc, char** argv);
+
+	/// @brief Socket of the daemon, $TOOLCHAINKIT_DAEMON or $TMPDIR/tkd-<uid>.sock.
+	std::string daemon_socket_path();
+
+	/// @brief Find a module by name, e.g "CompilerCPlusPlusX8664".
+	/// @return nullptr if it isn't served.
+	DaemonModuleFn daemon_find_module(const std::string& name);
+
+	/// @brief Serve jobs on path until a stop job comes.
+	/// @return the exit code of the daemon.
+	Int32 daemon_serve(const std::string& path, Bool verbose);
+
+	/// @brief Run a module in the daemon, args[0] being the program name.
+	/// @param code the exit code of the module.
+	/// @return false if no daemon answered, the job didn't run then.
+	Bool daemon_submit(const std::string& path, const std::string& module, const std::vector<std::string>& args, Int32& code);
+
+	/// @brief Ask the daemon at path to exit.
+	Bool daemon_stop(const std::string& path);
+} // namespace ToolchainKit
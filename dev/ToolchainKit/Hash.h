@@ -0,0 +1,52 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+#pragma once
+
+#include <ToolchainKit/Defines.h>
+#include <array>
+
+/// @file Hash.h
+/// @brief Fast streaming content hash, for build IDs and cache keys.
+/// Not a cryptographic hash.
+
+namespace ToolchainKit
+{
+	/// @brief 128-bit digest.
+	typedef std::array<UInt8, 16> HashDigest;
+
+	/// @brief Hashes a stream of bytes eight at a time on two lanes,
+	/// data can be fed in as many pieces as needed.
+	class StreamHash final
+	{
+	public:
+		explicit StreamHash(UInt64 seed = 0UL);
+		~StreamHash() = default;
+
+		TOOLCHAINKIT_COPY_DEFAULT(StreamHash);
+
+		/// @brief Feed size bytes.
+		void Update(const void* data, SizeType size);
+
+		/// @brief Feed a string, its length included so that "ab" "c" and "a" "bc" differ.
+		void Update(const std::string& text);
+
+		/// @brief Feed an integer, as little endian bytes.
+		void Update(UInt64 value);
+
+		/// @brief Digest of what was fed so far, the hash can still be fed after.
+		HashDigest Final() const;
+
+		/// @brief Digest as 32 hex characters.
+		static std::string Hex(const HashDigest& digest);
+
+	private:
+		UInt64	 fLanes[2];
+		UInt8	 fTail[8];
+		SizeType fTailSize{0UL};
+		UInt64	 fLength{0UL};
+	};
+} // namespace ToolchainKit
@@ -0,0 +1,232 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+#pragma once
+
+#include <ToolchainKit/Defines.h>
+#include <ToolchainKit/AAL/AssemblyInterface.h>
+
+/// @file IR.h
+/// @brief Target independent three-address IR, shared by the C/C++ front ends
+/// and the instruction selectors.
+
+/// @brief Assembler directive carrying the IR section of an object, in hex (LTO).
+#define kIRDirective ".ir"
+
+namespace ToolchainKit
+{
+	enum IROpcode : UInt8
+	{
+		kIRConst,  // dst = imm
+		kIRCopy,   // dst = lhs
+		kIRParam,  // dst = argument #imm
+		kIRAdd,	   // dst = lhs op rhs
+		kIRSub,
+		kIRMul,
+		kIRDiv,
+		kIRMod,
+		kIRAnd,
+		kIROr,
+		kIRXor,
+		kIRShl,
+		kIRShr,
+		kIRCmpEq, // dst = lhs cmp rhs, 0 or 1
+		kIRCmpNe,
+		kIRCmpLt,
+		kIRCmpLe,
+		kIRCmpGt,
+		kIRCmpGe,
+		kIRNeg,		   // dst = -lhs
+		kIRNot,		   // dst = ~lhs
+		kIRLoad,	   // dst = [sym]
+		kIRStore,	   // [sym] = lhs
+		kIRCall,	   // dst = sym(args...)
+		kIRRet,		   // return lhs
+		kIRJump,	   // goto label
+		kIRJumpIfZero, // if (!lhs) goto label
+		kIRJumpNotZero,
+		kIRLabel,
+		kIROpcodeCount,
+	};
+
+	/// @brief A virtual register, an immediate or a symbol.
+	struct IROperand final
+	{
+		enum
+		{
+			kNone,
+			kTemp,
+			kImm,
+			kSym,
+		} fKind{kNone};
+
+		Int64		fValue{0}; // temp index, immediate or label index.
+		std::string fSymbol;
+
+		static IROperand Temp(Int64 index)
+		{
+			IROperand op;
+			op.fKind  = kTemp;
+			op.fValue = index;
+
+			return op;
+		}
+
+		static IROperand Imm(Int64 value)
+		{
+			IROperand op;
+			op.fKind  = kImm;
+			op.fValue = value;
+
+			return op;
+		}
+
+		static IROperand Sym(const std::string& name)
+		{
+			IROperand op;
+			op.fKind   = kSym;
+			op.fSymbol = name;
+
+			return op;
+		}
+	};
+
+	struct IRInstr final
+	{
+		IROpcode			   fOp{kIRConst};
+		IROperand			   fDst;
+		IROperand			   fLhs;
+		IROperand			   fRhs;
+		Int64				   fLabel{-1}; // jumps and labels.
+		std::vector<IROperand> fArgs;	   // calls.
+	};
+
+	struct IRFunction final
+	{
+		std::string			 fName;
+		SizeType			 fParams{0UL};
+		Int64				 fTemps{0};
+		Int64				 fLabels{0};
+		std::vector<IRInstr> fCode;
+		Bool				 fExtern{false}; // prototype only.
+	};
+
+	struct IRGlobal final
+	{
+		std::string fName;
+		Int64		fValue{0};
+	};
+
+	struct IRModule final
+	{
+		std::string				fSource;
+		std::vector<IRFunction> fFunctions;
+		std::vector<IRGlobal>	fGlobals;
+	};
+
+	/// @brief Where the allocator put a temp.
+	struct IRLocation final
+	{
+		Int32 fReg{-1};	 // index in the selector's pool, or -1.
+		Int32 fSlot{-1}; // spill slot, or -1.
+	};
+
+	/// @brief Linear scan over a function's temps.
+	/// Temps live across a call are always spilled, selectors treat every
+	/// register as clobbered by a call.
+	/// @param pool how many registers the selector can hand out.
+	/// @param slots how many spill slots were used.
+	std::vector<IRLocation> ir_allocate(const IRFunction& fn, SizeType pool, SizeType& slots);
+
+	/// @brief Print a module in a readable form, for debugging.
+	std::string ir_dump(const IRModule& module);
+
+	/// @brief Builds the IR of a C translation unit.
+	/// The C++ front end shares it for the C subset of the language.
+	class IRFrontendC final
+	{
+	public:
+		explicit IRFrontendC() = default;
+		~IRFrontendC()		   = default;
+
+		TOOLCHAINKIT_COPY_DEFAULT(IRFrontendC);
+
+		/// @brief Parse source into module.
+		/// @return false and fill error when the source is out of the supported subset.
+		Bool Parse(const std::string& source, IRModule& module, std::string& error);
+	};
+
+	/// @brief Instruction selector, one per target.
+	class IRSelector
+	{
+	public:
+		explicit IRSelector() = default;
+		virtual ~IRSelector() = default;
+
+		TOOLCHAINKIT_COPY_DEFAULT(IRSelector);
+
+		/// @brief Turn module into assembly for this target.
+		virtual std::string Select(const IRModule& module) = 0;
+
+		/// @brief One of AssemblyFactory::kArch*.
+		virtual Int32 Arch() noexcept = 0;
+
+		/// @brief Widest vector the selector may use, in bytes, 0 for the baseline of its target.
+		void SetVectorSize(SizeType bytes) noexcept
+		{
+			fVectorSize = bytes;
+		}
+
+	protected:
+		SizeType fVectorSize{0UL};
+	};
+
+	/// @brief Get the selector of arch, nullptr if there is none.
+	std::unique_ptr<IRSelector> ir_selector_for(Int32 arch);
+
+	/// @brief Front end then selection, what the compilers call under their IR flag.
+	/// @return false and fill error on failure.
+	Bool ir_compile(const std::string& source, Int32 arch, std::string& assembly, std::string& error);
+
+	/// @brief ir_compile, and the module as ir_write gives it for the IR section of the object (LTO).
+	/// @param vector_size see IRSelector::SetVectorSize.
+	Bool ir_compile(const std::string& source, Int32 arch, std::string& assembly, std::string& ir, std::string& error,
+					SizeType vector_size = 0UL);
+
+	/// @brief Serialize module, what an object carries for link time optimization.
+	std::string ir_write(const IRModule& module);
+
+	/// @brief Read what ir_write wrote.
+	/// @return false on a truncated blob or one of another IR version.
+	Bool ir_read(const std::string& blob, IRModule& module);
+
+	/// @brief The kIRDirective lines carrying blob, the compilers append them to their assembly.
+	std::string ir_directives(const std::string& blob);
+
+	/// @brief Decode a kIRDirective line at the end of blob.
+	/// @return false if line isn't a kIRDirective or its payload isn't hex.
+	Bool ir_read_directive(const std::string& line, std::string& blob);
+
+	/// @brief What ir_optimize did.
+	struct IRLinkStats final
+	{
+		SizeType fInlined{0UL}; // calls replaced by the body of the callee.
+		SizeType fFolded{0UL};	// instructions turned into constants or removed branches.
+		SizeType fRemoved{0UL}; // functions nothing reachable calls.
+	};
+
+	/// @brief Merge the modules of a link, prototypes are bound to the definition of another module.
+	/// @return false and fill error if two modules define the same symbol.
+	Bool ir_merge(const std::vector<IRModule>& modules, IRModule& merged, std::string& error);
+
+	/// @brief Whole program passes over a merged module: inlining, constant propagation and dead function removal.
+	/// @param roots symbols code outside the module refers to, they are kept and their globals may change.
+	IRLinkStats ir_optimize(IRModule& module, const std::vector<std::string>& roots);
+
+	/// @brief Split module in up to count modules of about the same size.
+	/// The first one has the globals, each one declares the functions of the others it calls.
+	std::vector<IRModule> ir_partition(const IRModule& module, SizeType count);
+} // namespace ToolchainKit
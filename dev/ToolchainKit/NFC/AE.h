@@ -19,6 +19,18 @@
 #define kAEMagLen	 (2)
 #define kAENullType	 (0x00)
 
+// v1 objects carry zero padding where the version is, hence 0.
+#define kAEVersion1 (0)
+#define kAEVersion2 (2)
+
+// v3 is v2 and a relocation table after the string table.
+#define kAEVersion3 (3)
+
+// IR section, for link time optimization: after the code, kAEIRMagic, a varint size
+// and the IR of the object. Readers of the code never look past it.
+#define kAEIRMagic	  "AEIR"
+#define kAEIRMagicLen (4)
+
 // Advanced Executable File Format for MetroLink.
 // Reloctable by offset is the default strategy.
 // You can also relocate at runtime but that's up to the operating system
@@ -38,7 +50,8 @@ namespace ToolchainKit
 		CharType fSize;
 		SizeType fStartCode;
 		SizeType fCodeSize;
-		CharType fPad[kAEPad];
+		CharType fVersion;
+		CharType fPad[kAEPad - 1];
 	} PACKED AEHeader, *AEHeaderPtr;
 
 	// @brief Advanced Executable Record.
@@ -55,11 +68,47 @@ namespace ToolchainKit
 		CharType fPad[kAEPad];
 	} PACKED AERecordHeader, *AERecordHeaderPtr;
 
+	// @brief AE v2 record, its name is an offset in the string table.
+	// The size and the offset of the record follow the table as varints.
+
+	typedef struct AERecordHeaderV2 final
+	{
+		UInt32 fName;
+		UInt16 fKind;
+		UInt16 fFlags;
+	} PACKED AERecordHeaderV2, *AERecordHeaderV2Ptr;
+
 	enum
 	{
 		kKindRelocationByOffset	 = 0x23f,
 		kKindRelocationAtRuntime = 0x34f,
 	};
+
+	// @brief Relocation types, S is the symbol address, A the addend and P the
+	// address of the field. Fields are little endian, as the assemblers write them.
+
+	enum
+	{
+		kAERelocInvalid,
+		kAERelocAbs64,			  /* S + A, 64 bits */
+		kAERelocAbs32,			  /* S + A, 32 bits, must fit */
+		kAERelocRel32,			  /* S + A - P, 32 bits signed (AMD64 call/jmp rel32, A = -4) */
+		kAERelocPowerBranch24,	  /* S + A - P in the LI field of a POWER b/bl word */
+		kAERelocPowerBranch24Abs, /* S + A in the LI field of a POWER ba/bla word */
+		kAERelocCount,
+	};
+
+	// @brief A relocation of the object code, in memory.
+	// On disk (v3): a varint count, then per relocation its type, offset,
+	// zigzag addend and the string table offset of its symbol, all varints.
+
+	struct AERelocation final
+	{
+		std::string fSymbol; // without the segment prefix, as pef_symbol_name gives it.
+		UInt64		fOffset; // of the field in the object code.
+		Int64		fAddend;
+		UInt16		fType;
+	};
 } // namespace ToolchainKit
 
 // provide operator<< for AE
@@ -94,6 +143,46 @@ inline std::ifstream& operator>>(std::ifstream&				   fp,
 
 namespace ToolchainKit::Utils
 {
+	/// @brief Write the records of an AE object, right after its header.
+	/// @param version kAEVersion1 (255 byte names) or kAEVersion2 (string table and varints).
+	/// @return false if a record doesn't fit in the version.
+	Bool ae_write_records(std::ofstream& fp, const std::vector<AERecordHeader>& records, CharType version);
+
+	/// @brief Write the records and the relocations of a v3 object, right after its header.
+	/// @return false if a record doesn't fit or version isn't kAEVersion3.
+	Bool ae_write_records(std::ofstream& fp, const std::vector<AERecordHeader>& records, CharType version, const std::vector<AERelocation>& relocations);
+
+	/// @brief Read the records of an AE object of any version, right after its header.
+	/// @return false on a truncated table or an unknown version.
+	Bool ae_read_records(std::ifstream& fp, const AEHeader& hdr, std::vector<AERecordHeader>& records);
+
+	/// @brief Read the records and the relocations (v3 only, none before) of an AE object.
+	Bool ae_read_records(std::ifstream& fp, const AEHeader& hdr, std::vector<AERecordHeader>& records, std::vector<AERelocation>& relocations);
+
+	/// @brief Write the IR section of an object, right after its code.
+	Bool ae_write_ir(std::ofstream& fp, const std::string& ir);
+
+	/// @brief Read the IR section of the object at the start of fp.
+	/// @return false if the object doesn't carry one.
+	Bool ae_read_ir(std::ifstream& fp, const AEHeader& hdr, std::string& ir);
+
+	/// @brief Bytes of the field a relocation type patches, 0 if it is unknown.
+	inline SizeType ae_relocation_width(UInt16 type)
+	{
+		switch (type)
+		{
+		case kAERelocAbs64:
+			return sizeof(UInt64);
+		case kAERelocAbs32:
+		case kAERelocRel32:
+		case kAERelocPowerBranch24:
+		case kAERelocPowerBranch24Abs:
+			return sizeof(UInt32);
+		default:
+			return 0UL;
+		}
+	}
+
 	/**
 	 * @brief AE Reader protocol
 	 *
@@ -0,0 +1,102 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+#pragma once
+
+#include <ToolchainKit/Defines.h>
+
+// @file Library.h
+// @brief Static library (.lib), AE members and a hashed index of the symbols they define.
+
+#define kLibMagic	 "AELib!\0"
+#define kLibMagicLen (8)
+#define kLibVersion	 (1)
+
+// no symbol of the index is in that bucket.
+#define kLibBucketEmpty (0xFFFFFFFFU)
+
+// Layout: LibraryHeader, fMemberCount LibraryMember, fSymbolCount LibrarySymbol (sorted by bucket,
+// a bucket is a run of symbols), fBucketCount UInt32 (first symbol of the bucket), the string
+// pool, then the AE members themselves. Only the tables need to be read to find a member.
+
+namespace ToolchainKit
+{
+	typedef struct LibraryHeader final
+	{
+		CharType fMagic[kLibMagicLen];
+		UInt32	 fVersion;
+		UInt32	 fArch;
+		UInt32	 fMemberCount;
+		UInt32	 fSymbolCount;
+		UInt32	 fBucketCount;
+		UInt32	 fPad;
+		UInt64	 fStringsSize;
+	} PACKED LibraryHeader;
+
+	typedef struct LibraryMember final
+	{
+		UInt32 fName; // offset in the string pool.
+		UInt32 fPad;
+		UInt64 fOffset; // file offset of the AE object.
+		UInt64 fSize;
+	} PACKED LibraryMember;
+
+	typedef struct LibrarySymbol final
+	{
+		UInt32 fName; // offset in the string pool, without the segment prefix.
+		UInt32 fMember;
+		UInt32 fHash; // pef_hash of the name.
+	} PACKED LibrarySymbol;
+
+	/// @brief A library open for lookups, members are read on demand.
+	class LibraryReader final
+	{
+	public:
+		explicit LibraryReader() = default;
+		~LibraryReader()		 = default;
+
+		TOOLCHAINKIT_COPY_DELETE(LibraryReader);
+
+		/// @brief Read the header and the tables of path.
+		/// @return false if it isn't a library or its tables are truncated.
+		Bool Open(const std::string& path);
+
+		/// @brief The member defining symbol (no segment prefix), -1 if none does.
+		Int64 Find(const std::string& symbol) const;
+
+		const LibraryHeader& Header() const
+		{
+			return fHeader;
+		}
+
+		const std::vector<LibraryMember>& Members() const
+		{
+			return fMembers;
+		}
+
+		const std::vector<LibrarySymbol>& Symbols() const
+		{
+			return fSymbols;
+		}
+
+		/// @brief A name of the string pool.
+		std::string Name(UInt32 offset) const;
+
+		/// @brief The file, to read a member from.
+		std::ifstream& File()
+		{
+			return fFile;
+		}
+
+	private:
+		std::ifstream			   fFile;
+		LibraryHeader			   fHeader{};
+		std::vector<LibraryMember> fMembers;
+		std::vector<LibrarySymbol> fSymbols;
+		std::vector<UInt32>		   fBuckets;
+		std::string				   fStrings;
+	};
+} // namespace ToolchainKit
@@ -31,13 +31,29 @@
 
 #define kPefMagicLen (5)
 
-#define kPefVersion (3)
-#define kPefNameLen (255)
+// v3 names are inline, v4 names are in a string pool and symbols are hashed.
+#define kPefVersion3 (3)
+#define kPefVersion4 (4)
+#define kPefVersion	 kPefVersion3 // v4 is opt in, older loaders only read v3.
+#define kPefNameLen	 (255)
+
+// default page size of --ld64:page-align.
+#define kPefPageSize (0x1000)
+
+// no v4 bucket starts there.
+#define kPefHashEmpty (0xFFFFFFFFU)
 
 #define kPefBaseOrigin (0x40000000)
 
 #define kPefStart "__ImageStart"
 
+// lazy binding: the slot the loader fills with its resolver, and the stub jumping through it.
+#define kPefBinder	   "__ImageBinder"
+#define kPefBinderStub "__ImageBinderStub"
+
+// an import command is named <dylib>:RuntimeSymbol:<symbol>.
+#define kPefImportMarker ":RuntimeSymbol:"
+
 namespace ToolchainKit
 {
 	enum
@@ -104,6 +120,78 @@ namespace ToolchainKit
 		SizeType Size;				/* file size */
 	} PACKED PEFCommandHeader;
 
+	/* v4: PEFIndex follows PEFContainer (HdrSz covers both), then Count PEFCommandHeaderV4, */
+	/* then the string pool and the symbol hash section. */
+
+	typedef struct PEFIndex final
+	{
+		UIntPtr	 StringsOffset; /* string pool, NUL terminated names */
+		SizeType StringsSize;
+		UIntPtr	 HashOffset; /* symbol hash section, PEFHashHeader */
+		SizeType HashSize;
+		UIntPtr	 SegmentsOffset; /* PEFSegment table, page aligned images only */
+		SizeType SegmentCount;
+		SizeType Align; /* alignment of the segments (the page size), 0 when packed */
+	} PACKED PEFIndex;
+
+	/* A page aligned image maps file offset N at image base + N, a segment is one mapping. */
+	/* .zero64 has no file bytes, it is anonymous memory past the file backed segments. */
+
+	typedef struct PEFSegment final
+	{
+		UInt32	 Kind;		 /* kPefCode, kPefData or kPefZero */
+		UInt32	 Protection; /* kPefProt* */
+		UIntPtr	 FileOffset;
+		SizeType FileSize;
+		UIntPtr	 VirtualOffset; /* from the image base */
+		SizeType VirtualSize;
+	} PACKED PEFSegment;
+
+	typedef struct PEFCommandHeaderV4 final
+	{
+		UInt32	 Name;	 /* offset in the string pool */
+		UInt32	 Cpu;	 /* container cpu */
+		UInt32	 SubCpu; /* container sub-cpu */
+		UInt32	 Flags;	 /* container flags */
+		UInt16	 Kind;	 /* container kind */
+		UInt16	 Reserved;
+		UIntPtr	 Offset; /* file offset */
+		SizeType Size;	 /* file size */
+	} PACKED PEFCommandHeaderV4;
+
+	/* GNU style hash: BloomCount UInt64 words, BucketCount UInt32 buckets (first command of the bucket */
+	/* or kPefHashEmpty), then a UInt32 chain per command from SymbolBase on, the hash with the low bit */
+	/* set on the last command of a bucket. Commands below SymbolBase aren't hashed. */
+
+	typedef struct PEFHashHeader final
+	{
+		UInt32 BucketCount;
+		UInt32 SymbolBase;
+		UInt32 BloomCount;
+		UInt32 BloomShift;
+	} PACKED PEFHashHeader;
+
+	/* Fat image: PEFFatHeader, Count PEFFatSlice, then each slice, a whole image of one cpu at a */
+	/* page aligned offset. Offsets within a slice are from the slice start, so mapping a slice is */
+	/* mapping an image at Offset. */
+
+	typedef struct PEFFatHeader final
+	{
+		CharType Magic[kPefMagicLen]; /* kPefMagicFat */
+		UInt32	 Linker;
+		UInt32	 Version;
+		UInt32	 Count; /* PEFFatSlice count */
+		SizeType Align; /* alignment of the slices */
+	} PACKED PEFFatHeader;
+
+	typedef struct PEFFatSlice final
+	{
+		UInt32	 Cpu;
+		UInt32	 SubCpu;
+		UIntPtr	 Offset; /* file offset of the slice image */
+		SizeType Size;
+	} PACKED PEFFatSlice;
+
 	enum
 	{
 		kPefCode	 = 0xC,
@@ -113,6 +201,24 @@ namespace ToolchainKit
 		kPefCount	 = 4,
 		kPefInvalid	 = 0xFF,
 	};
+
+	enum
+	{
+		kPefProtRead  = 1,
+		kPefProtWrite = 2,
+		kPefProtExec  = 4,
+	};
+
+	/* Imports (v4): a command per symbol taken from a dylib, Offset is its pointer slot and calls go */
+	/* through a stub jumping through the slot. The loader binds every slot at load, unless the */
+	/* command has kPefBindLazy: the slot then holds the stub's lazy entry, which pushes the import */
+	/* index (the order of the import commands) and jumps through the kPefBinder slot. The loader puts */
+	/* its resolver there, the resolver writes the slot and jumps to the symbol. */
+
+	enum
+	{
+		kPefBindLazy = 1,
+	};
 } // namespace ToolchainKit
 
 inline std::ofstream& operator<<(std::ofstream&				 fp,
@@ -142,3 +248,41 @@ inline std::ifstream& operator>>(std::ifstream&					 fp,
 	fp.read((char*)&container, sizeof(ToolchainKit::PEFCommandHeader));
 	return fp;
 }
+
+namespace ToolchainKit::Utils
+{
+	/// @brief The name a v4 image hashes, without the segment prefix (.code64$__ImageStart -> __ImageStart).
+	inline const CharType* pef_symbol_name(const CharType* name)
+	{
+		for (auto segment : {kPefCode64 "$", kPefData64 "$", kPefZero64 "$"})
+		{
+			if (auto at = strstr(name, segment))
+				return at + strlen(segment);
+		}
+
+		return name;
+	}
+
+	/// @brief djb2, the hash of the GNU hash section.
+	inline UInt32 pef_hash(const CharType* name)
+	{
+		UInt32 hash = 5381U;
+
+		for (; *name; ++name)
+			hash = hash * 33U + static_cast<UInt8>(*name);
+
+		return hash;
+	}
+
+	/// @brief Sort the commands from symbol_base on by bucket and build their hash section.
+	/// @param strings the string pool the command names point in.
+	std::vector<CharType> pef_build_symbol_hash(std::vector<PEFCommandHeaderV4>& commands, SizeType symbol_base, const std::string& strings);
+
+	/// @brief Look a symbol up in a v4 image in memory, as a loader would.
+	/// @return false if the image isn't v4 or has no such symbol.
+	Bool pef_find_symbol(const CharType* image, SizeType size, const CharType* name, PEFCommandHeaderV4& command);
+
+	/// @brief Find the slice of cpu in a fat image in memory.
+	/// @return false if the image isn't fat or has no such slice.
+	Bool pef_find_slice(const CharType* image, SizeType size, UInt32 cpu, PEFFatSlice& slice);
+} // namespace ToolchainKit::Utils
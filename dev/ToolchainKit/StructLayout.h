@@ -0,0 +1,98 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+#pragma once
+
+#include <ToolchainKit/Defines.h>
+#include <unordered_map>
+
+/// @file StructLayout.h
+/// @brief Struct/class layout: offsets, padding and alignment of each member,
+/// so that member access becomes a displacement from the object's address.
+
+namespace ToolchainKit
+{
+	/// @brief A member, as the front end read it.
+	struct StructFieldDecl final
+	{
+		std::string fName;
+		std::string fType;
+		SizeType	fCount{1UL};	 // array length.
+		SizeType	fAlignAs{0UL}; // alignas(N), 0 when absent.
+		Bool		fHot{false};	 // [[hot]], first in line when reordering.
+		Bool		fPinned{false};	 // bases and the vtable pointer, never moved.
+	};
+
+	/// @brief A member, as laid out.
+	struct StructField final
+	{
+		std::string fName;
+		std::string fType;
+		SizeType	fOffset{0UL};
+		SizeType	fSize{0UL}; // whole member, arrays included.
+		SizeType	fAlign{1UL};
+		SizeType	fCount{1UL};
+	};
+
+	/// @brief What the attributes of a struct ask for.
+	struct StructLayoutHints final
+	{
+		SizeType fPack{0UL};	  // [[packed]] is 1, [[pack(N)]] is N, 0 is natural alignment.
+		SizeType fAlignAs{0UL};	  // alignas(N) on the struct.
+		Bool	 fReorder{false};	  // [[reorder]], sort by alignment to remove padding.
+		Bool	 fCacheLine{false}; // [[cacheline]], hot members share the first cache line.
+	};
+
+	struct StructLayout final
+	{
+		std::string				 fName;
+		std::vector<StructField> fFields; // by offset.
+		SizeType				 fSize{0UL};
+		SizeType				 fAlign{1UL};
+		SizeType				 fPadding{0UL}; // bytes lost to alignment.
+
+		/// @brief Find a member by name, nullptr if there is none.
+		const StructField* Find(const std::string& name) const;
+	};
+
+	/// @brief Computes and keeps the layouts of a translation unit.
+	/// Sizes follow LP64, the data model of our 64-bit targets.
+	class StructLayoutEngine final
+	{
+	public:
+		static constexpr SizeType kCacheLine   = 64UL;
+		static constexpr SizeType kPointerSize = 8UL;
+
+		explicit StructLayoutEngine();
+		~StructLayoutEngine() = default;
+
+		TOOLCHAINKIT_COPY_DEFAULT(StructLayoutEngine);
+
+		/// @brief Teach the engine a scalar type.
+		void AddScalar(const std::string& type, SizeType size, SizeType align);
+
+		/// @brief Size and alignment of type, scalars, pointers and known structs.
+		/// @return false if the type is unknown.
+		Bool SizeOf(const std::string& type, SizeType& size, SizeType& align) const;
+
+		/// @brief Lay out a struct and remember it.
+		/// @return the layout, nullptr and error if a member has an unknown type.
+		const StructLayout* Define(const std::string& name, const std::vector<StructFieldDecl>& fields, const StructLayoutHints& hints, std::string& error);
+
+		/// @brief Find a layout by name, nullptr if there is none.
+		const StructLayout* Find(const std::string& name) const;
+
+		/// @brief Forget every struct, scalars stay.
+		void Clear() noexcept;
+
+		/// @brief Drop qualifiers and struct/class keywords from a type name.
+		static std::string Normalize(const std::string& type);
+
+	private:
+		std::unordered_map<std::string, std::pair<SizeType, SizeType>> fScalars;
+		std::unordered_map<std::string, StructLayout>				   fLayouts;
+	};
+} // namespace ToolchainKit
@@ -0,0 +1,124 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+#pragma once
+
+#include <ToolchainKit/Defines.h>
+#include <deque>
+#include <unordered_map>
+
+/// @file SymbolTable.h
+/// @brief Hashed, block scoped symbol table for the front ends.
+
+namespace ToolchainKit
+{
+	/// @brief Index of an interned name.
+	typedef UInt32 SymbolId;
+
+	/// @brief Index of a scope, scopes are never reused so a scope id stays
+	/// valid after the scope is popped.
+	typedef Int32 ScopeId;
+
+	/// @brief Interns names, each distinct name is stored once.
+	class SymbolInterner final
+	{
+	public:
+		explicit SymbolInterner() = default;
+		~SymbolInterner()		  = default;
+
+		TOOLCHAINKIT_COPY_DEFAULT(SymbolInterner);
+
+		/// @brief Get the id of name, adds it if it's new.
+		SymbolId Intern(const std::string& name);
+
+		/// @brief Get the id of name without adding it.
+		/// @return false if it was never interned.
+		Bool Lookup(const std::string& name, SymbolId& id) const;
+
+		/// @brief Get the name behind id.
+		const std::string& Name(SymbolId id) const;
+
+		void Clear() noexcept;
+
+	private:
+		std::deque<std::string>				   fNames;
+		std::unordered_map<std::string, SymbolId> fIds;
+	};
+
+	struct SymbolEntry final
+	{
+		SymbolId	fName{0U};
+		ScopeId		fScope{0};
+		std::string fValue; // register, type or whatever the front end binds.
+	};
+
+	/// @brief Symbols by scope, a lookup walks from a scope to its parents,
+	/// each step being one hash lookup.
+	class SymbolTable final
+	{
+	public:
+		static constexpr ScopeId kGlobalScope = 0;
+		static constexpr ScopeId kNoScope	  = -1;
+
+		explicit SymbolTable();
+		~SymbolTable() = default;
+
+		TOOLCHAINKIT_COPY_DEFAULT(SymbolTable);
+
+		/// @brief Open a scope inside the current one.
+		/// @return the new scope.
+		ScopeId PushScope();
+
+		/// @brief Go back to the parent scope, the global scope is never popped.
+		/// @return the scope we're in now.
+		ScopeId PopScope() noexcept;
+
+		ScopeId Current() const noexcept
+		{
+			return fCurrent;
+		}
+
+		/// @brief How many scopes are open above the global one.
+		SizeType Depth() const noexcept;
+
+		/// @brief Declare name in the current scope.
+		/// @return the entry, the existing one if name is already declared in this scope.
+		const SymbolEntry& Declare(const std::string& name, const std::string& value = "");
+
+		/// @brief Find name from the current scope outwards.
+		const SymbolEntry* Find(const std::string& name) const;
+
+		/// @brief Find name from scope outwards.
+		const SymbolEntry* Find(const std::string& name, ScopeId scope) const;
+
+		/// @brief Find name in the current scope only.
+		const SymbolEntry* FindLocal(const std::string& name) const;
+
+		/// @brief Get the name of an entry.
+		const std::string& Name(const SymbolEntry& entry) const;
+
+		/// @brief How many symbols were declared, popped scopes included.
+		SizeType Size() const noexcept
+		{
+			return fEntries.size();
+		}
+
+		/// @brief Drop every symbol and scope, back to the global scope.
+		void Clear();
+
+	private:
+		struct SymbolScope final
+		{
+			ScopeId							  fParent{kNoScope};
+			std::unordered_map<SymbolId, SizeType> fSymbols;
+		};
+
+		std::vector<SymbolScope> fScopes;
+		std::deque<SymbolEntry>	 fEntries;
+		SymbolInterner			 fInterner;
+		ScopeId					 fCurrent{kGlobalScope};
+	};
+} // namespace ToolchainKit
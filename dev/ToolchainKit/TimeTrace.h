@@ -0,0 +1,111 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+#pragma once
+
+#include <ToolchainKit/Defines.h>
+
+/// @file TimeTrace.h
+/// @brief Time spans of the toolchain stages, written as Chrome trace events
+/// (chrome://tracing, Perfetto). Disabled, a span is one flag test.
+
+namespace ToolchainKit
+{
+	class TimeTrace final
+	{
+	public:
+		/// @brief Start recording, the trace goes to path on End().
+		static void Begin(const std::string& path);
+
+		/// @brief Write the trace and stop recording.
+		/// @return false if the file couldn't be written.
+		static Bool End();
+
+		static Bool Enabled() noexcept
+		{
+			return fEnabled;
+		}
+
+		/// @brief Microseconds since the trace began.
+		static UInt64 Now() noexcept;
+
+		/// @brief Record a span, name must outlive the trace (a literal).
+		static void Add(const char* name, const std::string& detail, UInt64 start, UInt64 end);
+
+		/// @brief Read a --<tool>:time-trace[=path] option.
+		/// @param fallback the path when none is given.
+		/// @return false if arg isn't one.
+		static Bool Option(const char* arg, const char* prefix, const std::string& fallback);
+
+	private:
+		static Bool fEnabled;
+	};
+
+	/// @brief Records the span of a scope.
+	class TimeTraceScope final
+	{
+	public:
+		explicit TimeTraceScope(const char* name)
+			: fName(TimeTrace::Enabled() ? name : nullptr)
+		{
+			if (fName)
+				fStart = TimeTrace::Now();
+		}
+
+		explicit TimeTraceScope(const char* name, const std::string& detail)
+			: fName(TimeTrace::Enabled() ? name : nullptr)
+		{
+			if (fName)
+			{
+				fDetail = detail;
+				fStart	= TimeTrace::Now();
+			}
+		}
+
+		~TimeTraceScope()
+		{
+			if (fName)
+				TimeTrace::Add(fName, fDetail, fStart, TimeTrace::Now());
+		}
+
+		TOOLCHAINKIT_COPY_DELETE(TimeTraceScope);
+
+	private:
+		const char* fName{nullptr};
+		std::string fDetail;
+		UInt64		fStart{0UL};
+	};
+
+	/// @brief Records a span per batch of items, for loops too hot for a span per item.
+	class TimeTraceBatch final
+	{
+	public:
+		static constexpr SizeType kDefaultSize = 1024UL;
+
+		explicit TimeTraceBatch(const char* name, const std::string& detail, SizeType size = kDefaultSize);
+		~TimeTraceBatch();
+
+		TOOLCHAINKIT_COPY_DELETE(TimeTraceBatch);
+
+		/// @brief One more item done.
+		void Tick()
+		{
+			if (fName && ++fCount - fFirst >= fSize)
+				this->Flush();
+		}
+
+	private:
+		void Flush();
+
+	private:
+		const char* fName{nullptr};
+		std::string fDetail;
+		SizeType	fSize{kDefaultSize};
+		SizeType	fFirst{0UL};
+		SizeType	fCount{0UL};
+		UInt64		fStart{0UL};
+	};
+} // namespace ToolchainKit
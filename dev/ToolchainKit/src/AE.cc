@@ -0,0 +1,282 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+/// @file AE.cc
+/// @brief AE record tables, v1 (fixed 255 byte names), v2 (string table and varints) and v3 (v2 and relocations),
+/// and the IR section of the objects built for link time optimization.
+
+#include <ToolchainKit/NFC/AE.h>
+#include <unordered_map>
+
+/// @brief no object has that many records, a bigger count is a corrupted header.
+#define kAERecordMax (1UL << 24)
+
+namespace Details
+{
+	static void ae_write_varint(std::ofstream& fp, UInt64 value)
+	{
+		do
+		{
+			UInt8 byte = value & 0x7F;
+			value >>= 7;
+
+			if (value)
+				byte |= 0x80;
+
+			fp.put(static_cast<CharType>(byte));
+		} while (value);
+	}
+
+	// small negative addends stay small.
+	static UInt64 ae_zigzag(Int64 value)
+	{
+		return (UInt64(value) << 1) ^ UInt64(value >> 63);
+	}
+
+	static Int64 ae_unzigzag(UInt64 value)
+	{
+		return Int64(value >> 1) ^ -Int64(value & 1);
+	}
+
+	static bool ae_read_varint(std::ifstream& fp, UInt64& value)
+	{
+		value = 0UL;
+
+		for (Int32 shift = 0; shift < 64; shift += 7)
+		{
+			auto byte = fp.get();
+
+			if (byte == std::ifstream::traits_type::eof())
+				return false;
+
+			value |= UInt64(byte & 0x7F) << shift;
+
+			if (!(byte & 0x80))
+				return true;
+		}
+
+		return false;
+	}
+} // namespace Details
+
+namespace ToolchainKit::Utils
+{
+	Bool ae_write_records(std::ofstream& fp, const std::vector<AERecordHeader>& records, CharType version)
+	{
+		if (version == kAEVersion1)
+		{
+			for (auto record : records)
+				fp << record;
+
+			return fp.good();
+		}
+
+		if (version != kAEVersion2)
+			return false;
+
+		return ae_write_records(fp, records, version, {});
+	}
+
+	Bool ae_write_records(std::ofstream& fp, const std::vector<AERecordHeader>& records, CharType version, const std::vector<AERelocation>& relocations)
+	{
+		if (version != kAEVersion2 && version != kAEVersion3)
+			return false;
+
+		if (version == kAEVersion2 && !relocations.empty())
+			return false;
+
+		std::string							 strings;
+		std::unordered_map<std::string, UInt32> offsets;
+
+		auto intern = [&](const std::string& name) {
+			auto [it, inserted] = offsets.try_emplace(name, strings.size());
+
+			if (inserted)
+			{
+				strings += name;
+				strings.push_back(0);
+			}
+
+			return it->second;
+		};
+
+		for (auto& record : records)
+		{
+			if (record.fKind > UINT16_MAX || record.fFlags > UINT16_MAX)
+				return false;
+
+			AERecordHeaderV2 compact{
+				.fName	= intern(std::string(record.fName, strnlen(record.fName, kAESymbolLen))),
+				.fKind	= static_cast<UInt16>(record.fKind),
+				.fFlags = static_cast<UInt16>(record.fFlags)};
+
+			fp.write(reinterpret_cast<const CharType*>(&compact), sizeof(AERecordHeaderV2));
+		}
+
+		for (auto& record : records)
+		{
+			Details::ae_write_varint(fp, record.fSize);
+			Details::ae_write_varint(fp, record.fOffset);
+		}
+
+		for (auto& relocation : relocations)
+			intern(relocation.fSymbol);
+
+		Details::ae_write_varint(fp, strings.size());
+		fp.write(strings.data(), strings.size());
+
+		if (version == kAEVersion3)
+		{
+			Details::ae_write_varint(fp, relocations.size());
+
+			for (auto& relocation : relocations)
+			{
+				Details::ae_write_varint(fp, relocation.fType);
+				Details::ae_write_varint(fp, relocation.fOffset);
+				Details::ae_write_varint(fp, Details::ae_zigzag(relocation.fAddend));
+				Details::ae_write_varint(fp, offsets[relocation.fSymbol]);
+			}
+		}
+
+		return fp.good();
+	}
+
+	Bool ae_read_records(std::ifstream& fp, const AEHeader& hdr, std::vector<AERecordHeader>& records)
+	{
+		std::vector<AERelocation> relocations;
+		return ae_read_records(fp, hdr, records, relocations);
+	}
+
+	Bool ae_read_records(std::ifstream& fp, const AEHeader& hdr, std::vector<AERecordHeader>& records, std::vector<AERelocation>& relocations)
+	{
+		records.clear();
+		relocations.clear();
+
+		if (hdr.fCount > kAERecordMax)
+			return false;
+
+		if (hdr.fVersion == kAEVersion1)
+		{
+			records.resize(hdr.fCount);
+
+			for (auto& record : records)
+				fp >> record;
+
+			return fp.good();
+		}
+
+		if (hdr.fVersion != kAEVersion2 && hdr.fVersion != kAEVersion3)
+			return false;
+
+		std::vector<AERecordHeaderV2> compact(hdr.fCount);
+
+		fp.read(reinterpret_cast<CharType*>(compact.data()), compact.size() * sizeof(AERecordHeaderV2));
+
+		if (!fp.good())
+			return false;
+
+		records.resize(hdr.fCount);
+
+		for (SizeType index = 0; index < compact.size(); ++index)
+		{
+			UInt64 size = 0UL, offset = 0UL;
+
+			if (!Details::ae_read_varint(fp, size) || !Details::ae_read_varint(fp, offset))
+				return false;
+
+			auto& record = records[index];
+
+			memset(&record, 0, sizeof(AERecordHeader));
+
+			record.fKind   = compact[index].fKind;
+			record.fFlags  = compact[index].fFlags;
+			record.fSize   = size;
+			record.fOffset = offset;
+		}
+
+		UInt64 strings_size = 0UL;
+
+		if (!Details::ae_read_varint(fp, strings_size) || strings_size > kAERecordMax * kAESymbolLen)
+			return false;
+
+		std::string strings(strings_size, 0);
+		fp.read(strings.data(), strings_size);
+
+		if (!fp.good())
+			return false;
+
+		for (SizeType index = 0; index < compact.size(); ++index)
+		{
+			auto at = compact[index].fName;
+
+			if (at >= strings.size())
+				return false;
+
+			auto name = strings.c_str() + at;
+			memcpy(records[index].fName, name, std::min<SizeType>(strnlen(name, strings.size() - at), kAESymbolLen - 1));
+		}
+
+		if (hdr.fVersion != kAEVersion3)
+			return true;
+
+		UInt64 count = 0UL;
+
+		if (!Details::ae_read_varint(fp, count) || count > kAERecordMax)
+			return false;
+
+		relocations.resize(count);
+
+		for (auto& relocation : relocations)
+		{
+			UInt64 type = 0UL, addend = 0UL, name = 0UL;
+
+			if (!Details::ae_read_varint(fp, type) || !Details::ae_read_varint(fp, relocation.fOffset) ||
+				!Details::ae_read_varint(fp, addend) || !Details::ae_read_varint(fp, name))
+				return false;
+
+			if (type == kAERelocInvalid || type >= kAERelocCount || name >= strings.size())
+				return false;
+
+			relocation.fType   = type;
+			relocation.fAddend = Details::ae_unzigzag(addend);
+			relocation.fSymbol = strings.c_str() + name;
+		}
+
+		return true;
+	}
+
+	Bool ae_write_ir(std::ofstream& fp, const std::string& ir)
+	{
+		fp.write(kAEIRMagic, kAEIRMagicLen);
+
+		Details::ae_write_varint(fp, ir.size());
+		fp.write(ir.data(), ir.size());
+
+		return fp.good();
+	}
+
+	Bool ae_read_ir(std::ifstream& fp, const AEHeader& hdr, std::string& ir)
+	{
+		CharType magic[kAEIRMagicLen] = {0};
+
+		fp.clear();
+		fp.seekg(std::streamoff(hdr.fStartCode + hdr.fCodeSize));
+		fp.read(magic, kAEIRMagicLen);
+
+		if (!fp.good() || memcmp(magic, kAEIRMagic, kAEIRMagicLen) != 0)
+			return false;
+
+		UInt64 size = 0UL;
+
+		if (!Details::ae_read_varint(fp, size) || size > kAERecordMax * kAESymbolLen)
+			return false;
+
+		ir.resize(size);
+		fp.read(ir.data(), size);
+
+		return fp.good();
+	}
+} // namespace ToolchainKit::Utils
@@ -21,8 +21,10 @@
 
 #include <ToolchainKit/AAL/CPU/64x0.h>
 #include <ToolchainKit/Parser.h>
+#include <ToolchainKit/TimeTrace.h>
 #include <ToolchainKit/NFC/AE.h>
 #include <ToolchainKit/NFC/PEF.h>
+#include <ToolchainKit/IR.h>
 #include <Algorithms>
 #include <filesystem>
 #include <fstream>
@@ -43,32 +45,42 @@
 #define kStdOut (std::cout << kWhite)
 #define kStdErr (std::cout << kRed)
 
-static char	   kOutputArch	   = ToolchainKit::kPefArch64000;
-static Boolean kOutputAsBinary = false;
+/* thread local, ld64 assembles the partitions of a link time optimized program in parallel. */
+static thread_local char	kOutputArch		= ToolchainKit::kPefArch64000;
+static thread_local Boolean kOutputAsBinary = false;
 
-static UInt32 kErrorLimit		= 10;
-static UInt32 kAcceptableErrors = 0;
+/// @brief AE version of the objects, v1 is for linkers predating v2.
+static thread_local CharType kObjectVersion = kAEVersion2;
+
+static thread_local UInt32 kErrorLimit		  = 10;
+static thread_local UInt32 kAcceptableErrors = 0;
 
 constexpr auto c64x0IPAlignment = 0x4U;
 
-static std::size_t kCounter = 1UL;
+static thread_local std::size_t kCounter = 1UL;
 
-static std::uintptr_t									   kOrigin = kPefBaseOrigin;
-static std::vector<std::pair<std::string, std::uintptr_t>> kOriginLabel;
+static thread_local std::uintptr_t										kOrigin = kPefBaseOrigin;
+static thread_local std::vector<std::pair<std::string, std::uintptr_t>> kOriginLabel;
 
-static bool kVerbose = false;
+static thread_local bool kVerbose = false;
 
-static std::vector<e64k_num_t> kBytes;
+static thread_local std::vector<e64k_num_t> kBytes;
 
-static ToolchainKit::AERecordHeader kCurrentRecord{
+static thread_local ToolchainKit::AERecordHeader kCurrentRecord{
 	.fName = "", .fKind = ToolchainKit::kPefCode, .fSize = 0, .fOffset = 0};
 
-static std::vector<ToolchainKit::AERecordHeader> kRecords;
-static std::vector<std::string>			kUndefinedSymbols;
+static thread_local std::vector<ToolchainKit::AERecordHeader> kRecords;
+static thread_local std::vector<std::string>					kUndefinedSymbols;
 
 static const std::string kUndefinedSymbol = ":UndefinedSymbol:";
 static const std::string kRelocSymbol	  = ":RuntimeSymbol:";
 
+/// @brief the fields ld64 fills with a symbol address, offsets are in kBytes.
+static thread_local std::vector<ToolchainKit::AERelocation> kRelocations;
+
+/// @brief the IR section, what the kIRDirective lines carry.
+static thread_local std::string kIRSection;
+
 // \brief forward decl.
 static bool asm_read_attributes(std::string& line);
 
@@ -84,11 +96,6 @@ namespace Details
 									: ("FileException{ " + file + " }: "))
 				<< kBlank << std::endl;
 		kStdErr << kRed << "[ ToolchainKit ] " << kWhite << reason << kBlank << std::endl;
-
-		if (kAcceptableErrors > kErrorLimit)
-			std::exit(3);
-
-		++kAcceptableErrors;
 	}
 
 	void print_warning_asm(std::string reason, std::string file) noexcept
@@ -113,6 +120,22 @@ namespace Details
 
 TOOLCHAINKIT_MODULE(AssemblerMain64x0)
 {
+	// the module may run many times in one process (asm, tkd), start clean.
+	kOutputAsBinary	  = false;
+	kObjectVersion	  = kAEVersion2;
+	kVerbose		  = false;
+	kAcceptableErrors = 0;
+	kCounter		  = 1UL;
+	kOrigin			  = kPefBaseOrigin;
+	kCurrentRecord	  = {.fName = "", .fKind = ToolchainKit::kPefCode, .fSize = 0, .fFlags = 0, .fOffset = 0, .fPad = {}};
+
+	kOriginLabel.clear();
+	kRelocations.clear();
+	kBytes.clear();
+	kRecords.clear();
+	kUndefinedSymbols.clear();
+	kIRSection.clear();
+
 	for (size_t i = 1; i < argc; ++i)
 	{
 		if (argv[i][0] == '-')
@@ -130,6 +153,7 @@ TOOLCHAINKIT_MODULE(AssemblerMain64x0)
 				kStdOut << "--version: Print program version.\n";
 				kStdOut << "--verbose: Print verbose output.\n";
 				kStdOut << "--binary: Output as flat binary.\n";
+				kStdOut << "--ae-v1: Output v1 objects, for older linkers.\n";
 				kStdOut << "--64xxx: Compile for a subset of the X64000.\n";
 
 				return 0;
@@ -139,6 +163,11 @@ TOOLCHAINKIT_MODULE(AssemblerMain64x0)
 				kOutputAsBinary = true;
 				continue;
 			}
+			else if (strcmp(argv[i], "--ae-v1") == 0)
+			{
+				kObjectVersion = kAEVersion1;
+				continue;
+			}
 			else if (strcmp(argv[i], "--verbose") == 0)
 			{
 				kVerbose = true;
@@ -180,14 +209,15 @@ TOOLCHAINKIT_MODULE(AssemblerMain64x0)
 
 		std::string line;
 
-		ToolchainKit::AEHeader hdr{0};
+		ToolchainKit::AEHeader hdr{};
 
-		memset(hdr.fPad, kAENullType, kAEPad);
+		memset(hdr.fPad, kAENullType, sizeof(hdr.fPad));
 
 		hdr.fMagic[0] = kAEMag0;
 		hdr.fMagic[1] = kAEMag1;
 		hdr.fSize	  = sizeof(ToolchainKit::AEHeader);
 		hdr.fArch	  = kOutputArch;
+		hdr.fVersion  = kObjectVersion;
 
 		/////////////////////////////////////////////////////////////////////////////////////////
 
@@ -197,11 +227,22 @@ TOOLCHAINKIT_MODULE(AssemblerMain64x0)
 
 		ToolchainKit::Encoder64x0 asm64;
 
+		ToolchainKit::TimeTraceScope trace("Assemble", argv[i]);
+		ToolchainKit::TimeTraceBatch trace_lines("WriteLine", argv[i]);
+
 		while (std::getline(file_ptr, line))
 		{
 			if (auto ln = asm64.CheckLine(line, argv[i]); !ln.empty())
 			{
 				Details::print_error_asm(ln, argv[i]);
+
+				// too many errors, fail the module; exiting would take tkd down with it.
+				if (++kAcceptableErrors > kErrorLimit)
+				{
+					std::filesystem::remove(object_output);
+					goto asm_fail_exit;
+				}
+
 				continue;
 			}
 
@@ -209,6 +250,8 @@ TOOLCHAINKIT_MODULE(AssemblerMain64x0)
 			{
 				asm_read_attributes(line);
 				asm64.WriteLine(line, argv[i]);
+
+				trace_lines.Tick();
 			}
 			catch (const std::exception& e)
 			{
@@ -236,6 +279,19 @@ TOOLCHAINKIT_MODULE(AssemblerMain64x0)
 
 			hdr.fCount = kRecords.size() + kUndefinedSymbols.size();
 
+			if (!kRelocations.empty())
+			{
+				if (kObjectVersion == kAEVersion1)
+				{
+					kStdErr << "Assembler64x0: " << argv[i] << " refers to symbols, v1 objects can't carry relocations.\n";
+
+					std::filesystem::remove(object_output);
+					return 1;
+				}
+
+				hdr.fVersion = kAEVersion3;
+			}
+
 			file_ptr_out << hdr;
 
 			if (kRecords.empty())
@@ -249,7 +305,8 @@ TOOLCHAINKIT_MODULE(AssemblerMain64x0)
 
 			kRecords[kRecords.size() - 1].fSize = kBytes.size();
 
-			std::size_t record_count = 0UL;
+			std::vector<ToolchainKit::AERecordHeader> records;
+			std::size_t								  record_count = 0UL;
 
 			for (auto& rec : kRecords)
 			{
@@ -260,7 +317,7 @@ TOOLCHAINKIT_MODULE(AssemblerMain64x0)
 				rec.fOffset = record_count;
 				++record_count;
 
-				file_ptr_out << rec;
+				records.push_back(rec);
 			}
 
 			// increment once again, so that we won't lie about the kUndefinedSymbols.
@@ -282,11 +339,20 @@ TOOLCHAINKIT_MODULE(AssemblerMain64x0)
 				memset(_record_hdr.fPad, kAENullType, kAEPad);
 				memcpy(_record_hdr.fName, sym.c_str(), sym.size());
 
-				file_ptr_out << _record_hdr;
+				records.push_back(_record_hdr);
 
 				++kCounter;
 			}
 
+			if (!(kRelocations.empty() ? ToolchainKit::Utils::ae_write_records(file_ptr_out, records, kObjectVersion)
+									   : ToolchainKit::Utils::ae_write_records(file_ptr_out, records, kAEVersion3, kRelocations)))
+			{
+				kStdErr << "Assembler64x0: can't write the records of " << object_output << ".\n";
+
+				std::filesystem::remove(object_output);
+				return 1;
+			}
+
 			auto pos_end = file_ptr_out.tellp();
 
 			file_ptr_out.seekp(pos);
@@ -312,6 +378,15 @@ TOOLCHAINKIT_MODULE(AssemblerMain64x0)
 			file_ptr_out.write(reinterpret_cast<const char*>(&byte), sizeof(byte));
 		}
 
+		// ld64 finds it after the code, --ld64:lto.
+		if (!kIRSection.empty() && !ToolchainKit::Utils::ae_write_ir(file_ptr_out, kIRSection))
+		{
+			kStdErr << "Assembler64x0: can't write the IR section of " << object_output << ".\n";
+
+			std::filesystem::remove(object_output);
+			return 1;
+		}
+
 		if (kVerbose)
 			kStdOut << "Assembler64x0: Wrote file with program in it.\n";
 
@@ -341,9 +416,28 @@ asm_fail_exit:
 
 static bool asm_read_attributes(std::string& line)
 {
+	// the IR of the object, ld64 optimizes the program with it at link time.
+	if (ToolchainKit::find_word(line, kIRDirective))
+	{
+		if (kOutputAsBinary)
+		{
+			Details::print_error_asm("Invalid " kIRDirective " directive in flat binary mode.",
+									"ToolchainKit");
+			throw std::runtime_error("invalid_ir_bin");
+		}
+
+		if (!ToolchainKit::ir_read_directive(line, kIRSection))
+		{
+			Details::print_error_asm("Invalid " kIRDirective " directive.", "ToolchainKit");
+			throw std::runtime_error("invalid_ir");
+		}
+
+		line.clear();
+		return true;
+	}
 	// extern_segment is the opposite of public_segment, it signals to the ld
 	// that we need this symbol.
-	if (ToolchainKit::find_word(line, "extern_segment"))
+	else if (ToolchainKit::find_word(line, "extern_segment"))
 	{
 		if (kOutputAsBinary)
 		{
@@ -522,7 +616,7 @@ std::string ToolchainKit::Encoder64x0::CheckLine(std::string&	   line,
 	std::string err_str;
 
 	if (line.empty() || ToolchainKit::find_word(line, "extern_segment") ||
-		ToolchainKit::find_word(line, "public_segment") ||
+		ToolchainKit::find_word(line, "public_segment") || ToolchainKit::find_word(line, kIRDirective) ||
 		line.find('#') != std::string::npos || ToolchainKit::find_word(line, ";"))
 	{
 		if (line.find('#') != std::string::npos)
@@ -1001,6 +1095,7 @@ bool ToolchainKit::Encoder64x0::WriteLine(std::string&		line,
 				if (cpy_jump_label.find('\n') != std::string::npos)
 					cpy_jump_label.erase(cpy_jump_label.find('\n'), 1);
 
+				// the symbol is found the same way, defined here or not.
 				if (cpy_jump_label.find("extern_segment") != std::string::npos)
 				{
 					cpy_jump_label.erase(cpy_jump_label.find("extern_segment"), strlen("extern_segment"));
@@ -1011,35 +1106,10 @@ bool ToolchainKit::Encoder64x0::WriteLine(std::string&		line,
 												file);
 						throw std::runtime_error("extern_segment_sta_op");
 					}
-					else
-					{
-						goto asm_end_label_cpy;
-					}
 				}
 
 				if (name == "lda" || name == "sta")
 				{
-					for (auto& label : kOriginLabel)
-					{
-						if (cpy_jump_label == label.first)
-						{
-							if (kVerbose)
-							{
-								kStdOut << "Assembler64x0: Replace label " << cpy_jump_label
-										<< " to address: " << label.second << std::endl;
-							}
-
-							ToolchainKit::NumberCast64 num(label.second);
-
-							for (auto& num : num.number)
-							{
-								kBytes.push_back(num);
-							}
-
-							goto asm_end_label_cpy;
-						}
-					}
-
 					if (cpy_jump_label[0] == '0')
 					{
 						switch (cpy_jump_label[1])
@@ -1077,30 +1147,26 @@ bool ToolchainKit::Encoder64x0::WriteLine(std::string&		line,
 				if (name == "ldw" || name == "stw")
 					break;
 
-				auto mld_reloc_str = std::to_string(cpy_jump_label.size());
-				mld_reloc_str += kUndefinedSymbol;
-				mld_reloc_str += cpy_jump_label;
-
-				bool ignore_back_slash = false;
+				if (kOutputAsBinary)
+				{
+					Details::print_error_asm("A symbol needs an object, not a flat binary: " + cpy_jump_label, file);
+					throw std::runtime_error("symbol_in_binary");
+				}
 
-				for (auto& reloc_chr : mld_reloc_str)
+				// the spaces are gone, .code64 foo reads .code64foo here.
+				for (auto segment : {kPefCode64, kPefData64, kPefZero64})
 				{
-					if (reloc_chr == '\\')
-					{
-						ignore_back_slash = true;
-						continue;
-					}
+					if (cpy_jump_label.rfind(segment, 0) == 0 && cpy_jump_label[strlen(segment)] != '$')
+						cpy_jump_label.insert(strlen(segment), "$");
+				}
 
-					if (ignore_back_slash)
-					{
-						ignore_back_slash = false;
-						continue;
-					}
+				if (kVerbose)
+					kStdOut << "Assembler64x0: Relocate " << cpy_jump_label << " at " << kBytes.size() << std::endl;
 
-					kBytes.push_back(reloc_chr);
-				}
+				// ld64 writes the address of the symbol there.
+				kRelocations.push_back({ToolchainKit::Utils::pef_symbol_name(cpy_jump_label.c_str()), kBytes.size(), 0L, ToolchainKit::kAERelocAbs64});
+				kBytes.insert(kBytes.end(), sizeof(UInt64), 0);
 
-				kBytes.push_back('\0');
 				goto asm_end_label_cpy;
 			}
 
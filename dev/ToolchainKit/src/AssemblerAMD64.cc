@@ -16,8 +16,7 @@
 
 /// bugs: 0
 
-/// feature request: 1
-/// Encode registers in mov, add, xor...
+/// feature request: 0
 
 /////////////////////////////////////////////////////////////////////////////////////////
 
@@ -28,13 +27,18 @@
 
 #include <ToolchainKit/AAL/CPU/amd64.h>
 #include <ToolchainKit/Parser.h>
+#include <ToolchainKit/TimeTrace.h>
 #include <ToolchainKit/NFC/AE.h>
 #include <ToolchainKit/NFC/PEF.h>
+#include <ToolchainKit/IR.h>
 #include <Algorithms>
+#include <charconv>
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <set>
 #include <vector>
 
 /////////////////////
@@ -51,85 +55,137 @@
 #define kStdOut (std::cout << kWhite)
 #define kStdErr (std::cout << kRed)
 
-static char	   kOutputArch	   = ToolchainKit::kPefArchAMD64;
-static Boolean kOutputAsBinary = false;
+/* thread local, ld64 assembles the partitions of a link time optimized program in parallel. */
+static thread_local char	kOutputArch		= ToolchainKit::kPefArchAMD64;
+static thread_local Boolean kOutputAsBinary = false;
 
-static UInt32 kErrorLimit		= 10;
-static UInt32 kAcceptableErrors = 0;
+/// @brief AE version of the objects, v1 is for linkers predating v2.
+static thread_local CharType kObjectVersion = kAEVersion2;
 
-constexpr auto kIPAlignement = 0x4U;
+static thread_local UInt32 kErrorLimit		  = 10;
+static thread_local UInt32 kAcceptableErrors = 0;
 
-static std::size_t kCounter = 1UL;
+static thread_local std::size_t kCounter = 1UL;
 
-static std::uintptr_t									   kOrigin = kPefBaseOrigin;
-static std::vector<std::pair<std::string, std::uintptr_t>> kOriginLabel;
+/// @brief the address of the first byte (#org), the labels are at kOrigin + their offset.
+static thread_local std::uintptr_t										kOrigin = kPefBaseOrigin;
+static thread_local std::vector<std::pair<std::string, std::uintptr_t>> kOriginLabel;
 
-/// @brief keep it simple by default.
-static std::int32_t kRegisterBitWidth = 16U;
+static thread_local bool kVerbose = false;
 
-static bool kVerbose = false;
+static thread_local std::vector<i64_byte_t> kAppBytes;
 
-static std::vector<i64_byte_t> kAppBytes;
-
-static ToolchainKit::AERecordHeader kCurrentRecord{
+static thread_local ToolchainKit::AERecordHeader kCurrentRecord{
 	.fName = "", .fKind = ToolchainKit::kPefCode, .fSize = 0, .fOffset = 0};
 
-static std::vector<ToolchainKit::AERecordHeader> kRecords;
-static std::vector<std::string>			kDefinedSymbols;
-static std::vector<std::string>			kUndefinedSymbols;
+static thread_local std::vector<ToolchainKit::AERecordHeader> kRecords;
+static thread_local std::vector<std::string>					kDefinedSymbols;
+static thread_local std::vector<std::string>					kUndefinedSymbols;
 
 static const std::string kUndefinedSymbol = ":UndefinedSymbol:";
 
+/// @brief the fields ld64 fills with a symbol address, offsets are in kAppBytes.
+static thread_local std::vector<ToolchainKit::AERelocation> kRelocations;
+
+/// @brief the IR section, what the kIRDirective lines carry.
+static thread_local std::string kIRSection;
+
+/// @brief the local labels (a line "name:"), their record, and their address in this pass and the one before.
+static thread_local std::map<std::string, SizeType>		 kLabelRecords;
+static thread_local std::map<std::string, std::uintptr_t> kLocalLabels;
+static thread_local std::map<std::string, std::uintptr_t> kLocalLabelsPrev;
+
+/// @brief the branches to a number or a label, in order; those out of rel8 reach stay rel32 for the next passes.
+static thread_local SizeType		   kBranchCounter = 0UL;
+static thread_local std::set<SizeType> kNearBranches;
+
 // \brief forward decl.
 static bool asm_read_attributes(std::string& line);
 
 #include <AsmUtils.h>
 
-/////////////////////////////////////////////////////////////////////////////////////////
+/// @brief ld64 fills the field at offset of kAppBytes with symbol.
+static void asm_relocate(const std::string& symbol, UInt16 type, SizeType offset, Int64 addend)
+{
+	if (kOutputAsBinary)
+	{
+		Details::print_error_asm("A symbol needs an object, not a flat binary: " + symbol, "ToolchainKit");
+		throw std::runtime_error("symbol_in_binary");
+	}
 
-// @brief AMD64 assembler entrypoint, the program/module starts here.
+	kRelocations.push_back({ToolchainKit::Utils::pef_symbol_name(symbol.c_str()), offset, addend, type});
+}
 
-/////////////////////////////////////////////////////////////////////////////////////////
+/// @brief Write a field for symbol, zero until ld64 relocates it.
+static void asm_write_relocation(const std::string& symbol, UInt16 type, SizeType width, Int64 addend)
+{
+	asm_relocate(symbol, type, kAppBytes.size(), addend);
+	kAppBytes.insert(kAppBytes.end(), width, 0);
+}
 
-TOOLCHAINKIT_MODULE(AssemblerAMD64)
+/// @brief A local label is a line "name:", it names an offset of its record and isn't exported.
+static bool asm_label_name(const std::string& line, std::string& name)
 {
-	//////////////// CPU OPCODES BEGIN ////////////////
+	auto first = line.find_first_not_of(" \t");
+	auto colon = line.find(':');
+
+	if (first == std::string::npos || colon == std::string::npos || colon == first ||
+		line.find_first_not_of(" \t", colon + 1) != std::string::npos || isdigit(line[first]))
+		return false;
 
-	std::string opcodes_jump[kJumpLimit] = {
-		"ja", "jae", "jb", "jbe", "jc", "je", "jg", "jge", "jl", "jle",
-		"jna", "jnae", "jnb", "jnbe", "jnc", "jne", "jng", "jnge", "jnl", "jnle",
-		"jno", "jnp", "jns", "jnz", "jo", "jp", "jpe", "jpo", "js", "jz"};
+	name = line.substr(first, colon - first);
 
-	for (i64_hword_t i = 0; i < kJumpLimit; i++)
-	{
-		CpuOpcodeAMD64 code{
-			.fName	 = opcodes_jump[i],
-			.fOpcode = static_cast<i64_hword_t>(kAsmJumpOpcode + i)};
-		kOpcodesAMD64.push_back(code);
-	}
+	return std::find_if(name.begin(), name.end(), [](char ch) { return !isalnum(ch) && ch != '_' && ch != '.' && ch != '$' && ch != '@'; }) == name.end();
+}
 
-	CpuOpcodeAMD64 code{.fName = "jcxz", .fOpcode = 0xE3};
-	kOpcodesAMD64.push_back(code);
+/// @brief The address of the local label name; one below this line is where the last pass put it, or here on the first.
+static bool asm_label_address(const std::string& name, std::uintptr_t& address, const std::string& file)
+{
+	auto record = kLabelRecords.find(name);
+
+	if (record == kLabelRecords.end())
+		return false;
 
-	for (i64_hword_t i = kJumpLimitStandard; i < kJumpLimitStandardLimit; i++)
+	if (record->second != kRecords.size())
 	{
-		CpuOpcodeAMD64 code{.fName = "jmp", .fOpcode = i};
-		kOpcodesAMD64.push_back(code);
+		Details::print_error_asm("Local label of another record, make it a public_segment: " + name, file);
+		throw std::runtime_error("label_out_of_record");
 	}
 
-	CpuOpcodeAMD64 lahf{.fName = "lahf", .fOpcode = 0x9F};
-	kOpcodesAMD64.push_back(lahf);
+	if (auto label = kLocalLabels.find(name); label != kLocalLabels.end())
+		address = label->second;
+	else if (auto label = kLocalLabelsPrev.find(name); label != kLocalLabelsPrev.end())
+		address = label->second;
+	else
+		address = kOrigin + kAppBytes.size();
+
+	return true;
+}
 
-	CpuOpcodeAMD64 lds{.fName = "lds", .fOpcode = 0xC5};
-	kOpcodesAMD64.push_back(lds);
+/////////////////////////////////////////////////////////////////////////////////////////
 
-	CpuOpcodeAMD64 lea{.fName = "lea", .fOpcode = 0x8D};
-	kOpcodesAMD64.push_back(lea);
+// @brief AMD64 assembler entrypoint, the program/module starts here.
 
-	CpuOpcodeAMD64 nop{.fName = "nop", .fOpcode = 0x90};
-	kOpcodesAMD64.push_back(nop);
+/////////////////////////////////////////////////////////////////////////////////////////
 
-	//////////////// CPU OPCODES END ////////////////
+TOOLCHAINKIT_MODULE(AssemblerAMD64)
+{
+	// the module may run many times in one process (cl, tkd), start clean.
+	kOutputAsBinary	  = false;
+	kObjectVersion	  = kAEVersion2;
+	kVerbose		  = false;
+	kAcceptableErrors = 0;
+	kCounter		  = 1UL;
+	kOrigin			  = kPefBaseOrigin;
+	kCurrentRecord	  = {.fName = "", .fKind = ToolchainKit::kPefCode, .fSize = 0, .fFlags = 0, .fOffset = 0, .fPad = {}};
+
+	kOriginLabel.clear();
+	kAppBytes.clear();
+	kRecords.clear();
+	kDefinedSymbols.clear();
+	kUndefinedSymbols.clear();
+	kRelocations.clear();
+	kIRSection.clear();
 
 	for (size_t i = 1; i < argc; ++i)
 	{
@@ -148,6 +204,7 @@ TOOLCHAINKIT_MODULE(AssemblerAMD64)
 				kStdOut << "--version: Print program version.\n";
 				kStdOut << "--verbose: Print verbose output.\n";
 				kStdOut << "--binary: Output as flat binary.\n";
+				kStdOut << "--amd64:ae-v1: Output v1 objects, for older linkers.\n";
 
 				return 0;
 			}
@@ -156,6 +213,11 @@ TOOLCHAINKIT_MODULE(AssemblerAMD64)
 				kOutputAsBinary = true;
 				continue;
 			}
+			else if (strcmp(argv[i], "--amd64:ae-v1") == 0)
+			{
+				kObjectVersion = kAEVersion1;
+				continue;
+			}
 			else if (strcmp(argv[i], "--amd64:verbose") == 0)
 			{
 				kVerbose = true;
@@ -203,14 +265,15 @@ TOOLCHAINKIT_MODULE(AssemblerAMD64)
 
 		std::string line;
 
-		ToolchainKit::AEHeader hdr{0};
+		ToolchainKit::AEHeader hdr{};
 
-		memset(hdr.fPad, kAENullType, kAEPad);
+		memset(hdr.fPad, kAENullType, sizeof(hdr.fPad));
 
 		hdr.fMagic[0] = kAEMag0;
 		hdr.fMagic[1] = kAEMag1;
 		hdr.fSize	  = sizeof(ToolchainKit::AEHeader);
 		hdr.fArch	  = kOutputArch;
+		hdr.fVersion  = kObjectVersion;
 
 		/////////////////////////////////////////////////////////////////////////////////////////
 
@@ -226,37 +289,95 @@ TOOLCHAINKIT_MODULE(AssemblerAMD64)
 			kStdOut << "From: " + line << "\n";
 		}
 
+		ToolchainKit::TimeTraceScope trace("Assemble", argv[i]);
+		ToolchainKit::TimeTraceBatch trace_lines("WriteLine", argv[i]);
+
+		std::vector<std::string> lines;
+		SizeType				 records = 0UL;
+
+		kLabelRecords.clear();
+		kLocalLabelsPrev.clear();
+		kNearBranches.clear();
+
 		while (std::getline(file_ptr, line))
 		{
 			if (auto ln = asm64.CheckLine(line, argv[i]); !ln.empty())
 			{
 				Details::print_error_asm(ln, argv[i]);
+
+				// past the error limit, fail this file; ld64 assembles in process too.
+				if (++kAcceptableErrors > kErrorLimit)
+				{
+					std::filesystem::remove(object_output);
+					goto asm_fail_exit;
+				}
+
 				continue;
 			}
 
-			try
-			{
-				asm_read_attributes(line);
-				asm64.WriteLine(line, argv[i]);
-			}
-			catch (const std::exception& e)
+			// a label belongs to the record above it, the same record as its branches.
+			if (std::string label; asm_label_name(line, label))
+				kLabelRecords[label] = records;
+			else if (!ToolchainKit::find_word(line, kIRDirective) &&
+					 (ToolchainKit::find_word(line, "public_segment") || ToolchainKit::find_word(line, "extern_segment")))
+				++records;
+
+			lines.push_back(line);
+		}
+
+		// lay the file out until the labels stay put: a branch is rel8 until its label is out of reach,
+		// then rel32 for good, which moves the labels after it. branches only grow, so this ends.
+		for (;;)
+		{
+			kOrigin		   = kPefBaseOrigin;
+			kCounter	   = 1UL;
+			kCurrentRecord = {.fName = "", .fKind = ToolchainKit::kPefCode, .fSize = 0, .fFlags = 0, .fOffset = 0, .fPad = {}};
+			kBranchCounter = 0UL;
+
+			kOriginLabel.clear();
+			kAppBytes.clear();
+			kRecords.clear();
+			kDefinedSymbols.clear();
+			kUndefinedSymbols.clear();
+			kRelocations.clear();
+			kIRSection.clear();
+			kLocalLabels.clear();
+
+			for (auto& source : lines)
 			{
-				if (kVerbose)
-				{
-					std::string what = e.what();
-					Details::print_warning_asm("exit because of: " + what, "ToolchainKit");
-				}
+				line = source;
 
 				try
 				{
-					std::filesystem::remove(object_output);
+					asm_read_attributes(line);
+					asm64.WriteLine(line, argv[i]);
+
+					trace_lines.Tick();
 				}
-				catch (...)
+				catch (const std::exception& e)
 				{
-				}
+					if (kVerbose)
+					{
+						std::string what = e.what();
+						Details::print_warning_asm("exit because of: " + what, "ToolchainKit");
+					}
+
+					try
+					{
+						std::filesystem::remove(object_output);
+					}
+					catch (...)
+					{
+					}
 
-				goto asm_fail_exit;
+					goto asm_fail_exit;
+				}
 			}
+
+			if (kLocalLabels == kLocalLabelsPrev)
+				break;
+
+			kLocalLabelsPrev = kLocalLabels;
 		}
 
 		if (!kOutputAsBinary)
@@ -272,6 +393,19 @@ TOOLCHAINKIT_MODULE(AssemblerAMD64)
 
 			hdr.fCount = kRecords.size() + kUndefinedSymbols.size();
 
+			if (!kRelocations.empty())
+			{
+				if (kObjectVersion == kAEVersion1)
+				{
+					kStdErr << "AssemblerAMD64: " << argv[i] << " refers to symbols, v1 objects can't carry relocations.\n";
+
+					std::filesystem::remove(object_output);
+					return 1;
+				}
+
+				hdr.fVersion = kAEVersion3;
+			}
+
 			file_ptr_out << hdr;
 
 			if (kRecords.empty())
@@ -285,7 +419,8 @@ TOOLCHAINKIT_MODULE(AssemblerAMD64)
 
 			kRecords[kRecords.size() - 1].fSize = kAppBytes.size();
 
-			std::size_t record_count = 0UL;
+			std::vector<ToolchainKit::AERecordHeader> records;
+			std::size_t								  record_count = 0UL;
 
 			for (auto& rec : kRecords)
 			{
@@ -296,7 +431,7 @@ TOOLCHAINKIT_MODULE(AssemblerAMD64)
 				rec.fOffset = record_count;
 				++record_count;
 
-				file_ptr_out << rec;
+				records.push_back(rec);
 			}
 
 			// increment once again, so that we won't lie about the kUndefinedSymbols.
@@ -318,11 +453,20 @@ TOOLCHAINKIT_MODULE(AssemblerAMD64)
 				memset(_record_hdr.fPad, kAENullType, kAEPad);
 				memcpy(_record_hdr.fName, sym.c_str(), sym.size());
 
-				file_ptr_out << _record_hdr;
+				records.push_back(_record_hdr);
 
 				++kCounter;
 			}
 
+			if (!(kRelocations.empty() ? ToolchainKit::Utils::ae_write_records(file_ptr_out, records, kObjectVersion)
+									   : ToolchainKit::Utils::ae_write_records(file_ptr_out, records, kAEVersion3, kRelocations)))
+			{
+				kStdErr << "AssemblerAMD64: can't write the records of " << object_output << ".\n";
+
+				std::filesystem::remove(object_output);
+				return 1;
+			}
+
 			auto pos_end = file_ptr_out.tellp();
 
 			file_ptr_out.seekp(pos);
@@ -342,18 +486,15 @@ TOOLCHAINKIT_MODULE(AssemblerAMD64)
 			}
 		}
 
-		// byte from byte, we write this.
-		for (auto& byte : kAppBytes)
-		{
-			if (byte == 0)
-				continue;
+		file_ptr_out.write(reinterpret_cast<const char*>(kAppBytes.data()), kAppBytes.size());
 
-			if (byte == 0xFF)
-			{
-				byte = 0;
-			}
+		// ld64 finds it after the code, --ld64:lto.
+		if (!kIRSection.empty() && !ToolchainKit::Utils::ae_write_ir(file_ptr_out, kIRSection))
+		{
+			kStdErr << "AssemblerAMD64: can't write the IR section of " << object_output << ".\n";
 
-			file_ptr_out << reinterpret_cast<const char*>(&byte)[0];
+			std::filesystem::remove(object_output);
+			return 1;
 		}
 
 		if (kVerbose)
@@ -385,9 +526,27 @@ asm_fail_exit:
 
 static bool asm_read_attributes(std::string& line)
 {
+	// the IR of the object, ld64 optimizes the program with it at link time.
+	if (ToolchainKit::find_word(line, kIRDirective))
+	{
+		if (kOutputAsBinary)
+		{
+			Details::print_error_asm("Invalid directive in flat binary mode.", "ToolchainKit");
+			throw std::runtime_error("invalid_ir_bin");
+		}
+
+		if (!ToolchainKit::ir_read_directive(line, kIRSection))
+		{
+			Details::print_error_asm("Invalid " kIRDirective " directive.", "ToolchainKit");
+			throw std::runtime_error("invalid_ir");
+		}
+
+		line.clear();
+		return true;
+	}
 	// extern_segment is the opposite of public_segment, it signals to the ld
 	// that we need this symbol.
-	if (ToolchainKit::find_word(line, "extern_segment"))
+	else if (ToolchainKit::find_word(line, "extern_segment"))
 	{
 		if (kOutputAsBinary)
 		{
@@ -518,8 +677,7 @@ static bool asm_read_attributes(std::string& line)
 		while (name_copy.find(" ") != std::string::npos)
 			name_copy.erase(name_copy.find(" "), 1);
 
-		kOriginLabel.push_back(std::make_pair(name_copy, kOrigin));
-		++kOrigin;
+		kOriginLabel.push_back(std::make_pair(name_copy, kOrigin + kAppBytes.size()));
 
 		// now we can tell the code size of the previous kCurrentRecord.
 
@@ -551,7 +709,7 @@ namespace Details::Algorithms
 		if ((isalpha(c) || isdigit(c)) || ((c == ' ') || (c == '\t') ||
 				 (c == ',') || (c == '(') || (c == ')') || (c == '"') || (c == '*') ||
 				 (c == '\'') || (c == '[') || (c == ']') || (c == '+') ||
-				 (c == '_') || (c == ':') || (c == '@') || (c == '.') || (c == '#') || (c == ';')))
+				 (c == '_') || (c == ':') || (c == '@') || (c == '.') || (c == '#') || (c == ';') || (c == '-')))
 				 return false;
 
 		return true;
@@ -563,919 +721,1126 @@ namespace Details::Algorithms
 	}
 } // namespace Details::Algorithms
 
-/////////////////////////////////////////////////////////////////////////////////////////
+// \brief the encoder: operands, then the first form of kOpcodesAMD64 they fit.
 
-// @brief Check for line (syntax check)
+namespace Details
+{
+	/// @brief a general or a vector register (xmm, ymm and zmm are 128, 256 and 512), fSize in bits.
+	struct asm_register final
+	{
+		Int32 fNum{-1};
+		Int32 fSize{0};
+		Bool  fRex{false};	// spl, bpl, sil and dil only exist with a REX prefix.
+		Bool  fHigh{false}; // ah, ch, dh and bh don't exist with one.
+	};
 
-/////////////////////////////////////////////////////////////////////////////////////////
+	struct asm_operand final
+	{
+		enum
+		{
+			kReg,
+			kMem,
+			kImm,
+		} fKind{kImm};
+
+		asm_register fReg;
+		Int32		 fSize{0}; // bits, 0 when the operand doesn't tell.
+		Int32		 fBase{-1};
+		Int32		 fIndex{-1};
+		Int32		 fScale{1};
+		Bool		 fRip{false};
+		Int64		 fValue{0}; // displacement or immediate.
+		std::string	 fSymbol;	// ld64 adds its address to fValue.
+		Bool		 fLocal{false}; // fValue is the address of a local label, rip relative.
+	};
 
-std::string ToolchainKit::EncoderAMD64::CheckLine(std::string&		line,
-										 const std::string& file)
-{
-	std::string err_str;
+	/// @brief a field of the instruction ld64 fills, fOffset is from its first byte.
+	struct asm_fixup final
+	{
+		std::string fSymbol;
+		UInt16		fType;
+		SizeType	fOffset;
+		Int64		fAddend;
+	};
 
-	if (line.empty() || ToolchainKit::find_word(line, "extern_segment") ||
-		ToolchainKit::find_word(line, "public_segment") ||
-		ToolchainKit::find_word(line, kAssemblerPragmaSymStr) ||
-		ToolchainKit::find_word(line, ";") || line[0] == kAssemblerPragmaSym)
+	static std::string asm_trim(std::string text)
 	{
-		if (line.find(';') != std::string::npos)
-		{
-			line.erase(line.find(';'));
-		}
-		else
-		{
-			// now check the line for validity
-			if (!Details::Algorithms::is_valid_amd64(line))
-			{
-				err_str = "Line contains non valid characters.\nhere -> ";
-				err_str += line;
-			}
-		}
+		while (!text.empty() && isspace(text.front()))
+			text.erase(0, 1);
 
-		return err_str;
-	}
+		while (!text.empty() && isspace(text.back()))
+			text.pop_back();
 
-	// check for a valid instruction format.
+		return text;
+	}
 
-	if (line.find(',') != std::string::npos)
+	/// @brief 0x, 0b, 0o and decimal numbers, with a sign.
+	static Bool asm_number(std::string text, Int64& value)
 	{
-		if (line.find(',') + 1 == line.size())
-		{
-			err_str += "\nInstruction lacks right register, here -> ";
-			err_str += line.substr(line.find(','));
+		text = asm_trim(text);
 
-			return err_str;
-		}
-		else
-		{
-			bool nothing_on_right = true;
+		Bool negative = !text.empty() && text[0] == '-';
 
-			if (line.find(',') + 1 > line.size())
-			{
-				err_str += "\nInstruction not complete, here -> ";
-				err_str += line;
+		if (!text.empty() && (text[0] == '-' || text[0] == '+'))
+			text = asm_trim(text.substr(1));
 
-				return err_str;
-			}
+		Int32 base = 10;
 
-			auto substr = line.substr(line.find(',') + 1);
+		if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'b' || text[1] == 'o'))
+		{
+			base = text[1] == 'x' ? 16 : (text[1] == 'b' ? 2 : 8);
+			text = text.substr(2);
+		}
 
-			for (auto& ch : substr)
-			{
-				if (ch != ' ' && ch != '\t')
-				{
-					nothing_on_right = false;
-				}
-			}
+		UInt64 raw = 0UL;
 
-			// this means we found nothing after that ',' .
-			if (nothing_on_right)
-			{
-				err_str += "\nInstruction not complete, here -> ";
-				err_str += line;
+		if (text.empty() || std::from_chars(text.data(), text.data() + text.size(), raw, base).ptr != text.data() + text.size())
+			return false;
 
-				return err_str;
-			}
-		}
+		value = negative ? -Int64(raw) : Int64(raw);
+
+		return true;
 	}
-	for (auto& opcodeAMD64 : kOpcodesAMD64)
+
+	static Bool asm_fits(Int64 value, Int64 min, Int64 max)
 	{
-		if (ToolchainKit::find_word(line, opcodeAMD64.fName))
-		{
-			return err_str;
-		}
+		return value >= min && value <= max;
 	}
 
-	err_str += "\nUnrecognized instruction -> " + line;
-
-	return err_str;
-}
+	static Bool asm_parse_register(const std::string& name, asm_register& reg)
+	{
+		static const char* cLegacy[] = {"ax", "cx", "dx", "bx", "sp", "bp", "si", "di"};
+		static const char* cBytes[]	 = {"al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil"};
+		static const char* cHigh[]	 = {"ah", "ch", "dh", "bh"};
 
-bool ToolchainKit::EncoderAMD64::WriteNumber(const std::size_t& pos,
-									std::string&	   jump_label)
-{
-	if (!isdigit(jump_label[pos]))
-		return false;
+		reg = {};
 
-	switch (jump_label[pos + 1])
-	{
-	case 'x': {
-		if (auto res = strtol(jump_label.substr(pos + 2).c_str(), nullptr, 16);
-			!res)
+		for (Int32 num = 0; num < 8; ++num)
 		{
-			if (errno != 0)
-			{
-				Details::print_error_asm("invalid hex number: " + jump_label, "ToolchainKit");
-				throw std::runtime_error("invalid_hex");
-			}
+			if (name == cLegacy[num])
+				reg = {num, 16};
+			else if (name == std::string("e") + cLegacy[num])
+				reg = {num, 32};
+			else if (name == std::string("r") + cLegacy[num])
+				reg = {num, 64};
+			else if (name == cBytes[num])
+				reg = {num, 8, num >= 4};
+			else if (num < 4 && name == cHigh[num])
+				reg = {num + 4, 8, false, true};
 		}
 
-		ToolchainKit::NumberCast64 num = ToolchainKit::NumberCast64(
-			strtol(jump_label.substr(pos + 2).c_str(), nullptr, 16));
+		// xmm0 to zmm31, EVEX encodes the registers above 15.
+		static const std::pair<const char*, Int32> cVectors[] = {{"xmm", 128}, {"ymm", 256}, {"zmm", 512}};
 
-		for (char& i : num.number)
+		for (auto& [prefix, bits] : cVectors)
 		{
-			if (i == 0)
-				i = 0xFF;
+			if (name.size() > 3 && name.size() <= 5 && name.starts_with(prefix) &&
+				std::all_of(name.begin() + 3, name.end(), isdigit))
+			{
+				Int32 num = std::atoi(name.c_str() + 3);
+
+				if (num > 31)
+					return false;
 
-			kAppBytes.push_back(i);
+				reg = {num, bits};
+			}
 		}
 
-		if (kVerbose)
+		// r8 to r15, then the d, w and b (or l) suffixes.
+		if (reg.fNum < 0 && name.size() > 1 && name[0] == 'r' && isdigit(name[1]))
 		{
-			kStdOut << "AssemblerAMD64: Found a base 16 number here: "
-					<< jump_label.substr(pos) << "\n";
+			SizeType digits = 1;
+
+			while (digits + 1 < name.size() && isdigit(name[digits + 1]))
+				++digits;
+
+			Int32		num	   = std::atoi(name.substr(1, digits).c_str());
+			std::string suffix = name.substr(1 + digits);
+
+			if (num < 8 || num > 15)
+				return false;
+
+			if (suffix.empty())
+				reg = {num, 64};
+			else if (suffix == "d")
+				reg = {num, 32};
+			else if (suffix == "w")
+				reg = {num, 16};
+			else if (suffix == "b" || suffix == "l")
+				reg = {num, 8};
 		}
 
-		return true;
+		return reg.fNum >= 0;
 	}
-	case 'b': {
-		if (auto res = strtol(jump_label.substr(pos + 2).c_str(), nullptr, 2);
-			!res)
+
+	/// @brief [base + index * scale + disp], [rip + disp], [symbol + disp] or [disp].
+	static Bool asm_parse_memory(const std::string& text, asm_operand& op)
+	{
+		std::vector<std::pair<Bool, std::string>> terms;
+		Bool									  negative = false;
+		std::string								  term;
+
+		for (auto ch : text + "+")
 		{
-			if (errno != 0)
+			if (ch != '+' && ch != '-')
 			{
-				Details::print_error_asm("invalid binary number: " + jump_label, "ToolchainKit");
-				throw std::runtime_error("invalid_bin");
+				term.push_back(ch);
+				continue;
 			}
-		}
 
-		ToolchainKit::NumberCast64 num = ToolchainKit::NumberCast64(
-			strtol(jump_label.substr(pos + 2).c_str(), nullptr, 2));
+			if (!asm_trim(term).empty())
+				terms.push_back({negative, asm_trim(term)});
+			else if (!terms.empty() || negative)
+				return false;
 
-		if (kVerbose)
-		{
-			kStdOut << "AssemblerAMD64: Found a base 2 number here: "
-					<< jump_label.substr(pos) << "\n";
+			term.clear();
+			negative = ch == '-';
 		}
 
-		for (char& i : num.number)
+		for (auto& [minus, part] : terms)
 		{
-			if (i == 0)
-				i = 0xFF;
+			asm_register reg;
+			Int64		 number = 0;
 
-			kAppBytes.push_back(i);
-		}
+			if (part.find('*') != std::string::npos)
+			{
+				auto lhs = asm_trim(part.substr(0, part.find('*')));
+				auto rhs = asm_trim(part.substr(part.find('*') + 1));
 
-		return true;
-	}
-	case 'o': {
-		if (auto res = strtol(jump_label.substr(pos + 2).c_str(), nullptr, 7);
-			!res)
-		{
-			if (errno != 0)
+				if (!asm_parse_register(lhs, reg))
+					std::swap(lhs, rhs);
+
+				if (minus || op.fIndex >= 0 || !asm_parse_register(lhs, reg) || reg.fSize != 64 || !asm_number(rhs, number) ||
+					(number != 1 && number != 2 && number != 4 && number != 8))
+					return false;
+
+				op.fIndex = reg.fNum;
+				op.fScale = number;
+			}
+			else if (part == "rip")
 			{
-				Details::print_error_asm("invalid octal number: " + jump_label, "ToolchainKit");
-				throw std::runtime_error("invalid_octal");
+				if (minus || op.fRip)
+					return false;
+
+				op.fRip = true;
 			}
-		}
+			else if (asm_parse_register(part, reg))
+			{
+				if (minus || reg.fSize != 64)
+					return false;
 
-		ToolchainKit::NumberCast64 num = ToolchainKit::NumberCast64(
-			strtol(jump_label.substr(pos + 2).c_str(), nullptr, 7));
+				if (op.fBase < 0)
+					op.fBase = reg.fNum;
+				else if (op.fIndex < 0)
+					op.fIndex = reg.fNum;
+				else
+					return false;
+			}
+			else if (asm_number(part, number))
+			{
+				op.fValue += minus ? -number : number;
+			}
+			else
+			{
+				if (minus || !op.fSymbol.empty())
+					return false;
 
-		if (kVerbose)
-		{
-			kStdOut << "AssemblerAMD64: Found a base 8 number here: "
-					<< jump_label.substr(pos) << "\n";
+				op.fSymbol = part;
+			}
 		}
 
-		for (char& i : num.number)
-		{
-			if (i == 0)
-				i = 0xFF;
-
-			kAppBytes.push_back(i);
-		}
+		if (op.fRip && (op.fBase >= 0 || op.fIndex >= 0))
+			return false;
 
-		return true;
-	}
-	default: {
-		break;
-	}
-	}
+		// rsp can't be an index, swap it with the base when the scale allows it.
+		if (op.fIndex == 4 && op.fScale == 1 && op.fBase != 4)
+			std::swap(op.fBase, op.fIndex);
 
-	/* check for errno and stuff like that */
-	if (auto res = strtol(jump_label.substr(pos).c_str(), nullptr, 10); !res)
-	{
-		if (errno != 0)
-		{
+		if (op.fIndex == 4)
 			return false;
-		}
-	}
 
-	ToolchainKit::NumberCast64 num = ToolchainKit::NumberCast64(
-		strtol(jump_label.substr(pos).c_str(), nullptr, 10));
+		// a symbol alone is rip relative.
+		if (op.fBase < 0 && op.fIndex < 0 && !op.fSymbol.empty())
+			op.fRip = true;
 
-	for (char& i : num.number)
-	{
-		if (i == 0)
-			i = 0xFF;
-
-		kAppBytes.push_back(i);
+		return true;
 	}
 
-	if (kVerbose)
+	static Bool asm_parse_operand(std::string text, asm_operand& op)
 	{
-		kStdOut << "AssemblerAMD64: Found a base 10 number here: " << jump_label.substr(pos)
-				<< "\n";
-	}
+		op	 = {};
+		text = asm_trim(text);
 
-	return true;
-}
+		static const std::pair<const char*, Int32> cSizes[] = {{"byte", 8}, {"word", 16}, {"dword", 32}, {"qword", 64},
+																{"xmmword", 128}, {"ymmword", 256}, {"zmmword", 512}};
 
-bool ToolchainKit::EncoderAMD64::WriteNumber32(const std::size_t& pos,
-									  std::string&		 jump_label)
-{
-	if (!isdigit(jump_label[pos]))
-		return false;
+		for (auto& [keyword, bits] : cSizes)
+		{
+			if (text.starts_with(keyword) && text.size() > strlen(keyword) && !isalnum(text[strlen(keyword)]))
+			{
+				op.fSize = bits;
+				text	 = asm_trim(text.substr(strlen(keyword)));
 
-	switch (jump_label[pos + 1])
-	{
-	case 'x': {
-		auto res = strtol(jump_label.substr(pos + 2).c_str(), nullptr, 16);
-		res += kOrigin;
+				if (text.starts_with("ptr") && text.size() > 3 && !isalnum(text[3]))
+					text = asm_trim(text.substr(3));
 
-		if (errno != 0)
-		{
-			return false;
+				break;
+			}
 		}
 
-		ToolchainKit::NumberCast32 num = ToolchainKit::NumberCast32(res);
-
-		for (char& i : num.number)
+		if (!text.empty() && text.front() == '[')
 		{
-			if (i == 0)
-				i = 0xFF;
+			if (text.back() != ']')
+				return false;
 
-			kAppBytes.push_back(i);
+			op.fKind = asm_operand::kMem;
+			return asm_parse_memory(text.substr(1, text.size() - 2), op);
 		}
 
-		if (kVerbose)
+		if (op.fSize != 0)
+			return false;
+
+		if (asm_parse_register(text, op.fReg))
 		{
-			kStdOut << "AssemblerAMD64: Found a base 16 number here: "
-					<< jump_label.substr(pos) << "\n";
+			op.fKind = asm_operand::kReg;
+			op.fSize = op.fReg.fSize;
+
+			return true;
 		}
 
-		return true;
-	}
-	case 'b': {
-		auto res = strtol(jump_label.substr(pos + 2).c_str(), nullptr, 2);
-		res += kOrigin;
+		op.fKind = asm_operand::kImm;
 
-		if (errno != 0)
-		{
-			return false;
-		}
-
-		ToolchainKit::NumberCast32 num = ToolchainKit::NumberCast32(res);
+		if (asm_number(text, op.fValue))
+			return true;
 
-		if (kVerbose)
-		{
-			kStdOut << "AssemblerAMD64: Found a base 2 number here: "
-					<< jump_label.substr(pos) << "\n";
-		}
-
-		for (char& i : num.number)
-		{
-			if (i == 0)
-				i = 0xFF;
+		// a symbol, its address.
+		if (text.empty() || isdigit(text[0]) ||
+			std::find_if(text.begin(), text.end(), [](char ch) { return !isalnum(ch) && ch != '_' && ch != '.' && ch != '$' && ch != '@'; }) != text.end())
+			return false;
 
-			kAppBytes.push_back(i);
-		}
+		op.fSymbol = text;
 
 		return true;
 	}
-	case 'o': {
-		auto res = strtol(jump_label.substr(pos + 2).c_str(), nullptr, 7);
-		res += kOrigin;
-
-		if (errno != 0)
-		{
-			return false;
-		}
 
-		ToolchainKit::NumberCast32 num = ToolchainKit::NumberCast32(res);
+	/// @brief split at the commas, not those of a string.
+	static std::vector<std::string> asm_split_operands(const std::string& text)
+	{
+		std::vector<std::string> operands;
+		std::string				 operand;
+		CharType				 quote = 0;
 
-		if (kVerbose)
+		for (auto ch : text)
 		{
-			kStdOut << "AssemblerAMD64: Found a base 8 number here: "
-					<< jump_label.substr(pos) << "\n";
-		}
+			if (quote == 0 && ch == ',')
+			{
+				operands.push_back(asm_trim(operand));
+				operand.clear();
 
-		for (char& i : num.number)
-		{
-			if (i == 0)
-				i = 0xFF;
+				continue;
+			}
 
-			kAppBytes.push_back(i);
-		}
+			if (ch == '"' || ch == '\'')
+				quote = quote == 0 ? ch : (quote == ch ? 0 : quote);
 
-		return true;
-	}
-	default: {
-		break;
-	}
-	}
+			operand.push_back(ch);
+		}
 
-	auto res = strtol(jump_label.substr(pos + 2).c_str(), nullptr, 10);
-	res += kOrigin;
+		if (!asm_trim(operand).empty() || !operands.empty())
+			operands.push_back(asm_trim(operand));
 
-	if (errno != 0)
-	{
-		return false;
+		return operands;
 	}
 
-	ToolchainKit::NumberCast32 num = ToolchainKit::NumberCast32(res);
-
-	for (char& i : num.number)
+	static Bool asm_is_sized(i64_byte_t kind)
 	{
-		if (i == 0)
-			i = 0xFF;
-
-		kAppBytes.push_back(i);
+		return kind == kAsmOpR || kind == kAsmOpAcc || kind == kAsmOpRM || kind == kAsmOpM;
 	}
 
-	if (kVerbose)
+	/// @brief Does form take these operands? size is set to the operation size.
+	static Bool asm_match(const CpuOpcodeAMD64& form, const std::vector<asm_operand>& operands, Int32& size)
 	{
-		kStdOut << "AssemblerAMD64: Found a base 10 number here: " << jump_label.substr(pos)
-				<< "\n";
-	}
+		if (form.Arity() != operands.size())
+			return false;
 
-	return true;
-}
+		Bool sized = false;
 
-bool ToolchainKit::EncoderAMD64::WriteNumber16(const std::size_t& pos,
-									  std::string&		 jump_label)
-{
-	if (!isdigit(jump_label[pos]))
-		return false;
+		size = 0;
 
-	switch (jump_label[pos + 1])
-	{
-	case 'x': {
-		if (auto res = strtol(jump_label.substr(pos + 2).c_str(), nullptr, 16);
-			!res)
+		for (SizeType index = 0; index < operands.size(); ++index)
 		{
-			if (errno != 0)
+			auto kind = form.fOperands[index];
+
+			sized |= asm_is_sized(kind);
+
+			if ((kind == kAsmOpR || kind == kAsmOpAcc || kind == kAsmOpRM) && operands[index].fSize != 0)
 			{
-				Details::print_error_asm("invalid hex number: " + jump_label, "ToolchainKit");
-				throw std::runtime_error("invalid_hex");
+				if (size != 0 && size != operands[index].fSize)
+					return false;
+
+				size = operands[index].fSize;
 			}
 		}
 
-		ToolchainKit::NumberCast16 num = ToolchainKit::NumberCast16(
-			strtol(jump_label.substr(pos + 2).c_str(), nullptr, 16));
+		if (size == 0 && (form.fFlags & kAsmFormDefault64))
+			size = 64;
 
-		for (char& i : num.number)
+		if (sized)
 		{
-			if (i == 0)
-				i = 0xFF;
+			if (size == 0 || size > 64 || Bool(form.fFlags & kAsmFormByte) != (size == 8))
+				return false;
 
-			kAppBytes.push_back(i);
-		}
+			if ((form.fFlags & kAsmFormDefault64) && size == 32)
+				return false;
 
-		if (kVerbose)
-		{
-			kStdOut << "AssemblerAMD64: Found a base 16 number here: "
-					<< jump_label.substr(pos) << "\n";
+			if ((form.fFlags & kAsmFormNo64) && size == 64)
+				return false;
+
+			if ((form.fFlags & kAsmFormOnly64) && size != 64)
+				return false;
 		}
 
-		return true;
-	}
-	case 'b': {
-		if (auto res = strtol(jump_label.substr(pos + 2).c_str(), nullptr, 2);
-			!res)
+		for (SizeType index = 0; index < operands.size(); ++index)
 		{
-			if (errno != 0)
+			auto& op = operands[index];
+
+			Bool vec = op.fKind == asm_operand::kReg && op.fReg.fSize > 64;
+			Bool reg = op.fKind == asm_operand::kReg && !vec;
+			Bool mem = op.fKind == asm_operand::kMem;
+			Bool imm = op.fKind == asm_operand::kImm;
+			Bool num = imm && op.fSymbol.empty();
+
+			// only EVEX reaches the vector registers 16 to 31.
+			if (vec && op.fReg.fNum > 15 && !(form.fFlags & kAsmFormEvex))
+				return false;
+
+			switch (form.fOperands[index])
 			{
-				Details::print_error_asm("invalid binary number: " + jump_label, "ToolchainKit");
-				throw std::runtime_error("invalid_bin");
+			case kAsmOpR:
+				if (!reg)
+					return false;
+				break;
+			case kAsmOpAcc:
+				if (!reg || op.fReg.fNum != 0)
+					return false;
+				break;
+			case kAsmOpRM:
+				if (!reg && !mem)
+					return false;
+				break;
+			case kAsmOpRM8:
+			case kAsmOpRM16:
+			case kAsmOpRM32: {
+				Int32 bits = form.fOperands[index] == kAsmOpRM8 ? 8 : (form.fOperands[index] == kAsmOpRM16 ? 16 : 32);
+
+				if (!(reg && op.fSize == bits) && !(mem && (op.fSize == 0 || op.fSize == bits)))
+					return false;
+
+				break;
 			}
-		}
+			case kAsmOpM:
+				if (!mem)
+					return false;
+				break;
+			case kAsmOpImm8:
+				if (!num || !asm_fits(op.fValue, -128, (form.fFlags & kAsmFormByte) ? 255 : 127))
+					return false;
+				break;
+			case kAsmOpImm16:
+				if (!num || !asm_fits(op.fValue, 0, UINT16_MAX))
+					return false;
+				break;
+			case kAsmOpImm:
+				if (!imm || (!num && size < 32))
+					return false;
 
-		ToolchainKit::NumberCast16 num = ToolchainKit::NumberCast16(
-			strtol(jump_label.substr(pos + 2).c_str(), nullptr, 2));
+				if (num && !(size == 16	  ? asm_fits(op.fValue, INT16_MIN, UINT16_MAX)
+							 : size == 32 ? asm_fits(op.fValue, INT32_MIN, UINT32_MAX)
+										  : asm_fits(op.fValue, INT32_MIN, INT32_MAX)))
+					return false;
 
-		if (kVerbose)
-		{
-			kStdOut << "AssemblerAMD64: Found a base 2 number here: "
-					<< jump_label.substr(pos) << "\n";
-		}
+				break;
+			case kAsmOpImm64:
+				if (!imm)
+					return false;
+				break;
+			case kAsmOpOne:
+				if (!num || op.fValue != 1)
+					return false;
+				break;
+			case kAsmOpCL:
+				if (!reg || op.fReg.fNum != 1 || op.fSize != 8 || op.fReg.fHigh)
+					return false;
+				break;
+			case kAsmOpRel8:
+				if (!num)
+					return false;
+				break;
+			case kAsmOpRel32:
+				if (!imm)
+					return false;
+				break;
+			case kAsmOpV:
+			case kAsmOpVV:
+				if (!vec || op.fSize != form.VectorSize())
+					return false;
+				break;
+			case kAsmOpVM:
+				if (!(vec && op.fSize == form.VectorSize()) && !(mem && (op.fSize == 0 || op.fSize == form.VectorSize())))
+					return false;
+				break;
+			case kAsmOpX:
+				if (!vec || op.fSize != 128)
+					return false;
+				break;
+			case kAsmOpXM32:
+			case kAsmOpXM64: {
+				Int32 bits = form.fOperands[index] == kAsmOpXM32 ? 32 : 64;
 
-		for (char& i : num.number)
-		{
-			if (i == 0)
-				i = 0xFF;
+				if (!(vec && op.fSize == 128) && !(mem && (op.fSize == 0 || op.fSize == bits)))
+					return false;
 
-			kAppBytes.push_back(i);
+				break;
+			}
+			default:
+				return false;
+			}
 		}
 
 		return true;
 	}
-	case 'o': {
-		if (auto res = strtol(jump_label.substr(pos + 2).c_str(), nullptr, 7);
-			!res)
+
+	static void asm_emit(std::vector<i64_byte_t>& out, Int64 value, SizeType width)
+	{
+		for (SizeType byte = 0; byte < width; ++byte)
+			out.push_back(i64_byte_t(UInt64(value) >> (8 * byte)));
+	}
+
+	/// @brief Encode operands with form, at offset at of kAppBytes.
+	/// @return false if a branch target is out of the reach of the form.
+	static Bool asm_encode(const CpuOpcodeAMD64& form, const std::vector<asm_operand>& operands, Int32 size,
+						   const std::vector<i64_byte_t>& prefixes, SizeType at, std::vector<i64_byte_t>& out, std::vector<asm_fixup>& fixups)
+	{
+		const asm_operand* reg		 = nullptr;
+		const asm_operand* rm		 = nullptr;
+		const asm_operand* vvvv		 = nullptr;
+		const asm_operand* imm		 = nullptr;
+		SizeType		   imm_width = 0;
+		Bool			   rel		 = false;
+		Int64			   disp_unit = 1; // EVEX scales a disp8 by the size of the memory operand.
+
+		for (SizeType index = 0; index < operands.size(); ++index)
 		{
-			if (errno != 0)
+			switch (form.fOperands[index])
 			{
-				Details::print_error_asm("invalid octal number: " + jump_label, "ToolchainKit");
-				throw std::runtime_error("invalid_octal");
+			case kAsmOpR:
+			case kAsmOpV:
+			case kAsmOpX:
+				// the second register of pmovmskb or a broadcast is the rm one.
+				(reg ? rm : reg) = &operands[index];
+				break;
+			case kAsmOpRM:
+			case kAsmOpRM8:
+			case kAsmOpRM16:
+			case kAsmOpRM32:
+			case kAsmOpM:
+				rm = &operands[index];
+				break;
+			case kAsmOpVM:
+				rm		  = &operands[index];
+				disp_unit = form.VectorSize() / 8;
+				break;
+			case kAsmOpXM32:
+			case kAsmOpXM64:
+				rm		  = &operands[index];
+				disp_unit = form.fOperands[index] == kAsmOpXM32 ? 4 : 8;
+				break;
+			case kAsmOpVV:
+				vvvv = &operands[index];
+				break;
+			case kAsmOpImm8:
+			case kAsmOpRel8:
+				imm		  = &operands[index];
+				imm_width = 1;
+				rel		  = form.fOperands[index] == kAsmOpRel8;
+				break;
+			case kAsmOpImm16:
+				imm		  = &operands[index];
+				imm_width = 2;
+				break;
+			case kAsmOpImm:
+				imm		  = &operands[index];
+				imm_width = size == 16 ? 2 : 4;
+				break;
+			case kAsmOpImm64:
+				imm		  = &operands[index];
+				imm_width = 8;
+				break;
+			case kAsmOpRel32:
+				imm		  = &operands[index];
+				imm_width = 4;
+				rel		  = true;
+				break;
+			default:
+				break;
 			}
 		}
 
-		ToolchainKit::NumberCast16 num = ToolchainKit::NumberCast16(
-			strtol(jump_label.substr(pos + 2).c_str(), nullptr, 7));
+		Bool vex  = form.fFlags & kAsmFormVex;
+		Bool evex = form.fFlags & kAsmFormEvex;
 
-		if (kVerbose)
-		{
-			kStdOut << "AssemblerAMD64: Found a base 8 number here: "
-					<< jump_label.substr(pos) << "\n";
-		}
+		if (!evex)
+			disp_unit = 1;
+
+		out = prefixes;
+
+		if (form.fPrefix == 0x67)
+			out.push_back(0x67);
+
+		if ((form.fFlags & kAsmFormOp16) || (size == 16 && std::any_of(form.fOperands, form.fOperands + 3, asm_is_sized)))
+			out.push_back(0x66);
+
+		if (form.fPrefix != 0 && form.fPrefix != 0x67 && !vex && !evex)
+			out.push_back(form.fPrefix);
 
-		for (char& i : num.number)
+		// REX: W, then R, X and B extend ModRM.reg, SIB.index and ModRM.rm (or the opcode register).
+		Bool	   plus_reg = form.fFlags & kAsmFormPlusReg;
+		i64_byte_t rex		= 0;
+
+		if ((form.fFlags & kAsmFormRexW) || (size == 64 && !(form.fFlags & kAsmFormDefault64)))
+			rex |= 0x08;
+
+		if (reg && !plus_reg && (reg->fReg.fNum & 8))
+			rex |= 0x04;
+
+		if (rm && rm->fKind == asm_operand::kMem && rm->fIndex >= 0 && (rm->fIndex & 8))
+			rex |= 0x02;
+
+		if ((reg && plus_reg && (reg->fReg.fNum & 8)) || (rm && rm->fKind == asm_operand::kReg && (rm->fReg.fNum & 8)) ||
+			(rm && rm->fKind == asm_operand::kMem && rm->fBase >= 0 && (rm->fBase & 8)))
+			rex |= 0x01;
+
+		Bool needs_rex = rex != 0;
+		Bool no_rex	   = false;
+
+		for (auto& op : operands)
 		{
-			if (i == 0)
-				i = 0xFF;
+			if (op.fKind != asm_operand::kReg)
+				continue;
 
-			kAppBytes.push_back(i);
+			needs_rex |= op.fReg.fRex;
+			no_rex |= op.fReg.fHigh;
 		}
 
-		return true;
-	}
-	default: {
-		break;
-	}
-	}
+		if (needs_rex && no_rex)
+			return false;
 
-	/* check for errno and stuff like that */
-	if (auto res = strtol(jump_label.substr(pos).c_str(), nullptr, 10); !res)
-	{
-		if (errno != 0)
+		const i64_byte_t* opcode	 = form.fOpcode;
+		SizeType		  opcode_len = form.fOpcodeLen;
+
+		if (vex || evex)
 		{
-			return false;
-		}
-	}
+			// the map replaces the 0F, 0F 38 or 0F 3A escape, pp the mandatory prefix.
+			i64_byte_t map = 1;
 
-	ToolchainKit::NumberCast16 num = ToolchainKit::NumberCast16(
-		strtol(jump_label.substr(pos).c_str(), nullptr, 10));
+			if (opcode_len > 2 && (opcode[1] == 0x38 || opcode[1] == 0x3A))
+				map = opcode[1] == 0x38 ? 2 : 3;
 
-	for (char& i : num.number)
-	{
-		if (i == 0)
-			i = 0xFF;
+			opcode += map == 1 ? 1 : 2;
+			opcode_len -= map == 1 ? 1 : 2;
 
-		kAppBytes.push_back(i);
-	}
+			i64_byte_t pp = form.fPrefix == 0x66 ? 1 : (form.fPrefix == 0xF3 ? 2 : (form.fPrefix == 0xF2 ? 3 : 0));
+			i64_byte_t w  = (form.fFlags & kAsmFormW1) || (rex & 0x08);
+			i64_byte_t v  = vvvv ? vvvv->fReg.fNum : 0;
 
-	if (kVerbose)
-	{
-		kStdOut << "AssemblerAMD64: Found a base 10 number here: " << jump_label.substr(pos)
-				<< "\n";
-	}
+			// R, X, B and vvvv are inverted.
+			i64_byte_t r = !(rex & 0x04), x = !(rex & 0x02), b = !(rex & 0x01);
 
-	return true;
-}
+			if (evex)
+			{
+				i64_byte_t r_high = !(reg && (reg->fReg.fNum & 16));
 
-bool ToolchainKit::EncoderAMD64::WriteNumber8(const std::size_t& pos,
-									 std::string&		jump_label)
-{
-	if (!isdigit(jump_label[pos]))
-		return false;
+				// X extends a register rm to 32 registers.
+				if (rm && rm->fKind == asm_operand::kReg && (rm->fReg.fNum & 16))
+					x = 0;
 
-	switch (jump_label[pos + 1])
-	{
-	case 'x': {
-		if (auto res = strtol(jump_label.substr(pos + 2).c_str(), nullptr, 16);
-			!res)
-		{
-			if (errno != 0)
+				i64_byte_t length = (form.fFlags & kAsmFormL512) ? 2 : ((form.fFlags & kAsmFormL256) ? 1 : 0);
+
+				out.push_back(0x62);
+				out.push_back(r << 7 | x << 6 | b << 5 | r_high << 4 | map);
+				out.push_back(w << 7 | (~v & 15) << 3 | 0x04 | pp);
+				out.push_back(length << 5 | !(v & 16) << 3);
+			}
+			else if (map == 1 && x && b && !w)
 			{
-				Details::print_error_asm("invalid hex number: " + jump_label, "ToolchainKit");
-				throw std::runtime_error("invalid_hex");
+				out.push_back(0xC5);
+				out.push_back(r << 7 | (~v & 15) << 3 | Bool(form.fFlags & kAsmFormL256) << 2 | pp);
 			}
+			else
+			{
+				out.push_back(0xC4);
+				out.push_back(r << 7 | x << 6 | b << 5 | map);
+				out.push_back(w << 7 | (~v & 15) << 3 | Bool(form.fFlags & kAsmFormL256) << 2 | pp);
+			}
+		}
+		else if (needs_rex)
+		{
+			out.push_back(0x40 | rex);
 		}
 
-		ToolchainKit::NumberCast8 num = ToolchainKit::NumberCast8(
-			strtol(jump_label.substr(pos + 2).c_str(), nullptr, 16));
+		out.insert(out.end(), opcode, opcode + opcode_len);
 
-		kAppBytes.push_back(num.number);
+		if (plus_reg)
+			out.back() += reg->fReg.fNum & 7;
 
-		if (kVerbose)
+		if (form.fModReg != kAsmModRegNone)
 		{
-			kStdOut << "AssemblerAMD64: Found a base 16 number here: "
-					<< jump_label.substr(pos) << "\n";
-		}
+			i64_byte_t field = form.fModReg == kAsmModRegR ? (reg->fReg.fNum & 7) : form.fModReg;
 
-		return true;
-	}
-	case 'b': {
-		if (auto res = strtol(jump_label.substr(pos + 2).c_str(), nullptr, 2);
-			!res)
-		{
-			if (errno != 0)
+			if (rm->fKind == asm_operand::kReg)
 			{
-				Details::print_error_asm("invalid binary number: " + jump_label, "ToolchainKit");
-				throw std::runtime_error("invalid_bin");
+				out.push_back(0xC0 | field << 3 | (rm->fReg.fNum & 7));
 			}
-		}
+			else if (rm->fRip)
+			{
+				out.push_back(field << 3 | 0x05);
 
-		ToolchainKit::NumberCast8 num = ToolchainKit::NumberCast8(
-			strtol(jump_label.substr(pos + 2).c_str(), nullptr, 2));
+				// rip is the next instruction, past the immediate.
+				if (!rm->fSymbol.empty())
+					fixups.push_back({rm->fSymbol, ToolchainKit::kAERelocRel32, out.size(), rm->fValue - Int64(sizeof(UInt32) + imm_width)});
 
-		if (kVerbose)
-		{
-			kStdOut << "AssemblerAMD64: Found a base 2 number here: "
-					<< jump_label.substr(pos) << "\n";
-		}
+				if (rm->fLocal)
+					asm_emit(out, rm->fValue - Int64(kOrigin + at + out.size() + sizeof(UInt32) + imm_width), sizeof(UInt32));
+				else
+					asm_emit(out, rm->fSymbol.empty() ? rm->fValue : 0, sizeof(UInt32));
+			}
+			else
+			{
+				Int32 base	= rm->fBase;
+				Bool  sib	= rm->fIndex >= 0 || base < 0 || (base & 7) == 4;
+				Int32 mod	= 2;
+				Int32 scale = rm->fScale == 8 ? 3 : (rm->fScale == 4 ? 2 : (rm->fScale == 2 ? 1 : 0));
 
-		kAppBytes.push_back(num.number);
+				// no base is mod 0 with base 5, then a disp32; rbp and r13 need a displacement.
+				if (base < 0)
+					mod = 0;
+				else if (rm->fSymbol.empty() && rm->fValue == 0 && (base & 7) != 5)
+					mod = 0;
+				else if (rm->fSymbol.empty() && rm->fValue % disp_unit == 0 && asm_fits(rm->fValue / disp_unit, INT8_MIN, INT8_MAX))
+					mod = 1;
 
-		return true;
-	}
-	case 'o': {
-		if (auto res = strtol(jump_label.substr(pos + 2).c_str(), nullptr, 7);
-			!res)
-		{
-			if (errno != 0)
-			{
-				Details::print_error_asm("invalid octal number: " + jump_label, "ToolchainKit");
-				throw std::runtime_error("invalid_octal");
+				out.push_back(mod << 6 | field << 3 | (sib ? 4 : (base & 7)));
+
+				if (sib)
+					out.push_back(scale << 6 | (rm->fIndex >= 0 ? rm->fIndex & 7 : 4) << 3 | (base >= 0 ? base & 7 : 5));
+
+				if (mod == 1)
+				{
+					asm_emit(out, rm->fValue / disp_unit, 1);
+				}
+				else if (mod == 2 || base < 0)
+				{
+					if (!rm->fSymbol.empty())
+						fixups.push_back({rm->fSymbol, ToolchainKit::kAERelocAbs32, out.size(), rm->fValue});
+
+					asm_emit(out, rm->fSymbol.empty() ? rm->fValue : 0, sizeof(UInt32));
+				}
 			}
 		}
 
-		ToolchainKit::NumberCast8 num = ToolchainKit::NumberCast8(
-			strtol(jump_label.substr(pos + 2).c_str(), nullptr, 7));
+		if (!imm)
+			return true;
 
-		if (kVerbose)
+		if (rel && imm->fSymbol.empty())
 		{
-			kStdOut << "AssemblerAMD64: Found a base 8 number here: "
-					<< jump_label.substr(pos) << "\n";
-		}
+			// from the end of the instruction.
+			Int64 disp = imm->fValue - Int64(kOrigin + at + out.size() + imm_width);
+
+			if (imm_width == 1 ? !asm_fits(disp, INT8_MIN, INT8_MAX) : !asm_fits(disp, INT32_MIN, INT32_MAX))
+				return false;
 
-		kAppBytes.push_back(num.number);
+			asm_emit(out, disp, imm_width);
+		}
+		else if (rel)
+		{
+			fixups.push_back({imm->fSymbol, ToolchainKit::kAERelocRel32, out.size(), imm->fValue - Int64(sizeof(UInt32))});
+			asm_emit(out, 0, imm_width);
+		}
+		else if (!imm->fSymbol.empty())
+		{
+			fixups.push_back({imm->fSymbol, imm_width == 8 ? ToolchainKit::kAERelocAbs64 : ToolchainKit::kAERelocAbs32, out.size(), imm->fValue});
+			asm_emit(out, 0, imm_width);
+		}
+		else
+		{
+			asm_emit(out, imm->fValue, imm_width);
+		}
 
 		return true;
 	}
-	default: {
-		break;
-	}
-	}
 
-	/* check for errno and stuff like that */
-	if (auto res = strtol(jump_label.substr(pos).c_str(), nullptr, 10); !res)
+	/// @brief line prefixes.
+	static const std::pair<const char*, i64_byte_t> kAsmPrefixes[] = {
+		{"lock", 0xF0}, {"rep", 0xF3}, {"repe", 0xF3}, {"repz", 0xF3}, {"repne", 0xF2}, {"repnz", 0xF2}};
+
+	/// @brief The mnemonic of text, past its prefixes; text is left with the operands.
+	static std::string asm_mnemonic(std::string& text, std::vector<i64_byte_t>& prefixes)
 	{
-		if (errno != 0)
+		while (true)
 		{
-			return false;
+			text = asm_trim(text);
+
+			auto end	  = std::find_if(text.begin(), text.end(), [](char ch) { return isspace(ch); }) - text.begin();
+			auto mnemonic = text.substr(0, end);
+
+			std::transform(mnemonic.begin(), mnemonic.end(), mnemonic.begin(), [](char ch) { return tolower(ch); });
+
+			text = text.substr(end);
+
+			auto prefix = std::find_if(std::begin(kAsmPrefixes), std::end(kAsmPrefixes), [&](auto& entry) { return mnemonic == entry.first; });
+
+			if (prefix == std::end(kAsmPrefixes))
+				return mnemonic;
+
+			prefixes.push_back(prefix->second);
 		}
 	}
 
-	ToolchainKit::NumberCast8 num = ToolchainKit::NumberCast8(
-		strtol(jump_label.substr(pos).c_str(), nullptr, 10));
+	/// @brief the data directives, db, dw, dd and dq, then .word, .dword and .long.
+	static SizeType asm_data_width(const std::string& mnemonic)
+	{
+		if (mnemonic == "db")
+			return 1;
+		if (mnemonic == "dw" || mnemonic == ".word")
+			return 2;
+		if (mnemonic == "dd" || mnemonic == ".dword")
+			return 4;
+		if (mnemonic == "dq" || mnemonic == ".long")
+			return 8;
 
-	kAppBytes.push_back(num.number);
+		return 0;
+	}
 
-	if (kVerbose)
+	/// @brief numbers, strings (db) and symbols (dd, dq).
+	static void asm_write_data(const std::string& text, SizeType width, const std::string& file)
 	{
-		kStdOut << "AssemblerAMD64: Found a base 10 number here: " << jump_label.substr(pos)
-				<< "\n";
-	}
+		for (auto& item : asm_split_operands(text))
+		{
+			Int64 value = 0;
 
-	return true;
-}
+			if (width == 1 && item.size() > 1 && (item.front() == '"' || item.front() == '\'') && item.back() == item.front())
+			{
+				kAppBytes.insert(kAppBytes.end(), item.begin() + 1, item.end() - 1);
+			}
+			else if (asm_number(item, value))
+			{
+				asm_emit(kAppBytes, value, width);
+			}
+			else if (width >= 4 && !item.empty() && !isdigit(item[0]))
+			{
+				asm_write_relocation(item, width == 8 ? ToolchainKit::kAERelocAbs64 : ToolchainKit::kAERelocAbs32, width, 0L);
+			}
+			else
+			{
+				print_error_asm("Invalid data: " + item, file);
+				throw std::runtime_error("invalid_data");
+			}
+		}
+	}
+} // namespace Details
 
 /////////////////////////////////////////////////////////////////////////////////////////
 
-// @brief Read and write an instruction to the output array.
+// @brief Check for line (syntax check)
 
 /////////////////////////////////////////////////////////////////////////////////////////
 
-bool ToolchainKit::EncoderAMD64::WriteLine(std::string&		 line,
-								  const std::string& file)
+std::string ToolchainKit::EncoderAMD64::CheckLine(std::string&		line,
+										 const std::string& file)
 {
-	if (ToolchainKit::find_word(line, "public_segment "))
-		return true;
+	std::string err_str;
+
+	// the C++ backend ends some lines with \r\n.
+	while (!line.empty() && line.back() == '\r')
+		line.pop_back();
 
-	struct RegMapAMD64
+	if (line.empty() || ToolchainKit::find_word(line, "extern_segment") ||
+		ToolchainKit::find_word(line, "public_segment") ||
+		ToolchainKit::find_word(line, kAssemblerPragmaSymStr) ||
+		ToolchainKit::find_word(line, ";") || line[0] == kAssemblerPragmaSym ||
+		ToolchainKit::find_word(line, ".dword") || ToolchainKit::find_word(line, ".long") ||
+		ToolchainKit::find_word(line, ".word") || ToolchainKit::find_word(line, kIRDirective))
 	{
-		std::string fName;
-		i64_byte_t	fModRM;
-	};
+		if (line.find(';') != std::string::npos)
+		{
+			line.erase(line.find(';'));
+		}
+		else
+		{
+			// now check the line for validity
+			if (!Details::Algorithms::is_valid_amd64(line))
+			{
+				err_str = "Line contains non valid characters.\nhere -> ";
+				err_str += line;
+			}
+		}
 
-	std::vector<RegMapAMD64> kRegisterList{
-		{.fName = "ax", .fModRM = 0x0},
-		{.fName = "cx", .fModRM = 1},
-		{.fName = "dx", .fModRM = 0x2},
-		{.fName = "bx", .fModRM = 3},
-		{.fName = "sp", .fModRM = 0x4},
-		{.fName = "bp", .fModRM = 5},
-		{.fName = "si", .fModRM = 0x6},
-		{.fName = "di", .fModRM = 7},
-		{.fName = "r8", .fModRM = 8},
-		{.fName = "r13", .fModRM = 9},
-		{.fName = "r9", .fModRM = 10},
-		{.fName = "r14", .fModRM = 11},
-		{.fName = "r10", .fModRM = 12},
-		{.fName = "r15", .fModRM = 13},
-		{.fName = "r11", .fModRM = 14},
-	};
+		return err_str;
+	}
+
+	// a local label, WriteLine places it.
+	if (std::string label; asm_label_name(line, label))
+		return err_str;
 
-	bool foundInstruction = false;
+	// check for a valid instruction format.
 
-	for (auto& opcodeAMD64 : kOpcodesAMD64)
+	if (line.find(',') != std::string::npos)
 	{
-		// strict check here
-		if (ToolchainKit::find_word(line, opcodeAMD64.fName) &&
-			Details::Algorithms::is_valid_amd64(line))
+		if (line.find(',') + 1 == line.size())
+		{
+			err_str += "\nInstruction lacks right register, here -> ";
+			err_str += line.substr(line.find(','));
+
+			return err_str;
+		}
+		else
 		{
-			foundInstruction = true;
-			std::string name(opcodeAMD64.fName);
+			bool nothing_on_right = true;
 
-			/// Move instruction handler.
-			if (line.find(name) != std::string::npos &&
-				name == "mov")
+			if (line.find(',') + 1 > line.size())
 			{
-				std::string substr = line.substr(line.find(name) + name.size());
+				err_str += "\nInstruction not complete, here -> ";
+				err_str += line;
 
-				uint64_t bits = kRegisterBitWidth;
+				return err_str;
+			}
 
-				if (substr.find(",") == std::string::npos)
+			auto substr = line.substr(line.find(',') + 1);
+
+			for (auto& ch : substr)
+			{
+				if (ch != ' ' && ch != '\t')
 				{
-					Details::print_error_asm("Syntax error: missing right operand.", "ToolchainKit");
-					throw std::runtime_error("syntax_err");
+					nothing_on_right = false;
 				}
+			}
 
-				bool onlyOneReg = true;
-
-				std::vector<RegMapAMD64> currentRegList;
+			// this means we found nothing after that ',' .
+			if (nothing_on_right)
+			{
+				err_str += "\nInstruction not complete, here -> ";
+				err_str += line;
 
-				for (auto& reg : kRegisterList)
-				{
-					std::vector<char> regExt = {'e', 'r'};
+				return err_str;
+			}
+		}
+	}
+	std::vector<i64_byte_t> prefixes;
+	std::string				operands = line;
 
-					for (auto& ext : regExt)
-					{
-						std::string registerName;
-
-						if (bits > 16)
-							registerName.push_back(ext);
-
-						registerName += reg.fName;
-
-						while (line.find(registerName) != std::string::npos)
-						{
-							line.erase(line.find(registerName), registerName.size());
-
-							if (bits == 16)
-							{
-								if (registerName[0] == 'r')
-								{
-									Details::print_error_asm(
-										"invalid size for register, current bit width is: " +
-											std::to_string(kRegisterBitWidth),
-										file);
-									throw std::runtime_error("invalid_reg_size");
-								}
-							}
-
-							currentRegList.push_back(
-								{.fName = registerName, .fModRM = reg.fModRM});
-						}
-					}
-				}
+	auto mnemonic = Details::asm_mnemonic(operands, prefixes);
+	auto forms	  = amd64_find_forms(mnemonic);
 
-				if (currentRegList.size() > 1)
-					onlyOneReg = false;
+	if (Details::asm_data_width(mnemonic) != 0 || forms.first != forms.second)
+		return err_str;
 
-				bool hasRBasedRegs = false;
+	err_str += "\nUnrecognized instruction -> " + line;
 
-				if (!onlyOneReg)
-				{
-					/// very tricky to understand.
-					/// but this checks for a r8 through r15 register.
-					if (currentRegList[0].fName[0] == 'r' ||
-						currentRegList[1].fName[0] == 'r')
-					{
-						if (isdigit(currentRegList[0].fName[1]) &&
-							isdigit(currentRegList[1].fName[1]))
-						{
-							kAppBytes.emplace_back(0x4d);
-							hasRBasedRegs = true;
-						}
-						else if (isdigit(currentRegList[0].fName[1]) ||
-								 isdigit(currentRegList[1].fName[1]))
-						{
-							kAppBytes.emplace_back(0x4c);
-							hasRBasedRegs = true;
-						}
-					}
-				}
+	return err_str;
+}
 
-				if (bits == 64 || bits == 32)
-				{
-					if (!hasRBasedRegs && bits >= 32)
-					{
-						kAppBytes.emplace_back(opcodeAMD64.fOpcode);
-					}
+/// @brief Write the number at pos of from_what, width bytes little endian.
+static bool asm_write_number(const std::size_t& pos, std::string& from_what, SizeType width)
+{
+	auto text = from_what.substr(std::min(pos, from_what.size()));
 
-					if (!onlyOneReg)
-						kAppBytes.emplace_back(0x89);
-				}
-				else if (bits == 16)
-				{
-					if (hasRBasedRegs)
-					{
-						Details::print_error_asm(
-							"Invalid combination of operands and registers.", "ToolchainKit");
-						throw std::runtime_error("comb_op_reg");
-					}
-					else
-					{
-						kAppBytes.emplace_back(0x66);
-						kAppBytes.emplace_back(0x89);
-					}
-				}
+	if (text.find_first_of(",;") != std::string::npos)
+		text.erase(text.find_first_of(",;"));
 
-				if (onlyOneReg)
-				{
-					auto num = GetNumber32(line, ",");
+	Int64 value = 0;
 
-					for (auto& num_idx: num.number)
-					{
-						if (num_idx == 0)
-							num_idx = 0xFF;
-					}
+	if (!Details::asm_number(text, value))
+		return false;
 
-					auto modrm = (0x3 << 6 |
-								  currentRegList[0].fModRM);
+	Details::asm_emit(kAppBytes, value, width);
 
-					kAppBytes.emplace_back(0xC7); // prefixed before placing the modrm and then the number.
-					kAppBytes.emplace_back(modrm);
-					kAppBytes.emplace_back(num.number[0]);
-					kAppBytes.emplace_back(num.number[1]);
-					kAppBytes.emplace_back(num.number[2]);
-					kAppBytes.emplace_back(num.number[3]);
+	if (kVerbose)
+		kStdOut << "AssemblerAMD64: Found a number here: " << Details::asm_trim(text) << "\n";
 
-					break;
-				}
+	return true;
+}
 
-				if (currentRegList[1].fName[0] == 'r' &&
-					currentRegList[0].fName[0] == 'e')
-				{
-					Details::print_error_asm("Invalid combination of operands and registers.",
-											"ToolchainKit");
-					throw std::runtime_error("comb_op_reg");
-				}
+bool ToolchainKit::EncoderAMD64::WriteNumber(const std::size_t& pos,
+											 std::string&		jump_label)
+{
+	return asm_write_number(pos, jump_label, sizeof(UInt64));
+}
 
-				if (currentRegList[0].fName[0] == 'r' &&
-					currentRegList[1].fName[0] == 'e')
-				{
-					Details::print_error_asm("Invalid combination of operands and registers.",
-											"ToolchainKit");
-					throw std::runtime_error("comb_op_reg");
-				}
+bool ToolchainKit::EncoderAMD64::WriteNumber32(const std::size_t& pos,
+											   std::string&		  jump_label)
+{
+	return asm_write_number(pos, jump_label, sizeof(UInt32));
+}
 
-				if (bits == 16)
-				{
-					if (currentRegList[0].fName[0] == 'r' ||
-						currentRegList[0].fName[0] == 'e')
-					{
-						Details::print_error_asm("Invalid combination of operands and registers.",
-												"ToolchainKit");
-						throw std::runtime_error("comb_op_reg");
-					}
+bool ToolchainKit::EncoderAMD64::WriteNumber16(const std::size_t& pos,
+											   std::string&		  jump_label)
+{
+	return asm_write_number(pos, jump_label, sizeof(UInt16));
+}
 
-					if (currentRegList[1].fName[0] == 'r' ||
-						currentRegList[1].fName[0] == 'e')
-					{
-						Details::print_error_asm("Invalid combination of operands and registers.",
-												"ToolchainKit");
-						throw std::runtime_error("comb_op_reg");
-					}
-				}
-				else
-				{
-					if (currentRegList[0].fName[0] != 'r' ||
-						currentRegList[0].fName[0] == 'e')
-					{
-						Details::print_error_asm("Invalid combination of operands and registers.",
-												"ToolchainKit");
-						throw std::runtime_error("comb_op_reg");
-					}
+bool ToolchainKit::EncoderAMD64::WriteNumber8(const std::size_t& pos,
+											  std::string&		 jump_label)
+{
+	return asm_write_number(pos, jump_label, sizeof(UInt8));
+}
 
-					if (currentRegList[1].fName[0] != 'r' ||
-						currentRegList[1].fName[0] == 'e')
-					{
-						Details::print_error_asm("Invalid combination of operands and registers.",
-												"ToolchainKit");
-						throw std::runtime_error("comb_op_reg");
-					}
-				}
+/////////////////////////////////////////////////////////////////////////////////////////
 
-				/// encode register using the modrm encoding.
+// @brief Read and write an instruction to the output array.
 
-				auto modrm = (0x3 << 6 | currentRegList[1].fModRM << 3 |
-							  currentRegList[0].fModRM);
+/////////////////////////////////////////////////////////////////////////////////////////
 
-				kAppBytes.emplace_back(modrm);
+bool ToolchainKit::EncoderAMD64::WriteLine(std::string&		  line,
+										   const std::string& file)
+{
+	if (ToolchainKit::find_word(line, "public_segment ") || ToolchainKit::find_word(line, "extern_segment "))
+		return true;
 
-				break;
-			}
-			else if (name == "int" || name == "into" || name == "intd")
-			{
-				kAppBytes.emplace_back(opcodeAMD64.fOpcode);
-				this->WriteNumber8(line.find(name) + name.size() + 1, line);
+	auto text = Details::asm_trim(line);
 
-				break;
-			}
-			else if (name == "jmp" || name == "call")
-			{
-				kAppBytes.emplace_back(opcodeAMD64.fOpcode);
+	if (text.empty())
+		return true;
 
-				if (!this->WriteNumber32(line.find(name) + name.size() + 1, line))
-				{
-					throw std::runtime_error("BUG: WriteNumber32");
-				}
+	if (text[0] == kAssemblerPragmaSym)
+	{
+		if (line.find("bits 32") != std::string::npos || line.find("bits 16") != std::string::npos)
+		{
+			Details::print_error_asm("Only 64-bit code is encoded, here -> " + line, file);
+			throw std::runtime_error("invalid_bits");
+		}
+		else if (line.find("org") != std::string::npos)
+		{
+			Int64 origin = 0;
 
-				break;
-			}
-			else
+			if (!Details::asm_number(line.substr(line.find("org") + strlen("org")), origin))
 			{
-				kAppBytes.emplace_back(opcodeAMD64.fOpcode);
-
-				break;
+				Details::print_error_asm("Invalid origin, here -> " + line, file);
+				throw std::runtime_error("invalid_org");
 			}
+
+			kOrigin = origin;
+
+			if (kVerbose)
+				kStdOut << "AssemblerAMD64: origin set: " << kOrigin << std::endl;
 		}
+
+		return true;
 	}
 
-	if (line[0] == kAssemblerPragmaSym)
+	if (std::string label; asm_label_name(text, label))
 	{
-		if (foundInstruction)
+		if (!kLocalLabels.emplace(label, kOrigin + kAppBytes.size()).second)
 		{
-			Details::print_error_asm("Syntax error: " + line, "ToolchainKit");
-			throw std::runtime_error("syntax_err");
+			Details::print_error_asm("Label already defined: " + label, file);
+			throw std::runtime_error("label_defined");
 		}
 
-		if (line.find("bits 64") != std::string::npos)
-		{
-			kRegisterBitWidth = 64U;
-		}
-		else if (line.find("bits 32") != std::string::npos)
-		{
-			kRegisterBitWidth = 32U;
-		}
-		else if (line.find("bits 16") != std::string::npos)
-		{
-			kRegisterBitWidth = 16U;
-		}
-		else if (line.find("org") != std::string::npos)
-		{
-			size_t base[] = {10, 16, 2, 7};
+		return true;
+	}
 
-			for (size_t i = 0; i < 4; i++)
-			{
-				if (kOrigin = strtol(
-						(line.substr(line.find("org") + strlen("org") + 1)).c_str(),
-						nullptr, base[i]);
-					kOrigin)
-				{
-					if (errno != 0)
-					{
-						continue;
-					}
-					else
-					{
-						if (kVerbose)
-						{
-							kStdOut << "AssemblerAMD64: origin set: " << kOrigin << std::endl;
-						}
+	std::vector<i64_byte_t> prefixes;
 
-						break;
-					}
-				}
-			}
-		}
+	auto mnemonic = Details::asm_mnemonic(text, prefixes);
+
+	if (auto width = Details::asm_data_width(mnemonic); width != 0)
+	{
+		Details::asm_write_data(text, width, file);
+		return true;
 	}
-	/// write a dword
-	else if (line.find(".dword") != std::string::npos)
+
+	auto [first, last] = amd64_find_forms(mnemonic);
+
+	if (first == last || !Details::Algorithms::is_valid_amd64(line))
 	{
-		this->WriteNumber32(line.find(".dword") + strlen(".dword") + 1, line);
+		Details::print_error_asm("Unrecognized instruction -> " + line, file);
+		throw std::runtime_error("syntax_err");
 	}
-	/// write a long
-	else if (line.find(".long") != std::string::npos)
+
+	std::vector<Details::asm_operand> operands;
+
+	for (auto& operand : Details::asm_split_operands(text))
 	{
-		this->WriteNumber(line.find(".long") + strlen(".long") + 1, line);
+		Details::asm_operand op;
+
+		if (!Details::asm_parse_operand(operand, op))
+		{
+			Details::print_error_asm("Invalid operand: " + operand + ", here -> " + line, file);
+			throw std::runtime_error("invalid_operand");
+		}
+
+		operands.push_back(op);
 	}
-	/// write a 16-bit number
-	else if (line.find(".word") != std::string::npos)
+
+	Bool branch = std::any_of(first, last, [](const CpuOpcodeAMD64& form) { return form.fOperands[0] == kAsmOpRel8 || form.fOperands[0] == kAsmOpRel32; });
+
+	// a local label is a number here, the target of a branch or a rip relative address.
+	for (auto& op : operands)
 	{
-		this->WriteNumber16(line.find(".word") + strlen(".word") + 1, line);
+		std::uintptr_t address = 0;
+
+		if (op.fSymbol.empty() || !asm_label_address(op.fSymbol, address, file))
+			continue;
+
+		if (op.fKind == Details::asm_operand::kImm ? !branch : !op.fRip)
+		{
+			Details::print_error_asm("A local label is a branch target or a rip relative address, here -> " + line, file);
+			throw std::runtime_error("label_operand");
+		}
+
+		op.fValue += address;
+		op.fLocal = op.fKind == Details::asm_operand::kMem;
+		op.fSymbol.clear();
 	}
 
-	kOrigin += kIPAlignement;
+	// each branch to a number is relaxed, counted in the order of the file to follow it from pass to pass.
+	Bool	 relaxed = operands.size() == 1 && operands[0].fKind == Details::asm_operand::kImm && operands[0].fSymbol.empty() &&
+				   std::any_of(first, last, [](const CpuOpcodeAMD64& form) { return form.fOperands[0] == kAsmOpRel8; });
+	SizeType ordinal = relaxed ? kBranchCounter++ : 0UL;
+	Bool	 grown	 = relaxed && kNearBranches.count(ordinal) != 0;
 
-	return true;
+	// the forms are in the order they are tried, shorter encodings first.
+	for (auto form = first; form != last; ++form)
+	{
+		Int32							size = 0;
+		std::vector<i64_byte_t>			bytes;
+		std::vector<Details::asm_fixup> fixups;
+
+		if (grown && form->fOperands[0] == kAsmOpRel8)
+			continue;
+
+		if (!Details::asm_match(*form, operands, size) ||
+			!Details::asm_encode(*form, operands, size, prefixes, kAppBytes.size(), bytes, fixups))
+			continue;
+
+		if (relaxed && form->fOperands[0] == kAsmOpRel32)
+			kNearBranches.insert(ordinal);
+
+		for (auto& fixup : fixups)
+			asm_relocate(fixup.fSymbol, fixup.fType, kAppBytes.size() + fixup.fOffset, fixup.fAddend);
+
+		kAppBytes.insert(kAppBytes.end(), bytes.begin(), bytes.end());
+
+		return true;
+	}
+
+	if (relaxed)
+	{
+		Details::print_error_asm("Branch target out of reach, here -> " + line, file);
+		throw std::runtime_error("branch_reach");
+	}
+
+	Details::print_error_asm("Invalid combination of operands and registers, or a memory operand without a size (byte, word, dword, qword), here -> " + line, file);
+	throw std::runtime_error("comb_op_reg");
 }
 
 // Last rev 13-1-24
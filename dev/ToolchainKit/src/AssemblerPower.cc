@@ -21,6 +21,7 @@
 #include <ToolchainKit/AAL/CPU/power64.h>
 #include <ToolchainKit/NFC/PEF.h>
 #include <ToolchainKit/Parser.h>
+#include <ToolchainKit/TimeTrace.h>
 #include <ToolchainKit/NFC/AE.h>
 #include <ToolchainKit/Version.h>
 #include <filesystem>
@@ -48,6 +49,9 @@ constexpr auto cPowerIPAlignment = 0x4U;
 static CharType kOutputArch		= ToolchainKit::kPefArchPowerPC;
 static Boolean	kOutputAsBinary = false;
 
+/// @brief AE version of the objects, v1 is for linkers predating v2.
+static CharType kObjectVersion = kAEVersion2;
+
 static UInt32 kErrorLimit		= 10;
 static UInt32 kAcceptableErrors = 0;
 
@@ -69,12 +73,113 @@ static std::vector<std::string>			kUndefinedSymbols;
 static const std::string kUndefinedSymbol = ":UndefinedSymbol:";
 static const std::string kRelocSymbol	  = ":RuntimeSymbol:";
 
+/// @brief the branches ld64 points at a symbol, offsets are in kBytes.
+static std::vector<ToolchainKit::AERelocation> kRelocations;
+
 // \brief forward decl.
 static bool asm_read_attributes(std::string& line);
 
 /// Do not move it on top! it uses the assembler detail namespace!
 #include <AsmUtils.h>
 
+/// @brief Get Number from lineBuffer.
+/// @param lineBuffer the lineBuffer to fetch from.
+/// @param numberKey where to seek that number.
+/// @return
+static NumberCast32 GetNumber32(std::string lineBuffer, std::string numberKey)
+{
+	auto pos = lineBuffer.find(numberKey) + numberKey.size();
+
+	while (lineBuffer[pos] == ' ')
+	{
+		++pos;
+	}
+
+	switch (lineBuffer[pos + 1])
+	{
+	case 'x': {
+		if (auto res = strtol(lineBuffer.substr(pos).c_str(), nullptr, 16); !res)
+		{
+			if (errno != 0)
+			{
+				Details::print_error_asm("invalid hex number: " + lineBuffer, "ToolchainKit");
+				throw std::runtime_error("invalid_hex");
+			}
+		}
+
+		NumberCast32 numOffset(strtol(lineBuffer.substr(pos).c_str(), nullptr, 16));
+
+		if (kVerbose)
+		{
+			kStdOut << "asm: found a base 16 number here: " << lineBuffer.substr(pos)
+					<< "\n";
+		}
+
+		return numOffset;
+	}
+	case 'b': {
+		if (auto res = strtol(lineBuffer.substr(pos).c_str(), nullptr, 2); !res)
+		{
+			if (errno != 0)
+			{
+				Details::print_error_asm("invalid binary number:" + lineBuffer, "ToolchainKit");
+				throw std::runtime_error("invalid_bin");
+			}
+		}
+
+		NumberCast32 numOffset(strtol(lineBuffer.substr(pos).c_str(), nullptr, 2));
+
+		if (kVerbose)
+		{
+			kStdOut << "asm: found a base 2 number here:" << lineBuffer.substr(pos)
+					<< "\n";
+		}
+
+		return numOffset;
+	}
+	case 'o': {
+		if (auto res = strtol(lineBuffer.substr(pos).c_str(), nullptr, 7); !res)
+		{
+			if (errno != 0)
+			{
+				Details::print_error_asm("invalid octal number: " + lineBuffer, "ToolchainKit");
+				throw std::runtime_error("invalid_octal");
+			}
+		}
+
+		NumberCast32 numOffset(strtol(lineBuffer.substr(pos).c_str(), nullptr, 7));
+
+		if (kVerbose)
+		{
+			kStdOut << "asm: found a base 8 number here:" << lineBuffer.substr(pos)
+					<< "\n";
+		}
+
+		return numOffset;
+	}
+	default: {
+		if (auto res = strtol(lineBuffer.substr(pos).c_str(), nullptr, 10); !res)
+		{
+			if (errno != 0)
+			{
+				Details::print_error_asm("invalid hex number: " + lineBuffer, "ToolchainKit");
+				throw std::runtime_error("invalid_hex");
+			}
+		}
+
+		NumberCast32 numOffset(strtol(lineBuffer.substr(pos).c_str(), nullptr, 10));
+
+		if (kVerbose)
+		{
+			kStdOut << "asm: found a base 10 number here:" << lineBuffer.substr(pos)
+					<< "\n";
+		}
+
+		return numOffset;
+	}
+	}
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////
 
 /// @brief POWER assembler entrypoint, the program/module starts here.
@@ -83,6 +188,21 @@ static bool asm_read_attributes(std::string& line);
 
 TOOLCHAINKIT_MODULE(AssemblerMainPower64)
 {
+	// the module may run many times in one process (asm, tkd), start clean.
+	kOutputAsBinary	  = false;
+	kObjectVersion	  = kAEVersion2;
+	kVerbose		  = false;
+	kAcceptableErrors = 0;
+	kCounter		  = 1UL;
+	kOrigin			  = kPefBaseOrigin;
+	kCurrentRecord	  = {.fName = "", .fKind = ToolchainKit::kPefCode, .fSize = 0, .fFlags = 0, .fOffset = 0, .fPad = {}};
+
+	kOriginLabel.clear();
+	kBytes.clear();
+	kRecords.clear();
+	kRelocations.clear();
+	kUndefinedSymbols.clear();
+
 	for (size_t i = 1; i < argc; ++i)
 	{
 		if (argv[i][0] == '-')
@@ -101,6 +221,7 @@ TOOLCHAINKIT_MODULE(AssemblerMainPower64)
 				kStdOut << "--version,/v: print program version.\n";
 				kStdOut << "--verbose: print verbose output.\n";
 				kStdOut << "--binary: output as flat binary.\n";
+				kStdOut << "--ae-v1: output v1 objects, for older linkers.\n";
 
 				return 0;
 			}
@@ -109,6 +230,11 @@ TOOLCHAINKIT_MODULE(AssemblerMainPower64)
 				kOutputAsBinary = true;
 				continue;
 			}
+			else if (strcmp(argv[i], "--ae-v1") == 0)
+			{
+				kObjectVersion = kAEVersion1;
+				continue;
+			}
 			else if (strcmp(argv[i], "--verbose") == 0)
 			{
 				kVerbose = true;
@@ -150,14 +276,15 @@ TOOLCHAINKIT_MODULE(AssemblerMainPower64)
 
 		std::string line;
 
-		ToolchainKit::AEHeader hdr{0};
+		ToolchainKit::AEHeader hdr{};
 
-		memset(hdr.fPad, kAENullType, kAEPad);
+		memset(hdr.fPad, kAENullType, sizeof(hdr.fPad));
 
 		hdr.fMagic[0] = kAEMag0;
 		hdr.fMagic[1] = kAEMag1;
 		hdr.fSize	  = sizeof(ToolchainKit::AEHeader);
 		hdr.fArch	  = kOutputArch;
+		hdr.fVersion  = kObjectVersion;
 
 		/////////////////////////////////////////////////////////////////////////////////////////
 
@@ -167,11 +294,22 @@ TOOLCHAINKIT_MODULE(AssemblerMainPower64)
 
 		ToolchainKit::EncoderPowerPC asm64;
 
+		ToolchainKit::TimeTraceScope trace("Assemble", argv[i]);
+		ToolchainKit::TimeTraceBatch trace_lines("WriteLine", argv[i]);
+
 		while (std::getline(file_ptr, line))
 		{
 			if (auto ln = asm64.CheckLine(line, argv[i]); !ln.empty())
 			{
 				Details::print_error_asm(ln, argv[i]);
+
+				// past the error limit, stop with this file.
+				if (++kAcceptableErrors > kErrorLimit)
+				{
+					std::filesystem::remove(object_output);
+					goto asm_fail_exit;
+				}
+
 				continue;
 			}
 
@@ -179,6 +317,8 @@ TOOLCHAINKIT_MODULE(AssemblerMainPower64)
 			{
 				asm_read_attributes(line);
 				asm64.WriteLine(line, argv[i]);
+
+				trace_lines.Tick();
 			}
 			catch (const std::exception& e)
 			{
@@ -206,6 +346,19 @@ TOOLCHAINKIT_MODULE(AssemblerMainPower64)
 
 			hdr.fCount = kRecords.size() + kUndefinedSymbols.size();
 
+			if (!kRelocations.empty())
+			{
+				if (kObjectVersion == kAEVersion1)
+				{
+					kStdErr << "AssemblerPower: " << argv[i] << " refers to symbols, v1 objects can't carry relocations.\n";
+
+					std::filesystem::remove(object_output);
+					return 1;
+				}
+
+				hdr.fVersion = kAEVersion3;
+			}
+
 			file_ptr_out << hdr;
 
 			if (kRecords.empty())
@@ -219,7 +372,8 @@ TOOLCHAINKIT_MODULE(AssemblerMainPower64)
 
 			kRecords[kRecords.size() - 1].fSize = kBytes.size();
 
-			std::size_t record_count = 0UL;
+			std::vector<ToolchainKit::AERecordHeader> records;
+			std::size_t								  record_count = 0UL;
 
 			for (auto& record_hdr : kRecords)
 			{
@@ -227,7 +381,7 @@ TOOLCHAINKIT_MODULE(AssemblerMainPower64)
 				record_hdr.fOffset = record_count;
 				++record_count;
 
-				file_ptr_out << record_hdr;
+				records.push_back(record_hdr);
 
 				if (kVerbose)
 					kStdOut << "AssemblerPower: Wrote record " << record_hdr.fName << "...\n";
@@ -252,11 +406,20 @@ TOOLCHAINKIT_MODULE(AssemblerMainPower64)
 				memset(undefined_sym.fPad, kAENullType, kAEPad);
 				memcpy(undefined_sym.fName, sym.c_str(), sym.size());
 
-				file_ptr_out << undefined_sym;
+				records.push_back(undefined_sym);
 
 				++kCounter;
 			}
 
+			if (!(kRelocations.empty() ? ToolchainKit::Utils::ae_write_records(file_ptr_out, records, kObjectVersion)
+									   : ToolchainKit::Utils::ae_write_records(file_ptr_out, records, kAEVersion3, kRelocations)))
+			{
+				kStdErr << "AssemblerPower: can't write the records of " << object_output << ".\n";
+
+				std::filesystem::remove(object_output);
+				return 1;
+			}
+
 			auto pos_end = file_ptr_out.tellp();
 
 			file_ptr_out.seekp(pos);
@@ -773,6 +936,35 @@ bool ToolchainKit::EncoderPowerPC::WriteLine(std::string&	   line,
 			}
 			case BADDR:
 			case PCREL: {
+				std::string symbol = line.substr(line.find(name) + name.size());
+
+				while (!symbol.empty() && isspace(symbol.front()))
+					symbol.erase(0, 1);
+
+				if (symbol.find_first_of(" \t;") != std::string::npos)
+					symbol.erase(symbol.find_first_of(" \t;"));
+
+				// b, ba, bl, bla to a symbol, ld64 fills the LI field.
+				if (!symbol.empty() && !isdigit(symbol[0]) && (opcodePPC.opcode & 0xFC000000) == 0x48000000)
+				{
+					if (kOutputAsBinary)
+					{
+						Details::print_error_asm("A symbol needs an object, not a flat binary: " + symbol, "ToolchainKit");
+						throw std::runtime_error("symbol_in_binary");
+					}
+
+					kRelocations.push_back({ToolchainKit::Utils::pef_symbol_name(symbol.c_str()), kBytes.size(), 0L,
+											UInt16(opcodePPC.ops->type == BADDR ? ToolchainKit::kAERelocPowerBranch24Abs
+																				 : ToolchainKit::kAERelocPowerBranch24)});
+
+					NumberCast32 word(opcodePPC.opcode);
+
+					for (auto ch : word.number)
+						kBytes.emplace_back(ch);
+
+					break;
+				}
+
 				auto num = GetNumber32(line, name);
 
 				kBytes.emplace_back(num.number[0]);
@@ -11,6 +11,9 @@
 /// TODO: none
 
 #include <ToolchainKit/AAL/CPU/64x0.h>
+#include <ToolchainKit/AAL/Peephole.h>
+#include <ToolchainKit/ConstantFolder.h>
+#include <ToolchainKit/IR.h>
 #include <ToolchainKit/Parser.h>
 #include <ToolchainKit/UUID.h>
 #include <filesystem>
@@ -51,49 +54,16 @@
 
 /////////////////////////////////////
 
-namespace Details
-{
-	// \brief Register map structure, used to keep track of each variable's registers.
-	struct CompilerRegisterMap final
-	{
-		std::string fName;
-		std::string fReg;
-	};
-
-	// \brief Map for C structs
-	// \author amlel
-	struct CompilerStructMap final
-	{
-		// 'my_foo'
-		std::string fName;
-
-		// if instance: stores a valid register.
-		std::string fReg;
-
-		// offset count
-		std::size_t fOffsetsCnt;
-
-		// offset array.
-		std::vector<std::pair<Int32, std::string>> fOffsets;
-	};
-
-	struct CompilerState final
-	{
-		std::vector<ToolchainKit::SyntaxLeafList> fSyntaxTreeList;
-		std::vector<CompilerRegisterMap> kStackFrame;
-		std::vector<CompilerStructMap>	 kStructMap;
-		ToolchainKit::SyntaxLeafList*			 fSyntaxTree{nullptr};
-		std::unique_ptr<std::ofstream>	 fOutputAssembly;
-		std::string						 fLastFile;
-		std::string						 fLastError;
-		bool							 fVerbose;
-	};
-} // namespace Details
+#include <CompilerState.h>
 
 static Details::CompilerState kState;
 static SizeType				 kErrorLimit	   = 100;
 static std::string			 kIfFunction	   = "";
 static Int32				 kAcceptableErrors = 0;
+static Bool				 kPeepholeEnabled  = true;
+static Bool				 kFoldEnabled	   = true;
+static Bool				 kIREnabled		   = false;
+static Bool				 kLTOEnabled	   = false;
 
 namespace Details
 {
@@ -160,12 +130,59 @@ public:
 };
 
 static CompilerFrontend64x0*			 kCompilerFrontend = nullptr;
-static std::vector<Details::CompilerType> kCompilerVariables;
-static std::vector<std::string>			 kCompilerFunctions;
+static ToolchainKit::SymbolTable		 kCompilerVariables;
+static ToolchainKit::SymbolTable		 kCompilerFunctions;
 static std::vector<Details::CompilerType> kCompilerTypes;
 
 namespace Details
 {
+	/// @brief Open a block, for the variables and their registers.
+	static void cc_enter_scope()
+	{
+		kCompilerVariables.PushScope();
+
+		kState.fScopeMarks.push_back({kState.fSyntaxTree->fLeafList.size(), kState.kStackFrame.PushScope()});
+	}
+
+	/// @brief Close the current block.
+	static void cc_leave_scope()
+	{
+		kCompilerVariables.PopScope();
+
+		kState.fScopeMarks.push_back({kState.fSyntaxTree->fLeafList.size(), kState.kStackFrame.PopScope()});
+	}
+
+	/// @brief Get the variable name of a declaration leaf, "\tldw foo,5" gives "foo".
+	static std::string cc_symbol_name(const std::string& decl)
+	{
+		std::string needle;
+
+		for (size_t i = 0; i < decl.size(); i++)
+		{
+			if (decl[i] == ' ')
+			{
+				++i;
+
+				for (; i < decl.size(); i++)
+				{
+					if (decl[i] == ',')
+					{
+						break;
+					}
+
+					if (decl[i] == ' ')
+						continue;
+
+					needle += decl[i];
+				}
+
+				break;
+			}
+		}
+
+		return needle;
+	}
+
 	union number_cast final {
 	public:
 		number_cast(UInt64 _Raw)
@@ -285,6 +302,8 @@ bool CompilerFrontend64x0::Compile(const std::string text, const std::string fil
 			kInBraces = true;
 			++kBracesCount;
 
+			Details::cc_enter_scope();
+
 			kState.fSyntaxTree->fLeafList.push_back(syntaxLeaf);
 		}
 
@@ -564,11 +583,7 @@ bool CompilerFrontend64x0::Compile(const std::string text, const std::string fil
 					substr.erase(substr.find("public_segment .data64"), strlen("public_segment .data64"));
 			}
 
-			auto var_to_find =
-				std::find_if(kCompilerVariables.cbegin(), kCompilerVariables.cend(),
-							 [&](Details::CompilerType type) {
-								 return type.fName.find(substr) != std::string::npos;
-							 });
+			auto symbol = Details::cc_symbol_name(substr);
 
 			if (kRegisterCounter == 5 || kRegisterCounter == 6)
 				++kRegisterCounter;
@@ -576,12 +591,11 @@ bool CompilerFrontend64x0::Compile(const std::string text, const std::string fil
 			std::string reg = kAsmRegisterPrefix;
 			reg += std::to_string(kRegisterCounter);
 
-			if (var_to_find == kCompilerVariables.cend())
+			if (!kState.kStackFrame.FindLocal(symbol))
 			{
 				++kRegisterCounter;
 
-				kState.kStackFrame.push_back({.fName = substr, .fReg = reg});
-				kCompilerVariables.push_back({.fName = substr});
+				kState.kStackFrame.Declare(symbol, reg);
 			}
 
 			syntaxLeaf.fUserValue += substr;
@@ -693,7 +707,7 @@ bool CompilerFrontend64x0::Compile(const std::string text, const std::string fil
 				fnFound = true;
 			}
 
-			kCompilerFunctions.push_back(textBuffer);
+			kCompilerFunctions.Declare(Details::last_identifier(textBuffer.substr(0, textBuffer.find('('))), textBuffer);
 		}
 
 		if (textBuffer[text_index] == '-' && textBuffer[text_index + 1] == '-')
@@ -730,6 +744,8 @@ bool CompilerFrontend64x0::Compile(const std::string text, const std::string fil
 
 			if (kInStruct)
 				kInStruct = false;
+			else
+				Details::cc_leave_scope();
 
 			kState.fSyntaxTree->fLeafList.push_back(syntaxLeaf);
 		}
@@ -921,7 +937,7 @@ std::string CompilerFrontend64x0::Check(const char* text, const char* file)
 					std::string reg = kAsmRegisterPrefix;
 					reg += std::to_string(kRegisterCounter);
 
-					kCompilerVariables.push_back({.fValue = varname});
+					kCompilerVariables.Declare(varname);
 					goto cc_check_done;
 				}
 
@@ -941,47 +957,16 @@ std::string CompilerFrontend64x0::Check(const char* text, const char* file)
 			while (keyword.find(' ') != std::string::npos)
 				keyword.erase(keyword.find(' '), 1);
 
-			for (auto& var : kCompilerVariables)
+			if (kCompilerVariables.Find(keyword))
 			{
-				if (var.fValue.find(keyword) != std::string::npos)
-				{
-					err_str.clear();
-					goto cc_next;
-				}
+				err_str.clear();
+				goto cc_next;
 			}
 
-			for (auto& fn : kCompilerFunctions)
+			if (kCompilerFunctions.Find(Details::last_identifier(keyword.substr(0, keyword.find('(')))))
 			{
-				if (fn.find(keyword[0]) != std::string::npos)
-				{
-					auto where_begin   = fn.find(keyword[0]);
-					auto keyword_begin = 0UL;
-					auto failed		   = false;
-
-					for (; where_begin < keyword.size(); ++where_begin)
-					{
-						if (fn[where_begin] == '(' && keyword[keyword_begin] == '(')
-							break;
-
-						if (fn[where_begin] != keyword[keyword_begin])
-						{
-							failed = true;
-							break;
-						}
-
-						++keyword_begin;
-					}
-
-					if (!failed)
-					{
-						err_str.clear();
-						goto cc_next;
-					}
-					else
-					{
-						continue;
-					}
-				}
+				err_str.clear();
+				goto cc_next;
 			}
 
 		cc_error_value:
@@ -1008,7 +993,7 @@ cc_next:
 	if (ToolchainKit::find_word(ln, "extern"))
 	{
 		auto substr = ln.substr(ln.find("extern") + strlen("extern"));
-		kCompilerVariables.push_back({.fValue = substr});
+		kCompilerVariables.Declare(Details::last_identifier(substr));
 	}
 
 	if (kShouldHaveBraces && ln.find('{') == std::string::npos)
@@ -1350,9 +1335,65 @@ public:
 		kState.fSyntaxTree =
 			&kState.fSyntaxTreeList[kState.fSyntaxTreeList.size() - 1];
 
-		std::string line_src;
+		// variables don't outlive their translation unit.
+		kState.kStackFrame.Clear();
+		kState.fScopeMarks.clear();
+		kCompilerVariables.Clear();
+
+		std::vector<std::string> lines;
+		std::string				 line_src;
 
 		while (std::getline(src_fp, line_src))
+		{
+			lines.push_back(line_src);
+		}
+
+		std::string ir;
+
+		if (kIREnabled)
+		{
+			std::string source;
+
+			for (auto& line : lines)
+			{
+				source += line;
+				source += "\n";
+			}
+
+			std::string assembly, error;
+
+			if (!ToolchainKit::ir_compile(source, ToolchainKit::AssemblyFactory::kArch64x0, assembly, ir, error))
+			{
+				Details::print_error_asm(error, src.data());
+				return 1;
+			}
+
+			auto syntaxLeaf	   = ToolchainKit::SyntaxLeafList::SyntaxLeaf();
+			syntaxLeaf.fUserValue = assembly;
+
+			kState.fSyntaxTree->fLeafList.push_back(syntaxLeaf);
+
+			// the selector did the whole file.
+			lines.clear();
+		}
+		else if (kFoldEnabled)
+		{
+			std::vector<std::string> types;
+
+			for (auto& type : kCompilerTypes)
+			{
+				types.push_back(type.fName);
+			}
+
+			ToolchainKit::ConstantFolder folder(types);
+			lines = folder.Run(lines);
+
+			if (kState.fVerbose)
+				std::cout << "fold: folded " << folder.Folded() << " expression(s), removed "
+						  << folder.Removed() << " line(s).\n";
+		}
+
+		for (auto& line_src : lines)
 		{
 			if (auto err = kCompilerFrontend->Check(line_src.c_str(), src.data());
 				err.empty())
@@ -1373,10 +1414,22 @@ public:
 
 		///
 		/// Replace, optimize, fix assembly output.
+		/// One pass, each leaf is resolved against the scope it was emitted in.
 		///
 
-		for (auto& leaf : kState.fSyntaxTree->fLeafList)
+		auto mark  = kState.fScopeMarks.cbegin();
+		auto scope = ToolchainKit::SymbolTable::kGlobalScope;
+
+		for (SizeType leaf_index = 0UL; leaf_index < kState.fSyntaxTree->fLeafList.size(); ++leaf_index)
 		{
+			auto& leaf = kState.fSyntaxTree->fLeafList[leaf_index];
+
+			while (mark != kState.fScopeMarks.cend() && mark->first <= leaf_index)
+			{
+				scope = mark->second;
+				++mark;
+			}
+
 			std::vector<std::string> access_keywords = {"->", "."};
 
 			for (auto& access_ident : access_keywords)
@@ -1390,84 +1443,47 @@ public:
 				}
 			}
 
-			for (auto& keyword : keywords)
-			{
-				if (ToolchainKit::find_word(leaf.fUserValue, keyword))
-				{
-					std::size_t cnt = 0UL;
-
-					for (auto& reg : kState.kStackFrame)
-					{
-						std::string needle;
-
-						for (size_t i = 0; i < reg.fName.size(); i++)
-						{
-							if (reg.fName[i] == ' ')
-							{
-								++i;
-
-								for (; i < reg.fName.size(); i++)
-								{
-									if (reg.fName[i] == ',')
-									{
-										break;
-									}
-
-									if (reg.fName[i] == ' ')
-										continue;
+			auto keyword = std::find_if(keywords.cbegin(), keywords.cend(), [&](const std::string& word) {
+				return ToolchainKit::find_word(leaf.fUserValue, word);
+			});
 
-									needle += reg.fName[i];
-								}
+			if (keyword == keywords.cend())
+				continue;
 
-								break;
-							}
-						}
+			Details::resolve_symbols(kState, leaf.fUserValue, scope);
+		}
 
-						if (ToolchainKit::find_word(leaf.fUserValue, needle))
-						{
-							if (leaf.fUserValue.find("extern_segment " + needle) !=
-								std::string::npos)
-							{
-								std::string range = "extern_segment " + needle;
-								leaf.fUserValue.replace(
-									leaf.fUserValue.find("extern_segment " + needle), range.size(),
-									needle);
-							}
+		std::string assembly;
 
-							if (leaf.fUserValue.find("ldw r6") != std::string::npos)
-							{
-								std::string::difference_type countComma = std::count(
-									leaf.fUserValue.begin(), leaf.fUserValue.end(), ',');
-
-								if (countComma == 1)
-								{
-									leaf.fUserValue.replace(leaf.fUserValue.find("ldw"),
-															strlen("ldw"), "mv");
-								}
-							}
+		for (auto& leaf : kState.fSyntaxTree->fLeafList)
+		{
+			assembly += leaf.fUserValue;
+		}
 
-							leaf.fUserValue.replace(leaf.fUserValue.find(needle),
-													needle.size(), reg.fReg);
+		// resolved symbols leave ldw/stw between two registers, the peephole stage turns them into mv.
+		ToolchainKit::PeepholeOptimizer peephole(ToolchainKit::AssemblyFactory::kArch64x0);
+		auto							instrs = peephole.Parse(assembly);
 
-							++cnt;
-						}
-					}
+		if (kPeepholeEnabled)
+		{
+			peephole.Optimize(instrs);
 
-					if (cnt > 1 && keyword != "mv" && keyword != "add" &&
-						keyword != "sub")
-					{
-						leaf.fUserValue.replace(leaf.fUserValue.find(keyword),
-												keyword.size(), "mv");
-					}
-				}
-			}
+			if (kState.fVerbose)
+				std::cout << "peephole: removed " << peephole.Removed() << " instruction(s).\n";
 		}
-
-		for (auto& leaf : kState.fSyntaxTree->fLeafList)
+		else
 		{
-			(*kState.fOutputAssembly) << leaf.fUserValue;
+			peephole.Lower(instrs);
 		}
 
+		assembly = peephole.Emit(instrs);
+
+		// the object carries its IR for ld64 --ld64:lto, the code stays for a regular link.
+		if (kLTOEnabled)
+			assembly += ToolchainKit::ir_directives(ir);
+
+		(*kState.fOutputAssembly) << assembly;
+
 		kState.fSyntaxTree = nullptr;
 
 		kState.fOutputAssembly->flush();
@@ -1533,6 +1549,36 @@ TOOLCHAINKIT_MODULE(NewOSCompilerCLang64x0)
 				continue;
 			}
 
+			if (strcmp(argv[index], "--fno-peephole") == 0)
+			{
+				kPeepholeEnabled = false;
+
+				continue;
+			}
+
+			if (strcmp(argv[index], "--fno-fold") == 0)
+			{
+				kFoldEnabled = false;
+
+				continue;
+			}
+
+			if (strcmp(argv[index], "--ir") == 0)
+			{
+				kIREnabled = true;
+
+				continue;
+			}
+
+			// the IR goes in the object too, for link time optimization.
+			if (strcmp(argv[index], "--lto") == 0)
+			{
+				kIREnabled	= true;
+				kLTOEnabled = true;
+
+				continue;
+			}
+
 			if (strcmp(argv[index], "--h") == 0 || strcmp(argv[index], "--help") == 0)
 			{
 				cc_print_help();
@@ -8,6 +8,9 @@
  */
 
 #include <ToolchainKit/AAL/CPU/power64.h>
+#include <ToolchainKit/AAL/Peephole.h>
+#include <ToolchainKit/ConstantFolder.h>
+#include <ToolchainKit/IR.h>
 #include <ToolchainKit/Parser.h>
 #include <ToolchainKit/UUID.h>
 #include <filesystem>
@@ -42,49 +45,15 @@
 
 /////////////////////////////////////
 
-namespace Details
-{
-	// \brief name to register struct.
-	struct CompilerRegisterMap final
-	{
-		std::string fName;
-		std::string fReg;
-	};
-
-	// \brief Map for C structs
-	// \author amlel
-	struct CompilerStructMap final
-	{
-		/// 'struct::my_foo'
-		std::string fName;
-
-		/// if instance: stores a valid register.
-		std::string fReg;
-
-		/// offset count
-		std::size_t fOffsetsCnt;
-
-		/// offset array.
-		std::vector<std::pair<Int32, std::string>> fOffsets;
-	};
-
-	struct CompilerState final
-	{
-		std::vector<ToolchainKit::SyntaxLeafList> fSyntaxTreeList;
-		std::vector<CompilerRegisterMap> kStackFrame;
-		std::vector<CompilerStructMap>	 kStructMap;
-		ToolchainKit::SyntaxLeafList*			 fSyntaxTree{nullptr};
-		std::unique_ptr<std::ofstream>	 fOutputAssembly;
-		std::string						 fLastFile;
-		std::string						 fLastError;
-		bool							 fVerbose;
-	};
-} // namespace Details
+#include <CompilerState.h>
 
 static Details::CompilerState kState;
 static SizeType				 kErrorLimit	   = 100;
 static std::string			 kIfFunction	   = "";
 static Int32				 kAcceptableErrors = 0;
+static Bool				 kPeepholeEnabled  = true;
+static Bool				 kFoldEnabled	   = true;
+static Bool				 kIREnabled		   = false;
 
 namespace Details
 {
@@ -151,12 +120,28 @@ public:
 };
 
 static CompilerFrontendPower64*			 kCompilerFrontend = nullptr;
-static std::vector<Details::CompilerType> kCompilerVariables;
-static std::vector<std::string>			 kCompilerFunctions;
+static ToolchainKit::SymbolTable		 kCompilerVariables;
+static ToolchainKit::SymbolTable		 kCompilerFunctions;
 static std::vector<Details::CompilerType> kCompilerTypes;
 
 namespace Details
 {
+	/// @brief Open a block, for the variables and their registers.
+	static void cc_enter_scope()
+	{
+		kCompilerVariables.PushScope();
+
+		kState.fScopeMarks.push_back({kState.fSyntaxTree->fLeafList.size(), kState.kStackFrame.PushScope()});
+	}
+
+	/// @brief Close the current block.
+	static void cc_leave_scope()
+	{
+		kCompilerVariables.PopScope();
+
+		kState.fScopeMarks.push_back({kState.fSyntaxTree->fLeafList.size(), kState.kStackFrame.PopScope()});
+	}
+
 	union number_cast final {
 	public:
 		number_cast(UInt64 _Raw)
@@ -276,6 +261,8 @@ bool CompilerFrontendPower64::Compile(const std::string text, const std::string
 			kInBraces = true;
 			++kBracesCount;
 
+			Details::cc_enter_scope();
+
 			kState.fSyntaxTree->fLeafList.push_back(syntaxLeaf);
 		}
 
@@ -341,19 +328,9 @@ bool CompilerFrontendPower64::Compile(const std::string text, const std::string
 					while (value.find("extern_segment") != std::string::npos)
 						value.erase(value.find("extern_segment"), strlen("extern_segment"));
 
-					bool found = false;
-
-					for (auto& reg : kState.kStackFrame)
-					{
-						if (value.find(reg.fName) != std::string::npos)
-						{
-							found = true;
-							syntaxLeaf.fUserValue += reg.fReg;
-							break;
-						}
-					}
-
-					if (!found)
+					if (auto reg = kState.kStackFrame.Find(value); reg)
+						syntaxLeaf.fUserValue += reg->fValue;
+					else
 						syntaxLeaf.fUserValue += "r0";
 				}
 
@@ -575,14 +552,6 @@ bool CompilerFrontendPower64::Compile(const std::string text, const std::string
 					substr.erase(substr.find("public_segment .data64"), strlen("public_segment .data64"));
 			}
 
-			auto var_to_find =
-				std::find_if(kCompilerVariables.cbegin(), kCompilerVariables.cend(),
-							 [&](Details::CompilerType type) {
-								 return type.fName.find(substr) != std::string::npos;
-							 });
-
-			kCompilerVariables.push_back({.fName = substr});
-
 			if (textBuffer[text_index] == ';')
 				break;
 
@@ -606,7 +575,8 @@ bool CompilerFrontendPower64::Compile(const std::string text, const std::string
 				symbol += (newSubstr[start]);
 			}
 
-			kState.kStackFrame.push_back({.fName = symbol, .fReg = reg});
+			// an assignment writes to the register the variable already has.
+			reg = kState.kStackFrame.Declare(symbol, reg).fValue;
 
 			syntaxLeaf.fUserValue +=
 				"\n\tli " + reg + substr.substr(substr.find(','));
@@ -716,7 +686,7 @@ bool CompilerFrontendPower64::Compile(const std::string text, const std::string
 				fnFound = true;
 			}
 
-			kCompilerFunctions.push_back(textBuffer);
+			kCompilerFunctions.Declare(Details::last_identifier(textBuffer.substr(0, textBuffer.find('('))), textBuffer);
 		}
 
 		if (textBuffer[text_index] == '-' && textBuffer[text_index + 1] == '-')
@@ -753,6 +723,8 @@ bool CompilerFrontendPower64::Compile(const std::string text, const std::string
 
 			if (kInStruct)
 				kInStruct = false;
+			else
+				Details::cc_leave_scope();
 
 			kState.fSyntaxTree->fLeafList.push_back(syntaxLeaf);
 		}
@@ -944,7 +916,7 @@ std::string CompilerFrontendPower64::Check(const char* text, const char* file)
 					std::string reg = kAsmRegisterPrefix;
 					reg += std::to_string(kRegisterCounter);
 
-					kCompilerVariables.push_back({.fValue = varname});
+					kCompilerVariables.Declare(varname);
 					goto cc_check_done;
 				}
 
@@ -964,47 +936,16 @@ std::string CompilerFrontendPower64::Check(const char* text, const char* file)
 			while (keyword.find(' ') != std::string::npos)
 				keyword.erase(keyword.find(' '), 1);
 
-			for (auto& var : kCompilerVariables)
+			if (kCompilerVariables.Find(keyword))
 			{
-				if (var.fValue.find(keyword) != std::string::npos)
-				{
-					err_str.clear();
-					goto cc_next;
-				}
+				err_str.clear();
+				goto cc_next;
 			}
 
-			for (auto& fn : kCompilerFunctions)
+			if (kCompilerFunctions.Find(Details::last_identifier(keyword.substr(0, keyword.find('(')))))
 			{
-				if (fn.find(keyword[0]) != std::string::npos)
-				{
-					auto where_begin   = fn.find(keyword[0]);
-					auto keyword_begin = 0UL;
-					auto failed		   = false;
-
-					for (; where_begin < keyword.size(); ++where_begin)
-					{
-						if (fn[where_begin] == '(' && keyword[keyword_begin] == '(')
-							break;
-
-						if (fn[where_begin] != keyword[keyword_begin])
-						{
-							failed = true;
-							break;
-						}
-
-						++keyword_begin;
-					}
-
-					if (!failed)
-					{
-						err_str.clear();
-						goto cc_next;
-					}
-					else
-					{
-						continue;
-					}
-				}
+				err_str.clear();
+				goto cc_next;
 			}
 
 		cc_error_value:
@@ -1031,7 +972,7 @@ cc_next:
 	if (ToolchainKit::find_word(ln, "extern"))
 	{
 		auto substr = ln.substr(ln.find("extern") + strlen("extern"));
-		kCompilerVariables.push_back({.fValue = substr});
+		kCompilerVariables.Declare(Details::last_identifier(substr));
 	}
 
 	if (kShouldHaveBraces && ln.find('{') == std::string::npos)
@@ -1373,9 +1314,63 @@ public:
 		kState.fSyntaxTree =
 			&kState.fSyntaxTreeList[kState.fSyntaxTreeList.size() - 1];
 
-		std::string line_src;
+		// variables don't outlive their translation unit.
+		kState.kStackFrame.Clear();
+		kState.fScopeMarks.clear();
+		kCompilerVariables.Clear();
+
+		std::vector<std::string> lines;
+		std::string				 line_src;
 
 		while (std::getline(src_fp, line_src))
+		{
+			lines.push_back(line_src);
+		}
+
+		if (kIREnabled)
+		{
+			std::string source;
+
+			for (auto& line : lines)
+			{
+				source += line;
+				source += "\n";
+			}
+
+			std::string assembly, error;
+
+			if (!ToolchainKit::ir_compile(source, ToolchainKit::AssemblyFactory::kArchPowerPC, assembly, error))
+			{
+				Details::print_error_asm(error, src.data());
+				return 1;
+			}
+
+			auto syntaxLeaf	   = ToolchainKit::SyntaxLeafList::SyntaxLeaf();
+			syntaxLeaf.fUserValue = assembly;
+
+			kState.fSyntaxTree->fLeafList.push_back(syntaxLeaf);
+
+			// the selector did the whole file.
+			lines.clear();
+		}
+		else if (kFoldEnabled)
+		{
+			std::vector<std::string> types;
+
+			for (auto& type : kCompilerTypes)
+			{
+				types.push_back(type.fName);
+			}
+
+			ToolchainKit::ConstantFolder folder(types);
+			lines = folder.Run(lines);
+
+			if (kState.fVerbose)
+				std::cout << "fold: folded " << folder.Folded() << " expression(s), removed "
+						  << folder.Removed() << " line(s).\n";
+		}
+
+		for (auto& line_src : lines)
 		{
 			if (auto err = kCompilerFrontend->Check(line_src.c_str(), src.data());
 				err.empty())
@@ -1395,10 +1390,22 @@ public:
 
 		///
 		/// Replace, optimize, fix assembly output.
+		/// One pass, each leaf is resolved against the scope it was emitted in.
 		///
 
-		for (auto& leaf : kState.fSyntaxTree->fLeafList)
+		auto mark  = kState.fScopeMarks.cbegin();
+		auto scope = ToolchainKit::SymbolTable::kGlobalScope;
+
+		for (SizeType leaf_index = 0UL; leaf_index < kState.fSyntaxTree->fLeafList.size(); ++leaf_index)
 		{
+			auto& leaf = kState.fSyntaxTree->fLeafList[leaf_index];
+
+			while (mark != kState.fScopeMarks.cend() && mark->first <= leaf_index)
+			{
+				scope = mark->second;
+				++mark;
+			}
+
 			std::vector<std::string> access_keywords = {"->", "."};
 
 			for (auto& access_ident : access_keywords)
@@ -1412,82 +1419,53 @@ public:
 				}
 			}
 
-			for (auto& keyword : keywords)
-			{
-				if (ToolchainKit::find_word(leaf.fUserValue, keyword))
-				{
-					std::size_t cnt = 0UL;
-
-					for (auto& reg : kState.kStackFrame)
-					{
-						std::string needle;
-
-						for (size_t i = 0; i < reg.fName.size(); i++)
-						{
-							if (reg.fName[i] == ' ')
-							{
-								++i;
-
-								for (; i < reg.fName.size(); i++)
-								{
-									if (reg.fName[i] == ',')
-									{
-										break;
-									}
-
-									if (reg.fName[i] == ' ')
-										continue;
-
-									needle += reg.fName[i];
-								}
-
-								break;
-							}
-						}
-
-						if (ToolchainKit::find_word(leaf.fUserValue, needle))
-						{
-							if (leaf.fUserValue.find("extern_segment ") != std::string::npos)
-							{
-								std::string range = "extern_segment ";
-								leaf.fUserValue.replace(leaf.fUserValue.find(range),
-														range.size(), "");
-							}
+			auto keyword = std::find_if(keywords.cbegin(), keywords.cend(), [&](const std::string& word) {
+				return ToolchainKit::find_word(leaf.fUserValue, word);
+			});
 
-							if (leaf.fUserValue.find("ldw r6") != std::string::npos)
-							{
-								std::string::difference_type countComma = std::count(
-									leaf.fUserValue.begin(), leaf.fUserValue.end(), ',');
-
-								if (countComma == 1)
-								{
-									leaf.fUserValue.replace(leaf.fUserValue.find("ldw"),
-															strlen("ldw"), "mr");
-								}
-							}
+			if (keyword == keywords.cend())
+				continue;
 
-							leaf.fUserValue.replace(leaf.fUserValue.find(needle),
-													needle.size(), reg.fReg);
+			auto cnt = Details::resolve_symbols(kState, leaf.fUserValue, scope);
 
-							++cnt;
-						}
-					}
+			if (cnt > 0 && leaf.fUserValue.find("ldw r6") != std::string::npos)
+			{
+				std::string::difference_type countComma = std::count(
+					leaf.fUserValue.begin(), leaf.fUserValue.end(), ',');
 
-					if (cnt > 1 && keyword != "mr" && keyword != "add" &&
-						keyword != "dec")
-					{
-						leaf.fUserValue.replace(leaf.fUserValue.find(keyword),
-												keyword.size(), "mr");
-					}
+				if (countComma == 1)
+				{
+					leaf.fUserValue.replace(leaf.fUserValue.find("ldw"),
+											strlen("ldw"), "mr");
 				}
 			}
+
+			if (cnt > 1 && *keyword != "mr" && *keyword != "add" &&
+				*keyword != "dec")
+			{
+				leaf.fUserValue.replace(leaf.fUserValue.find(*keyword),
+										keyword->size(), "mr");
+			}
 		}
 
+		std::string assembly;
+
 		for (auto& leaf : kState.fSyntaxTree->fLeafList)
 		{
-			(*kState.fOutputAssembly) << leaf.fUserValue;
+			assembly += leaf.fUserValue;
 		}
 
+		if (kPeepholeEnabled)
+		{
+			ToolchainKit::PeepholeOptimizer peephole(ToolchainKit::AssemblyFactory::kArchPowerPC);
+			assembly = peephole.Run(assembly);
+
+			if (kState.fVerbose)
+				std::cout << "peephole: removed " << peephole.Removed() << " instruction(s).\n";
+		}
+
+		(*kState.fOutputAssembly) << assembly;
+
 		kState.fSyntaxTree = nullptr;
 
 		kState.fOutputAssembly->flush();
@@ -1553,6 +1531,27 @@ TOOLCHAINKIT_MODULE(NewOSCompilerCLangPowerPC)
 				continue;
 			}
 
+			if (strcmp(argv[index], "-fno-peephole") == 0)
+			{
+				kPeepholeEnabled = false;
+
+				continue;
+			}
+
+			if (strcmp(argv[index], "-fno-fold") == 0)
+			{
+				kFoldEnabled = false;
+
+				continue;
+			}
+
+			if (strcmp(argv[index], "-ir") == 0)
+			{
+				kIREnabled = true;
+
+				continue;
+			}
+
 			if (strcmp(argv[index], "-h") == 0 || strcmp(argv[index], "-help") == 0)
 			{
 				cc_print_help();
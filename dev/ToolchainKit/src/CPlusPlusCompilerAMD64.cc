@@ -21,8 +21,13 @@
 // extern_segment, @autodelete { ... }, fn foo() -> auto { ... }
 
 #include <ToolchainKit/AAL/CPU/amd64.h>
+#include <ToolchainKit/AAL/Peephole.h>
+#include <ToolchainKit/IR.h>
 #include <ToolchainKit/Parser.h>
+#include <ToolchainKit/StructLayout.h>
+#include <ToolchainKit/TimeTrace.h>
 #include <ToolchainKit/UUID.h>
+#include <CompilerState.h>
 
 /* ZKA C++ Compiler */
 /* This is part of the ToolchainKit. */
@@ -32,7 +37,7 @@
 /// @file CPlusPlusCompilerAMD64.cxx
 /// @brief Optimized C++ Compiler Driver.
 /// @todo Throw error for scoped inside scoped variables when they get referenced outside.
-/// @todo Add class/struct/enum support.
+/// @todo Add enum support.
 
 ///////////////////////
 
@@ -73,42 +78,18 @@ namespace Details
 		}
 		return p;
 	}
-
-	struct CompilerRegisterMap final
-	{
-		std::string fName;
-		std::string fReg;
-	};
-
-	// \brief Offset based struct/class
-	struct CompilerStructMap final
-	{
-		std::string fName;
-		std::string fReg;
-
-		// offset counter
-		std::size_t fOffsetsCnt;
-
-		// offset array
-		std::vector<std::pair<Int32, std::string>> fOffsets;
-	};
-
-	struct CompilerState final
-	{
-		std::vector<CompilerRegisterMap> fStackMapVector;
-		std::vector<CompilerStructMap>	 fStructMapVector;
-		ToolchainKit::SyntaxLeafList*	 fSyntaxTree{nullptr};
-		std::unique_ptr<std::ofstream>	 fOutputAssembly;
-		std::string						 fLastFile;
-		std::string						 fLastError;
-		bool							 fVerbose;
-	};
 } // namespace Details
 
 static Details::CompilerState kState;
 static SizeType				 kErrorLimit = 100;
 
 static Int32 kAcceptableErrors = 0;
+static Bool  kPeepholeEnabled  = true;
+static Bool  kIREnabled		   = false;
+static Bool  kLTOEnabled	   = false;
+
+/// @brief widest vector of the IR selector in bytes, 0 for SSE2.
+static SizeType kVectorSize = 0UL;
 
 namespace Details
 {
@@ -205,8 +186,712 @@ static std::vector<std::string> kRegisterConventionCallList = {
 
 static std::size_t kFunctionEmbedLevel = 0UL;
 
+/// @internal struct layouts, and the struct typed variables of the current function.
+
+static ToolchainKit::StructLayoutEngine				kStructLayouts;
+static std::unordered_map<std::string, std::string> kStructVariables; // variable -> struct.
+static std::string									kStructName;
+static std::vector<ToolchainKit::StructFieldDecl>	kStructFields;
+static ToolchainKit::StructLayoutHints				kStructHints;
+static bool											kStructVirtual	 = false;
+static std::size_t									kStructFrameSize = 0UL; // stack taken by instances.
+
+/// @internal function being traced, a function's span ends where the next one starts.
+static std::string kTraceFunction;
+static UInt64	   kTraceFunctionStart = 0UL;
+
 /// detail namespaces
 
+namespace Details
+{
+	/// @brief End the span of the current function, and start the one of name if any.
+	static void cxx_trace_function(const std::string& name)
+	{
+		if (!ToolchainKit::TimeTrace::Enabled())
+			return;
+
+		auto now = ToolchainKit::TimeTrace::Now();
+
+		if (!kTraceFunction.empty())
+			ToolchainKit::TimeTrace::Add("Function", kTraceFunction, kTraceFunctionStart, now);
+
+		kTraceFunction		= name;
+		kTraceFunctionStart = now;
+	}
+
+	static std::string cxx_trim(std::string text)
+	{
+		while (!text.empty() && isspace(text.front()))
+			text.erase(0, 1);
+
+		while (!text.empty() && isspace(text.back()))
+			text.pop_back();
+
+		return text;
+	}
+
+	/// @brief Register of a variable, empty if there is no such variable.
+	static std::string cxx_register_of(const std::string& name)
+	{
+		for (std::size_t index = 0UL; index < kRegisterMap.size(); ++index)
+		{
+			if (kRegisterMap[index] == name)
+				return kRegisterList[index];
+		}
+
+		return "";
+	}
+
+	/// @brief Name of the low size bytes of a 64-bit register.
+	static std::string cxx_sized_register(const std::string& reg, std::size_t size)
+	{
+		if (size == 8)
+			return reg;
+
+		// r8 to r15.
+		if (isdigit(reg[1]))
+			return reg + (size == 4 ? "d" : (size == 2 ? "w" : "b"));
+
+		auto base = reg.substr(1);
+
+		if (size == 4)
+			return "e" + base;
+
+		if (size == 2)
+			return base;
+
+		if (base == "si" || base == "di")
+			return base + "l";
+
+		return base.substr(0, 1) + "l";
+	}
+
+	static const char* cxx_size_keyword(std::size_t size)
+	{
+		switch (size)
+		{
+		case 1:
+			return "byte";
+		case 2:
+			return "word";
+		case 4:
+			return "dword";
+		default:
+			return "qword";
+		}
+	}
+
+	/// @brief Take the [[...]] and alignas(N) out of text.
+	static void cxx_struct_attributes(std::string& text, std::vector<std::string>& attrs, std::size_t& align_as)
+	{
+		while (text.find("[[") != std::string::npos)
+		{
+			auto begin = text.find("[[");
+			auto end   = text.find("]]", begin);
+
+			if (end == std::string::npos)
+				break;
+
+			std::string attr;
+
+			for (auto ch : text.substr(begin + 2, end - begin - 2) + ",")
+			{
+				if (ch == ',')
+				{
+					attrs.push_back(cxx_trim(attr));
+					attr.clear();
+
+					continue;
+				}
+
+				attr += ch;
+			}
+
+			text.erase(begin, end + 2 - begin);
+		}
+
+		while (text.find("alignas(") != std::string::npos)
+		{
+			auto begin = text.find("alignas(");
+			auto end   = text.find(')', begin);
+
+			if (end == std::string::npos)
+				break;
+
+			align_as = std::max<std::size_t>(align_as, std::strtoul(text.substr(begin + strlen("alignas(")).c_str(), nullptr, 10));
+			text.erase(begin, end + 1 - begin);
+		}
+	}
+
+	/// @brief Read the head of a struct, 'struct [[packed]] Foo final : public Bar'.
+	static void cxx_struct_begin(std::string head)
+	{
+		std::vector<std::string> attrs;
+
+		kStructFields.clear();
+		kStructHints   = ToolchainKit::StructLayoutHints();
+		kStructVirtual = false;
+
+		cxx_struct_attributes(head, attrs, kStructHints.fAlignAs);
+
+		for (auto& attr : attrs)
+		{
+			if (attr == "packed" || attr == "gnu::packed")
+				kStructHints.fPack = 1UL;
+			else if (attr.starts_with("pack("))
+				kStructHints.fPack = std::strtoul(attr.substr(strlen("pack(")).c_str(), nullptr, 10);
+			else if (attr == "reorder")
+				kStructHints.fReorder = true;
+			else if (attr == "cacheline")
+				kStructHints.fCacheLine = true;
+		}
+
+		std::string bases;
+
+		for (std::size_t index = 0UL; index < head.size(); ++index)
+		{
+			if (head[index] != ':')
+				continue;
+
+			if (head[index + 1] == ':')
+			{
+				++index;
+				continue;
+			}
+
+			bases = head.substr(index + 1);
+			head.erase(index);
+
+			break;
+		}
+
+		head = ToolchainKit::StructLayoutEngine::Normalize(head);
+
+		if (ToolchainKit::find_word(head, "final"))
+			head.erase(head.find("final"), strlen("final"));
+
+		kStructName = Details::last_identifier(head);
+
+		bases += ",";
+
+		std::string base;
+
+		// bases come first and stay in declaration order.
+		for (auto ch : bases)
+		{
+			if (ch != ',')
+			{
+				base += ch;
+				continue;
+			}
+
+			base = Details::last_identifier(base);
+
+			if (!base.empty())
+				kStructFields.push_back({.fName = "__base_" + base, .fType = base, .fPinned = true});
+
+			base.clear();
+		}
+	}
+
+	/// @brief Read the members declared by one line of a struct body.
+	static void cxx_struct_members(std::string line)
+	{
+		line = cxx_trim(line);
+
+		if (line.empty() || line == "{" || line.ends_with(":"))
+			return;
+
+		// methods don't take room, a virtual one brings a vtable.
+		if (line.find('(') != std::string::npos)
+		{
+			if (ToolchainKit::find_word(line, "virtual"))
+				kStructVirtual = true;
+
+			return;
+		}
+
+		if (ToolchainKit::find_word(line, "static") || ToolchainKit::find_word(line, "using") ||
+			ToolchainKit::find_word(line, "typedef") || ToolchainKit::find_word(line, "friend"))
+			return;
+
+		std::vector<std::string> attrs;
+		std::size_t				 align_as = 0UL;
+
+		cxx_struct_attributes(line, attrs, align_as);
+
+		bool hot = std::find(attrs.begin(), attrs.end(), "hot") != attrs.end();
+
+		while (line.find(';') != std::string::npos)
+			line.erase(line.find(';'), 1);
+
+		std::vector<std::string> declarators;
+		std::string				 part;
+
+		for (auto ch : line + ",")
+		{
+			if (ch == ',')
+			{
+				declarators.push_back(cxx_trim(part));
+				part.clear();
+
+				continue;
+			}
+
+			part += ch;
+		}
+
+		std::string type;
+
+		for (auto& declarator : declarators)
+		{
+			// default member initializer.
+			if (declarator.find('=') != std::string::npos)
+				declarator = cxx_trim(declarator.erase(declarator.find('=')));
+
+			std::size_t count = 1UL;
+
+			if (declarator.find('[') != std::string::npos)
+			{
+				count = std::strtoul(declarator.substr(declarator.find('[') + 1).c_str(), nullptr, 0);
+				declarator.erase(declarator.find('['));
+			}
+
+			auto name = Details::last_identifier(declarator);
+
+			if (name.empty())
+				continue;
+
+			auto stars = declarator.substr(0, declarator.rfind(name));
+
+			// the first declarator carries the type, 'int a, *b'.
+			if (type.empty())
+			{
+				while (!stars.empty() && (stars.back() == '*' || stars.back() == '&' || isspace(stars.back())))
+					stars.pop_back();
+
+				type  = cxx_trim(stars);
+				stars = declarator.substr(type.size(), declarator.rfind(name) - type.size());
+			}
+
+			auto member_type = type;
+
+			for (auto ch : stars)
+			{
+				if (ch == '*' || ch == '&')
+					member_type += ch;
+			}
+
+			kStructFields.push_back({.fName	   = name,
+									 .fType	   = member_type,
+									 .fCount   = std::max<std::size_t>(count, 1UL),
+									 .fAlignAs = align_as,
+									 .fHot	   = hot});
+		}
+	}
+
+	/// @brief Lay out the struct we just read.
+	static void cxx_struct_end(const std::string& file)
+	{
+		// a base already brings the vtable pointer.
+		if (kStructVirtual && !kStructFields.empty() && kStructFields[0].fPinned)
+			kStructVirtual = false;
+
+		if (kStructVirtual)
+			kStructFields.insert(kStructFields.begin(), {.fName = "__vptr", .fType = "void*", .fPinned = true});
+
+		std::string error;
+
+		auto layout = kStructLayouts.Define(kStructName, kStructFields, kStructHints, error);
+
+		if (!layout)
+		{
+			Details::print_error_asm(error, file);
+			return;
+		}
+
+		if (kState.fVerbose)
+		{
+			std::cout << "layout: " << layout->fName << ", size " << layout->fSize << ", align "
+					  << layout->fAlign << ", padding " << layout->fPadding << "\n";
+
+			for (auto& field : layout->fFields)
+				std::cout << "layout: \t+" << field.fOffset << " " << field.fType << " " << field.fName << "\n";
+		}
+	}
+
+	/// @brief Resolve 'obj.a.b' or 'ptr->a[2]' to the object's register and the member's offset.
+	static bool cxx_member(std::string expr, std::string& reg, std::size_t& offset, const ToolchainKit::StructField*& field)
+	{
+		while (expr.find(' ') != std::string::npos)
+			expr.erase(expr.find(' '), 1);
+
+		while (expr.find("->") != std::string::npos)
+			expr.replace(expr.find("->"), 2, ".");
+
+		if (expr.find('.') == std::string::npos)
+			return false;
+
+		auto base = expr.substr(0, expr.find('.'));
+
+		if (kStructVariables.find(base) == kStructVariables.end())
+			return false;
+
+		auto layout = kStructLayouts.Find(kStructVariables[base]);
+
+		reg	   = cxx_register_of(base);
+		offset = 0UL;
+		field  = nullptr;
+
+		expr = expr.substr(expr.find('.') + 1) + ".";
+
+		std::string segment;
+
+		for (auto ch : expr)
+		{
+			if (ch != '.')
+			{
+				segment += ch;
+				continue;
+			}
+
+			// only embedded structs can be walked through, a pointer needs a load.
+			if (field)
+				layout = kStructLayouts.Find(field->fType);
+
+			if (!layout)
+				return false;
+
+			std::size_t index = 0UL;
+
+			if (segment.find('[') != std::string::npos)
+			{
+				index = std::strtoul(segment.substr(segment.find('[') + 1).c_str(), nullptr, 0);
+				segment.erase(segment.find('['));
+			}
+
+			field = layout->Find(segment);
+
+			if (!field || index >= field->fCount)
+				return false;
+
+			offset += field->fOffset + index * (field->fSize / field->fCount);
+
+			segment.clear();
+		}
+
+		return !reg.empty() && field;
+	}
+
+	static std::string cxx_member_operand(const std::string& reg, std::size_t offset, std::size_t size)
+	{
+		std::string operand = cxx_size_keyword(size);
+		operand += " [" + reg;
+
+		if (offset > 0)
+			operand += " + " + std::to_string(offset);
+
+		return operand + "]";
+	}
+
+	/// @brief Load a scalar member into reg.
+	static bool cxx_member_load(std::string& out, const std::string& reg, const std::string& base, std::size_t offset, const ToolchainKit::StructField* field, const std::string& file)
+	{
+		auto size	 = field->fSize / field->fCount;
+		auto operand = cxx_member_operand(base, offset, size);
+		auto zero	 = field->fType.back() == '*' || field->fType.back() == '&' ||
+				   field->fType.find("unsigned") != std::string::npos || field->fType.find("bool") != std::string::npos;
+
+		if (size > 8 || kStructLayouts.Find(field->fType))
+		{
+			Details::print_error_asm("cannot load aggregate member: " + field->fName, file);
+			return false;
+		}
+
+		if (size == 8)
+			out += "mov " + reg + ", " + operand + "\n";
+		else if (size == 4 && zero)
+			out += "mov " + cxx_sized_register(reg, 4) + ", " + operand + "\n";
+		else if (size == 4)
+			out += "movsxd " + reg + ", " + operand + "\n";
+		else
+			out += (zero ? "movzx " : "movsx ") + reg + ", " + operand + "\n";
+
+		return true;
+	}
+
+	/// @brief Struct definitions, struct typed variables and member access.
+	/// Members are addressed by displacement from the object's register.
+	/// @return true if the line was handled here.
+	static bool cxx_compile_struct(const std::string& text, const std::string& file)
+	{
+		auto line = cxx_trim(text);
+		auto leaf = ToolchainKit::SyntaxLeafList::SyntaxLeaf();
+
+		if (kInStruct)
+		{
+			auto close = line.find('}');
+
+			cxx_struct_members(close == std::string::npos ? line : line.substr(0, close));
+
+			if (close != std::string::npos)
+			{
+				kInStruct = false;
+				cxx_struct_end(file);
+			}
+
+			return true;
+		}
+
+		if ((ToolchainKit::find_word(line, "struct") || ToolchainKit::find_word(line, "class")) &&
+			line.find('(') == std::string::npos)
+		{
+			// forward declaration.
+			if (line.find('{') == std::string::npos && line.ends_with(";"))
+				return true;
+
+			cxx_struct_begin(line.substr(0, line.find('{')));
+			kInStruct = true;
+
+			if (line.find('{') != std::string::npos)
+				return cxx_compile_struct(line.substr(line.find('{') + 1), file);
+
+			return true;
+		}
+
+		while (line.ends_with(";"))
+			line.pop_back();
+
+		auto first = line.substr(0, line.find_first_of(" \t*&"));
+
+		if (first == "const")
+			first = Details::last_identifier(line.substr(0, line.find_first_of("*&=")));
+
+		// 'Foo* p = q' or 'Foo f'.
+		if (auto layout = kStructLayouts.Find(first); layout)
+		{
+			auto decl  = line.substr(0, line.find('='));
+			auto name  = Details::last_identifier(decl);
+			auto value = line.find('=') != std::string::npos ? cxx_trim(line.substr(line.find('=') + 1)) : "";
+
+			if (kRegisterMap.size() >= kRegisterList.size())
+			{
+				Details::print_error_asm("too many variables for " + name, file);
+				return true;
+			}
+
+			auto reg = kRegisterList[kRegisterMap.size()];
+
+			if (decl.find('*') != std::string::npos || decl.find('&') != std::string::npos)
+			{
+				if (value.starts_with("&"))
+					value = cxx_trim(value.substr(1));
+
+				if (value == "nullptr")
+					value = "0";
+
+				if (!value.empty() && !isdigit(value[0]))
+				{
+					if (cxx_register_of(value).empty())
+					{
+						Details::print_error_asm("Variable not declared: " + value, file);
+						return true;
+					}
+
+					value = cxx_register_of(value);
+				}
+
+				if (!value.empty())
+					leaf.fUserValue = "mov " + reg + ", " + value + "\n";
+			}
+			else
+			{
+				// instances live on the stack until the function returns.
+				auto size = (layout->fSize + 15UL) & ~15UL;
+
+				leaf.fUserValue = "sub rsp, " + std::to_string(size + (layout->fAlign > 16 ? layout->fAlign : 0UL)) + "\n";
+				leaf.fUserValue += "mov " + reg + ", rsp\n";
+
+				if (layout->fAlign > 16)
+				{
+					size += layout->fAlign;
+
+					leaf.fUserValue += "add " + reg + ", " + std::to_string(layout->fAlign - 1) + "\n";
+					leaf.fUserValue += "and " + reg + ", -" + std::to_string(layout->fAlign) + "\n";
+				}
+
+				kStructFrameSize += size;
+			}
+
+			kRegisterMap.push_back(name);
+			kStructVariables[name] = layout->fName;
+
+			kState.fSyntaxTree->fLeafList.push_back(leaf);
+
+			return true;
+		}
+
+		if (line.find("->") == std::string::npos && line.find('.') == std::string::npos)
+			return false;
+
+		std::string						 base;
+		std::size_t						 offset = 0UL;
+		const ToolchainKit::StructField* field	= nullptr;
+
+		if (line.starts_with("return ") || line.starts_with("return\t"))
+		{
+			if (!cxx_member(line.substr(strlen("return")), base, offset, field))
+				return false;
+
+			if (!cxx_member_load(leaf.fUserValue, "rax", base, offset, field, file))
+				return true;
+
+			if (kStructFrameSize > 0)
+				leaf.fUserValue += "add rsp, " + std::to_string(kStructFrameSize) + "\n";
+
+			leaf.fUserValue += "ret\n";
+
+			kState.fSyntaxTree->fLeafList.push_back(leaf);
+
+			return true;
+		}
+
+		std::string op;
+		std::size_t op_at = std::string::npos;
+
+		for (std::size_t index = 0UL; index < line.size(); ++index)
+		{
+			if (line[index] != '=')
+				continue;
+
+			if (line[index + 1] == '=' || (index > 0 && (line[index - 1] == '!' ||
+														 line[index - 1] == '<' || line[index - 1] == '>')))
+			{
+				++index;
+				continue;
+			}
+
+			op_at = index;
+			op	  = "mov";
+
+			if (index > 0 && line[index - 1] == '+')
+			{
+				op = "add";
+				--op_at;
+			}
+			else if (index > 0 && line[index - 1] == '-')
+			{
+				op = "sub";
+				--op_at;
+			}
+
+			break;
+		}
+
+		if (op_at == std::string::npos)
+			return false;
+
+		auto lhs = cxx_trim(line.substr(0, op_at));
+		auto rhs = cxx_trim(line.substr(line.find('=', op_at) + 1));
+
+		// store into a member.
+		if (cxx_member(lhs, base, offset, field))
+		{
+			auto size = field->fSize / field->fCount;
+
+			if (size > 8 || kStructLayouts.Find(field->fType))
+			{
+				Details::print_error_asm("cannot store to aggregate member: " + field->fName, file);
+				return true;
+			}
+
+			std::string						 value;
+			std::string						 rhs_base;
+			std::size_t						 rhs_offset = 0UL;
+			const ToolchainKit::StructField* rhs_field	= nullptr;
+
+			if (rhs == "true" || rhs == "false")
+			{
+				value = rhs == "true" ? "1" : "0";
+			}
+			else if (isdigit(rhs[0]) || rhs[0] == '-')
+			{
+				value = rhs;
+			}
+			else if (cxx_member(rhs, rhs_base, rhs_offset, rhs_field))
+			{
+				if (!cxx_member_load(leaf.fUserValue, "rax", rhs_base, rhs_offset, rhs_field, file))
+					return true;
+
+				value = cxx_sized_register("rax", size);
+			}
+			else if (!cxx_register_of(rhs).empty())
+			{
+				value = cxx_sized_register(cxx_register_of(rhs), size);
+			}
+			else
+			{
+				Details::print_error_asm("Variable not declared: " + rhs, file);
+				return true;
+			}
+
+			leaf.fUserValue += op + " " + cxx_member_operand(base, offset, size) + ", " + value + "\n";
+			kState.fSyntaxTree->fLeafList.push_back(leaf);
+
+			return true;
+		}
+
+		// load from a member, into a new or an existing variable.
+		if (cxx_member(rhs, base, offset, field))
+		{
+			std::string reg;
+
+			if (lhs.find_first_of(" \t") != std::string::npos)
+			{
+				auto name = Details::last_identifier(lhs);
+
+				if (kRegisterMap.size() >= kRegisterList.size())
+				{
+					Details::print_error_asm("too many variables for " + name, file);
+					return true;
+				}
+
+				reg = kRegisterList[kRegisterMap.size()];
+				kRegisterMap.push_back(name);
+			}
+			else
+			{
+				reg = cxx_register_of(lhs);
+			}
+
+			if (reg.empty())
+			{
+				Details::print_error_asm("Variable not declared: " + lhs, file);
+				return true;
+			}
+
+			if (op == "mov")
+			{
+				if (!cxx_member_load(leaf.fUserValue, reg, base, offset, field, file))
+					return true;
+			}
+			else
+			{
+				if (!cxx_member_load(leaf.fUserValue, "rax", base, offset, field, file))
+					return true;
+
+				leaf.fUserValue += op + " " + reg + ", rax\n";
+			}
+
+			kState.fSyntaxTree->fLeafList.push_back(leaf);
+
+			return true;
+		}
+
+		return false;
+	}
+} // namespace Details
+
 const char* CompilerFrontendCPlusPlus::Language()
 {
 	return "ZKA C++";
@@ -271,6 +956,9 @@ bool CompilerFrontendCPlusPlus::Compile(const std::string text,
 		}
 	}
 
+	if (!commentBlock && Details::cxx_compile_struct(text, file))
+		return true;
+
 	if (!found && !commentBlock)
 	{
 		for (size_t i = 0; i < text.size(); i++)
@@ -407,21 +1095,32 @@ bool CompilerFrontendCPlusPlus::Compile(const std::string text,
 
 			syntax_tree.fUserValue = "public_segment .code64 __TOOLCHAINKIT_" + fnName + "\n";
 
+			// locals live in their function only, the end of the previous one isn't always seen.
+			kRegisterMap.clear();
+			kStructVariables.clear();
+			kStructFrameSize = 0UL;
+
+			Details::cxx_trace_function(fnName);
+
 			++kFunctionEmbedLevel;
 		}
 		case ToolchainKit::KeywordKind::eKeywordKindFunctionEnd: {
 			if (text.ends_with(";"))
 				break;
 
-			--kFunctionEmbedLevel;
+			if (kFunctionEmbedLevel > 0)
+				--kFunctionEmbedLevel;
 
-			if (kRegisterMap.size() > kRegisterList.size())
+			if (kRegisterMap.size() > kRegisterList.size() && kFunctionEmbedLevel > 0)
 			{
 				--kFunctionEmbedLevel;
 			}
 
 			if (kFunctionEmbedLevel < 1)
+			{
 				kRegisterMap.clear();
+				kStructVariables.clear();
+			}
 			break;
 		}
 		case ToolchainKit::KeywordKind::eKeywordKindEndInstr:
@@ -740,13 +1439,17 @@ bool CompilerFrontendCPlusPlus::Compile(const std::string text,
 					syntax_tree.fUserValue = "__TOOLCHAINKIT_LOCAL_RETURN_STRING: db " + subText + ", 0\nmov rcx, __TOOLCHAINKIT_LOCAL_RETURN_STRING\n";
 					syntax_tree.fUserValue += "mov rax, rcx\r\nret\n";
 				}
-
-				break;
 			}
 			catch (...)
 			{
 				syntax_tree.fUserValue = "ret\n";
 			}
+
+			// give back the stack of the struct instances.
+			if (kStructFrameSize > 0 && syntax_tree.fUserValue.rfind("ret") != std::string::npos)
+				syntax_tree.fUserValue.insert(syntax_tree.fUserValue.rfind("ret"), "add rsp, " + std::to_string(kStructFrameSize) + "\n");
+
+			break;
 		}
 		default:
 			break;
@@ -847,22 +1550,85 @@ public:
 
 		kState.fSyntaxTree = new ToolchainKit::SyntaxLeafList();
 
+		ToolchainKit::TimeTraceScope trace("Compile", src);
+
+		// nothing carries over from the previous file.
+		kRegisterMap.clear();
+		kStructLayouts.Clear();
+		kStructVariables.clear();
+
+		kRegisterCounter	= kStartUsable;
+		kInStruct			= false;
+		kOnWhileLoop		= false;
+		kOnForLoop			= false;
+		kInBraces			= false;
+		kBracesCount		= 0UL;
+		kFunctionEmbedLevel = 0UL;
+		kStructFrameSize	= 0UL;
+
 		// ===================================
 		// Parse source file.
 		// ===================================
 
 		std::string line_source;
+		std::string assembly;
+		std::string ir;
+
+		if (kIREnabled)
+		{
+			// the C subset goes through the shared IR instead.
+			std::string source, error;
 
-		while (std::getline(src_fp, line_source))
+			while (std::getline(src_fp, line_source))
+			{
+				source += line_source;
+				source += "\n";
+			}
+
+			ToolchainKit::TimeTraceScope trace_ir("IR", src);
+
+			if (!ToolchainKit::ir_compile(source, ToolchainKit::AssemblyFactory::kArchAMD64, assembly, ir, error, kVectorSize))
+			{
+				Details::print_error_asm(error, src);
+
+				delete kState.fSyntaxTree;
+				kState.fSyntaxTree = nullptr;
+
+				return 1;
+			}
+		}
+		else
 		{
-			kCompilerFrontend->Compile(line_source, src);
+			while (std::getline(src_fp, line_source))
+			{
+				kCompilerFrontend->Compile(line_source, src);
+			}
+
+			Details::cxx_trace_function("");
+
+			for (auto& ast_generated : kState.fSyntaxTree->fLeafList)
+			{
+				assembly += ast_generated.fUserValue;
+			}
 		}
 
-		for (auto& ast_generated : kState.fSyntaxTree->fLeafList)
+		if (kPeepholeEnabled)
 		{
-			(*kState.fOutputAssembly) << ast_generated.fUserValue;
+			ToolchainKit::TimeTraceScope trace_peephole("Peephole", src);
+
+			ToolchainKit::PeepholeOptimizer peephole(ToolchainKit::AssemblyFactory::kArchAMD64);
+			assembly = peephole.Run(assembly);
+
+			if (kState.fVerbose)
+				std::cout << "peephole: removed " << peephole.Removed() << " instruction(s).\n";
 		}
 
+		// the object carries its IR for ld64 --ld64:lto, the code stays for a regular link.
+		if (kLTOEnabled)
+			assembly += ToolchainKit::ir_directives(ir);
+
+		(*kState.fOutputAssembly) << assembly;
+
 		kState.fOutputAssembly->flush();
 		kState.fOutputAssembly->close();
 
@@ -896,66 +1662,84 @@ TOOLCHAINKIT_MODULE(CompilerCPlusPlusX8664)
 {
 	bool skip = false;
 
-	kKeywords.push_back({.keyword_name = "if", .keyword_kind = ToolchainKit::eKeywordKindIf});
-	kKeywords.push_back({.keyword_name = "else", .keyword_kind = ToolchainKit::eKeywordKindElse});
-	kKeywords.push_back({.keyword_name = "else if", .keyword_kind = ToolchainKit::eKeywordKindElseIf});
-
-	kKeywords.push_back({.keyword_name = "class", .keyword_kind = ToolchainKit::eKeywordKindClass});
-	kKeywords.push_back({.keyword_name = "struct", .keyword_kind = ToolchainKit::eKeywordKindClass});
-	kKeywords.push_back({.keyword_name = "namespace", .keyword_kind = ToolchainKit::eKeywordKindNamespace});
-	kKeywords.push_back({.keyword_name = "typedef", .keyword_kind = ToolchainKit::eKeywordKindTypedef});
-	kKeywords.push_back({.keyword_name = "using", .keyword_kind = ToolchainKit::eKeywordKindTypedef});
-	kKeywords.push_back({.keyword_name = "{", .keyword_kind = ToolchainKit::eKeywordKindBodyStart});
-	kKeywords.push_back({.keyword_name = "}", .keyword_kind = ToolchainKit::eKeywordKindBodyEnd});
-	kKeywords.push_back({.keyword_name = "auto", .keyword_kind = ToolchainKit::eKeywordKindVariable});
-	kKeywords.push_back({.keyword_name = "int", .keyword_kind = ToolchainKit::eKeywordKindType});
-	kKeywords.push_back({.keyword_name = "bool", .keyword_kind = ToolchainKit::eKeywordKindType});
-	kKeywords.push_back({.keyword_name = "unsigned", .keyword_kind = ToolchainKit::eKeywordKindType});
-	kKeywords.push_back({.keyword_name = "short", .keyword_kind = ToolchainKit::eKeywordKindType});
-	kKeywords.push_back({.keyword_name = "char", .keyword_kind = ToolchainKit::eKeywordKindType});
-	kKeywords.push_back({.keyword_name = "long", .keyword_kind = ToolchainKit::eKeywordKindType});
-	kKeywords.push_back({.keyword_name = "float", .keyword_kind = ToolchainKit::eKeywordKindType});
-	kKeywords.push_back({.keyword_name = "double", .keyword_kind = ToolchainKit::eKeywordKindType});
-	kKeywords.push_back({.keyword_name = "void", .keyword_kind = ToolchainKit::eKeywordKindType});
-
-	kKeywords.push_back({.keyword_name = "auto*", .keyword_kind = ToolchainKit::eKeywordKindVariablePtr});
-	kKeywords.push_back({.keyword_name = "int*", .keyword_kind = ToolchainKit::eKeywordKindTypePtr});
-	kKeywords.push_back({.keyword_name = "bool*", .keyword_kind = ToolchainKit::eKeywordKindTypePtr});
-	kKeywords.push_back({.keyword_name = "unsigned*", .keyword_kind = ToolchainKit::eKeywordKindTypePtr});
-	kKeywords.push_back({.keyword_name = "short*", .keyword_kind = ToolchainKit::eKeywordKindTypePtr});
-	kKeywords.push_back({.keyword_name = "char*", .keyword_kind = ToolchainKit::eKeywordKindTypePtr});
-	kKeywords.push_back({.keyword_name = "long*", .keyword_kind = ToolchainKit::eKeywordKindTypePtr});
-	kKeywords.push_back({.keyword_name = "float*", .keyword_kind = ToolchainKit::eKeywordKindTypePtr});
-	kKeywords.push_back({.keyword_name = "double*", .keyword_kind = ToolchainKit::eKeywordKindTypePtr});
-	kKeywords.push_back({.keyword_name = "void*", .keyword_kind = ToolchainKit::eKeywordKindTypePtr});
-
-	kKeywords.push_back({.keyword_name = "(", .keyword_kind = ToolchainKit::eKeywordKindFunctionStart});
-	kKeywords.push_back({.keyword_name = ")", .keyword_kind = ToolchainKit::eKeywordKindFunctionEnd});
-	kKeywords.push_back({.keyword_name = "=", .keyword_kind = ToolchainKit::eKeywordKindVariableAssign});
-	kKeywords.push_back({.keyword_name = "+=", .keyword_kind = ToolchainKit::eKeywordKindVariableInc});
-	kKeywords.push_back({.keyword_name = "-=", .keyword_kind = ToolchainKit::eKeywordKindVariableDec});
-	kKeywords.push_back({.keyword_name = "const", .keyword_kind = ToolchainKit::eKeywordKindConstant});
-	kKeywords.push_back({.keyword_name = "*", .keyword_kind = ToolchainKit::eKeywordKindPtr});
-	kKeywords.push_back({.keyword_name = "->", .keyword_kind = ToolchainKit::eKeywordKindPtrAccess});
-	kKeywords.push_back({.keyword_name = ".", .keyword_kind = ToolchainKit::eKeywordKindAccess});
-	kKeywords.push_back({.keyword_name = ",", .keyword_kind = ToolchainKit::eKeywordKindArgSeparator});
-	kKeywords.push_back({.keyword_name = ";", .keyword_kind = ToolchainKit::eKeywordKindEndInstr});
-	kKeywords.push_back({.keyword_name = ":", .keyword_kind = ToolchainKit::eKeywordKindSpecifier});
-	kKeywords.push_back({.keyword_name = "public:", .keyword_kind = ToolchainKit::eKeywordKindSpecifier});
-	kKeywords.push_back({.keyword_name = "private:", .keyword_kind = ToolchainKit::eKeywordKindSpecifier});
-	kKeywords.push_back({.keyword_name = "protected:", .keyword_kind = ToolchainKit::eKeywordKindSpecifier});
-	kKeywords.push_back({.keyword_name = "final", .keyword_kind = ToolchainKit::eKeywordKindSpecifier});
-	kKeywords.push_back({.keyword_name = "return", .keyword_kind = ToolchainKit::eKeywordKindReturn});
-	kKeywords.push_back({.keyword_name = "--*", .keyword_kind = ToolchainKit::eKeywordKindCommentMultiLineStart});
-	kKeywords.push_back({.keyword_name = "*/", .keyword_kind = ToolchainKit::eKeywordKindCommentMultiLineStart});
-	kKeywords.push_back({.keyword_name = "--/", .keyword_kind = ToolchainKit::eKeywordKindCommentInline});
-	kKeywords.push_back({.keyword_name = "==", .keyword_kind = ToolchainKit::eKeywordKindEq});
-	kKeywords.push_back({.keyword_name = "!=", .keyword_kind = ToolchainKit::eKeywordKindNotEq});
-	kKeywords.push_back({.keyword_name = ">=", .keyword_kind = ToolchainKit::eKeywordKindGreaterEq});
-	kKeywords.push_back({.keyword_name = "<=", .keyword_kind = ToolchainKit::eKeywordKindLessEq});
-
-	kFactory.Mount(new AssemblyCPlusPlusInterface());
-	kCompilerFrontend = new CompilerFrontendCPlusPlus();
+	// the module may run many times in one process (cl, tkd), start clean.
+	kState.fVerbose	  = false;
+	kPeepholeEnabled  = true;
+	kIREnabled		  = false;
+	kLTOEnabled		  = false;
+	kVectorSize		  = 0UL;
+	kErrorLimit		  = 100;
+	kAcceptableErrors = 0;
+
+	kFileList.clear();
+
+	// the keywords and the backend are set up once.
+	if (kKeywords.empty())
+	{
+		kKeywords.push_back({.keyword_name = "if", .keyword_kind = ToolchainKit::eKeywordKindIf});
+		kKeywords.push_back({.keyword_name = "else", .keyword_kind = ToolchainKit::eKeywordKindElse});
+		kKeywords.push_back({.keyword_name = "else if", .keyword_kind = ToolchainKit::eKeywordKindElseIf});
+
+		kKeywords.push_back({.keyword_name = "class", .keyword_kind = ToolchainKit::eKeywordKindClass});
+		kKeywords.push_back({.keyword_name = "struct", .keyword_kind = ToolchainKit::eKeywordKindClass});
+		kKeywords.push_back({.keyword_name = "namespace", .keyword_kind = ToolchainKit::eKeywordKindNamespace});
+		kKeywords.push_back({.keyword_name = "typedef", .keyword_kind = ToolchainKit::eKeywordKindTypedef});
+		kKeywords.push_back({.keyword_name = "using", .keyword_kind = ToolchainKit::eKeywordKindTypedef});
+		kKeywords.push_back({.keyword_name = "{", .keyword_kind = ToolchainKit::eKeywordKindBodyStart});
+		kKeywords.push_back({.keyword_name = "}", .keyword_kind = ToolchainKit::eKeywordKindBodyEnd});
+		kKeywords.push_back({.keyword_name = "auto", .keyword_kind = ToolchainKit::eKeywordKindVariable});
+		kKeywords.push_back({.keyword_name = "int", .keyword_kind = ToolchainKit::eKeywordKindType});
+		kKeywords.push_back({.keyword_name = "bool", .keyword_kind = ToolchainKit::eKeywordKindType});
+		kKeywords.push_back({.keyword_name = "unsigned", .keyword_kind = ToolchainKit::eKeywordKindType});
+		kKeywords.push_back({.keyword_name = "short", .keyword_kind = ToolchainKit::eKeywordKindType});
+		kKeywords.push_back({.keyword_name = "char", .keyword_kind = ToolchainKit::eKeywordKindType});
+		kKeywords.push_back({.keyword_name = "long", .keyword_kind = ToolchainKit::eKeywordKindType});
+		kKeywords.push_back({.keyword_name = "float", .keyword_kind = ToolchainKit::eKeywordKindType});
+		kKeywords.push_back({.keyword_name = "double", .keyword_kind = ToolchainKit::eKeywordKindType});
+		kKeywords.push_back({.keyword_name = "void", .keyword_kind = ToolchainKit::eKeywordKindType});
+
+		kKeywords.push_back({.keyword_name = "auto*", .keyword_kind = ToolchainKit::eKeywordKindVariablePtr});
+		kKeywords.push_back({.keyword_name = "int*", .keyword_kind = ToolchainKit::eKeywordKindTypePtr});
+		kKeywords.push_back({.keyword_name = "bool*", .keyword_kind = ToolchainKit::eKeywordKindTypePtr});
+		kKeywords.push_back({.keyword_name = "unsigned*", .keyword_kind = ToolchainKit::eKeywordKindTypePtr});
+		kKeywords.push_back({.keyword_name = "short*", .keyword_kind = ToolchainKit::eKeywordKindTypePtr});
+		kKeywords.push_back({.keyword_name = "char*", .keyword_kind = ToolchainKit::eKeywordKindTypePtr});
+		kKeywords.push_back({.keyword_name = "long*", .keyword_kind = ToolchainKit::eKeywordKindTypePtr});
+		kKeywords.push_back({.keyword_name = "float*", .keyword_kind = ToolchainKit::eKeywordKindTypePtr});
+		kKeywords.push_back({.keyword_name = "double*", .keyword_kind = ToolchainKit::eKeywordKindTypePtr});
+		kKeywords.push_back({.keyword_name = "void*", .keyword_kind = ToolchainKit::eKeywordKindTypePtr});
+
+		kKeywords.push_back({.keyword_name = "(", .keyword_kind = ToolchainKit::eKeywordKindFunctionStart});
+		kKeywords.push_back({.keyword_name = ")", .keyword_kind = ToolchainKit::eKeywordKindFunctionEnd});
+		kKeywords.push_back({.keyword_name = "=", .keyword_kind = ToolchainKit::eKeywordKindVariableAssign});
+		kKeywords.push_back({.keyword_name = "+=", .keyword_kind = ToolchainKit::eKeywordKindVariableInc});
+		kKeywords.push_back({.keyword_name = "-=", .keyword_kind = ToolchainKit::eKeywordKindVariableDec});
+		kKeywords.push_back({.keyword_name = "const", .keyword_kind = ToolchainKit::eKeywordKindConstant});
+		kKeywords.push_back({.keyword_name = "*", .keyword_kind = ToolchainKit::eKeywordKindPtr});
+		kKeywords.push_back({.keyword_name = "->", .keyword_kind = ToolchainKit::eKeywordKindPtrAccess});
+		kKeywords.push_back({.keyword_name = ".", .keyword_kind = ToolchainKit::eKeywordKindAccess});
+		kKeywords.push_back({.keyword_name = ",", .keyword_kind = ToolchainKit::eKeywordKindArgSeparator});
+		kKeywords.push_back({.keyword_name = ";", .keyword_kind = ToolchainKit::eKeywordKindEndInstr});
+		kKeywords.push_back({.keyword_name = ":", .keyword_kind = ToolchainKit::eKeywordKindSpecifier});
+		kKeywords.push_back({.keyword_name = "public:", .keyword_kind = ToolchainKit::eKeywordKindSpecifier});
+		kKeywords.push_back({.keyword_name = "private:", .keyword_kind = ToolchainKit::eKeywordKindSpecifier});
+		kKeywords.push_back({.keyword_name = "protected:", .keyword_kind = ToolchainKit::eKeywordKindSpecifier});
+		kKeywords.push_back({.keyword_name = "final", .keyword_kind = ToolchainKit::eKeywordKindSpecifier});
+		kKeywords.push_back({.keyword_name = "return", .keyword_kind = ToolchainKit::eKeywordKindReturn});
+		kKeywords.push_back({.keyword_name = "--*", .keyword_kind = ToolchainKit::eKeywordKindCommentMultiLineStart});
+		kKeywords.push_back({.keyword_name = "*/", .keyword_kind = ToolchainKit::eKeywordKindCommentMultiLineStart});
+		kKeywords.push_back({.keyword_name = "--/", .keyword_kind = ToolchainKit::eKeywordKindCommentInline});
+		kKeywords.push_back({.keyword_name = "==", .keyword_kind = ToolchainKit::eKeywordKindEq});
+		kKeywords.push_back({.keyword_name = "!=", .keyword_kind = ToolchainKit::eKeywordKindNotEq});
+		kKeywords.push_back({.keyword_name = ">=", .keyword_kind = ToolchainKit::eKeywordKindGreaterEq});
+		kKeywords.push_back({.keyword_name = "<=", .keyword_kind = ToolchainKit::eKeywordKindLessEq});
+	}
+
+	if (!kCompilerFrontend)
+	{
+		kFactory.Mount(new AssemblyCPlusPlusInterface());
+		kCompilerFrontend = new CompilerFrontendCPlusPlus();
+	}
 
 	for (auto index = 1UL; index < argc; ++index)
 	{
@@ -980,6 +1764,44 @@ TOOLCHAINKIT_MODULE(CompilerCPlusPlusX8664)
 				continue;
 			}
 
+			if (strcmp(argv[index], "--cl:no-peephole") == 0)
+			{
+				kPeepholeEnabled = false;
+
+				continue;
+			}
+
+			if (strcmp(argv[index], "--cl:ir") == 0)
+			{
+				kIREnabled = true;
+
+				continue;
+			}
+
+			// the IR goes in the object too, for link time optimization.
+			if (strcmp(argv[index], "--cl:lto") == 0)
+			{
+				kIREnabled	= true;
+				kLTOEnabled = true;
+
+				continue;
+			}
+
+			// vectors of the IR selector, SSE2 otherwise.
+			if (strcmp(argv[index], "--cl:avx2") == 0)
+			{
+				kVectorSize = 32UL;
+
+				continue;
+			}
+
+			if (strcmp(argv[index], "--cl:avx512") == 0)
+			{
+				kVectorSize = 64UL;
+
+				continue;
+			}
+
 			if (strcmp(argv[index], "--cl:h") == 0)
 			{
 				cxx_print_help();
@@ -11,11 +11,14 @@
 
 #include <ToolchainKit/Parser.h>
 #include <ToolchainKit/NFC/ErrorID.h>
+#include <ToolchainKit/TimeTrace.h>
 #include <Algorithms>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <stdexcept>
+#include <unordered_map>
 #include <vector>
 
 #define kMacroPrefix '#'
@@ -56,6 +59,8 @@ namespace Details
 		std::string				 fName;
 		std::string				 fValue;
 
+		bool operator==(const bpp_macro&) const = default;
+
 		void Print()
 		{
 			std::cout << "name: " << fName << "\n";
@@ -79,6 +84,35 @@ namespace Details
 		std::string		fMacroName;
 		bpp_parser_fn_t fParse;
 	};
+
+	/// @brief A header as it was on disk when we read it.
+	struct bpp_header final
+	{
+		std::filesystem::file_time_type fTime;
+		std::uintmax_t					fSize{0};
+		std::string						fText;
+	};
+
+	/// @brief A header a preprocessed header depends on, as it was on disk.
+	struct bpp_stamp final
+	{
+		std::string						fPath;
+		std::filesystem::file_time_type fTime;
+		std::uintmax_t					fSize{0};
+	};
+
+	/// @brief A header once preprocessed, replayed when it comes again in the same state.
+	struct bpp_expansion final
+	{
+		std::vector<bpp_macro>	 fMacrosIn;	  // the macro table it was preprocessed with.
+		std::vector<std::string> fIncludesIn; // headers already included then.
+		std::vector<std::string> fSearchIn;	  // and the include directories.
+		std::vector<bpp_macro>	 fMacros;	  // what it defines.
+		std::vector<std::string> fIncludes;	  // what it includes.
+		std::vector<std::string> fWarnings;	  // #warning messages it printed.
+		std::vector<bpp_stamp>	 fDeps;		  // itself and every header it read.
+		std::string				 fText;
+	};
 } // namespace Details
 
 static std::vector<std::string>		  kFiles;
@@ -87,6 +121,13 @@ static std::vector<std::string>		  kIncludes;
 
 static std::string kWorkingDir;
 
+/// @brief headers read so far, kept across runs (tkd) while they don't change on disk.
+static std::unordered_map<std::string, Details::bpp_header> kHeaderCache;
+
+/// @brief preprocessed headers by path, and the ones being preprocessed (innermost last).
+static std::unordered_map<std::string, Details::bpp_expansion> kExpansionCache;
+static std::vector<Details::bpp_expansion*>					   kExpansionStack;
+
 static std::vector<std::string> kKeywords = {
 	"include", "if", "pragma", "def", "elif",
 	"ifdef", "ifndef", "else", "warning", "error"};
@@ -288,12 +329,158 @@ std::vector<std::string> kAllIncludes;
 
 /////////////////////////////////////////////////////////////////////////////////////////
 
+// @name bpp_open_header
+// @brief open a header through the header cache.
+// @return false if there is no such file.
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+static bool bpp_open_header(const std::string& path, std::istringstream& header)
+{
+	std::error_code err;
+
+	auto time = std::filesystem::last_write_time(path, err);
+
+	if (err)
+		return false;
+
+	auto size = std::filesystem::file_size(path, err);
+
+	if (err)
+		return false;
+
+	auto& cached = kHeaderCache[path];
+
+	if (cached.fText.empty() || cached.fTime != time || cached.fSize != size)
+	{
+		std::ifstream	  file(path);
+		std::stringstream text;
+
+		if (!file.is_open())
+		{
+			kHeaderCache.erase(path);
+			return false;
+		}
+
+		text << file.rdbuf();
+
+		cached.fTime = time;
+		cached.fSize = size;
+		cached.fText = text.str();
+	}
+
+	header.str(cached.fText);
+
+	// every header being preprocessed now depends on this one.
+	for (auto expansion : kExpansionStack)
+		expansion->fDeps.push_back({.fPath = path, .fTime = time, .fSize = size});
+
+	return true;
+}
+
+void bpp_parse_file(std::istream& hdr_file, std::ostream& pp_out);
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+// @name bpp_include_header
+// @brief preprocess a header into pp_out, or replay it when it was preprocessed
+// in the same state and nothing it read changed on disk.
+// @return false if there is no such file.
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+static bool bpp_include_header(const std::string& path, std::ostream& pp_out)
+{
+	auto cached = kExpansionCache.find(path);
+
+	if (cached != kExpansionCache.end() && cached->second.fMacrosIn == kMacros &&
+		cached->second.fIncludesIn == kAllIncludes && cached->second.fSearchIn == kIncludes)
+	{
+		auto& expansion = cached->second;
+		bool  fresh		= true;
+
+		for (auto& dep : expansion.fDeps)
+		{
+			std::error_code err;
+
+			auto time = std::filesystem::last_write_time(dep.fPath, err);
+
+			if (!err)
+			{
+				auto size = std::filesystem::file_size(dep.fPath, err);
+
+				if (!err && time == dep.fTime && size == dep.fSize)
+					continue;
+			}
+
+			fresh = false;
+			break;
+		}
+
+		if (fresh)
+		{
+			for (auto& message : expansion.fWarnings)
+				std::cout << "warn: " << message << std::endl;
+
+			kMacros.insert(kMacros.end(), expansion.fMacros.begin(), expansion.fMacros.end());
+			kAllIncludes.insert(kAllIncludes.end(), expansion.fIncludes.begin(), expansion.fIncludes.end());
+
+			for (auto outer : kExpansionStack)
+			{
+				outer->fDeps.insert(outer->fDeps.end(), expansion.fDeps.begin(), expansion.fDeps.end());
+				outer->fWarnings.insert(outer->fWarnings.end(), expansion.fWarnings.begin(), expansion.fWarnings.end());
+			}
+
+			pp_out << expansion.fText;
+
+			return true;
+		}
+	}
+
+	Details::bpp_expansion expansion;
+
+	expansion.fMacrosIn	  = kMacros;
+	expansion.fIncludesIn = kAllIncludes;
+	expansion.fSearchIn	  = kIncludes;
+
+	kExpansionStack.push_back(&expansion);
+
+	std::istringstream header;
+
+	if (!bpp_open_header(path, header))
+	{
+		kExpansionStack.pop_back();
+		return false;
+	}
+
+	std::ostringstream text;
+
+	{
+		ToolchainKit::TimeTraceScope trace("Include", path);
+		bpp_parse_file(header, text);
+	}
+
+	kExpansionStack.pop_back();
+
+	expansion.fMacros.assign(kMacros.begin() + expansion.fMacrosIn.size(), kMacros.end());
+	expansion.fIncludes.assign(kAllIncludes.begin() + expansion.fIncludesIn.size(), kAllIncludes.end());
+	expansion.fText = text.str();
+
+	pp_out << expansion.fText;
+
+	kExpansionCache[path] = std::move(expansion);
+
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
 // @name bpp_parse_file
 // @brief parse file to preprocess it.
 
 /////////////////////////////////////////////////////////////////////////////////////////
 
-void bpp_parse_file(std::ifstream& hdr_file, std::ofstream& pp_out)
+void bpp_parse_file(std::istream& hdr_file, std::ostream& pp_out)
 {
 	std::string hdr_line;
 	std::string line_after_include;
@@ -773,6 +960,9 @@ void bpp_parse_file(std::ifstream& hdr_file, std::ofstream& pp_out)
 				}
 
 				std::cout << "warn: " << message << std::endl;
+
+				for (auto expansion : kExpansionStack)
+					expansion->fWarnings.push_back(message);
 			}
 			else if (hdr_line[0] == kMacroPrefix &&
 					 hdr_line.find("error") != std::string::npos)
@@ -861,15 +1051,10 @@ void bpp_parse_file(std::ifstream& hdr_file, std::ofstream& pp_out)
 						header_path.push_back('-');
 						header_path += path;
 
-						std::ifstream header(header_path);
-
-						if (!header.is_open())
+						if (!bpp_include_header(header_path, pp_out))
 							continue;
 
 						open = true;
-
-						bpp_parse_file(header, pp_out);
-
 						break;
 					}
 
@@ -880,12 +1065,8 @@ void bpp_parse_file(std::ifstream& hdr_file, std::ofstream& pp_out)
 				}
 				else
 				{
-					std::ifstream header(path);
-
-					if (!header.is_open())
+					if (!bpp_include_header(path, pp_out))
 						throw std::runtime_error("bpp: no such include file: " + path);
-
-					bpp_parse_file(header, pp_out);
 				}
 			}
 			else
@@ -915,6 +1096,14 @@ TOOLCHAINKIT_MODULE(CPlusPlusPreprocessorMain)
 		bool skip		 = false;
 		bool double_skip = false;
 
+		// the module may run many times in one process (tkd), start clean but keep the header caches.
+		kExpansionStack.clear();
+		kFiles.clear();
+		kMacros.clear();
+		kIncludes.clear();
+		kAllIncludes.clear();
+		kWorkingDir.clear();
+
 		Details::bpp_macro macro_1;
 
 		macro_1.fName  = "__true";
@@ -1051,6 +1240,8 @@ TOOLCHAINKIT_MODULE(CPlusPlusPreprocessorMain)
 			if (!std::filesystem::exists(file))
 				continue;
 
+			ToolchainKit::TimeTraceScope trace("Preprocess", file);
+
 			std::ifstream file_descriptor(file);
 			std::ofstream file_descriptor_pp(file + ".pp");
 
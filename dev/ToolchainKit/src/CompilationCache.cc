@@ -0,0 +1,282 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+/// @file CompilationCache.cc
+/// @brief Content addressed compilation cache.
+
+#include <ToolchainKit/CompilationCache.h>
+#include <ToolchainKit/Hash.h>
+#include <ToolchainKit/Version.h>
+#include <algorithm>
+#include <map>
+#include <unistd.h>
+
+#define kCacheStatsFile "stats"
+#define kCacheTmpPrefix ".tmp-"
+
+namespace fs = std::filesystem;
+
+namespace Details
+{
+	static const std::pair<const char*, UInt64 ToolchainKit::CompilationCacheStats::*> kCacheCounters[] = {
+		{"hits", &ToolchainKit::CompilationCacheStats::fHits},
+		{"misses", &ToolchainKit::CompilationCacheStats::fMisses},
+		{"stores", &ToolchainKit::CompilationCacheStats::fStores},
+		{"evictions", &ToolchainKit::CompilationCacheStats::fEvictions},
+	};
+
+	static void cache_read_counters(const std::string& path, ToolchainKit::CompilationCacheStats& stats)
+	{
+		std::ifstream file(path);
+		std::string	  name;
+		UInt64		  value = 0UL;
+
+		while (file >> name >> value)
+		{
+			for (auto& counter : kCacheCounters)
+			{
+				if (name == counter.first)
+					stats.*counter.second = value;
+			}
+		}
+	}
+
+	/// @brief Copy from to to through a temporary file, readers never see half a file.
+	static bool cache_copy(const std::string& from, const std::string& to)
+	{
+		std::error_code err;
+
+		auto tmp = (fs::path(to).parent_path() /
+					(kCacheTmpPrefix + std::to_string(getpid()) + "-" + fs::path(to).filename().string()))
+					   .string();
+
+		fs::copy_file(from, tmp, fs::copy_options::overwrite_existing, err);
+
+		if (err)
+			return false;
+
+		fs::rename(tmp, to, err);
+
+		if (err)
+		{
+			fs::remove(tmp, err);
+			return false;
+		}
+
+		return true;
+	}
+} // namespace Details
+
+namespace ToolchainKit
+{
+	CompilationCache::CompilationCache(const std::string& dir, UInt64 limit)
+		: fDir(dir), fLimit(limit)
+	{
+		std::error_code err;
+		fs::create_directories(fDir, err);
+	}
+
+	std::string CompilationCache::DefaultDirectory()
+	{
+		if (auto dir = std::getenv("TOOLCHAINKIT_CACHE"); dir && *dir)
+			return dir;
+
+		if (auto dir = std::getenv("XDG_CACHE_HOME"); dir && *dir)
+			return std::string(dir) + "/toolchainkit";
+
+		if (auto home = std::getenv("HOME"); home && *home)
+			return std::string(home) + "/.cache/toolchainkit";
+
+		return ".toolchainkit-cache";
+	}
+
+	std::string CompilationCache::Key(const std::string& source, const std::vector<std::string>& flags)
+	{
+		std::ifstream file(source, std::ios::binary);
+
+		if (!file.is_open())
+			return "";
+
+		StreamHash hash;
+
+		hash.Update(std::string(kDistVersion));
+		hash.Update(UInt64(flags.size()));
+
+		for (auto& flag : flags)
+			hash.Update(flag);
+
+		char chunk[65536];
+
+		while (file.read(chunk, sizeof(chunk)) || file.gcount() > 0)
+			hash.Update(chunk, file.gcount());
+
+		return StreamHash::Hex(hash.Final());
+	}
+
+	std::string CompilationCache::EntryPath(const std::string& key, const std::string& kind) const
+	{
+		return fDir + "/" + key.substr(0, 2) + "/" + key + kind;
+	}
+
+	Bool CompilationCache::Fetch(const std::string& key, const std::vector<CompilationCacheOutput>& outputs)
+	{
+		std::error_code err;
+
+		for (auto& output : outputs)
+		{
+			if (!fs::exists(this->EntryPath(key, output.fKind), err))
+			{
+				this->Count(&CompilationCacheStats::fMisses);
+				return false;
+			}
+		}
+
+		auto now = fs::file_time_type::clock::now();
+
+		for (auto& output : outputs)
+		{
+			auto entry = this->EntryPath(key, output.fKind);
+
+			// evicted under us, count it as a miss.
+			if (!Details::cache_copy(entry, output.fPath))
+			{
+				this->Count(&CompilationCacheStats::fMisses);
+				return false;
+			}
+
+			// the modification time is the last use.
+			fs::last_write_time(entry, now, err);
+		}
+
+		this->Count(&CompilationCacheStats::fHits);
+
+		return true;
+	}
+
+	Bool CompilationCache::Store(const std::string& key, const std::vector<CompilationCacheOutput>& outputs)
+	{
+		std::error_code err;
+
+		fs::create_directories(fDir + "/" + key.substr(0, 2), err);
+
+		for (auto& output : outputs)
+		{
+			if (!Details::cache_copy(output.fPath, this->EntryPath(key, output.fKind)))
+				return false;
+		}
+
+		this->Count(&CompilationCacheStats::fStores);
+		this->Evict();
+
+		return true;
+	}
+
+	CompilationCacheStats CompilationCache::Stats() const
+	{
+		CompilationCacheStats stats;
+		std::error_code		  err;
+
+		Details::cache_read_counters(fDir + "/" kCacheStatsFile, stats);
+
+		std::map<std::string, Bool> keys;
+
+		for (auto& entry : fs::recursive_directory_iterator(fDir, err))
+		{
+			if (!entry.is_regular_file() || entry.path().parent_path() == fs::path(fDir) ||
+				entry.path().filename().string().starts_with(kCacheTmpPrefix))
+				continue;
+
+			keys[entry.path().stem().string()] = true;
+			stats.fBytes += entry.file_size();
+		}
+
+		stats.fEntries = keys.size();
+
+		return stats;
+	}
+
+	void CompilationCache::Count(UInt64 CompilationCacheStats::*counter, UInt64 by)
+	{
+		CompilationCacheStats stats;
+
+		auto path = fDir + "/" kCacheStatsFile;
+
+		Details::cache_read_counters(path, stats);
+		stats.*counter += by;
+
+		auto tmp = path + kCacheTmpPrefix + std::to_string(getpid());
+
+		{
+			std::ofstream file(tmp);
+
+			for (auto& known : Details::kCacheCounters)
+				file << known.first << " " << stats.*known.second << "\n";
+		}
+
+		std::error_code err;
+		fs::rename(tmp, path, err);
+	}
+
+	void CompilationCache::Evict()
+	{
+		struct Entry final
+		{
+			std::vector<fs::path> fFiles;
+			UInt64				  fBytes{0UL};
+			fs::file_time_type	  fUsed{};
+		};
+
+		std::map<std::string, Entry> entries;
+		UInt64						 total = 0UL;
+		std::error_code				 err;
+
+		for (auto& file : fs::recursive_directory_iterator(fDir, err))
+		{
+			if (!file.is_regular_file() || file.path().parent_path() == fs::path(fDir) ||
+				file.path().filename().string().starts_with(kCacheTmpPrefix))
+				continue;
+
+			auto& entry = entries[file.path().stem().string()];
+
+			entry.fFiles.push_back(file.path());
+			entry.fBytes += file.file_size();
+			entry.fUsed = std::max(entry.fUsed, file.last_write_time());
+
+			total += file.file_size();
+		}
+
+		if (total <= fLimit)
+			return;
+
+		std::vector<Entry*> order;
+
+		for (auto& entry : entries)
+			order.push_back(&entry.second);
+
+		std::sort(order.begin(), order.end(), [](const Entry* lhs, const Entry* rhs) {
+			return lhs->fUsed < rhs->fUsed;
+		});
+
+		// go a bit under the limit, so that the next stores don't evict again right away.
+		UInt64 target  = fLimit - fLimit / 10;
+		UInt64 evicted = 0UL;
+
+		for (auto entry : order)
+		{
+			if (total <= target)
+				break;
+
+			for (auto& file : entry->fFiles)
+				fs::remove(file, err);
+
+			total -= entry->fBytes;
+			++evicted;
+		}
+
+		if (evicted > 0)
+			this->Count(&CompilationCacheStats::fEvictions, evicted);
+	}
+} // namespace ToolchainKit
@@ -0,0 +1,911 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+/// @file ConstantFolder.cc
+/// @brief Constant folding, propagation and dead code removal over C source lines.
+
+#include <ToolchainKit/ConstantFolder.h>
+#include <algorithm>
+
+namespace Details
+{
+	struct FoldToken final
+	{
+		enum
+		{
+			kIdent,
+			kNumber,
+			kPunct,
+			kOther,
+		} fKind;
+
+		std::string fText;
+	};
+
+	static std::string fold_trim(const std::string& str)
+	{
+		auto first = str.find_first_not_of(" \t\r");
+
+		if (first == std::string::npos)
+			return "";
+
+		auto last = str.find_last_not_of(" \t\r");
+		return str.substr(first, last - first + 1);
+	}
+
+	/// @brief parse an integer literal, suffixes included.
+	/// @param as_int only an int literal: an unsigned or a wider one compares unsigned
+	/// or wider in C, it isn't folded.
+	static Bool fold_literal(const std::string& text, Int64& value, Bool as_int)
+	{
+		std::string digits = text;
+
+		while (!digits.empty() && (digits.back() == 'l' || digits.back() == 'L' ||
+								   (!as_int && (digits.back() == 'u' || digits.back() == 'U'))))
+			digits.pop_back();
+
+		if (digits.empty() || digits.back() == 'u' || digits.back() == 'U')
+			return false;
+
+		char* end  = nullptr;
+		auto  wide = strtoull(digits.c_str(), &end, 0);
+
+		if (*end != 0 || (as_int && wide > UInt64(INT32_MAX)))
+			return false;
+
+		value = (Int64)wide;
+		return true;
+	}
+
+	/// @brief a folded value the target computes the same, in an int.
+	static Bool fold_fits(Int64 value)
+	{
+		return value >= INT32_MIN && value <= INT32_MAX;
+	}
+
+	static std::vector<FoldToken> fold_tokenize(const std::string& text)
+	{
+		static const std::vector<std::string> cPuncts = {
+			"<<=", ">>=", "<<", ">>", "<=", ">=", "==", "!=", "&&", "||", "++", "--",
+			"+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=", "->"};
+
+		std::vector<FoldToken> tokens;
+
+		for (SizeType i = 0; i < text.size();)
+		{
+			auto ch = text[i];
+
+			if (isspace(ch))
+			{
+				++i;
+				continue;
+			}
+
+			if (isalpha(ch) || ch == '_')
+			{
+				auto start = i;
+
+				while (i < text.size() && (isalnum(text[i]) || text[i] == '_'))
+					++i;
+
+				tokens.push_back({FoldToken::kIdent, text.substr(start, i - start)});
+				continue;
+			}
+
+			if (isdigit(ch))
+			{
+				auto start = i;
+
+				while (i < text.size() && (isalnum(text[i]) || text[i] == '.'))
+					++i;
+
+				Int64 value = 0;
+				auto  lit	= text.substr(start, i - start);
+
+				tokens.push_back({fold_literal(lit, value, false) ? FoldToken::kNumber : FoldToken::kOther, lit});
+				continue;
+			}
+
+			// strings and characters, only plain characters are folded.
+			if (ch == '"' || ch == '\'')
+			{
+				auto start = i++;
+
+				while (i < text.size() && text[i] != ch)
+				{
+					if (text[i] == '\\')
+						++i;
+
+					++i;
+				}
+
+				++i;
+
+				auto lit = text.substr(start, i - start);
+
+				if (ch == '\'' && lit.size() == 3)
+					tokens.push_back({FoldToken::kNumber, std::to_string((Int32)lit[1])});
+				else
+					tokens.push_back({FoldToken::kOther, lit});
+
+				continue;
+			}
+
+			Bool found = false;
+
+			for (auto& punct : cPuncts)
+			{
+				if (text.compare(i, punct.size(), punct) == 0)
+				{
+					tokens.push_back({FoldToken::kPunct, punct});
+					i += punct.size();
+
+					found = true;
+					break;
+				}
+			}
+
+			if (!found)
+			{
+				tokens.push_back({FoldToken::kPunct, std::string(1, ch)});
+				++i;
+			}
+		}
+
+		return tokens;
+	}
+
+	/// @brief precedence climbing over the tokens of an expression.
+	class FoldParser final
+	{
+	public:
+		explicit FoldParser(const std::vector<FoldToken>&						tokens,
+							const std::unordered_map<std::string, Int64>& env, Bool as_int)
+			: fTokens(tokens), fEnv(env), fAsInt(as_int)
+		{
+		}
+
+		Bool Parse(Int64& result)
+		{
+			if (fTokens.empty())
+				return false;
+
+			result = this->Ternary();
+
+			return fOk && fPos == fTokens.size();
+		}
+
+	private:
+		Bool Peek(const char* punct)
+		{
+			return fPos < fTokens.size() && fTokens[fPos].fKind == FoldToken::kPunct &&
+				   fTokens[fPos].fText == punct;
+		}
+
+		Bool Accept(const char* punct)
+		{
+			if (!this->Peek(punct))
+				return false;
+
+			++fPos;
+			return true;
+		}
+
+		Int64 Ternary()
+		{
+			auto cond = this->Binary(0);
+
+			if (!this->Accept("?"))
+				return cond;
+
+			auto lhs = this->Ternary();
+
+			if (!this->Accept(":"))
+			{
+				fOk = false;
+				return 0;
+			}
+
+			auto rhs = this->Ternary();
+
+			return cond ? lhs : rhs;
+		}
+
+		/// @brief lowest level first, || down to * / %.
+		Int64 Binary(SizeType level)
+		{
+			static const std::vector<std::vector<std::string>> cLevels = {
+				{"||"}, {"&&"}, {"|"}, {"^"}, {"&"}, {"==", "!="}, {"<", "<=", ">", ">="}, {"<<", ">>"}, {"+", "-"}, {"*", "/", "%"}};
+
+			if (level == cLevels.size())
+				return this->Unary();
+
+			auto lhs = this->Binary(level + 1);
+
+			while (fOk && fPos < fTokens.size() && fTokens[fPos].fKind == FoldToken::kPunct)
+			{
+				auto& op = fTokens[fPos].fText;
+
+				if (std::find(cLevels[level].begin(), cLevels[level].end(), op) == cLevels[level].end())
+					break;
+
+				++fPos;
+
+				auto rhs = this->Binary(level + 1);
+				lhs		 = this->Apply(op, lhs, rhs);
+
+				// an int that overflows is undefined, the C front ends don't widen it.
+				if (fAsInt && !fold_fits(lhs))
+					fOk = false;
+			}
+
+			return lhs;
+		}
+
+		Int64 Apply(const std::string& op, Int64 lhs, Int64 rhs)
+		{
+			// wrap around like the target does.
+			if (op == "+")
+				return (Int64)((UInt64)lhs + (UInt64)rhs);
+			if (op == "-")
+				return (Int64)((UInt64)lhs - (UInt64)rhs);
+			if (op == "*")
+				return (Int64)((UInt64)lhs * (UInt64)rhs);
+
+			if (op == "/" || op == "%")
+			{
+				if (rhs == 0 || (lhs == INT64_MIN && rhs == -1))
+				{
+					fOk = false;
+					return 0;
+				}
+
+				return op == "/" ? lhs / rhs : lhs % rhs;
+			}
+
+			if (op == "<<" || op == ">>")
+			{
+				if (rhs < 0 || rhs > 63)
+				{
+					fOk = false;
+					return 0;
+				}
+
+				return op == "<<" ? (Int64)((UInt64)lhs << rhs) : lhs >> rhs;
+			}
+
+			if (op == "<")
+				return lhs < rhs;
+			if (op == "<=")
+				return lhs <= rhs;
+			if (op == ">")
+				return lhs > rhs;
+			if (op == ">=")
+				return lhs >= rhs;
+			if (op == "==")
+				return lhs == rhs;
+			if (op == "!=")
+				return lhs != rhs;
+			if (op == "&")
+				return lhs & rhs;
+			if (op == "^")
+				return lhs ^ rhs;
+			if (op == "|")
+				return lhs | rhs;
+			if (op == "&&")
+				return lhs && rhs;
+			if (op == "||")
+				return lhs || rhs;
+
+			fOk = false;
+			return 0;
+		}
+
+		Int64 Unary()
+		{
+			if (this->Accept("-"))
+			{
+				auto value = (Int64)(0UL - (UInt64)this->Unary());
+
+				if (fAsInt && !fold_fits(value))
+					fOk = false;
+
+				return value;
+			}
+
+			if (this->Accept("+"))
+				return this->Unary();
+			if (this->Accept("!"))
+				return !this->Unary();
+			if (this->Accept("~"))
+				return ~this->Unary();
+
+			return this->Primary();
+		}
+
+		Int64 Primary()
+		{
+			if (fPos >= fTokens.size())
+			{
+				fOk = false;
+				return 0;
+			}
+
+			auto& tok = fTokens[fPos++];
+
+			if (tok.fKind == FoldToken::kNumber)
+			{
+				Int64 value = 0;
+
+				if (!fold_literal(tok.fText, value, fAsInt))
+					fOk = false;
+
+				return value;
+			}
+
+			if (tok.fKind == FoldToken::kIdent && fEnv.find(tok.fText) != fEnv.end())
+			{
+				// a call, not a constant.
+				if (this->Peek("("))
+				{
+					fOk = false;
+					return 0;
+				}
+
+				return fEnv.at(tok.fText);
+			}
+
+			if (tok.fKind == FoldToken::kPunct && tok.fText == "(")
+			{
+				auto value = this->Ternary();
+
+				if (!this->Accept(")"))
+					fOk = false;
+
+				return value;
+			}
+
+			fOk = false;
+			return 0;
+		}
+
+	private:
+		const std::vector<FoldToken>&				  fTokens;
+		const std::unordered_map<std::string, Int64>& fEnv;
+		SizeType									  fPos{0UL};
+		Bool										  fOk{true};
+		Bool										  fAsInt{true};
+	};
+
+	static Bool fold_is_assign(const std::string& op)
+	{
+		return op == "=" || op == "+=" || op == "-=" || op == "*=" || op == "/=" || op == "%=" ||
+			   op == "&=" || op == "|=" || op == "^=" || op == "<<=" || op == ">>=";
+	}
+
+	static Bool fold_is_qualifier(const std::string& word)
+	{
+		return word == "const" || word == "static" || word == "unsigned" || word == "signed" ||
+			   word == "volatile" || word == "register";
+	}
+
+	/// @brief brace balance of a line, strings and characters excluded.
+	static Int32 fold_braces(const std::string& line)
+	{
+		Int32 depth = 0;
+
+		for (auto& tok : fold_tokenize(line))
+		{
+			if (tok.fKind != FoldToken::kPunct)
+				continue;
+
+			if (tok.fText == "{")
+				++depth;
+			else if (tok.fText == "}")
+				--depth;
+		}
+
+		return depth;
+	}
+
+	/// @brief find the line closing the block opened at the end of start.
+	/// @param skip_close the start line begins with a '}' closing an older block.
+	static SizeType fold_block_end(const std::vector<std::string>& lines, SizeType start, Bool skip_close)
+	{
+		Int32 depth = skip_close ? 1 : 0;
+
+		for (SizeType index = start; index < lines.size(); ++index)
+		{
+			for (auto& tok : fold_tokenize(lines[index]))
+			{
+				if (tok.fKind != FoldToken::kPunct)
+					continue;
+
+				if (tok.fText == "{")
+				{
+					++depth;
+				}
+				else if (tok.fText == "}")
+				{
+					--depth;
+
+					if (depth == 0 && index != start)
+						return index;
+				}
+			}
+		}
+
+		return std::string::npos;
+	}
+
+	static std::string fold_squeeze(const std::string& line)
+	{
+		std::string out;
+
+		for (auto ch : line)
+		{
+			if (!isspace(ch))
+				out += ch;
+		}
+
+		return out;
+	}
+
+	/// @brief a declaration, by its scope and its name.
+	static UInt64 fold_key(const ToolchainKit::SymbolEntry& entry)
+	{
+		return (UInt64(UInt32(entry.fScope)) << 32) | entry.fName;
+	}
+} // namespace Details
+
+namespace ToolchainKit
+{
+	ConstantFolder::ConstantFolder(const std::vector<std::string>& types)
+		: fTypes(types)
+	{
+	}
+
+	Bool ConstantFolder::IsType(const std::string& word) const
+	{
+		return std::find(fTypes.begin(), fTypes.end(), word) != fTypes.end();
+	}
+
+	Bool ConstantFolder::Evaluate(const std::string& expr, const std::unordered_map<std::string, Int64>& env, Int64& result, Bool as_int)
+	{
+		auto tokens = Details::fold_tokenize(expr);
+
+		Details::FoldParser parser(tokens, env, as_int);
+		return parser.Parse(result);
+	}
+
+	std::vector<std::string> ConstantFolder::Run(const std::vector<std::string>& lines)
+	{
+		using Details::FoldToken;
+
+		fFolded	 = 0UL;
+		fRemoved = 0UL;
+		fConstants.clear();
+		fSymbols.Clear();
+
+		std::vector<std::string> out = lines;
+		std::vector<Bool>		 drop(lines.size(), false);
+
+		///
+		/// Only names declared once, with a value, and never written to again
+		/// are propagated, and only to the lines the declaration is in scope of.
+		/// Parameters are declared in the block that follows them.
+		///
+
+		std::unordered_map<UInt64, SizeType> defs, writes;
+		std::vector<ScopeId>				 line_scopes(lines.size(), SymbolTable::kGlobalScope);
+		std::vector<std::string>			 params;
+		Int32								 parens = 0;
+
+		for (SizeType line_index = 0; line_index < lines.size(); ++line_index)
+		{
+			auto tokens = Details::fold_tokenize(lines[line_index]);
+
+			line_scopes[line_index] = fSymbols.Current();
+
+			for (SizeType index = 0; index < tokens.size(); ++index)
+			{
+				auto& tok = tokens[index];
+
+				if (tok.fKind == FoldToken::kPunct)
+				{
+					if (tok.fText == "(")
+					{
+						++parens;
+					}
+					else if (tok.fText == ")")
+					{
+						--parens;
+					}
+					else if (tok.fText == "{")
+					{
+						fSymbols.PushScope();
+
+						for (auto& param : params)
+							++defs[Details::fold_key(fSymbols.Declare(param))];
+
+						params.clear();
+					}
+					else if (tok.fText == "}")
+					{
+						fSymbols.PopScope();
+					}
+					else if (tok.fText == ";" && parens == 0)
+					{
+						// a prototype, its parameters have no block.
+						params.clear();
+					}
+
+					continue;
+				}
+
+				if (tok.fKind != FoldToken::kIdent)
+					continue;
+
+				auto next = index + 1 < tokens.size() ? &tokens[index + 1] : nullptr;
+				auto prev = index > 0 ? &tokens[index - 1] : nullptr;
+
+				// a type, its pointers and qualifiers, then the name.
+				if (this->IsType(tok.fText))
+				{
+					auto name = index + 1;
+
+					while (name < tokens.size() && (tokens[name].fText == "*" || tokens[name].fText == "&" ||
+													Details::fold_is_qualifier(tokens[name].fText)))
+						++name;
+
+					if (name < tokens.size() && tokens[name].fKind == FoldToken::kIdent && !this->IsType(tokens[name].fText))
+					{
+						if (parens > 0)
+							params.push_back(tokens[name].fText);
+						else
+							++defs[Details::fold_key(fSymbols.Declare(tokens[name].fText))];
+					}
+				}
+
+				auto entry = fSymbols.Find(tok.fText);
+
+				if (!entry)
+					continue;
+
+				if (next && next->fKind == FoldToken::kPunct &&
+					(Details::fold_is_assign(next->fText) || next->fText == "++" || next->fText == "--"))
+					++writes[Details::fold_key(*entry)];
+
+				// ++x, --x and &x, the address of a constant can be written through.
+				if (prev && prev->fKind == FoldToken::kPunct &&
+					(prev->fText == "++" || prev->fText == "--" || prev->fText == "&"))
+					++writes[Details::fold_key(*entry)];
+			}
+		}
+
+		auto is_candidate = [&](UInt64 key) -> Bool {
+			return defs[key] == 1 && writes[key] == 1;
+		};
+
+		// the constants a line sees, by name.
+		auto scoped = [&](SizeType line_index) -> std::unordered_map<std::string, Int64> {
+			std::unordered_map<std::string, Int64> env;
+
+			for (auto& tok : Details::fold_tokenize(out[line_index]))
+			{
+				if (tok.fKind != FoldToken::kIdent)
+					continue;
+
+				auto entry = fSymbols.Find(tok.fText, line_scopes[line_index]);
+
+				if (auto it = entry ? fConstants.find(Details::fold_key(*entry)) : fConstants.end(); it != fConstants.end())
+					env[tok.fText] = it->second;
+			}
+
+			return env;
+		};
+
+		std::unordered_map<UInt64, std::pair<std::string, SizeType>> locals; // by declaration, its name and line.
+
+		Int32 depth = 0;
+
+		for (SizeType index = 0; index < out.size(); ++index)
+		{
+			if (drop[index])
+				continue;
+
+			auto& line = out[index];
+			auto  body = Details::fold_trim(line);
+
+			auto tokens = Details::fold_tokenize(body);
+
+			if (tokens.empty() || line.find('"') != std::string::npos)
+			{
+				depth += Details::fold_braces(line);
+				continue;
+			}
+
+			auto& head = tokens[0].fText;
+
+			///
+			/// if (cond) { ... } [else { ... }] and while (cond) { ... }, each brace
+			/// on the line of its keyword or on a line of its own.
+			///
+
+			if ((head == "if" || head == "while") && tokens.size() > 2 && tokens[1].fText == "(" &&
+				(tokens.back().fText == "{" || tokens.back().fText == ")"))
+			{
+				auto open  = body.find('(');
+				auto close = body.rfind(')');
+
+				Int64 value = 0;
+
+				// the next line with code on it.
+				auto next_line = [&](SizeType from) -> SizeType {
+					for (SizeType next = from + 1; next < out.size(); ++next)
+					{
+						if (!drop[next] && !Details::fold_trim(out[next]).empty())
+							return next;
+					}
+
+					return std::string::npos;
+				};
+
+				// the line of the brace that opens the block of the keyword at line from.
+				auto brace_line = [&](SizeType from, const std::string& rest) -> SizeType {
+					if (rest == "{")
+						return from;
+
+					auto next = rest.empty() ? next_line(from) : std::string::npos;
+
+					return next != std::string::npos && Details::fold_squeeze(out[next]) == "{" ? next : std::string::npos;
+				};
+
+				SizeType brace = std::string::npos;
+
+				if (close != std::string::npos && close > open)
+					brace = brace_line(index, Details::fold_trim(body.substr(close + 1)));
+
+				if (brace != std::string::npos &&
+					ConstantFolder::Evaluate(body.substr(open + 1, close - open - 1), scoped(index), value))
+				{
+					auto end = Details::fold_block_end(out, brace, false);
+
+					if (end == std::string::npos)
+					{
+						depth += Details::fold_braces(line);
+						continue;
+					}
+
+					auto squeezed = Details::fold_squeeze(out[end]);
+
+					SizeType else_brace = std::string::npos;
+					SizeType else_end	= std::string::npos;
+					Bool	 has_else	= false;
+
+					if (head == "if")
+					{
+						auto end_tokens = Details::fold_tokenize(out[end]);
+
+						if (end_tokens.size() > 1 && end_tokens[1].fText == "else")
+						{
+							has_else   = true;
+							else_brace = squeezed == "}else{" || squeezed == "}else" ? brace_line(end, squeezed.substr(strlen("}else"))) : std::string::npos;
+						}
+						else if (auto next = next_line(end); squeezed == "}" && next != std::string::npos)
+						{
+							auto next_tokens   = Details::fold_tokenize(out[next]);
+							auto next_squeezed = Details::fold_squeeze(out[next]);
+
+							// else if, or an else without braces, is left alone.
+							has_else   = !next_tokens.empty() && next_tokens[0].fText == "else";
+							else_brace = next_squeezed == "else{" || next_squeezed == "else" ? brace_line(next, next_squeezed.substr(strlen("else"))) : std::string::npos;
+						}
+
+						if (has_else && else_brace != std::string::npos)
+							else_end = Details::fold_block_end(out, else_brace, else_brace == end);
+
+						if (has_else && (else_end == std::string::npos || Details::fold_squeeze(out[else_end]) != "}"))
+						{
+							depth += Details::fold_braces(line);
+							continue;
+						}
+					}
+
+					if (!has_else && squeezed != "}")
+					{
+						depth += Details::fold_braces(line);
+						continue;
+					}
+
+					// a taken while (1) is a loop, leave it alone.
+					if (head == "while" && value)
+					{
+						depth += Details::fold_braces(line);
+						continue;
+					}
+
+					// the kept block would leak its locals into the outer scope.
+					SizeType kept_start = value ? brace + 1 : else_brace + 1;
+					SizeType kept_end	= value ? end : else_end;
+					Bool	 has_locals = false;
+
+					for (SizeType kept = kept_start; kept_end != std::string::npos && kept < kept_end; ++kept)
+					{
+						auto kept_tokens = Details::fold_tokenize(out[kept]);
+
+						for (SizeType tok = 0; tok + 1 < kept_tokens.size(); ++tok)
+						{
+							if (this->IsType(kept_tokens[tok].fText) &&
+								kept_tokens[tok + 1].fKind == FoldToken::kIdent)
+								has_locals = true;
+						}
+					}
+
+					if (has_locals)
+					{
+						depth += Details::fold_braces(line);
+						continue;
+					}
+
+					if (value)
+					{
+						drop[index] = true;
+						drop[brace] = true;
+						drop[end]	= true;
+
+						for (SizeType dead = end; else_end != std::string::npos && dead <= else_end; ++dead)
+							drop[dead] = true;
+					}
+					else
+					{
+						for (SizeType dead = index; dead <= end; ++dead)
+							drop[dead] = true;
+
+						// the else line and its brace, then the closing brace of the else.
+						for (SizeType dead = end; else_end != std::string::npos && dead <= else_brace; ++dead)
+							drop[dead] = true;
+
+						if (else_end != std::string::npos)
+							drop[else_end] = true;
+					}
+
+					++fFolded;
+					continue;
+				}
+
+				depth += Details::fold_braces(line);
+				continue;
+			}
+
+			///
+			/// return expr;
+			///
+
+			if (head == "return" && tokens.back().fText == ";" && tokens.size() > 2)
+			{
+				auto start = line.find("return") + strlen("return");
+				auto end   = line.rfind(';');
+
+				auto expr = Details::fold_trim(line.substr(start, end - start));
+
+				Int64 value = 0;
+
+				if (ConstantFolder::Evaluate(expr, scoped(index), value) && expr != std::to_string(value))
+				{
+					line = line.substr(0, start) + " " + std::to_string(value) + line.substr(end);
+					++fFolded;
+				}
+
+				depth += Details::fold_braces(line);
+				continue;
+			}
+
+			///
+			/// [qualifiers] type name = expr; and name = expr;
+			///
+
+			SizeType name_index	 = 0;
+			Bool	 is_unsigned = false;
+
+			while (name_index < tokens.size() && Details::fold_is_qualifier(tokens[name_index].fText))
+				is_unsigned |= tokens[name_index++].fText == "unsigned";
+
+			Bool is_decl = name_index < tokens.size() && this->IsType(tokens[name_index].fText);
+
+			if (is_decl)
+				++name_index;
+
+			if (name_index + 2 < tokens.size() && tokens[name_index].fKind == FoldToken::kIdent &&
+				tokens[name_index + 1].fText == "=" && tokens.back().fText == ";")
+			{
+				auto& name	= tokens[name_index].fText;
+				auto  start = line.find('=') + 1;
+				auto  end	= line.rfind(';');
+
+				auto expr = Details::fold_trim(line.substr(start, end - start));
+
+				Int64 value = 0;
+
+				if (ConstantFolder::Evaluate(expr, scoped(index), value))
+				{
+					if (expr != std::to_string(value))
+					{
+						line = line.substr(0, start) + " " + std::to_string(value) + line.substr(end);
+						++fFolded;
+					}
+
+					// an unsigned local compares unsigned, it is never propagated.
+					auto entry = fSymbols.Find(name, line_scopes[index]);
+
+					if (is_decl && !is_unsigned && entry && is_candidate(Details::fold_key(*entry)))
+					{
+						fConstants[Details::fold_key(*entry)] = value;
+
+						if (depth > 0)
+							locals[Details::fold_key(*entry)] = {name, index};
+					}
+				}
+			}
+
+			depth += Details::fold_braces(line);
+		}
+
+		///
+		/// Drop the constant locals nobody reads anymore.
+		///
+
+		for (auto& [key, local] : locals)
+		{
+			Bool used = false;
+
+			for (SizeType index = 0; index < out.size() && !used; ++index)
+			{
+				if (drop[index] || index == local.second)
+					continue;
+
+				auto tokens = Details::fold_tokenize(out[index]);
+
+				// a brace moves the scope within the line, any use of the name counts then.
+				Bool moves = std::any_of(tokens.begin(), tokens.end(), [](auto& tok) {
+					return tok.fKind == FoldToken::kPunct && (tok.fText == "{" || tok.fText == "}");
+				});
+
+				for (auto& tok : tokens)
+				{
+					if (tok.fKind != FoldToken::kIdent || tok.fText != local.first)
+						continue;
+
+					auto entry = fSymbols.Find(tok.fText, line_scopes[index]);
+
+					if (moves || (entry && Details::fold_key(*entry) == key))
+					{
+						used = true;
+						break;
+					}
+				}
+			}
+
+			if (!used)
+				drop[local.second] = true;
+		}
+
+		std::vector<std::string> result;
+
+		for (SizeType index = 0; index < out.size(); ++index)
+		{
+			if (drop[index])
+			{
+				++fRemoved;
+				continue;
+			}
+
+			result.push_back(out[index]);
+		}
+
+		return result;
+	}
+} // namespace ToolchainKit
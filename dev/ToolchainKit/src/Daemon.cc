@@ -0,0 +1,461 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+/// @file Daemon.cc
+/// @brief tkd server and client, over a Unix domain socket.
+
+#include <ToolchainKit/Daemon.h>
+#include <ToolchainKit/NFC/ErrorID.h>
+#include <climits>
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+TK_IMPORT_C int CPlusPlusPreprocessorMain(int argc, char** argv);
+TK_IMPORT_C int CompilerCPlusPlusX8664(int argc, char** argv);
+TK_IMPORT_C int AssemblerAMD64(int argc, char** argv);
+TK_IMPORT_C int AssemblerMain64x0(int argc, char** argv);
+TK_IMPORT_C int AssemblerMainPower64(int argc, char** argv);
+TK_IMPORT_C int DynamicLinker64PEF(int argc, char** argv);
+TK_IMPORT_C int LibraryArchiver64(int argc, char** argv);
+
+#define kDaemonMagic  0x31444B54 /* TKD1 */
+#define kDaemonStop	  "tkd:stop"
+#define kDaemonArgMax 4096
+
+namespace Details
+{
+	struct daemon_module final
+	{
+		const char*					 fName;
+		ToolchainKit::DaemonModuleFn fMain;
+	};
+
+	static const daemon_module kDaemonModules[] = {
+		{"CPlusPlusPreprocessorMain", CPlusPlusPreprocessorMain},
+		{"CompilerCPlusPlusX8664", CompilerCPlusPlusX8664},
+		{"AssemblerAMD64", AssemblerAMD64},
+		{"AssemblerMain64x0", AssemblerMain64x0},
+		{"AssemblerMainPower64", AssemblerMainPower64},
+		{"DynamicLinker64PEF", DynamicLinker64PEF},
+		{"LibraryArchiver64", LibraryArchiver64},
+	};
+
+	static bool daemon_write(int fd, const void* data, SizeType size)
+	{
+		auto bytes = static_cast<const char*>(data);
+
+		while (size > 0)
+		{
+			auto written = write(fd, bytes, size);
+
+			if (written <= 0)
+				return false;
+
+			bytes += written;
+			size -= written;
+		}
+
+		return true;
+	}
+
+	static bool daemon_read(int fd, void* data, SizeType size)
+	{
+		auto bytes = static_cast<char*>(data);
+
+		while (size > 0)
+		{
+			auto got = read(fd, bytes, size);
+
+			if (got <= 0)
+				return false;
+
+			bytes += got;
+			size -= got;
+		}
+
+		return true;
+	}
+
+	static bool daemon_write_string(int fd, const std::string& text)
+	{
+		UInt32 size = text.size();
+
+		return daemon_write(fd, &size, sizeof(size)) && daemon_write(fd, text.data(), size);
+	}
+
+	static bool daemon_read_string(int fd, std::string& text)
+	{
+		UInt32 size = 0;
+
+		if (!daemon_read(fd, &size, sizeof(size)) || size > PATH_MAX * 4)
+			return false;
+
+		text.resize(size);
+
+		return daemon_read(fd, text.data(), size);
+	}
+
+	static bool daemon_address(const std::string& path, sockaddr_un& addr)
+	{
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+
+		if (path.size() >= sizeof(addr.sun_path))
+			return false;
+
+		memcpy(addr.sun_path, path.c_str(), path.size());
+
+		return true;
+	}
+
+	static int daemon_connect(const std::string& path)
+	{
+		sockaddr_un addr;
+
+		if (!daemon_address(path, addr))
+			return -1;
+
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+		if (fd < 0)
+			return -1;
+
+		if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+		{
+			close(fd);
+			return -1;
+		}
+
+		return fd;
+	}
+
+	/// @brief Only serve our own user.
+	static bool daemon_peer_allowed(int fd)
+	{
+#ifdef __APPLE__
+		uid_t uid = 0;
+		gid_t gid = 0;
+
+		if (getpeereid(fd, &uid, &gid) < 0)
+			return false;
+
+		return uid == getuid();
+#else
+		ucred	  cred{};
+		socklen_t len = sizeof(cred);
+
+		if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0)
+			return false;
+
+		return cred.uid == getuid();
+#endif
+	}
+
+	/// @brief Send our stdout and stderr along with the magic.
+	static bool daemon_send_fds(int fd)
+	{
+		UInt32 magic   = kDaemonMagic;
+		int	   fds[2]  = {STDOUT_FILENO, STDERR_FILENO};
+		char   control[CMSG_SPACE(sizeof(fds))];
+		iovec  iov{&magic, sizeof(magic)};
+		msghdr msg{};
+
+		memset(control, 0, sizeof(control));
+
+		msg.msg_iov		   = &iov;
+		msg.msg_iovlen	   = 1;
+		msg.msg_control	   = control;
+		msg.msg_controllen = sizeof(control);
+
+		auto cmsg		 = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type	 = SCM_RIGHTS;
+		cmsg->cmsg_len	 = CMSG_LEN(sizeof(fds));
+
+		memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+		return sendmsg(fd, &msg, 0) == sizeof(magic);
+	}
+
+	static bool daemon_recv_fds(int fd, int fds[2])
+	{
+		UInt32 magic = 0;
+		char   control[CMSG_SPACE(sizeof(int) * 2)];
+		iovec  iov{&magic, sizeof(magic)};
+		msghdr msg{};
+
+		msg.msg_iov		   = &iov;
+		msg.msg_iovlen	   = 1;
+		msg.msg_control	   = control;
+		msg.msg_controllen = sizeof(control);
+
+		if (recvmsg(fd, &msg, 0) != sizeof(magic) || magic != kDaemonMagic)
+			return false;
+
+		auto cmsg = CMSG_FIRSTHDR(&msg);
+
+		if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(int) * 2))
+			return false;
+
+		memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * 2);
+
+		return true;
+	}
+
+	static void daemon_flush()
+	{
+		std::cout.flush();
+		std::cerr.flush();
+
+		fflush(stdout);
+		fflush(stderr);
+	}
+
+	/// @brief Run one job, its output goes to the client's stdout and stderr.
+	/// @return false if the daemon was asked to stop.
+	static bool daemon_job(int client, bool verbose)
+	{
+		int fds[2] = {-1, -1};
+
+		if (!daemon_recv_fds(client, fds))
+			return true;
+
+		UInt32					 count = 0;
+		std::string				 module, cwd;
+		std::vector<std::string> args;
+
+		bool ok = daemon_read(client, &count, sizeof(count)) && count < kDaemonArgMax &&
+				  daemon_read_string(client, module) && daemon_read_string(client, cwd);
+
+		for (UInt32 index = 0; ok && index < count; ++index)
+		{
+			args.emplace_back();
+			ok = daemon_read_string(client, args.back());
+		}
+
+		Int32 code = 1;
+
+		if (ok && module == kDaemonStop)
+		{
+			daemon_write(client, &code, sizeof(code));
+
+			close(fds[0]);
+			close(fds[1]);
+
+			return false;
+		}
+
+		auto main = ToolchainKit::daemon_find_module(module);
+
+		if (ok && main && !args.empty() && chdir(cwd.c_str()) == 0)
+		{
+			if (verbose)
+				std::cout << "tkd: job " << module << " in " << cwd << "\n";
+
+			daemon_flush();
+
+			int saved_out = dup(STDOUT_FILENO);
+			int saved_err = dup(STDERR_FILENO);
+
+			dup2(fds[0], STDOUT_FILENO);
+			dup2(fds[1], STDERR_FILENO);
+
+			std::vector<char*> argv;
+
+			for (auto& arg : args)
+				argv.push_back(arg.data());
+
+			argv.push_back(nullptr);
+
+			try
+			{
+				code = main(args.size(), argv.data());
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << "tkd: " << module << ": " << e.what() << "\n";
+				code = 1;
+			}
+
+			daemon_flush();
+
+			dup2(saved_out, STDOUT_FILENO);
+			dup2(saved_err, STDERR_FILENO);
+
+			close(saved_out);
+			close(saved_err);
+		}
+		else if (verbose)
+		{
+			std::cout << "tkd: bad job " << module << "\n";
+		}
+
+		close(fds[0]);
+		close(fds[1]);
+
+		daemon_write(client, &code, sizeof(code));
+
+		return true;
+	}
+} // namespace Details
+
+namespace ToolchainKit
+{
+	std::string daemon_socket_path()
+	{
+		if (auto path = getenv("TOOLCHAINKIT_DAEMON"); path && *path)
+			return path;
+
+		std::string dir = "/tmp";
+
+		if (auto tmp = getenv("TMPDIR"); tmp && *tmp)
+			dir = tmp;
+
+		if (dir.back() == '/')
+			dir.pop_back();
+
+		return dir + "/tkd-" + std::to_string(getuid()) + ".sock";
+	}
+
+	DaemonModuleFn daemon_find_module(const std::string& name)
+	{
+		for (auto& module : Details::kDaemonModules)
+		{
+			if (name == module.fName)
+				return module.fMain;
+		}
+
+		return nullptr;
+	}
+
+	Int32 daemon_serve(const std::string& path, Bool verbose)
+	{
+		sockaddr_un addr;
+
+		if (!Details::daemon_address(path, addr))
+		{
+			std::cout << "tkd: socket path too long: " << path << "\n";
+			return TOOLCHAINKIT_EXEC_ERROR;
+		}
+
+		// don't steal the socket of a live daemon, only a stale one.
+		if (int fd = Details::daemon_connect(path); fd >= 0)
+		{
+			close(fd);
+
+			std::cout << "tkd: already running on " << path << "\n";
+			return TOOLCHAINKIT_EXEC_ERROR;
+		}
+
+		unlink(path.c_str());
+
+		int server = socket(AF_UNIX, SOCK_STREAM, 0);
+
+		if (server < 0)
+			return TOOLCHAINKIT_EXEC_ERROR;
+
+		// the socket is created for our user only.
+		auto old_mask = umask(0077);
+		auto bound	  = bind(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+
+		umask(old_mask);
+
+		if (bound < 0 || listen(server, 16) < 0)
+		{
+			std::cout << "tkd: can't listen on " << path << ": " << strerror(errno) << "\n";
+			close(server);
+
+			return TOOLCHAINKIT_EXEC_ERROR;
+		}
+
+		// a client going away must not kill us.
+		signal(SIGPIPE, SIG_IGN);
+
+		if (verbose)
+			std::cout << "tkd: listening on " << path << "\n";
+
+		bool running = true;
+
+		while (running)
+		{
+			int client = accept(server, nullptr, nullptr);
+
+			if (client < 0)
+			{
+				if (errno == EINTR)
+					continue;
+
+				break;
+			}
+
+			if (Details::daemon_peer_allowed(client))
+				running = Details::daemon_job(client, verbose);
+
+			close(client);
+		}
+
+		close(server);
+		unlink(path.c_str());
+
+		if (verbose)
+			std::cout << "tkd: stopped.\n";
+
+		return 0;
+	}
+
+	Bool daemon_submit(const std::string& path, const std::string& module, const std::vector<std::string>& args, Int32& code)
+	{
+		int fd = Details::daemon_connect(path);
+
+		if (fd < 0)
+			return false;
+
+		char cwd[PATH_MAX] = {0};
+
+		if (!getcwd(cwd, sizeof(cwd)))
+		{
+			close(fd);
+			return false;
+		}
+
+		UInt32 count = args.size();
+
+		bool sent = Details::daemon_send_fds(fd) &&
+					Details::daemon_write(fd, &count, sizeof(count)) &&
+					Details::daemon_write_string(fd, module) &&
+					Details::daemon_write_string(fd, cwd);
+
+		for (auto& arg : args)
+			sent = sent && Details::daemon_write_string(fd, arg);
+
+		if (!sent)
+		{
+			close(fd);
+			return false;
+		}
+
+		// the job was sent, if no code comes back the daemon died running it.
+		if (!Details::daemon_read(fd, &code, sizeof(code)))
+		{
+			std::cout << "tkd: lost the daemon while running " << module << ".\n";
+			code = TOOLCHAINKIT_EXEC_ERROR;
+		}
+
+		close(fd);
+
+		return true;
+	}
+
+	Bool daemon_stop(const std::string& path)
+	{
+		Int32 code = 0;
+
+		return daemon_submit(path, kDaemonStop, {}, code);
+	}
+} // namespace ToolchainKit
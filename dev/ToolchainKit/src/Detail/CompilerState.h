@@ -0,0 +1,138 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+#pragma once
+
+#include <ToolchainKit/Parser.h>
+#include <ToolchainKit/SymbolTable.h>
+
+/// @file CompilerState.h
+/// @brief Compiler state shared by the C and C++ front ends, one definition
+/// for every translation unit of the library.
+
+namespace Details
+{
+	/// @brief Offset based struct/class.
+	struct CompilerStructMap final
+	{
+		/// 'my_foo'
+		std::string fName;
+
+		/// if instance: stores a valid register.
+		std::string fReg;
+
+		/// offset count
+		std::size_t fOffsetsCnt;
+
+		/// offset array.
+		std::vector<std::pair<Int32, std::string>> fOffsets;
+	};
+
+	struct CompilerState final
+	{
+		std::vector<ToolchainKit::SyntaxLeafList> fSyntaxTreeList;
+		ToolchainKit::SymbolTable				  kStackFrame; // variable -> register, by scope.
+		std::vector<CompilerStructMap>			  kStructMap;
+		ToolchainKit::SyntaxLeafList*			  fSyntaxTree{nullptr};
+		std::unique_ptr<std::ofstream>			  fOutputAssembly;
+		std::string								  fLastFile;
+		std::string								  fLastError;
+		bool									  fVerbose;
+
+		/// (leaf index, scope) each time a block opens or closes, so that a leaf
+		/// is resolved against the scope it was emitted in.
+		std::vector<std::pair<SizeType, ToolchainKit::ScopeId>> fScopeMarks;
+	};
+
+	/// @brief Get the last identifier of text, "int foo" gives "foo".
+	inline std::string last_identifier(const std::string& text)
+	{
+		std::string ident;
+		std::string last;
+
+		for (auto ch : text)
+		{
+			if (isalnum(ch) || ch == '_')
+			{
+				ident += ch;
+				continue;
+			}
+
+			if (!ident.empty())
+				last = ident;
+
+			ident.clear();
+		}
+
+		return ident.empty() ? last : ident;
+	}
+
+	/// @brief Replace the variables of text by their registers, as seen from scope.
+	/// One pass over the text, one hash lookup per word.
+	/// @return how many variables were replaced.
+	inline SizeType resolve_symbols(const CompilerState& state, std::string& text, ToolchainKit::ScopeId scope)
+	{
+		const std::string kExternSegment = "extern_segment ";
+
+		SizeType	cnt = 0UL;
+		std::string out;
+
+		for (SizeType index = 0UL; index < text.size();)
+		{
+			// leave strings alone.
+			if (text[index] == '"')
+			{
+				auto end = text.find('"', index + 1);
+				end		 = end == std::string::npos ? text.size() : end + 1;
+
+				out += text.substr(index, end - index);
+				index = end;
+
+				continue;
+			}
+
+			if (!isalpha(text[index]) && text[index] != '_')
+			{
+				out += text[index];
+				++index;
+
+				continue;
+			}
+
+			auto start = index;
+
+			while (index < text.size() && (isalnum(text[index]) || text[index] == '_'))
+				++index;
+
+			auto word = text.substr(start, index - start);
+
+			// a number suffix or hex digits, not a word.
+			if (start > 0 && isdigit(text[start - 1]))
+			{
+				out += word;
+				continue;
+			}
+
+			auto symbol = state.kStackFrame.Find(word, scope);
+
+			if (!symbol)
+			{
+				out += word;
+				continue;
+			}
+
+			if (out.size() >= kExternSegment.size() &&
+				out.compare(out.size() - kExternSegment.size(), kExternSegment.size(), kExternSegment) == 0)
+				out.erase(out.size() - kExternSegment.size());
+
+			out += symbol->fValue;
+			++cnt;
+		}
+
+		text = out;
+		return cnt;
+	}
+} // namespace Details
@@ -24,13 +24,24 @@
 //! Preferred Executable Format
 #include <ToolchainKit/NFC/PEF.h>
 #include <ToolchainKit/UUID.h>
+#include <ToolchainKit/Hash.h>
+#include <ToolchainKit/TimeTrace.h>
 
 //! Release macros.
 #include <ToolchainKit/Version.h>
 
 //! Advanced Executable Object Format.
 #include <ToolchainKit/NFC/AE.h>
+
+//! Static libraries.
+#include <ToolchainKit/NFC/Library.h>
+
+//! Link time optimization.
+#include <ToolchainKit/IR.h>
 #include <cstdint>
+#include <unordered_map>
+#include <sstream>
+#include <thread>
 
 #define kLinkerVersionStr "ELMH 64-Bit Dynamic Linker %s, (c) Amlal EL Mahrouss 2024, all rights reserved.\n"
 
@@ -47,6 +58,9 @@
 #define kLinkerId			 (0x5046FF)
 #define kLinkerAbiContainer	 "Container:ABI:"
 
+/// @brief segment alignment when records are laid out one by one but not page aligned.
+#define kLinkerRecordAlign (16)
+
 /// @brief PEF stack size symbol.
 #define kLinkerStackSizeSymbol "SizeOfReserveStack"
 
@@ -57,7 +71,113 @@ struct DynamicLinkerBlob final
 	std::vector<CharType> fPefBlob; // PEF code/bss/data blob.
 	std::uintptr_t fAEOffset; // the offset of the PEF container header..
 };
+
+// where the bytes of a record are in its object blob, for the page aligned layout.
+struct DynamicLinkerSlice final
+{
+	SizeType fObject;
+	SizeType fBegin;
+	SizeType fEnd;
+};
+
+// a field of an object code ld64 fills with the address of a symbol.
+struct DynamicLinkerRelocation final
+{
+	SizeType	fObject;
+	UInt64		fOffset; // in the object blob.
+	Int64		fAddend;
+	UInt16		fType;
+	std::string fSymbol;
+};
+
+// a symbol taken from a dylib, called through a stub.
+struct DynamicLinkerImport final
+{
+	std::string fDylib; // file name, as the loader finds it.
+	std::string fSymbol;
+};
+
+// a relocation resolved, the value goes at fSite.
+struct DynamicLinkerFixup final
+{
+	CharType* fSite;
+	Int64	  fValue;
+	UInt16	  fType;
+};
+
+// the value of a field at place pointing at target, false when it is out of reach.
+static Bool dynamic_linker_field(UInt16 type, Int64 target, UInt64 place, Int64& value)
+{
+	value = target;
+
+	switch (type)
+	{
+	case ToolchainKit::kAERelocAbs64:
+		return true;
+	case ToolchainKit::kAERelocAbs32:
+		return value >= 0 && value <= Int64(UINT32_MAX);
+	case ToolchainKit::kAERelocRel32:
+		value -= Int64(kLinkerDefaultOrigin + place);
+		return value >= INT32_MIN && value <= INT32_MAX;
+	case ToolchainKit::kAERelocPowerBranch24:
+		value -= Int64(kLinkerDefaultOrigin + place);
+		[[fallthrough]];
+	case ToolchainKit::kAERelocPowerBranch24Abs:
+		// LI is 24 bits of words, sign extended.
+		return (value & 3) == 0 && value >= -(1L << 25) && value < (1L << 25);
+	default:
+		return false;
+	}
+}
+
+// a call, jmp or jcc to the symbol, it can't observe the address of what it reaches.
+static Bool dynamic_linker_is_branch(const std::vector<CharType>& blob, const DynamicLinkerRelocation& relocation)
+{
+	switch (relocation.fType)
+	{
+	case ToolchainKit::kAERelocPowerBranch24:
+	case ToolchainKit::kAERelocPowerBranch24Abs:
+		return true;
+	case ToolchainKit::kAERelocRel32: {
+		if (relocation.fOffset < 1 || relocation.fOffset > blob.size())
+			return false;
+
+		UInt8 opcode = blob[relocation.fOffset - 1];
+
+		if (opcode == 0xE8 || opcode == 0xE9)
+			return true;
+
+		return relocation.fOffset >= 2 && UInt8(blob[relocation.fOffset - 2]) == 0x0F && (opcode & 0xF0) == 0x80;
+	}
+	default:
+		return false;
+	}
+}
+
+// writes the --ld64:time-trace of the link on the way out, whichever return it takes.
+struct DynamicLinkerTraceEnd final
+{
+	Bool fActive{false};
+
+	~DynamicLinkerTraceEnd()
+	{
+		if (fActive && !ToolchainKit::TimeTrace::End())
+			kStdOut << "ld64: can't write the time trace.\n";
+	}
+};
+
+static Bool dynamic_linker_is_trace(const char* arg)
+{
+	return StringCompare(arg, "--ld64:time-trace") == 0 || strstr(arg, "--ld64:time-trace=") == arg;
 }
+}
+
+enum
+{
+	kFoldNone, /* no identical code folding */
+	kFoldSafe, /* keep what other objects refer to distinct, its address may be taken */
+	kFoldAll,
+};
 
 enum
 {
@@ -66,22 +186,43 @@ enum
 	kABITypeInvalid = 0xFFFF,
 };
 
-static ToolchainKit::String kOutput	 = "";
-static Int32	   kAbi				 = kABITypeZKA;
-static Int32	   kSubArch			 = kPefNoSubCpu;
-static Int32	   kArch			 = ToolchainKit::kPefArchInvalid;
-static Bool		   kFatBinaryEnable	 = false;
-static Bool		   kStartFound		 = false;
-static Bool		   kDuplicateSymbols = false;
-static Bool		   kVerbose			 = false;
+/* thread local, each slice of a fat link runs the linker on its own thread. */
+static thread_local ToolchainKit::String	kOutput				= "";
+static thread_local Int32					kAbi				= kABITypeZKA;
+static thread_local Int32					kSubArch			= kPefNoSubCpu;
+static thread_local Int32					kArch				= ToolchainKit::kPefArchInvalid;
+static thread_local Bool					kFatBinaryEnable	= false;
+static thread_local Bool					kStartFound			= false;
+static thread_local Bool					kDuplicateSymbols	= false;
+static thread_local Bool					kVerbose			= false;
+static thread_local Bool					kDeterministic		= false;
+static thread_local UInt32					kImageVersion		= kPefVersion;
+static thread_local SizeType				kPageAlign			= 0UL;
+static thread_local Bool					kGarbageCollect		= false;
+static thread_local Int32					kFoldCode			= kFoldNone;
+static thread_local Bool					kIncremental		= false;
+static thread_local ToolchainKit::String	kMapPath			= "";
+static thread_local ToolchainKit::String	kSizeReportPath		= "";
+static thread_local Bool					kBindNow			= false;
+static thread_local Bool					kLinkTimeOptimize	= false;
+static thread_local SizeType				kLTOPartitions		= 0UL; /* 0: one per hardware thread. */
 
 /* ld64 is to be found, mld is to be found at runtime. */
 static const char* kLdDefineSymbol = ":UndefinedSymbol:";
 static const char* kLdDynamicSym   = ":RuntimeSymbol:";
 
 /* object code and list. */
-static std::vector<ToolchainKit::String> kObjectList;
-static std::vector<Details::DynamicLinkerBlob> kObjectBytes;
+static thread_local std::vector<ToolchainKit::String> kObjectList;
+static thread_local std::vector<Details::DynamicLinkerBlob> kObjectBytes;
+
+/* static libraries, their members come in when they define an undefined symbol. */
+static thread_local std::vector<ToolchainKit::String> kLibraryList;
+
+/* dylibs, what is still undefined after the libraries is imported from them. */
+static thread_local std::vector<ToolchainKit::String> kDylibList;
+
+/* symbols kept by --ld64:gc-sections besides the entrypoint. */
+static thread_local std::vector<ToolchainKit::String> kKeepSymbols;
 
 static uintptr_t kMIBCount = 8;
 static uintptr_t kByteCount	= 1024;
@@ -89,339 +230,2225 @@ static uintptr_t kByteCount	= 1024;
 #define kPrintF			printf
 #define kLinkerSplash() kPrintF(kWhite kLinkerVersionStr, kDistVersion)
 
-///	@brief ZKA 64-bit Linker.
-/// @note This linker is made for PEF executable, thus ZKA based OSes.
-TOOLCHAINKIT_MODULE(DynamicLinker64PEF)
+/// @brief incremental link state, next to the output.
+#define kLinkerStateExt ".ild"
+#define kLinkerStateMagic "ld64:incremental 1"
+
+/// @brief the object holding the import stubs and their pointer slots.
+#define kLinkerStubsObject "<stubs>"
+#define kLinkerImportSlot  "__imp_"
+
+/// @brief the partitions of --ld64:lto, next to the output until they are read.
+#define kLinkerLTOPartition ".lto"
+
+/// @brief link map and size report, next to the output by default.
+#define kLinkerMapExt		 ".map"
+#define kLinkerSizeReportExt ".size.json"
+
+namespace Details
 {
-	bool is_executable = true;
+	struct DynamicLinkerStateRecord final
+	{
+		UInt32		fKind;
+		Int64		fCommand; // index in the v4 command table, -1 when not written.
+		std::string fName;
+	};
 
-	/**
-	 * @brief parse flags and trigger options.
-	 */
-	for (size_t linker_arg = 1;	linker_arg < argc; ++linker_arg)
+	struct DynamicLinkerStateObject final
 	{
-		if (StringCompare(argv[linker_arg], "--ld64:help") == 0)
-		{
-			kLinkerSplash();
+		UInt64								  fSize;
+		Int64								  fTime;
+		std::string							  fHash;
+		UInt64								  fOffset; // file offset of the object code.
+		UInt64								  fReserve; // bytes kept for it, its code and room to grow.
+		std::string							  fPath;
+		std::vector<DynamicLinkerStateRecord> fRecords;
+	};
+
+	struct DynamicLinkerState final
+	{
+		std::string							  fSignature;
+		UInt64								  fOutputSize{0UL};
+		Int64								  fOutputTime{0L};
+		std::vector<DynamicLinkerStateObject> fObjects;
+		std::vector<DynamicLinkerRelocation>  fRelocations; // refilled when either end moves.
+	};
+
+	/// @brief an object code with room to grow, a quarter more and at least 64 bytes.
+	static UInt64 dynamic_linker_reserve(UInt64 size)
+	{
+		UInt64 reserve = size + std::max<UInt64>(64UL, size / 4UL);
+		return (reserve + kLinkerRecordAlign - 1) & ~UInt64(kLinkerRecordAlign - 1);
+	}
 
-			kStdOut << "--ld64:ver: Show linker version.\n";
-			kStdOut << "--ld64:?: Show linker help.\n";
-			kStdOut << "--ld64:verbose: Enable linker trace.\n";
-			kStdOut << "--ld64:dylib: Output as a Dylib PEF.\n";
-			kStdOut << "--ld64:fat: Output as a FAT PEF.\n";
-			kStdOut << "--ld64:32k: Output as a 32x0 PEF.\n";
-			kStdOut << "--ld64:64k: Output as a 64x0 PEF.\n";
-			kStdOut << "--ld64:amd64: Output as a AMD64 PEF.\n";
-			kStdOut << "--ld64:rv64: Output as a RISC-V PEF.\n";
-			kStdOut << "--ld64:power64: Output as a POWER PEF.\n";
-			kStdOut << "--ld64:arm64: Output as a ARM64 PEF.\n";
-			kStdOut << "--ld64:output: Select the output file name.\n";
+	static Int64 dynamic_linker_time(const std::string& path)
+	{
+		std::error_code err;
+		auto			time = std::filesystem::last_write_time(path, err);
 
-			return EXIT_SUCCESS;
-		}
-		else if (StringCompare(argv[linker_arg], "--ld64:version") == 0)
-		{
-			kLinkerSplash();
-			return EXIT_SUCCESS;
-		}
-		else if (StringCompare(argv[linker_arg], "--ld64:fat-binary") == 0)
-		{
-			kFatBinaryEnable = true;
+		return err ? 0L : Int64(time.time_since_epoch().count());
+	}
 
-			continue;
-		}
-		else if (StringCompare(argv[linker_arg], "--ld64:64k") == 0)
-		{
-			kArch = ToolchainKit::kPefArch64000;
+	static std::string dynamic_linker_hash(const std::string& path)
+	{
+		std::ifstream file(path, std::ios::binary);
 
-			continue;
-		}
-		else if (StringCompare(argv[linker_arg], "--ld64:amd64") == 0)
-		{
-			kArch = ToolchainKit::kPefArchAMD64;
+		if (!file.is_open())
+			return "";
 
-			continue;
-		}
-		else if (StringCompare(argv[linker_arg], "--ld64:32k") == 0)
-		{
-			kArch = ToolchainKit::kPefArch32000;
+		ToolchainKit::StreamHash hash;
+		CharType				 buffer[65536];
 
-			continue;
-		}
-		else if (StringCompare(argv[linker_arg], "--ld64:power64") == 0)
-		{
-			kArch = ToolchainKit::kPefArchPowerPC;
+		while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0)
+			hash.Update(buffer, file.gcount());
 
-			continue;
-		}
-		else if (StringCompare(argv[linker_arg], "--ld64:riscv64") == 0)
+		return ToolchainKit::StreamHash::Hex(hash.Final());
+	}
+
+	static Bool dynamic_linker_load_state(const std::string& path, DynamicLinkerState& state)
+	{
+		std::ifstream file(path);
+		std::string	  line;
+
+		if (!std::getline(file, line) || line != kLinkerStateMagic)
+			return false;
+
+		while (std::getline(file, line))
 		{
-			kArch = ToolchainKit::kPefArchRISCV;
+			std::istringstream in(line);
+			std::string		   tag;
 
-			continue;
+			in >> tag;
+
+			if (tag == "signature")
+			{
+				in >> state.fSignature;
+			}
+			else if (tag == "output")
+			{
+				in >> state.fOutputSize >> state.fOutputTime;
+			}
+			else if (tag == "relocation")
+			{
+				DynamicLinkerRelocation relocation{};
+
+				in >> relocation.fObject >> relocation.fOffset >> relocation.fType >> relocation.fAddend;
+				in.get();
+				std::getline(in, relocation.fSymbol);
+
+				if (relocation.fObject >= state.fObjects.size())
+					return false;
+
+				state.fRelocations.push_back(relocation);
+			}
+			else if (tag == "object")
+			{
+				DynamicLinkerStateObject object{};
+
+				in >> object.fSize >> object.fTime >> object.fHash >> object.fOffset >> object.fReserve;
+				in.get();
+				std::getline(in, object.fPath);
+
+				state.fObjects.push_back(object);
+			}
+			else if (tag == "record" && !state.fObjects.empty())
+			{
+				DynamicLinkerStateRecord record{};
+
+				in >> record.fKind >> record.fCommand;
+				in.get();
+				std::getline(in, record.fName);
+
+				state.fObjects.back().fRecords.push_back(record);
+			}
+			else
+			{
+				return false;
+			}
+
+			if (in.fail())
+				return false;
 		}
-		else if (StringCompare(argv[linker_arg], "--ld64:arm64") == 0)
+
+		return true;
+	}
+
+	static Bool dynamic_linker_save_state(const std::string& path, DynamicLinkerState& state)
+	{
+		std::ofstream file(path);
+
+		file << kLinkerStateMagic << "\n";
+		file << "signature " << state.fSignature << "\n";
+		file << "output " << state.fOutputSize << " " << state.fOutputTime << "\n";
+
+		for (auto& object : state.fObjects)
 		{
-			kArch = ToolchainKit::kPefArchARM64;
+			file << "object " << object.fSize << " " << object.fTime << " " << object.fHash << " "
+				 << object.fOffset << " " << object.fReserve << " " << object.fPath << "\n";
 
-			continue;
+			for (auto& record : object.fRecords)
+				file << "record " << record.fKind << " " << record.fCommand << " " << record.fName << "\n";
 		}
-		else if (StringCompare(argv[linker_arg], "--ld64:verbose") == 0)
+
+		for (auto& relocation : state.fRelocations)
+			file << "relocation " << relocation.fObject << " " << relocation.fOffset << " " << relocation.fType << " "
+				 << relocation.fAddend << " " << relocation.fSymbol << "\n";
+
+		return file.good();
+	}
+
+	/// @brief Patch the objects changed since the last link in place, in their reserved room.
+	/// @return false when it needs a full link, the image is untouched then.
+	static Bool dynamic_linker_relink(DynamicLinkerState& state, const std::string& signature)
+	{
+		namespace fs = std::filesystem;
+
+		std::error_code err;
+
+		if (state.fSignature != signature || state.fObjects.size() != kObjectList.size() ||
+			fs::file_size(kOutput, err) != state.fOutputSize || err ||
+			dynamic_linker_time(kOutput) != state.fOutputTime)
+			return false;
+
+		std::fstream image(kOutput, std::ios::in | std::ios::out | std::ios::binary);
+
+		ToolchainKit::PEFContainer container{};
+		image.read(reinterpret_cast<CharType*>(&container), sizeof(ToolchainKit::PEFContainer));
+
+		if (!image.good() || container.Version != kPefVersion4)
+			return false;
+
+		struct dynamic_linker_patch final
 		{
-			kVerbose = true;
+			SizeType						fObject;
+			std::vector<CharType>			fCode;
+			std::vector<DynamicLinkerSlice> fSlices;
+			DynamicLinkerStateObject		fState;
+			std::vector<DynamicLinkerRelocation> fRelocations;
+		};
 
-			continue;
-		}
-		else if (StringCompare(argv[linker_arg], "--ld64:dylib") == 0)
+		std::vector<dynamic_linker_patch> patches;
+
+		for (size_t object_index = 0UL; object_index < kObjectList.size(); ++object_index)
 		{
-			if (kOutput.empty())
+			auto& object = state.fObjects[object_index];
+			auto& path	 = kObjectList[object_index];
+
+			if (object.fPath != path)
+				return false;
+
+			auto size = fs::file_size(path, err);
+			auto time = dynamic_linker_time(path);
+
+			if (err)
+				return false;
+
+			if (size == object.fSize && time == object.fTime)
+				continue;
+
+			dynamic_linker_patch patch{object_index, {}, {}, object, {}};
+
+			patch.fState.fSize = size;
+			patch.fState.fTime = time;
+			patch.fState.fHash = dynamic_linker_hash(path);
+
+			// touched, not changed.
+			if (patch.fState.fHash == object.fHash)
 			{
+				object = patch.fState;
 				continue;
 			}
 
-			if (kOutput.find(kPefExt) != ToolchainKit::String::npos)
-				kOutput.erase(kOutput.find(kPefExt), strlen(kPefExt));
+			std::ifstream			 file(path, std::ios::binary);
+			ToolchainKit::AEHeader	 hdr{};
 
-			kOutput += kPefDylibExt;
+			file >> hdr;
 
-			is_executable = false;
+			if (hdr.fMagic[0] != kAEMag0 || hdr.fMagic[1] != kAEMag1 || hdr.fSize != sizeof(ToolchainKit::AEHeader) ||
+				hdr.fArch != kArch || hdr.fCodeSize > object.fReserve)
+				return false;
 
-			continue;
+			std::vector<ToolchainKit::AERecordHeader> records;
+			std::vector<ToolchainKit::AERelocation>	  relocations;
+
+			if (!ToolchainKit::Utils::ae_read_records(file, hdr, records, relocations))
+				return false;
+
+			for (auto& relocation : relocations)
+			{
+				if (relocation.fOffset + ToolchainKit::Utils::ae_relocation_width(relocation.fType) > hdr.fCodeSize)
+					return false;
+
+				patch.fRelocations.push_back({object_index, relocation.fOffset, relocation.fAddend, relocation.fType, relocation.fSymbol});
+			}
+
+			// the same symbols in and out, or the resolution may differ.
+			SizeType record_begin = 0UL;
+			SizeType known		  = 0UL;
+
+			for (auto& record : records)
+			{
+				DynamicLinkerSlice slice{object_index, record_begin, record_begin};
+
+				if (record.fKind != kAENullType)
+				{
+					slice.fEnd	 = std::clamp<SizeType>(record.fSize, record_begin, hdr.fCodeSize);
+					record_begin = slice.fEnd;
+				}
+
+				if (*record.fName == 0)
+					continue;
+
+				if (known >= object.fRecords.size() ||
+					object.fRecords[known].fName != ToolchainKit::String(record.fName, strnlen(record.fName, kPefNameLen)) ||
+					object.fRecords[known].fKind != record.fKind ||
+					object.fRecords[known].fCommand >= Int64(container.Count))
+					return false;
+
+				patch.fSlices.push_back(slice);
+				++known;
+			}
+
+			if (known != object.fRecords.size())
+				return false;
+
+			patch.fCode.resize(object.fReserve, 0);
+
+			file.seekg(std::streamsize(hdr.fStartCode));
+			file.read(patch.fCode.data(), std::streamsize(hdr.fCodeSize));
+
+			patches.push_back(std::move(patch));
 		}
-		else if (StringCompare(argv[linker_arg], "--ld64:output") == 0)
+
+		// the fields of a patched object come back blank and its symbols may have moved, both are filled
+		// again. The objects left alone are found through the command table.
+		struct dynamic_linker_refill final
 		{
-			kOutput = argv[linker_arg + 1];
-			++linker_arg;
+			UInt64 fAt; // in the image.
+			Int64  fValue;
+			UInt16 fType;
+		};
 
-			continue;
-		}
-		else
+		std::vector<Bool> patched(kObjectList.size(), false);
+
+		for (auto& patch : patches)
+			patched[patch.fObject] = true;
+
+		std::vector<ToolchainKit::PEFCommandHeaderV4> commands(container.Count);
+
+		image.seekg(container.HdrSz);
+		image.read(reinterpret_cast<CharType*>(commands.data()), commands.size() * sizeof(ToolchainKit::PEFCommandHeaderV4));
+
+		if (!image.good())
+			return false;
+
+		std::unordered_map<std::string, UInt64> definitions; // where the symbol is in the image.
+		std::unordered_map<std::string, Bool>	moved;
+		SizeType								patch_index = 0UL;
+
+		for (size_t object_index = 0UL; object_index < state.fObjects.size(); ++object_index)
 		{
-			if (argv[linker_arg][0] == '-')
+			auto& object = state.fObjects[object_index];
+			auto* patch	 = patched[object_index] ? &patches[patch_index++] : nullptr;
+
+			for (size_t record_index = 0UL; record_index < object.fRecords.size(); ++record_index)
 			{
-				kStdOut << "ld64: unknown flag: " << argv[linker_arg] << "\n";
-				return EXIT_FAILURE;
+				auto& record = object.fRecords[record_index];
+
+				if (record.fKind == kAENullType || record.fName.find(kLdDefineSymbol) != ToolchainKit::String::npos)
+					continue;
+
+				auto symbol = ToolchainKit::Utils::pef_symbol_name(record.fName.c_str());
+
+				if (patch)
+				{
+					definitions.try_emplace(symbol, UInt64(object.fOffset + patch->fSlices[record_index].fBegin));
+					moved[symbol] = true;
+				}
+				else if (record.fCommand >= 0)
+				{
+					definitions.try_emplace(symbol, UInt64(commands[record.fCommand].Offset));
+				}
 			}
+		}
 
-			kObjectList.emplace_back(argv[linker_arg]);
+		std::vector<DynamicLinkerRelocation> relocations;
+		std::vector<dynamic_linker_refill>	 refills;
 
-			continue;
+		for (auto& relocation : state.fRelocations)
+		{
+			if (!patched[relocation.fObject])
+				relocations.push_back(relocation);
 		}
-	}
 
-	if (kOutput.empty())
-	{
-		kStdOut << "ld64: no output filename set." << std::endl;
-		return TOOLCHAINKIT_EXEC_ERROR;
-	}
+		for (auto& patch : patches)
+			relocations.insert(relocations.end(), patch.fRelocations.begin(), patch.fRelocations.end());
 
-	// sanity check.
-	if (kObjectList.empty())
-	{
-		kStdOut << "ld64: no input files." << std::endl;
-		return TOOLCHAINKIT_EXEC_ERROR;
-	}
-	else
-	{
-		namespace fs = std::filesystem;
+		std::stable_sort(relocations.begin(), relocations.end(), [](auto& lhs, auto& rhs) {
+			return lhs.fObject < rhs.fObject;
+		});
 
-		// check for existing files, if they don't throw an error.
-		for (auto& obj : kObjectList)
+		for (auto& relocation : relocations)
 		{
-			if (!fs::exists(obj))
-			{
-				// if filesystem doesn't find file
-				//          -> throw error.
-				kStdOut << "ld64: no such file: " << obj << std::endl;
-				return TOOLCHAINKIT_EXEC_ERROR;
-			}
+			if (!patched[relocation.fObject] && !moved.count(relocation.fSymbol))
+				continue;
+
+			auto it = definitions.find(relocation.fSymbol);
+
+			if (it == definitions.end())
+				return false;
+
+			UInt64 at	 = state.fObjects[relocation.fObject].fOffset + relocation.fOffset;
+			Int64  value = 0L;
+
+			if (!dynamic_linker_field(relocation.fType, Int64(kLinkerDefaultOrigin + it->second) + relocation.fAddend, at, value))
+				return false;
+
+			refills.push_back({at, value, relocation.fType});
 		}
-	}
+
+		for (auto& patch : patches)
+		{
+			auto& object = state.fObjects[patch.fObject];
+
+			object = patch.fState;
+
+			image.seekp(object.fOffset);
+			image.write(patch.fCode.data(), patch.fCode.size());
+
+			for (size_t record_index = 0UL; record_index < object.fRecords.size(); ++record_index)
+			{
+				auto& record = object.fRecords[record_index];
+				auto& slice	 = patch.fSlices[record_index];
+
+				if (record.fCommand < 0)
+					continue;
+
+				ToolchainKit::PEFCommandHeaderV4 command{};
+				auto							 at = container.HdrSz + record.fCommand * sizeof(ToolchainKit::PEFCommandHeaderV4);
+
+				image.seekg(at);
+				image.read(reinterpret_cast<CharType*>(&command), sizeof(ToolchainKit::PEFCommandHeaderV4));
+
+				command.Offset = object.fOffset + slice.fBegin;
+				command.Size   = slice.fEnd - slice.fBegin;
+
+				image.seekp(at);
+				image.write(reinterpret_cast<const CharType*>(&command), sizeof(ToolchainKit::PEFCommandHeaderV4));
+
+				if (record.fName.find(kPefStart) != ToolchainKit::String::npos &&
+					record.fName.find(kPefCode64) != ToolchainKit::String::npos)
+					container.Start = command.Offset;
+			}
+
+			if (kVerbose)
+				kStdOut << "ld64: incremental: patched " << object.fPath << "\n";
+		}
+
+		for (auto& refill : refills)
+		{
+			UInt64 field = 0UL;
+			auto   width = ToolchainKit::Utils::ae_relocation_width(refill.fType);
+
+			image.seekg(refill.fAt);
+			image.read(reinterpret_cast<CharType*>(&field), width);
+
+			switch (refill.fType)
+			{
+			case ToolchainKit::kAERelocPowerBranch24:
+			case ToolchainKit::kAERelocPowerBranch24Abs:
+				field = (field & ~0x03FFFFFCUL) | (UInt64(refill.fValue) & 0x03FFFFFCUL);
+				break;
+			default:
+				field = UInt64(refill.fValue);
+				break;
+			}
+
+			image.seekp(refill.fAt);
+			image.write(reinterpret_cast<const CharType*>(&field), width);
+		}
+
+		state.fRelocations = std::move(relocations);
+
+		image.seekp(0);
+		image.write(reinterpret_cast<const CharType*>(&container), sizeof(ToolchainKit::PEFContainer));
+		image.close();
+
+		if (image.fail())
+			return false;
+
+		state.fOutputTime = dynamic_linker_time(kOutput);
+
+		if (kVerbose)
+			kStdOut << "ld64: incremental: patched " << patches.size() << " of " << kObjectList.size() << " objects, relocated "
+					<< refills.size() << " fields.\n";
+
+		return true;
+	}
+
+	/// @brief a record or a container as it landed in the image.
+	struct DynamicLinkerMapEntry final
+	{
+		ToolchainKit::String fName;
+		UInt32				 fKind;
+		UInt64				 fOffset; // from the image base, .zero64 is past the file.
+		UInt64				 fSize;
+		Int64				 fObject; // -1 for the containers the linker adds.
+		ToolchainKit::String fFolded; // the record it shares its bytes with, --ld64:icf.
+	};
+
+	struct DynamicLinkerMapObject final
+	{
+		ToolchainKit::String fPath;
+		ToolchainKit::String fReason; // why it is in the image.
+		UInt64				 fSize;	  // bytes of its records, folded ones aside.
+	};
+
+	struct DynamicLinkerReport final
+	{
+		ToolchainKit::String				  fOutput;
+		UInt32								  fVersion;
+		UInt32								  fArch;
+		UInt64								  fFileSize;
+		UInt64								  fHeaderSize; // everything before the first record.
+		std::vector<ToolchainKit::PEFSegment> fSegments;
+		std::vector<DynamicLinkerMapObject>	  fObjects;
+		std::vector<DynamicLinkerMapEntry>	  fEntries;
+	};
+
+	static const CharType* dynamic_linker_kind_name(UInt32 kind)
+	{
+		switch (kind)
+		{
+		case ToolchainKit::kPefCode:
+			return "code";
+		case ToolchainKit::kPefData:
+			return "data";
+		case ToolchainKit::kPefZero:
+			return "zero";
+		case ToolchainKit::kPefLinkerID:
+			return "linker";
+		default:
+			return "other";
+		}
+	}
+
+	/// @brief bytes of each kind, folded records aside.
+	static std::vector<std::pair<UInt32, UInt64>> dynamic_linker_sections(const DynamicLinkerReport& report)
+	{
+		std::vector<std::pair<UInt32, UInt64>> sections;
+
+		for (auto& entry : report.fEntries)
+		{
+			if (!entry.fFolded.empty() || entry.fObject < 0)
+				continue;
+
+			auto it = std::find_if(sections.begin(), sections.end(), [&entry](auto& section) { return section.first == entry.fKind; });
+
+			if (it == sections.end())
+				sections.push_back({entry.fKind, entry.fSize});
+			else
+				it->second += entry.fSize;
+		}
+
+		return sections;
+	}
+
+	/// @brief the text map, for people: sections, objects and why they are in, then the symbols by address.
+	static Bool dynamic_linker_write_map(const ToolchainKit::String& path, const DynamicLinkerReport& report)
+	{
+		std::ofstream map(path);
+
+		map << "# ld64 map of " << report.fOutput << ", PEF v" << report.fVersion << ", cpu " << report.fArch << ", "
+			<< report.fFileSize << " bytes, " << report.fHeaderSize << " of headers.\n";
+
+		map << "\n# Sections\n";
+
+		for (auto& section : dynamic_linker_sections(report))
+			map << dynamic_linker_kind_name(section.first) << "\t" << section.second << "\n";
+
+		if (!report.fSegments.empty())
+		{
+			map << "\n# Segments\n# kind\tfile offset\tfile size\tmemory offset\tmemory size\n";
+
+			for (auto& segment : report.fSegments)
+				map << dynamic_linker_kind_name(segment.Kind) << "\t0x" << std::hex << segment.FileOffset << "\t0x" << segment.FileSize
+					<< "\t0x" << segment.VirtualOffset << "\t0x" << segment.VirtualSize << std::dec << "\n";
+		}
+
+		map << "\n# Objects\n# size\tobject\tretained because\n";
+
+		for (auto& object : report.fObjects)
+			map << object.fSize << "\t" << object.fPath << "\t" << object.fReason << "\n";
+
+		std::vector<const DynamicLinkerMapEntry*> entries;
+
+		for (auto& entry : report.fEntries)
+			entries.push_back(&entry);
+
+		std::stable_sort(entries.begin(), entries.end(), [](auto lhs, auto rhs) { return lhs->fOffset < rhs->fOffset; });
+
+		map << "\n# Symbols\n# address\tsize\tkind\tobject\tname\n";
+
+		for (auto entry : entries)
+		{
+			map << "0x" << std::hex << entry->fOffset << std::dec << "\t" << entry->fSize << "\t" << dynamic_linker_kind_name(entry->fKind)
+				<< "\t" << (entry->fObject < 0 ? "<linker>" : report.fObjects[entry->fObject].fPath) << "\t" << entry->fName;
+
+			if (!entry->fFolded.empty())
+				map << "\t(folded into " << entry->fFolded << ")";
+
+			map << "\n";
+		}
+
+		return map.good();
+	}
+
+	static ToolchainKit::String dynamic_linker_json(const ToolchainKit::String& text)
+	{
+		ToolchainKit::String out = "\"";
+
+		for (auto ch : text)
+		{
+			if (ch == '"' || ch == '\\')
+				out += '\\';
+
+			if (static_cast<unsigned char>(ch) < 0x20)
+				continue;
+
+			out += ch;
+		}
+
+		return out + "\"";
+	}
+
+	/// @brief the size report, for tools: the bytes of each object and each of its symbols.
+	static Bool dynamic_linker_write_size_report(const ToolchainKit::String& path, const DynamicLinkerReport& report)
+	{
+		std::ofstream json(path);
+
+		json << "{\"output\":" << dynamic_linker_json(report.fOutput) << ",\"version\":" << report.fVersion
+			 << ",\"cpu\":" << report.fArch << ",\"fileSize\":" << report.fFileSize << ",\"headerSize\":" << report.fHeaderSize;
+
+		json << ",\n\"sections\":[";
+
+		auto sections = dynamic_linker_sections(report);
+
+		for (size_t index = 0UL; index < sections.size(); ++index)
+			json << (index ? "," : "") << "{\"kind\":\"" << dynamic_linker_kind_name(sections[index].first) << "\",\"size\":" << sections[index].second << "}";
+
+		json << "],\n\"objects\":[\n";
+
+		// the containers the linker adds go last, as an object of their own.
+		for (Int64 object = 0L; object <= Int64(report.fObjects.size()); ++object)
+		{
+			Bool   linker = object == Int64(report.fObjects.size());
+			UInt64 size	  = 0UL;
+
+			if (linker)
+			{
+				for (auto& entry : report.fEntries)
+					size += entry.fObject < 0 ? entry.fSize : 0UL;
+
+				json << "{\"path\":\"<linker>\",\"reason\":\"image metadata\",\"size\":" << size;
+			}
+			else
+			{
+				json << "{\"path\":" << dynamic_linker_json(report.fObjects[object].fPath)
+					 << ",\"reason\":" << dynamic_linker_json(report.fObjects[object].fReason)
+					 << ",\"size\":" << report.fObjects[object].fSize;
+			}
+
+			json << ",\"symbols\":[";
+
+			Bool first = true;
+
+			for (auto& entry : report.fEntries)
+			{
+				if (entry.fObject != (linker ? -1L : object))
+					continue;
+
+				json << (first ? "" : ",") << "{\"name\":" << dynamic_linker_json(entry.fName) << ",\"kind\":\""
+					 << dynamic_linker_kind_name(entry.fKind) << "\",\"offset\":" << entry.fOffset << ",\"size\":" << entry.fSize;
+
+				if (!entry.fFolded.empty())
+					json << ",\"foldedInto\":" << dynamic_linker_json(entry.fFolded);
+
+				json << "}";
+				first = false;
+			}
+
+			json << "]}" << (linker ? "\n" : ",\n");
+		}
+
+		json << "]}\n";
+
+		return json.good();
+	}
+
+	/// @brief where --ld64:dylib puts the image of output.
+	static ToolchainKit::String dynamic_linker_dylib_name(ToolchainKit::String output)
+	{
+		if (output.find(kPefExt) != ToolchainKit::String::npos)
+			output.erase(output.find(kPefExt), strlen(kPefExt));
+
+		return output + kPefDylibExt;
+	}
+
+	struct DynamicLinkerFatSlice final
+	{
+		const CharType*					  fName;
+		const CharType*					  fFlag;
+		UInt32							  fArch;
+		std::vector<ToolchainKit::String> fInputs;
+		ToolchainKit::String			  fOutput;
+		Int32							  fStatus;
+	};
+
+	/// @brief --ld64:slice=<name>, and the flag linking a slice for it.
+	static const DynamicLinkerFatSlice kFatSliceArchs[] = {
+		{"amd64", "--ld64:amd64", ToolchainKit::kPefArchAMD64, {}, "", 0},
+		{"64k", "--ld64:64k", ToolchainKit::kPefArch64000, {}, "", 0},
+		{"32k", "--ld64:32k", ToolchainKit::kPefArch32000, {}, "", 0},
+		{"power64", "--ld64:power64", ToolchainKit::kPefArchPowerPC, {}, "", 0},
+		{"riscv64", "--ld64:riscv64", ToolchainKit::kPefArchRISCV, {}, "", 0},
+		{"arm64", "--ld64:arm64", ToolchainKit::kPefArchARM64, {}, "", 0},
+	};
+} // namespace Details
+
+TOOLCHAINKIT_MODULE(DynamicLinker64PEF);
+
+/* the code generators of --ld64:lto, their assemblers run in process. */
+TOOLCHAINKIT_MODULE(AssemblerAMD64);
+TOOLCHAINKIT_MODULE(AssemblerMain64x0);
+
+namespace Details
+{
+	/// @brief Link each --ld64:slice= on its own thread, then pack the images in a fat PEF.
+	/// @note the other flags go to every slice.
+	static Int32 dynamic_linker_link_fat(int argc, char** argv)
+	{
+		ToolchainKit::String			  output;
+		Bool							  dylib	  = false;
+		Bool							  verbose = false;
+		std::vector<ToolchainKit::String> flags;
+		std::vector<ToolchainKit::String> reports; // --ld64:map and --ld64:size-report, a file per slice.
+		std::vector<DynamicLinkerFatSlice> slices;
+
+		for (SizeType linker_arg = 1; linker_arg < SizeType(argc); ++linker_arg)
+		{
+			ToolchainKit::String arg = argv[linker_arg];
+
+			if (arg.find("--ld64:slice=") == 0)
+			{
+				auto name = arg.substr(strlen("--ld64:slice="));
+				auto arch = std::find_if(std::begin(kFatSliceArchs), std::end(kFatSliceArchs),
+										 [&name](auto& entry) { return name == entry.fName; });
+
+				if (arch == std::end(kFatSliceArchs))
+				{
+					kStdOut << "ld64: unknown slice architecture: " << name << "\n";
+					return EXIT_FAILURE;
+				}
+
+				for (auto& slice : slices)
+				{
+					if (slice.fArch == arch->fArch)
+					{
+						kStdOut << "ld64: two slices for " << name << "\n";
+						return EXIT_FAILURE;
+					}
+				}
+
+				slices.push_back(*arch);
+			}
+			else if (arg == "--ld64:output" && linker_arg + 1 < SizeType(argc))
+			{
+				output = argv[++linker_arg];
+			}
+			else if (arg == "--ld64:dylib")
+			{
+				// as the module does, only after --ld64:output.
+				if (!output.empty())
+				{
+					output = dynamic_linker_dylib_name(output);
+					dylib  = true;
+				}
+			}
+			else if (arg == "--ld64:incremental" || arg == "--ld64:fat-binary" ||
+					 std::any_of(std::begin(kFatSliceArchs), std::end(kFatSliceArchs),
+								 [&arg](auto& entry) { return arg == entry.fFlag; }))
+			{
+				kStdOut << "ld64: " << arg << " doesn't go with --ld64:slice=, each slice has its own architecture.\n";
+				return EXIT_FAILURE;
+			}
+			else if (arg.find("--ld64:map") == 0 || arg.find("--ld64:size-report") == 0)
+			{
+				reports.push_back(arg);
+			}
+			else if (arg == "--ld64:keep" && linker_arg + 1 < SizeType(argc))
+			{
+				flags.push_back(arg);
+				flags.emplace_back(argv[++linker_arg]);
+			}
+			else if (dynamic_linker_is_trace(arg.c_str()))
+			{
+				continue;
+			}
+			else if (arg[0] == '-')
+			{
+				verbose |= arg == "--ld64:verbose";
+				flags.push_back(arg);
+			}
+			else if (slices.empty())
+			{
+				kStdOut << "ld64: " << arg << " comes before the first --ld64:slice=\n";
+				return EXIT_FAILURE;
+			}
+			else
+			{
+				slices.back().fInputs.push_back(arg);
+			}
+		}
+
+		if (output.empty())
+		{
+			kStdOut << "ld64: no output filename set." << std::endl;
+			return TOOLCHAINKIT_EXEC_ERROR;
+		}
+
+		std::vector<std::thread> threads;
+
+		for (auto& slice : slices)
+		{
+			slice.fOutput = output + "." + slice.fName + ".slice";
+
+			threads.emplace_back([&slice, &flags, &reports, &output, dylib]() {
+				ToolchainKit::TimeTraceScope trace("Slice", slice.fName);
+
+				std::vector<ToolchainKit::String> args{"ld64", "--ld64:output", slice.fOutput, slice.fFlag};
+
+				if (dylib)
+				{
+					args.emplace_back("--ld64:dylib");
+					slice.fOutput = dynamic_linker_dylib_name(slice.fOutput);
+				}
+
+				args.insert(args.end(), flags.begin(), flags.end());
+
+				// <output>.<slice>.map, or <path>.<slice>.<ext>.
+				for (auto& report : reports)
+				{
+					auto flag = report.substr(0, report.find('='));
+					auto ext  = flag == "--ld64:map" ? kLinkerMapExt : kLinkerSizeReportExt;
+
+					if (report.find('=') == ToolchainKit::String::npos)
+					{
+						args.push_back(flag + "=" + output + "." + slice.fName + ext);
+						continue;
+					}
+
+					std::filesystem::path path = report.substr(report.find('=') + 1);
+					auto				  tail = path.extension().string();
+
+					path.replace_extension();
+					path += ToolchainKit::String(".") + slice.fName + tail;
+
+					args.push_back(flag + "=" + path.string());
+				}
+
+				args.insert(args.end(), slice.fInputs.begin(), slice.fInputs.end());
+
+				std::vector<char*> arg_vec;
+
+				for (auto& arg : args)
+					arg_vec.push_back(arg.data());
+
+				slice.fStatus = DynamicLinker64PEF(arg_vec.size(), arg_vec.data());
+			});
+		}
+
+		for (auto& thread : threads)
+			thread.join();
+
+		Int32 status = EXIT_SUCCESS;
+
+		for (auto& slice : slices)
+		{
+			if (slice.fStatus != EXIT_SUCCESS)
+			{
+				kStdOut << "ld64: slice " << slice.fName << " failed to link." << std::endl;
+				status = slice.fStatus;
+			}
+		}
+
+		// a loader maps its slice alone, each one starts on a page.
+		ToolchainKit::PEFFatHeader			   hdr{};
+		std::vector<ToolchainKit::PEFFatSlice> table;
+
+		MemoryCopy(hdr.Magic, kPefMagicFat, kPefMagicLen);
+
+		hdr.Linker	= kLinkerId;
+		hdr.Version = kPefVersion;
+		hdr.Count	= slices.size();
+		hdr.Align	= kPefPageSize;
+
+		UInt64 offset = sizeof(ToolchainKit::PEFFatHeader) + slices.size() * sizeof(ToolchainKit::PEFFatSlice);
+
+		std::error_code err;
+
+		for (auto& slice : slices)
+		{
+			if (status != EXIT_SUCCESS)
+				break;
+
+			auto size = std::filesystem::file_size(slice.fOutput, err);
+
+			if (err)
+			{
+				kStdOut << "ld64: can't read slice " << slice.fOutput << std::endl;
+				status = TOOLCHAINKIT_EXEC_ERROR;
+				break;
+			}
+
+			offset = (offset + hdr.Align - 1) & ~(hdr.Align - 1);
+
+			table.push_back({slice.fArch, kPefNoSubCpu, offset, size});
+			offset += size;
+		}
+
+		if (status == EXIT_SUCCESS)
+		{
+			std::ofstream out(output, std::ios::binary);
+
+			out.write(reinterpret_cast<const CharType*>(&hdr), sizeof(ToolchainKit::PEFFatHeader));
+			out.write(reinterpret_cast<const CharType*>(table.data()), table.size() * sizeof(ToolchainKit::PEFFatSlice));
+
+			for (size_t index = 0UL; index < slices.size(); ++index)
+			{
+				std::ifstream		  in(slices[index].fOutput, std::ios::binary);
+				std::vector<CharType> padding(table[index].Offset - UInt64(out.tellp()), 0);
+
+				out.write(padding.data(), padding.size());
+				out << in.rdbuf();
+			}
+
+			if (!out.good() || UInt64(out.tellp()) != offset)
+			{
+				kStdOut << "ld64: can't write " << output << std::endl;
+				status = TOOLCHAINKIT_EXEC_ERROR;
+			}
+		}
+
+		for (auto& slice : slices)
+			std::filesystem::remove(slice.fOutput, err);
+
+		if (status != EXIT_SUCCESS)
+			std::filesystem::remove(output, err);
+		else if (verbose)
+			kStdOut << "ld64: wrote fat image " << output << ", " << slices.size() << " slices.\n";
+
+		return status;
+	}
+
+	/// @brief what --ld64:lto generates code with.
+	struct DynamicLinkerBackend final
+	{
+		Int32			fArch;	 // kPefArch*
+		Int32			fIRArch; // AssemblyFactory::kArch*
+		int				(*fAssembler)(int argc, char** argv);
+		const CharType* fExt; // of the assembly, the assembler names the object after it.
+		const CharType* fPrologue;
+	};
+
+	static const DynamicLinkerBackend kLTOBackends[] = {
+		{ToolchainKit::kPefArchAMD64, ToolchainKit::AssemblyFactory::kArchAMD64, AssemblerAMD64, ".masm", "#bits 64\n"},
+		{ToolchainKit::kPefArch64000, ToolchainKit::AssemblyFactory::kArch64x0, AssemblerMain64x0, ".64x", ""},
+	};
+
+	/// @brief The symbols an object defines or refers to, without the segment prefix.
+	/// @param fp right after the header of the object.
+	static Bool dynamic_linker_references(std::ifstream& fp, const ToolchainKit::AEHeader& hdr, std::vector<ToolchainKit::String>& names)
+	{
+		std::vector<ToolchainKit::AERecordHeader> records;
+		std::vector<ToolchainKit::AERelocation>	  relocations;
+
+		if (!ToolchainKit::Utils::ae_read_records(fp, hdr, records, relocations))
+			return false;
+
+		for (auto& record : records)
+		{
+			ToolchainKit::String name(record.fName, strnlen(record.fName, kAESymbolLen));
+
+			if (name.find(kLdDefineSymbol) != ToolchainKit::String::npos)
+				name = name.substr(name.find(kLdDefineSymbol) + strlen(kLdDefineSymbol));
+
+			names.emplace_back(ToolchainKit::Utils::pef_symbol_name(name.c_str()));
+		}
+
+		for (auto& relocation : relocations)
+			names.push_back(relocation.fSymbol);
+
+		return true;
+	}
+
+	/// @brief --ld64:lto: the objects carrying IR give way to code generated from their merged and
+	/// optimized IR, a partition per thread. The other objects and the libraries are linked as they are.
+	/// @param partitions the objects generated, to remove once read.
+	static Int32 dynamic_linker_lto(Bool is_executable, std::vector<ToolchainKit::String>& partitions)
+	{
+		ToolchainKit::TimeTraceScope trace_lto("LTO", kOutput);
+
+		auto backend = std::find_if(std::begin(kLTOBackends), std::end(kLTOBackends),
+									[](auto& entry) { return entry.fArch == kArch; });
+
+		if (backend == std::end(kLTOBackends))
+		{
+			kStdOut << "ld64: --ld64:lto can't generate code for this architecture." << std::endl;
+			return TOOLCHAINKIT_EXEC_ERROR;
+		}
+
+		std::vector<ToolchainKit::IRModule> modules;
+		std::vector<ToolchainKit::String>	objects; // the ones without IR, in order.
+		std::vector<ToolchainKit::String>	roots{kPefStart, kLinkerStackSizeSymbol};
+		SizeType							first_ir = SIZE_MAX;
+
+		roots.insert(roots.end(), kKeepSymbols.begin(), kKeepSymbols.end());
+
+		for (auto& obj : kObjectList)
+		{
+			std::ifstream			fp(obj, std::ifstream::binary);
+			ToolchainKit::AEHeader	hdr{};
+			std::string				ir;
+			ToolchainKit::IRModule	module;
+
+			fp >> hdr;
+
+			// not an object, ingesting it says so.
+			if (!fp.good() || hdr.fMagic[0] != kAEMag0 || hdr.fMagic[1] != kAEMag1 || hdr.fSize != sizeof(ToolchainKit::AEHeader))
+			{
+				objects.push_back(obj);
+				continue;
+			}
+
+			if (!ToolchainKit::Utils::ae_read_ir(fp, hdr, ir))
+			{
+				fp.clear();
+				fp.seekg(sizeof(ToolchainKit::AEHeader));
+
+				if (!dynamic_linker_references(fp, hdr, roots))
+				{
+					kStdOut << "ld64: error: bad records in object " << obj << std::endl;
+					return TOOLCHAINKIT_EXEC_ERROR;
+				}
+
+				objects.push_back(obj);
+				continue;
+			}
+
+			if (!ToolchainKit::ir_read(ir, module))
+			{
+				kStdOut << "ld64: error: bad IR section in object " << obj << std::endl;
+				return TOOLCHAINKIT_EXEC_ERROR;
+			}
+
+			module.fSource = obj;
+			modules.push_back(std::move(module));
+
+			first_ir = std::min(first_ir, objects.size());
+		}
+
+		if (modules.empty())
+		{
+			if (kVerbose)
+				kStdOut << "ld64: lto: no object carries IR.\n";
+
+			return EXIT_SUCCESS;
+		}
+
+		// what a library member refers to may only be defined in the IR.
+		for (auto& lib : kLibraryList)
+		{
+			ToolchainKit::LibraryReader library;
+
+			if (!library.Open(lib))
+				continue;
+
+			for (auto& member : library.Members())
+			{
+				ToolchainKit::AEHeader hdr{};
+
+				library.File().clear();
+				library.File().seekg(member.fOffset);
+				library.File() >> hdr;
+
+				if (!library.File().good() || !dynamic_linker_references(library.File(), hdr, roots))
+				{
+					kStdOut << "ld64: error: bad member " << library.Name(member.fName) << " in library " << lib << std::endl;
+					return TOOLCHAINKIT_EXEC_ERROR;
+				}
+			}
+		}
+
+		ToolchainKit::IRModule program;
+		std::string			   error;
+
+		if (!ToolchainKit::ir_merge(modules, program, error))
+		{
+			kStdOut << "ld64: lto: " << error << std::endl;
+			return TOOLCHAINKIT_EXEC_ERROR;
+		}
+
+		// a dylib exports all it defines.
+		if (!is_executable)
+		{
+			for (auto& fn : program.fFunctions)
+				roots.push_back(fn.fName);
+
+			for (auto& global : program.fGlobals)
+				roots.push_back(global.fName);
+		}
+
+		auto stats = ToolchainKit::ir_optimize(program, roots);
+
+		if (kVerbose)
+			kStdOut << "ld64: lto: " << modules.size() << " objects, inlined " << stats.fInlined << " calls, folded "
+					<< stats.fFolded << " instructions, removed " << stats.fRemoved << " functions.\n";
+
+		auto count = kLTOPartitions ? kLTOPartitions : std::max<SizeType>(std::thread::hardware_concurrency(), 1UL);
+		auto parts = ToolchainKit::ir_partition(program, count);
+
+		std::vector<Int32>				  status(parts.size(), EXIT_SUCCESS);
+		std::vector<ToolchainKit::String> errors(parts.size());
+		std::vector<std::thread>		  threads;
+
+		partitions.resize(parts.size());
+
+		// the linker state is thread_local, the backends only see this copy.
+		ToolchainKit::String output = kOutput;
+
+		for (SizeType part = 0UL; part < parts.size(); ++part)
+		{
+			threads.emplace_back([&, part]() {
+				ToolchainKit::TimeTraceScope trace("Backend", parts[part].fSource);
+
+				ToolchainKit::String assembly = output + kLinkerLTOPartition + std::to_string(part) + backend->fExt;
+				ToolchainKit::String object	  = assembly;
+
+				object.erase(object.find(backend->fExt), strlen(backend->fExt));
+				object += kObjectFileExt;
+
+				partitions[part] = object;
+
+				try
+				{
+					std::ofstream out(assembly);
+					out << backend->fPrologue << ToolchainKit::ir_selector_for(backend->fIRArch)->Select(parts[part]);
+				}
+				catch (const std::runtime_error& err)
+				{
+					errors[part] = err.what();
+					status[part] = TOOLCHAINKIT_EXEC_ERROR;
+
+					return;
+				}
+
+				ToolchainKit::String program = "as";
+				std::vector<char*>	 args{program.data(), assembly.data()};
+
+				status[part] = backend->fAssembler(args.size(), args.data());
+
+				std::filesystem::remove(assembly);
+
+				if (status[part] == EXIT_SUCCESS && !std::filesystem::exists(object))
+					status[part] = TOOLCHAINKIT_EXEC_ERROR;
+
+				if (status[part] != EXIT_SUCCESS && errors[part].empty())
+					errors[part] = "can't assemble " + assembly;
+			});
+		}
+
+		for (auto& thread : threads)
+			thread.join();
+
+		for (SizeType part = 0UL; part < parts.size(); ++part)
+		{
+			if (status[part] == EXIT_SUCCESS)
+				continue;
+
+			kStdOut << "ld64: lto: partition " << part << ": " << errors[part] << std::endl;
+
+			std::error_code err;
+
+			for (auto& object : partitions)
+				std::filesystem::remove(object, err);
+
+			return status[part];
+		}
+
+		if (kVerbose)
+			kStdOut << "ld64: lto: generated " << parts.size() << " partitions.\n";
+
+		// the generated code stands where the first object carrying IR was.
+		objects.insert(objects.begin() + first_ir, partitions.begin(), partitions.end());
+		kObjectList = std::move(objects);
+
+		return EXIT_SUCCESS;
+	}
+} // namespace Details
+
+///	@brief ZKA 64-bit Linker.
+/// @note This linker is made for PEF executable, thus ZKA based OSes.
+TOOLCHAINKIT_MODULE(DynamicLinker64PEF)
+{
+	bool is_executable = true;
+
+	// the module may run many times in one process (tkd), start clean.
+	kOutput			  = "";
+	kAbi			  = kABITypeZKA;
+	kSubArch		  = kPefNoSubCpu;
+	kArch			  = ToolchainKit::kPefArchInvalid;
+	kFatBinaryEnable  = false;
+	kStartFound		  = false;
+	kDuplicateSymbols = false;
+	kVerbose		  = false;
+	kDeterministic	  = false;
+	kImageVersion	  = kPefVersion;
+	kPageAlign		  = 0UL;
+	kGarbageCollect	  = false;
+	kFoldCode		  = kFoldNone;
+	kIncremental	  = false;
+	kMapPath		  = "";
+	kSizeReportPath	  = "";
+	kBindNow		  = false;
+	kLinkTimeOptimize = false;
+	kLTOPartitions	  = 0UL;
+
+	kObjectList.clear();
+	kObjectBytes.clear();
+	kKeepSymbols.clear();
+	kLibraryList.clear();
+	kDylibList.clear();
+
+	// the trace covers the whole link, the slices of a fat image too.
+	Details::DynamicLinkerTraceEnd trace_end;
+
+	for (SizeType linker_arg = 1; linker_arg < SizeType(argc); ++linker_arg)
+		trace_end.fActive |= ToolchainKit::TimeTrace::Option(argv[linker_arg], "--ld64:", "ld64.trace.json");
+
+	// a fat image, the slices are linked by this module again.
+	for (SizeType linker_arg = 1; linker_arg < SizeType(argc); ++linker_arg)
+	{
+		if (strstr(argv[linker_arg], "--ld64:slice=") == argv[linker_arg])
+			return Details::dynamic_linker_link_fat(argc, argv);
+	}
+
+	/**
+	 * @brief parse flags and trigger options.
+	 */
+	for (size_t linker_arg = 1;	linker_arg < argc; ++linker_arg)
+	{
+		if (StringCompare(argv[linker_arg], "--ld64:help") == 0)
+		{
+			kLinkerSplash();
+
+			kStdOut << "--ld64:ver: Show linker version.\n";
+			kStdOut << "--ld64:?: Show linker help.\n";
+			kStdOut << "--ld64:verbose: Enable linker trace.\n";
+			kStdOut << "--ld64:dylib: Output as a Dylib PEF.\n";
+			kStdOut << "--ld64:fat: Output as a FAT PEF.\n";
+			kStdOut << "--ld64:32k: Output as a 32x0 PEF.\n";
+			kStdOut << "--ld64:64k: Output as a 64x0 PEF.\n";
+			kStdOut << "--ld64:amd64: Output as a AMD64 PEF.\n";
+			kStdOut << "--ld64:rv64: Output as a RISC-V PEF.\n";
+			kStdOut << "--ld64:power64: Output as a POWER PEF.\n";
+			kStdOut << "--ld64:arm64: Output as a ARM64 PEF.\n";
+			kStdOut << "--ld64:slice=<amd64|64k|32k|power64|riscv64|arm64> <objects>: Link the objects that follow as the slice of a FAT PEF, slices link in parallel.\n";
+			kStdOut << "--ld64:output: Select the output file name.\n";
+			kStdOut << "--ld64:pef-v3: Write the v3 layout, inline names and no symbol hash (default).\n";
+			kStdOut << "--ld64:pef-v4: Write the v4 layout, a string pool and a symbol hash; dylibs, --ld64:icf, --ld64:page-align and --ld64:incremental need it.\n";
+			kStdOut << "--ld64:gc-sections: Drop the objects nothing reachable from the entrypoint refers to.\n";
+			kStdOut << "--ld64:keep <symbol>: Keep symbol and what it refers to with --ld64:gc-sections.\n";
+			kStdOut << "--ld64:icf[=safe|all]: Fold identical code records, safe keeps the ones other objects refer to (--ld64:pef-v4).\n";
+			kStdOut << "--ld64:bind-now: Bind the symbols imported from " kPefDylibExt " inputs at load, not on their first call (AMD64 stubs, --ld64:pef-v4).\n";
+			kStdOut << "--ld64:lto[=<partitions>]: Optimize the IR objects carry (--cl:lto) as one program: inline across objects, propagate constants, "
+					   "drop dead functions, then generate code in parallel partitions (AMD64, 64x0).\n";
+			kStdOut << "--ld64:incremental: Patch the changed objects in place, the state is kept in <output>" kLinkerStateExt " (--ld64:pef-v4).\n";
+			kStdOut << "--ld64:page-align[=<size>]: Page align code, data and zero segments so they can be mapped (--ld64:pef-v4).\n";
+			kStdOut << "--ld64:deterministic: Derive the GUID from the linked content, no build timestamp.\n";
+			kStdOut << "--ld64:map[=<path>]: Write each section, object and symbol with its address, size and why it is kept (<output>" kLinkerMapExt ").\n";
+			kStdOut << "--ld64:size-report[=<path>]: Write the bytes of each object and symbol as JSON (<output>" kLinkerSizeReportExt ").\n";
+			kStdOut << "--ld64:time-trace[=<path>]: Write where the time goes as a Chrome trace (ld64.trace.json).\n";
+
+			return EXIT_SUCCESS;
+		}
+		else if (Details::dynamic_linker_is_trace(argv[linker_arg]))
+		{
+			continue;
+		}
+		else if (StringCompare(argv[linker_arg], "--ld64:version") == 0)
+		{
+			kLinkerSplash();
+			return EXIT_SUCCESS;
+		}
+		else if (StringCompare(argv[linker_arg], "--ld64:fat-binary") == 0)
+		{
+			kFatBinaryEnable = true;
+
+			continue;
+		}
+		else if (StringCompare(argv[linker_arg], "--ld64:64k") == 0)
+		{
+			kArch = ToolchainKit::kPefArch64000;
+
+			continue;
+		}
+		else if (StringCompare(argv[linker_arg], "--ld64:amd64") == 0)
+		{
+			kArch = ToolchainKit::kPefArchAMD64;
+
+			continue;
+		}
+		else if (StringCompare(argv[linker_arg], "--ld64:32k") == 0)
+		{
+			kArch = ToolchainKit::kPefArch32000;
+
+			continue;
+		}
+		else if (StringCompare(argv[linker_arg], "--ld64:power64") == 0)
+		{
+			kArch = ToolchainKit::kPefArchPowerPC;
+
+			continue;
+		}
+		else if (StringCompare(argv[linker_arg], "--ld64:riscv64") == 0)
+		{
+			kArch = ToolchainKit::kPefArchRISCV;
+
+			continue;
+		}
+		else if (StringCompare(argv[linker_arg], "--ld64:arm64") == 0)
+		{
+			kArch = ToolchainKit::kPefArchARM64;
+
+			continue;
+		}
+		else if (StringCompare(argv[linker_arg], "--ld64:verbose") == 0)
+		{
+			kVerbose = true;
+
+			continue;
+		}
+		else if (StringCompare(argv[linker_arg], "--ld64:deterministic") == 0)
+		{
+			kDeterministic = true;
+
+			continue;
+		}
+		else if (StringCompare(argv[linker_arg], "--ld64:pef-v3") == 0)
+		{
+			kImageVersion = kPefVersion3;
+
+			continue;
+		}
+		else if (StringCompare(argv[linker_arg], "--ld64:pef-v4") == 0)
+		{
+			kImageVersion = kPefVersion4;
+
+			continue;
+		}
+		else if (StringCompare(argv[linker_arg], "--ld64:page-align") == 0 ||
+				 strstr(argv[linker_arg], "--ld64:page-align=") == argv[linker_arg])
+		{
+			kPageAlign = kPefPageSize;
+
+			if (argv[linker_arg][strlen("--ld64:page-align")] == '=')
+				kPageAlign = strtoul(argv[linker_arg] + strlen("--ld64:page-align="), nullptr, 0);
+
+			if (kPageAlign < 16UL || (kPageAlign & (kPageAlign - 1)) != 0)
+			{
+				kStdOut << "ld64: page size must be a power of two, 16 or more: " << argv[linker_arg] << "\n";
+				return EXIT_FAILURE;
+			}
+
+			continue;
+		}
+		else if (StringCompare(argv[linker_arg], "--ld64:gc-sections") == 0)
+		{
+			kGarbageCollect = true;
+
+			continue;
+		}
+		else if (StringCompare(argv[linker_arg], "--ld64:icf") == 0 ||
+				 StringCompare(argv[linker_arg], "--ld64:icf=safe") == 0)
+		{
+			kFoldCode = kFoldSafe;
+
+			continue;
+		}
+		else if (StringCompare(argv[linker_arg], "--ld64:icf=all") == 0)
+		{
+			kFoldCode = kFoldAll;
+
+			continue;
+		}
+		else if (StringCompare(argv[linker_arg], "--ld64:incremental") == 0)
+		{
+			kIncremental = true;
+
+			continue;
+		}
+		else if (StringCompare(argv[linker_arg], "--ld64:lto") == 0 ||
+				 strstr(argv[linker_arg], "--ld64:lto=") == argv[linker_arg])
+		{
+			kLinkTimeOptimize = true;
+
+			if (argv[linker_arg][strlen("--ld64:lto")] == '=')
+				kLTOPartitions = strtoul(argv[linker_arg] + strlen("--ld64:lto="), nullptr, 0);
+
+			continue;
+		}
+		else if (StringCompare(argv[linker_arg], "--ld64:bind-now") == 0)
+		{
+			kBindNow = true;
+
+			continue;
+		}
+		else if (StringCompare(argv[linker_arg], "--ld64:map") == 0 ||
+				 strstr(argv[linker_arg], "--ld64:map=") == argv[linker_arg])
+		{
+			// the default path is known with the output, once every flag is read.
+			kMapPath = argv[linker_arg][strlen("--ld64:map")] == '=' ? argv[linker_arg] + strlen("--ld64:map=") : kLinkerMapExt;
+
+			continue;
+		}
+		else if (StringCompare(argv[linker_arg], "--ld64:size-report") == 0 ||
+				 strstr(argv[linker_arg], "--ld64:size-report=") == argv[linker_arg])
+		{
+			kSizeReportPath = argv[linker_arg][strlen("--ld64:size-report")] == '=' ? argv[linker_arg] + strlen("--ld64:size-report=") : kLinkerSizeReportExt;
+
+			continue;
+		}
+		else if (StringCompare(argv[linker_arg], "--ld64:keep") == 0)
+		{
+			if (linker_arg + 1 >= SizeType(argc))
+			{
+				kStdOut << "ld64: --ld64:keep needs a symbol.\n";
+				return EXIT_FAILURE;
+			}
+
+			kKeepSymbols.emplace_back(argv[linker_arg + 1]);
+			++linker_arg;
+
+			continue;
+		}
+		else if (StringCompare(argv[linker_arg], "--ld64:dylib") == 0)
+		{
+			if (kOutput.empty())
+			{
+				continue;
+			}
+
+			kOutput = Details::dynamic_linker_dylib_name(kOutput);
+
+			is_executable = false;
+
+			continue;
+		}
+		else if (StringCompare(argv[linker_arg], "--ld64:output") == 0)
+		{
+			kOutput = argv[linker_arg + 1];
+			++linker_arg;
+
+			continue;
+		}
+		else
+		{
+			if (argv[linker_arg][0] == '-')
+			{
+				kStdOut << "ld64: unknown flag: " << argv[linker_arg] << "\n";
+				return EXIT_FAILURE;
+			}
+
+			ToolchainKit::String input = argv[linker_arg];
+
+			if (input.size() > strlen(kPefLibExt) &&
+				input.compare(input.size() - strlen(kPefLibExt), strlen(kPefLibExt), kPefLibExt) == 0)
+				kLibraryList.emplace_back(input);
+			else if (input.size() > strlen(kPefDylibExt) &&
+					 input.compare(input.size() - strlen(kPefDylibExt), strlen(kPefDylibExt), kPefDylibExt) == 0)
+				kDylibList.emplace_back(input);
+			else
+				kObjectList.emplace_back(input);
+
+			continue;
+		}
+	}
+
+	if (kOutput.empty())
+	{
+		kStdOut << "ld64: no output filename set." << std::endl;
+		return TOOLCHAINKIT_EXEC_ERROR;
+	}
+
+	if (kMapPath == kLinkerMapExt)
+		kMapPath = kOutput + kLinkerMapExt;
+
+	if (kSizeReportPath == kLinkerSizeReportExt)
+		kSizeReportPath = kOutput + kLinkerSizeReportExt;
+
+	// sanity check.
+	if (kObjectList.empty())
+	{
+		kStdOut << "ld64: no input files." << std::endl;
+		return TOOLCHAINKIT_EXEC_ERROR;
+	}
+	else
+	{
+		namespace fs = std::filesystem;
+
+		// check for existing files, if they don't throw an error.
+		for (auto& obj : kObjectList)
+		{
+			if (!fs::exists(obj))
+			{
+				// if filesystem doesn't find file
+				//          -> throw error.
+				kStdOut << "ld64: no such file: " << obj << std::endl;
+				return TOOLCHAINKIT_EXEC_ERROR;
+			}
+		}
+
+		for (auto& lib : kLibraryList)
+		{
+			if (!fs::exists(lib))
+			{
+				kStdOut << "ld64: no such file: " << lib << std::endl;
+				return TOOLCHAINKIT_EXEC_ERROR;
+			}
+		}
+
+		for (auto& dylib : kDylibList)
+		{
+			if (!fs::exists(dylib))
+			{
+				kStdOut << "ld64: no such file: " << dylib << std::endl;
+				return TOOLCHAINKIT_EXEC_ERROR;
+			}
+		}
+	}
+
+	// imports are named in the string pool.
+	if (!kDylibList.empty() && kImageVersion != kPefVersion4)
+	{
+		kStdOut << "ld64: linking against a dylib needs a PEF v4 image, pass --ld64:pef-v4." << std::endl;
+		return TOOLCHAINKIT_EXEC_ERROR;
+	}
+
+	// v3 has nowhere to record the segments.
+	if ((kPageAlign || kFoldCode != kFoldNone) && kImageVersion != kPefVersion4)
+	{
+		kStdOut << "ld64: --ld64:page-align and --ld64:icf need a PEF v4 image, pass --ld64:pef-v4." << std::endl;
+		return TOOLCHAINKIT_EXEC_ERROR;
+	}
+
+	// an incremental image keeps each object code whole with room to grow, padding depends on its history.
+	// a patched image would leave the map and the report behind.
+	if (kIncremental && (kImageVersion != kPefVersion4 || kPageAlign || kFoldCode != kFoldNone || kGarbageCollect || kDeterministic ||
+						 kLinkTimeOptimize || !kLibraryList.empty() || !kDylibList.empty() || !kMapPath.empty() || !kSizeReportPath.empty()))
+	{
+		kStdOut << "ld64: --ld64:incremental needs a PEF v4 image (--ld64:pef-v4) and goes with neither --ld64:page-align, "
+				   "--ld64:icf, --ld64:gc-sections, --ld64:deterministic, --ld64:lto, --ld64:map, --ld64:size-report, libraries nor dylibs."
+				<< std::endl;
+		return TOOLCHAINKIT_EXEC_ERROR;
+	}
+
+	// folding shares the bytes of records, so they are laid out one by one.
+	if (kFoldCode != kFoldNone && !kPageAlign)
+		kPageAlign = kLinkerRecordAlign;
 
 	// PEF expects a valid target architecture when outputing a binary.
 	if (kArch == 0)
 	{
-		kStdOut << "ld64: no target architecture set, can't continue." << std::endl;
+		kStdOut << "ld64: no target architecture set, can't continue." << std::endl;
+		return TOOLCHAINKIT_EXEC_ERROR;
+	}
+
+	// the objects generated by --ld64:lto, removed once ingested.
+	std::vector<ToolchainKit::String> lto_objects;
+
+	if (kLinkTimeOptimize)
+	{
+		if (auto code = Details::dynamic_linker_lto(is_executable, lto_objects))
+			return code;
+	}
+
+	ToolchainKit::PEFContainer pef_container{};
+
+	int32_t archs = kArch;
+
+	pef_container.Count	   = 0UL;
+	pef_container.Kind	   = is_executable ? ToolchainKit::kPefKindExec : ToolchainKit::kPefKindDylib;
+	pef_container.SubCpu   = kSubArch;
+	pef_container.Linker   = kLinkerId; // Amlal EL Mahrouss Linker
+	pef_container.Abi	   = kAbi;		// Multi-Processor UX ABI
+	pef_container.Magic[0] = kPefMagic[kFatBinaryEnable ? 2 : 0];
+	pef_container.Magic[1] = kPefMagic[1];
+	pef_container.Magic[2] = kPefMagic[kFatBinaryEnable ? 0 : 2];
+	pef_container.Magic[3] = kPefMagic[3];
+	pef_container.Version  = kImageVersion;
+
+	// specify the start address, can be 0x10000
+	pef_container.Start = kLinkerDefaultOrigin;
+	pef_container.HdrSz = sizeof(ToolchainKit::PEFContainer);
+
+	if (kImageVersion == kPefVersion4)
+		pef_container.HdrSz += sizeof(ToolchainKit::PEFIndex);
+
+	Details::DynamicLinkerState state;
+	ToolchainKit::String		state_path = kOutput + kLinkerStateExt;
+
+	if (kIncremental)
+	{
+		ToolchainKit::TimeTraceScope trace_relink("Relink", kOutput);
+
+		// what the layout depends on besides the objects.
+		ToolchainKit::StreamHash signature;
+
+		signature.Update(kOutput);
+		signature.Update(UInt64(kArch));
+		signature.Update(UInt64(kSubArch));
+		signature.Update(UInt64(kAbi));
+		signature.Update(UInt64(kFatBinaryEnable));
+		signature.Update(UInt64(is_executable));
+
+		for (auto& obj : kObjectList)
+			signature.Update(obj);
+
+		auto signature_hex = ToolchainKit::StreamHash::Hex(signature.Final());
+
+		if (Details::dynamic_linker_load_state(state_path, state) &&
+			Details::dynamic_linker_relink(state, signature_hex) &&
+			Details::dynamic_linker_save_state(state_path, state))
+			return EXIT_SUCCESS;
+
+		if (kVerbose)
+			kStdOut << "ld64: incremental: full link.\n";
+
+		// a failed link leaves no state behind.
+		std::filesystem::remove(state_path);
+
+		state			 = {};
+		state.fSignature = signature_hex;
+	}
+
+	std::ofstream output_fc(kOutput, std::ofstream::binary);
+
+	if (output_fc.bad())
+	{
+		if (kVerbose)
+		{
+			kStdOut << "ld64: error: " << strerror(errno) << "\n";
+		}
+
+		return TOOLCHAINKIT_FILE_NOT_FOUND;
+	}
+
+	//! Read AE to convert as PEF.
+
+	std::vector<ToolchainKit::PEFCommandHeader> command_headers;
+	std::vector<Details::DynamicLinkerSlice>	command_slices;
+	std::vector<Details::DynamicLinkerRelocation> relocations;
+	ToolchainKit::Utils::AEReadableProtocol	   reader_protocol{};
+
+	// why each object is in, for the map.
+	std::vector<ToolchainKit::String> object_reasons;
+
+	// reads the object at base in fp, a loose object or a library member ending at end.
+	auto ingest_object = [&](const ToolchainKit::String& objectFile, std::ifstream& fp, SizeType base, SizeType end) -> Int32 {
+		ToolchainKit::TimeTraceScope trace("Ingest", objectFile);
+
+		ToolchainKit::AEHeader hdr{};
+
+		fp >> hdr;
+
+		auto ae_header = hdr;
+
+		if (ae_header.fMagic[0] == kAEMag0 && ae_header.fMagic[1] == kAEMag1 &&
+			ae_header.fSize == sizeof(ToolchainKit::AEHeader))
+		{
+			if (ae_header.fArch != kArch)
+			{
+				if (kVerbose)
+					kStdOut << "ld64: info: is this a FAT binary? : ";
+
+				if (!kFatBinaryEnable)
+				{
+					if (kVerbose)
+						kStdOut << "No.\n";
+
+					kStdOut << "ld64: error: object " << objectFile
+							<< " is a different kind of architecture and output isn't "
+							   "treated as a FAT binary."
+							<< std::endl;
+
+					return TOOLCHAINKIT_FAT_ERROR;
+				}
+				else
+				{
+					if (kVerbose)
+					{
+						kStdOut << "Architecture matches what we expect.\n";
+					}
+				}
+			}
+
+			// append arch type to archs varaible.
+			archs |= ae_header.fArch;
+			std::size_t cnt = ae_header.fCount;
+
+			if (kVerbose)
+				kStdOut << "ld64: object header found, record count: " << cnt << ", version: " << Int32(ae_header.fVersion) << "\n";
+
+			pef_container.Count = cnt;
+
+			std::vector<ToolchainKit::AERecordHeader> ae_records;
+			std::vector<ToolchainKit::AERelocation>	  ae_relocations;
+
+			if (!ToolchainKit::Utils::ae_read_records(fp, ae_header, ae_records, ae_relocations))
+			{
+				kStdOut << "ld64: error: bad records in object " << objectFile << std::endl;
+				return TOOLCHAINKIT_EXEC_ERROR;
+			}
+
+			for (auto& relocation : ae_relocations)
+			{
+				if (relocation.fOffset + ToolchainKit::Utils::ae_relocation_width(relocation.fType) > ae_header.fCodeSize)
+				{
+					kStdOut << "ld64: error: relocation past the code of object " << objectFile << std::endl;
+					return TOOLCHAINKIT_EXEC_ERROR;
+				}
+
+				relocations.push_back({kObjectBytes.size(), relocation.fOffset, relocation.fAddend, relocation.fType, relocation.fSymbol});
+			}
+
+			// a record ends where the next one starts, its fSize is where it ends in the code.
+			SizeType record_begin = 0UL;
+
+			for (size_t ae_record_index = 0; ae_record_index < cnt;
+				 ++ae_record_index)
+			{
+				Details::DynamicLinkerSlice slice{kObjectBytes.size(), record_begin, record_begin};
+
+				if (ae_records[ae_record_index].fKind != kAENullType)
+				{
+					slice.fEnd	 = std::clamp<SizeType>(ae_records[ae_record_index].fSize, record_begin, ae_header.fCodeSize);
+					record_begin = slice.fEnd;
+				}
+
+				ToolchainKit::PEFCommandHeader command_header{};
+				std::size_t offset_of_obj = ae_records[ae_record_index].fOffset;
+
+				MemoryCopy(command_header.Name, ae_records[ae_record_index].fName,
+					   kPefNameLen);
+
+				ToolchainKit::String cmd_hdr_name(command_header.Name);
+
+				// check this header if it's any valid.
+				if (cmd_hdr_name.find(kPefCode64) ==
+						ToolchainKit::String::npos &&
+					cmd_hdr_name.find(kPefData64) ==
+						ToolchainKit::String::npos &&
+					cmd_hdr_name.find(kPefZero64) ==
+						ToolchainKit::String::npos)
+				{
+					if (cmd_hdr_name.find(kPefStart) ==
+							ToolchainKit::String::npos &&
+						*command_header.Name == 0)
+					{
+						if (cmd_hdr_name.find(kLdDefineSymbol) !=
+							ToolchainKit::String::npos)
+						{
+							goto ld_mark_header;
+						}
+						else
+						{
+							continue;
+						}
+					}
+				}
+
+				if (cmd_hdr_name.find(kPefStart) !=
+						ToolchainKit::String::npos &&
+					cmd_hdr_name.find(kPefCode64) !=
+						ToolchainKit::String::npos)
+				{
+					kStartFound = true;
+				}
+
+			ld_mark_header:
+				command_header.Offset = offset_of_obj;
+				command_header.Kind	  = ae_records[ae_record_index].fKind;
+				command_header.Size	  = ae_records[ae_record_index].fSize;
+				command_header.Cpu	  = ae_header.fArch;
+				command_header.SubCpu = ae_header.fSubArch;
+
+				if (kVerbose)
+				{
+					kStdOut << "ld64: Record: "
+							<< ae_records[ae_record_index].fName << " is marked.\n";
+
+					kStdOut << "ld64: Record offset: " << command_header.Offset << "\n";
+				}
+
+				command_headers.emplace_back(command_header);
+				command_slices.push_back(slice);
+			}
+
+			std::vector<char> bytes;
+			bytes.resize(ae_header.fCodeSize);
+
+			// TODO: Port this to NeFS.
+
+			// a library member stops where the next one starts.
+			SizeType code_start = base + ae_header.fStartCode;
+			SizeType code_size	= std::min<SizeType>(ae_header.fCodeSize, end > code_start ? end - code_start : 0UL);
+
+			fp.seekg(std::streamsize(code_start));
+			fp.read(bytes.data(), std::streamsize(code_size));
+
+			kObjectBytes.push_back({ .fPefBlob = bytes, .fAEOffset = ae_header.fStartCode });
+
+			return 0;
+		}
+
+		kStdOut << "ld64: Not an object container: " << objectFile << std::endl;
+		// don't continue, it is a fatal error.
 		return TOOLCHAINKIT_EXEC_ERROR;
+	};
+
+	for (const auto& objectFile : kObjectList)
+	{
+		reader_protocol.FP = std::ifstream(objectFile, std::ifstream::binary);
+
+		if (auto code = ingest_object(objectFile, reader_protocol.FP, 0UL, SIZE_MAX))
+		{
+			for (auto& object : lto_objects)
+				std::filesystem::remove(object);
+
+			return code;
+		}
+
+		Bool generated = std::find(lto_objects.begin(), lto_objects.end(), objectFile) != lto_objects.end();
+		object_reasons.emplace_back(generated ? "lto" : "input");
+
+		reader_protocol.FP.close();
+	}
+
+	for (auto& object : lto_objects)
+		std::filesystem::remove(object);
+
+	// libraries: only their tables are read, a member comes in when it defines a symbol still undefined.
+	if (!kLibraryList.empty())
+	{
+		ToolchainKit::TimeTraceScope trace_libraries("Libraries", kOutput);
+
+		std::vector<std::unique_ptr<ToolchainKit::LibraryReader>> libraries;
+		std::vector<std::vector<Bool>>							  loaded;
+
+		for (auto& lib : kLibraryList)
+		{
+			auto library = std::make_unique<ToolchainKit::LibraryReader>();
+
+			if (!library->Open(lib))
+			{
+				kStdOut << "ld64: not a library: " << lib << std::endl;
+				return TOOLCHAINKIT_EXEC_ERROR;
+			}
+
+			if (library->Header().fMemberCount && library->Header().fArch != UInt32(kArch) && !kFatBinaryEnable)
+			{
+				kStdOut << "ld64: error: library " << lib
+						<< " is a different kind of architecture and output isn't treated as a FAT binary." << std::endl;
+				return TOOLCHAINKIT_FAT_ERROR;
+			}
+
+			loaded.emplace_back(library->Members().size(), false);
+			libraries.push_back(std::move(library));
+		}
+
+		std::unordered_map<ToolchainKit::String, Bool> defined;
+		std::vector<ToolchainKit::String>			   wanted;
+		SizeType									   scanned			   = 0UL;
+		SizeType									   scanned_relocations = 0UL;
+
+		auto scan = [&]() {
+			// a relocation names what it needs, with or without an extern_segment.
+			for (; scanned_relocations < relocations.size(); ++scanned_relocations)
+				wanted.push_back(relocations[scanned_relocations].fSymbol);
+
+			for (; scanned < command_headers.size(); ++scanned)
+			{
+				ToolchainKit::String name = command_headers[scanned].Name;
+
+				if (name.find(kLdDefineSymbol) == ToolchainKit::String::npos)
+				{
+					defined[ToolchainKit::Utils::pef_symbol_name(name.c_str())] = true;
+				}
+				else if (name.find(kLdDynamicSym) == ToolchainKit::String::npos)
+				{
+					auto symbol = name.substr(name.find(kLdDefineSymbol) + strlen(kLdDefineSymbol));
+					wanted.emplace_back(ToolchainKit::Utils::pef_symbol_name(symbol.c_str()));
+				}
+			}
+		};
+
+		scan();
+
+		while (!wanted.empty())
+		{
+			auto symbol = wanted.back();
+			wanted.pop_back();
+
+			if (defined.count(symbol))
+				continue;
+
+			// the first library defining it wins.
+			for (size_t lib_index = 0UL; lib_index < libraries.size(); ++lib_index)
+			{
+				auto& library = *libraries[lib_index];
+				auto  member  = library.Find(symbol);
+
+				if (member < 0 || loaded[lib_index][member])
+					continue;
+
+				loaded[lib_index][member] = true;
+
+				auto& entry = library.Members()[member];
+				auto  name	= kLibraryList[lib_index] + "(" + library.Name(entry.fName) + ")";
+
+				if (kVerbose)
+					kStdOut << "ld64: " << symbol << " pulls in " << name << "\n";
+
+				library.File().clear();
+				library.File().seekg(std::streamsize(entry.fOffset));
+
+				if (auto code = ingest_object(name, library.File(), entry.fOffset, entry.fOffset + entry.fSize))
+					return code;
+
+				kObjectList.push_back(name);
+				object_reasons.push_back("defines " + symbol);
+
+				scan();
+				break;
+			}
+		}
 	}
 
-	ToolchainKit::PEFContainer pef_container{};
+	// dylibs: what no object nor library defines is imported if a dylib exports it. An import is a
+	// stub, defining the symbol so calls land there, and a pointer slot the stub jumps through.
+	std::vector<Details::DynamicLinkerImport> imports;
+
+	if (!kDylibList.empty())
+	{
+		ToolchainKit::TimeTraceScope trace_imports("Imports", kOutput);
+
+		std::vector<std::vector<CharType>> dylibs;
+
+		for (auto& path : kDylibList)
+		{
+			std::ifstream			   file(path, std::ios::binary);
+			std::vector<CharType>	   image{std::istreambuf_iterator<CharType>(file), std::istreambuf_iterator<CharType>()};
+			ToolchainKit::PEFContainer container{};
+
+			if (image.size() >= sizeof(ToolchainKit::PEFContainer))
+				memcpy(&container, image.data(), sizeof(ToolchainKit::PEFContainer));
+
+			// only v4 has the symbol hash to look them up.
+			if (image.size() < sizeof(ToolchainKit::PEFContainer) || memcmp(container.Magic, kPefMagic, strlen(kPefMagic)) != 0 ||
+				container.Kind != ToolchainKit::kPefKindDylib || container.Version != kPefVersion4)
+			{
+				kStdOut << "ld64: not a PEF v4 dylib, link it with --ld64:pef-v4: " << path << std::endl;
+				return TOOLCHAINKIT_EXEC_ERROR;
+			}
+
+			if (container.Cpu != UInt32(kArch))
+			{
+				kStdOut << "ld64: error: dylib " << path << " is a different kind of architecture." << std::endl;
+				return TOOLCHAINKIT_FAT_ERROR;
+			}
+
+			dylibs.push_back(std::move(image));
+		}
+
+		std::unordered_map<ToolchainKit::String, Bool> defined;
+		std::vector<ToolchainKit::String>			   undefined;
+
+		for (auto& command_hdr : command_headers)
+		{
+			ToolchainKit::String name = command_hdr.Name;
+
+			if (name.find(kLdDefineSymbol) == ToolchainKit::String::npos)
+			{
+				defined[ToolchainKit::Utils::pef_symbol_name(name.c_str())] = true;
+			}
+			else if (name.find(kLdDynamicSym) == ToolchainKit::String::npos)
+			{
+				auto symbol = name.substr(name.find(kLdDefineSymbol) + strlen(kLdDefineSymbol));
+				undefined.emplace_back(ToolchainKit::Utils::pef_symbol_name(symbol.c_str()));
+			}
+		}
+
+		for (auto& relocation : relocations)
+			undefined.push_back(relocation.fSymbol);
 
-	int32_t archs = kArch;
+		for (auto& symbol : undefined)
+		{
+			if (!defined.try_emplace(symbol, true).second)
+				continue;
 
-	pef_container.Count	   = 0UL;
-	pef_container.Kind	   = is_executable ? ToolchainKit::kPefKindExec : ToolchainKit::kPefKindDylib;
-	pef_container.SubCpu   = kSubArch;
-	pef_container.Linker   = kLinkerId; // Amlal EL Mahrouss Linker
-	pef_container.Abi	   = kAbi;		// Multi-Processor UX ABI
-	pef_container.Magic[0] = kPefMagic[kFatBinaryEnable ? 2 : 0];
-	pef_container.Magic[1] = kPefMagic[1];
-	pef_container.Magic[2] = kPefMagic[kFatBinaryEnable ? 0 : 2];
-	pef_container.Magic[3] = kPefMagic[3];
-	pef_container.Version  = kPefVersion;
+			// the first dylib exporting it wins.
+			for (size_t dylib_index = 0UL; dylib_index < dylibs.size(); ++dylib_index)
+			{
+				ToolchainKit::PEFCommandHeaderV4 command{};
 
-	// specify the start address, can be 0x10000
-	pef_container.Start = kLinkerDefaultOrigin;
-	pef_container.HdrSz = sizeof(ToolchainKit::PEFContainer);
+				if (!ToolchainKit::Utils::pef_find_symbol(dylibs[dylib_index].data(), dylibs[dylib_index].size(), symbol.c_str(), command))
+					continue;
 
-	std::ofstream output_fc(kOutput, std::ofstream::binary);
+				imports.push_back({std::filesystem::path(kDylibList[dylib_index]).filename().string(), symbol});
 
-	if (output_fc.bad())
-	{
-		if (kVerbose)
+				if (kVerbose)
+					kStdOut << "ld64: " << symbol << " is imported from " << imports.back().fDylib << "\n";
+
+				break;
+			}
+		}
+
+		if (!imports.empty() && kArch != ToolchainKit::kPefArchAMD64)
 		{
-			kStdOut << "ld64: error: " << strerror(errno) << "\n";
+			kStdOut << "ld64: error: importing from a dylib needs stubs, only AMD64 has them." << std::endl;
+			return TOOLCHAINKIT_EXEC_ERROR;
 		}
 
-		return TOOLCHAINKIT_FILE_NOT_FOUND;
-	}
+		if (!imports.empty())
+		{
+			Details::DynamicLinkerBlob stubs{{}, 0UL};
+			SizeType				   object = kObjectBytes.size();
+			auto&					   bytes  = stubs.fPefBlob;
 
-	//! Read AE to convert as PEF.
+			auto add_record = [&](const ToolchainKit::String& name, UInt16 kind, std::initializer_list<UInt8> code) {
+				ToolchainKit::PEFCommandHeader command_header{};
 
-	std::vector<ToolchainKit::PEFCommandHeader> command_headers;
-	ToolchainKit::Utils::AEReadableProtocol	   reader_protocol{};
+				MemoryCopy(command_header.Name, name.c_str(), std::min<SizeType>(name.size(), kPefNameLen - 1));
 
-	for (const auto& objectFile : kObjectList)
-	{
-		if (!std::filesystem::exists(objectFile))
-			continue;
+				command_header.Offset = command_slices.size();
+				command_header.Kind	  = kind;
+				command_header.Size	  = bytes.size() + code.size();
+				command_header.Cpu	  = kArch;
+				command_header.SubCpu = kSubArch;
 
-		ToolchainKit::AEHeader hdr{};
+				command_headers.push_back(command_header);
+				command_slices.push_back({object, bytes.size(), bytes.size() + code.size()});
 
-		reader_protocol.FP = std::ifstream(objectFile, std::ifstream::binary);
-		reader_protocol.FP >> hdr;
+				bytes.insert(bytes.end(), code.begin(), code.end());
+			};
 
-		auto ae_header = hdr;
+			auto add_relocation = [&](SizeType at, UInt16 type, Int64 addend, const ToolchainKit::String& symbol) {
+				relocations.push_back({object, at, addend, type, symbol});
+			};
 
-		if (ae_header.fMagic[0] == kAEMag0 && ae_header.fMagic[1] == kAEMag1 &&
-			ae_header.fSize == sizeof(ToolchainKit::AEHeader))
-		{
-			if (ae_header.fArch != kArch)
+			for (UInt32 import_index = 0U; import_index < imports.size(); ++import_index)
 			{
-				if (kVerbose)
-					kStdOut << "ld64: info: is this a FAT binary? : ";
+				auto& symbol = imports[import_index].fSymbol;
+				auto  at	 = bytes.size();
 
-				if (!kFatBinaryEnable)
+				// jmp [rip + slot], then the lazy entry: push the import index, jmp the binder stub.
+				if (kBindNow)
 				{
-					if (kVerbose)
-						kStdOut << "No.\n";
-
-					kStdOut << "ld64: error: object " << objectFile
-							<< " is a different kind of architecture and output isn't "
-							   "treated as a FAT binary."
-							<< std::endl;
-
-					return TOOLCHAINKIT_FAT_ERROR;
+					add_record(kPefCode64 "$" + symbol, ToolchainKit::kPefCode, {0xFF, 0x25, 0, 0, 0, 0, 0xCC, 0xCC});
 				}
 				else
 				{
-					if (kVerbose)
-					{
-						kStdOut << "Architecture matches what we expect.\n";
-					}
+					add_record(kPefCode64 "$" + symbol, ToolchainKit::kPefCode,
+							   {0xFF, 0x25, 0, 0, 0, 0,
+								0x68, UInt8(import_index), UInt8(import_index >> 8), UInt8(import_index >> 16), UInt8(import_index >> 24),
+								0xE9, 0, 0, 0, 0});
+
+					add_relocation(at + 12, ToolchainKit::kAERelocRel32, -4L, kPefBinderStub);
 				}
+
+				add_relocation(at + 2, ToolchainKit::kAERelocRel32, -4L, kLinkerImportSlot + symbol);
 			}
 
-			// append arch type to archs varaible.
-			archs |= ae_header.fArch;
-			std::size_t cnt = ae_header.fCount;
+			if (!kBindNow)
+			{
+				add_relocation(bytes.size() + 2, ToolchainKit::kAERelocRel32, -4L, kPefBinder);
+				add_record(kPefCode64 "$" kPefBinderStub, ToolchainKit::kPefCode, {0xFF, 0x25, 0, 0, 0, 0, 0xCC, 0xCC});
+			}
+
+			// a lazy slot starts at the lazy entry of its stub, right after the jmp.
+			for (auto& import : imports)
+			{
+				if (!kBindNow)
+					add_relocation(bytes.size(), ToolchainKit::kAERelocAbs64, 6L, import.fSymbol);
+
+				add_record(kPefData64 "$" kLinkerImportSlot + import.fSymbol, ToolchainKit::kPefData, {0, 0, 0, 0, 0, 0, 0, 0});
+			}
+
+			if (!kBindNow)
+				add_record(kPefData64 "$" kPefBinder, ToolchainKit::kPefData, {0, 0, 0, 0, 0, 0, 0, 0});
+
+			kObjectBytes.push_back(std::move(stubs));
+			kObjectList.push_back(kLinkerStubsObject);
+			object_reasons.push_back(std::to_string(imports.size()) + " imports from dylibs");
 
 			if (kVerbose)
-				kStdOut << "ld64: object header found, record count: " << cnt << "\n";
+				kStdOut << "ld64: " << imports.size() << " imports, " << (kBindNow ? "bound at load" : "bound lazily") << ".\n";
+		}
+	}
 
-			pef_container.Count = cnt;
+	// an object is the smallest unit: records carry no references, only the
+	// :UndefinedSymbol: records of an object say what it needs from the others.
+	if (kGarbageCollect)
+	{
+		ToolchainKit::TimeTraceScope trace_gc("GC", kOutput);
 
-			char_type* raw_ae_records =
-				new char_type[cnt * sizeof(ToolchainKit::AERecordHeader)];
+		std::unordered_map<ToolchainKit::String, std::vector<SizeType>> definitions;
+		std::vector<std::vector<ToolchainKit::String>>					references(kObjectBytes.size());
+		std::vector<Bool>												reachable(kObjectBytes.size(), false);
+		std::vector<SizeType>											worklist;
 
-			memset(raw_ae_records, 0, cnt * sizeof(ToolchainKit::AERecordHeader));
+		auto mark = [&](SizeType object, const ToolchainKit::String& reason) {
+			if (!reachable[object])
+			{
+				reachable[object]	   = true;
+				object_reasons[object] = reason;
+				worklist.push_back(object);
+			}
+		};
 
-			auto* ae_records = reader_protocol.Read(raw_ae_records, cnt);
+		for (size_t command_index = 0UL; command_index < command_headers.size(); ++command_index)
+		{
+			ToolchainKit::String name	= command_headers[command_index].Name;
+			auto				 object = command_slices[command_index].fObject;
 
-			for (size_t ae_record_index = 0; ae_record_index < cnt;
-				 ++ae_record_index)
+			if (name.find(kLdDefineSymbol) != ToolchainKit::String::npos)
 			{
-				ToolchainKit::PEFCommandHeader command_header{0};
-				std::size_t offset_of_obj = ae_records[ae_record_index].fOffset;
+				auto symbol = name.substr(name.find(kLdDefineSymbol) + strlen(kLdDefineSymbol));
+				references[object].emplace_back(ToolchainKit::Utils::pef_symbol_name(symbol.c_str()));
 
-				MemoryCopy(command_header.Name, ae_records[ae_record_index].fName,
-					   kPefNameLen);
+				continue;
+			}
 
-				ToolchainKit::String cmd_hdr_name(command_header.Name);
+			definitions[ToolchainKit::Utils::pef_symbol_name(name.c_str())].push_back(object);
 
-				// check this header if it's any valid.
-				if (cmd_hdr_name.find(kPefCode64) ==
-						ToolchainKit::String::npos &&
-					cmd_hdr_name.find(kPefData64) ==
-						ToolchainKit::String::npos &&
-					cmd_hdr_name.find(kPefZero64) ==
-						ToolchainKit::String::npos)
+			// a dylib exports everything.
+			if (!is_executable)
+				mark(object, "exported");
+			else if (name.find(kPefStart) != ToolchainKit::String::npos && name.find(kPefCode64) != ToolchainKit::String::npos)
+				mark(object, "entrypoint");
+		}
+
+		for (auto& relocation : relocations)
+			references[relocation.fObject].push_back(relocation.fSymbol);
+
+		for (auto& symbol : kKeepSymbols)
+		{
+			if (auto it = definitions.find(symbol); it != definitions.end())
+			{
+				for (auto object : it->second)
+					mark(object, "--ld64:keep " + symbol);
+			}
+			else
+			{
+				kStdOut << "ld64: warning: no symbol " << symbol << " to keep.\n";
+			}
+		}
+
+		if (worklist.empty())
+		{
+			kStdOut << "ld64: warning: nothing to start collecting from, keeping everything.\n";
+		}
+		else
+		{
+			while (!worklist.empty())
+			{
+				auto object = worklist.back();
+				worklist.pop_back();
+
+				for (auto& symbol : references[object])
 				{
-					if (cmd_hdr_name.find(kPefStart) ==
-							ToolchainKit::String::npos &&
-						*command_header.Name == 0)
+					if (auto it = definitions.find(symbol); it != definitions.end())
 					{
-						if (cmd_hdr_name.find(kLdDefineSymbol) !=
-							ToolchainKit::String::npos)
-						{
-							goto ld_mark_header;
-						}
-						else
-						{
-							continue;
-						}
+						for (auto defining : it->second)
+							mark(defining, "referenced by " + kObjectList[object] + " for " + symbol);
 					}
 				}
+			}
 
-				if (cmd_hdr_name.find(kPefStart) !=
-						ToolchainKit::String::npos &&
-					cmd_hdr_name.find(kPefCode64) !=
-						ToolchainKit::String::npos)
+			// renumber the objects left, then drop the records of the others.
+			std::vector<SizeType>				  renumber(kObjectBytes.size(), 0UL);
+			std::vector<Details::DynamicLinkerBlob> kept_bytes;
+			std::vector<ToolchainKit::String>	  kept_names;
+			std::vector<ToolchainKit::String>	  kept_reasons;
+			SizeType							  dropped_bytes = 0UL;
+
+			for (size_t object = 0UL; object < kObjectBytes.size(); ++object)
+			{
+				if (reachable[object])
 				{
-					kStartFound = true;
+					renumber[object] = kept_bytes.size();
+					kept_bytes.push_back(std::move(kObjectBytes[object]));
+					kept_names.push_back(kObjectList[object]);
+					kept_reasons.push_back(object_reasons[object]);
+
+					continue;
 				}
 
-			ld_mark_header:
-				command_header.Offset = offset_of_obj;
-				command_header.Kind	  = ae_records[ae_record_index].fKind;
-				command_header.Size	  = ae_records[ae_record_index].fSize;
-				command_header.Cpu	  = ae_header.fArch;
-				command_header.SubCpu = ae_header.fSubArch;
+				dropped_bytes += kObjectBytes[object].fPefBlob.size();
 
 				if (kVerbose)
-				{
-					kStdOut << "ld64: Record: "
-							<< ae_records[ae_record_index].fName << " is marked.\n";
+					kStdOut << "ld64: gc: dropped " << kObjectList[object] << "\n";
+			}
 
-					kStdOut << "ld64: Record offset: " << command_header.Offset << "\n";
-				}
+			std::vector<ToolchainKit::PEFCommandHeader> kept_headers;
+			std::vector<Details::DynamicLinkerSlice>	kept_slices;
 
-				command_headers.emplace_back(command_header);
-			}
+			for (size_t command_index = 0UL; command_index < command_headers.size(); ++command_index)
+			{
+				auto slice = command_slices[command_index];
 
-			delete[] raw_ae_records;
+				if (!reachable[slice.fObject])
+					continue;
 
-			std::vector<char> bytes;
-			bytes.resize(ae_header.fCodeSize);
+				slice.fObject = renumber[slice.fObject];
 
-			// TODO: Port this to NeFS.
+				kept_headers.push_back(command_headers[command_index]);
+				kept_slices.push_back(slice);
+			}
 
-			reader_protocol.FP.seekg(std::streamsize(ae_header.fStartCode));
-			reader_protocol.FP.read(bytes.data(), std::streamsize(ae_header.fCodeSize));
+			std::vector<Details::DynamicLinkerRelocation> kept_relocations;
 
-			for (auto& byte : bytes)
+			for (auto& relocation : relocations)
 			{
-				kObjectBytes.push_back({ .fPefBlob = bytes, .fAEOffset = ae_header.fStartCode });
-			}
+				if (!reachable[relocation.fObject])
+					continue;
 
-			reader_protocol.FP.close();
+				kept_relocations.push_back(relocation);
+				kept_relocations.back().fObject = renumber[relocation.fObject];
+			}
 
-			continue;
+			if (kVerbose)
+				kStdOut << "ld64: gc: kept " << kept_bytes.size() << " of " << kObjectBytes.size()
+						<< " objects, dropped " << dropped_bytes << " bytes.\n";
+
+			kObjectBytes	= std::move(kept_bytes);
+			kObjectList		= std::move(kept_names);
+			object_reasons	= std::move(kept_reasons);
+			command_headers = std::move(kept_headers);
+			command_slices	= std::move(kept_slices);
+			relocations		= std::move(kept_relocations);
 		}
-
-		kStdOut << "ld64: Not an object container: " << objectFile << std::endl;
-		// don't continue, it is a fatal error.
-		return TOOLCHAINKIT_EXEC_ERROR;
 	}
 
 	pef_container.Cpu = archs;
@@ -438,6 +2465,8 @@ TOOLCHAINKIT_MODULE(DynamicLinker64PEF)
 	std::vector<ToolchainKit::String> not_found;
 	std::vector<ToolchainKit::String> symbols;
 
+	auto trace_resolve = ToolchainKit::TimeTrace::Now();
+
 	// step 2: check for errors (multiple symbols, undefined ones)
 
 	for (auto& command_hdr : command_headers)
@@ -479,29 +2508,15 @@ TOOLCHAINKIT_MODULE(DynamicLinker64PEF)
 			symbol_imp.erase(
 				0, symbol_imp.find(kLdDefineSymbol) + strlen(kLdDefineSymbol));
 
-			// demangle everything.
-			while (symbol_imp.find('$') != ToolchainKit::String::npos)
-				symbol_imp.erase(symbol_imp.find('$'), 1);
+			// compare the names without their segment prefix, both sides are mangled alike.
+			symbol_imp = ToolchainKit::Utils::pef_symbol_name(symbol_imp.c_str());
 
-			// the reason we do is because, this may not match the symbol, and we need
-			// to look for other matching symbols.
 			for (auto& command_hdr : command_headers)
 			{
-				if (ToolchainKit::String(command_hdr.Name).find(symbol_imp) !=
+				if (ToolchainKit::String(command_hdr.Name).find(kLdDefineSymbol) ==
 						ToolchainKit::String::npos &&
-					ToolchainKit::String(command_hdr.Name).find(kLdDefineSymbol) ==
-						ToolchainKit::String::npos)
+					symbol_imp == ToolchainKit::Utils::pef_symbol_name(command_hdr.Name))
 				{
-					ToolchainKit::String undefined_symbol = command_hdr.Name;
-					auto		result_of_sym =
-						undefined_symbol.substr(undefined_symbol.find(symbol_imp));
-
-					for (int i = 0; result_of_sym[i] != 0; ++i)
-					{
-						if (result_of_sym[i] != symbol_imp[i])
-							goto ld_continue_search;
-					}
-
 					not_found.erase(it);
 
 					if (kVerbose)
@@ -510,9 +2525,6 @@ TOOLCHAINKIT_MODULE(DynamicLinker64PEF)
 					break;
 				}
 			}
-
-		ld_continue_search:
-			continue;
 		}
 	}
 
@@ -529,23 +2541,31 @@ TOOLCHAINKIT_MODULE(DynamicLinker64PEF)
 				<< " for executable: " << kOutput << "\n";
 	}
 
+	ToolchainKit::TimeTrace::Add("Resolve", kOutput, trace_resolve, ToolchainKit::TimeTrace::Now());
+
+	ToolchainKit::TimeTraceScope trace_write("Write", kOutput);
+
 	// step 4: write all PEF commands.
 
-	ToolchainKit::PEFCommandHeader date_cmd_hdr{};
+	// a timestamp would make two identical links differ.
+	if (!kDeterministic)
+	{
+		ToolchainKit::PEFCommandHeader date_cmd_hdr{};
 
-	time_t timestamp = time(nullptr);
+		time_t timestamp = time(nullptr);
 
-	ToolchainKit::String timeStampStr = "Container:BuildEpoch:";
-	timeStampStr += std::to_string(timestamp);
+		ToolchainKit::String timeStampStr = "Container:BuildEpoch:";
+		timeStampStr += std::to_string(timestamp);
 
-	strncpy(date_cmd_hdr.Name, timeStampStr.c_str(), timeStampStr.size());
+		strncpy(date_cmd_hdr.Name, timeStampStr.c_str(), timeStampStr.size());
 
-	date_cmd_hdr.Flags  = 0;
-	date_cmd_hdr.Kind	  = ToolchainKit::kPefZero;
-	date_cmd_hdr.Offset = output_fc.tellp();
-	date_cmd_hdr.Size	  = timeStampStr.size();
+		date_cmd_hdr.Flags  = 0;
+		date_cmd_hdr.Kind	  = ToolchainKit::kPefZero;
+		date_cmd_hdr.Offset = output_fc.tellp();
+		date_cmd_hdr.Size	  = timeStampStr.size();
 
-	command_headers.push_back(date_cmd_hdr);
+		command_headers.push_back(date_cmd_hdr);
+	}
 
 	ToolchainKit::PEFCommandHeader abi_cmd_hdr{};
 
@@ -572,58 +2592,291 @@ TOOLCHAINKIT_MODULE(DynamicLinker64PEF)
 	}
 	}
 
-	MemoryCopy(abi_cmd_hdr.Name, abi.c_str(), abi.size());
+	MemoryCopy(abi_cmd_hdr.Name, abi.c_str(), abi.size());
+
+	abi_cmd_hdr.Size	 = abi.size();
+	abi_cmd_hdr.Offset = output_fc.tellp();
+	abi_cmd_hdr.Flags	 = 0;
+	abi_cmd_hdr.Kind	 = ToolchainKit::kPefLinkerID;
+
+	command_headers.push_back(abi_cmd_hdr);
+
+	ToolchainKit::PEFCommandHeader stack_cmd_hdr{};
+
+	stack_cmd_hdr.Cpu	   = kArch;
+	stack_cmd_hdr.Flags  = 0;
+	stack_cmd_hdr.Size   = sizeof(uintptr_t);
+	stack_cmd_hdr.Offset = 0;
+
+	MemoryCopy(stack_cmd_hdr.Name, kLinkerStackSizeSymbol, strlen(kLinkerStackSizeSymbol));
+
+	command_headers.push_back(stack_cmd_hdr);
+
+	// an import command per symbol taken from a dylib, at its pointer slot once the layout is done.
+	std::unordered_map<SizeType, SizeType> import_slots; // command index to the slot record.
+
+	for (auto& import : imports)
+	{
+		ToolchainKit::String slot = kPefData64 "$" kLinkerImportSlot + import.fSymbol;
+
+		auto record = std::find_if(command_headers.begin(), command_headers.begin() + command_slices.size(), [&slot](auto& command_hdr) {
+			return slot == command_hdr.Name;
+		});
+
+		// the stubs are gone with --ld64:gc-sections, nothing calls them.
+		if (record == command_headers.begin() + command_slices.size())
+			continue;
+
+		ToolchainKit::PEFCommandHeader import_cmd_hdr{};
+		ToolchainKit::String		   name = import.fDylib + kLdDynamicSym + import.fSymbol;
+
+		MemoryCopy(import_cmd_hdr.Name, name.c_str(), std::min<SizeType>(name.size(), kPefNameLen - 1));
+
+		import_cmd_hdr.Cpu	 = kArch;
+		import_cmd_hdr.Flags = kBindNow ? 0 : ToolchainKit::kPefBindLazy;
+		import_cmd_hdr.Kind	 = ToolchainKit::kPefData;
+		import_cmd_hdr.Size	 = sizeof(UInt64);
+
+		import_slots[command_headers.size()] = record - command_headers.begin();
+		command_headers.push_back(import_cmd_hdr);
+	}
+
+	ToolchainKit::PEFCommandHeader uuid_cmd_hdr{};
+
+	ToolchainKit::String uuidStr;
+	ToolchainKit::String uuidPrefix;
+
+	if (kDeterministic)
+	{
+		// the nil GUID until the image is written, then the hash of the image with it.
+		uuidStr	   = uuids::to_string(uuids::uuid{});
+		uuidPrefix = "Container:GUID:5:";
+	}
+	else
+	{
+		// 128 bits of entropy are enough for a random GUID, no need to fill the whole mt19937 state.
+		std::random_device rd;
+
+		std::seed_seq seq{rd(), rd(), rd(), rd()};
+		std::mt19937  generator(seq);
+
+		auto		gen = uuids::uuid_random_generator{generator};
+		uuids::uuid id	= gen();
+
+		uuidStr	   = uuids::to_string(id);
+		uuidPrefix = "Container:GUID:4:";
+	}
+
+	MemoryCopy(uuid_cmd_hdr.Name, uuidPrefix.c_str(), uuidPrefix.size());
+	MemoryCopy(uuid_cmd_hdr.Name + uuidPrefix.size(), uuidStr.c_str(),
+		   uuidStr.size());
+
+	uuid_cmd_hdr.Size	  = strlen(uuid_cmd_hdr.Name);
+	uuid_cmd_hdr.Offset = output_fc.tellp();
+	uuid_cmd_hdr.Flags  = ToolchainKit::kPefLinkerID;
+	uuid_cmd_hdr.Kind	  = ToolchainKit::kPefZero;
+
+	SizeType uuid_index = command_headers.size();
+
+	command_headers.push_back(uuid_cmd_hdr);
+
+	// prepare a symbol vector.
+	std::vector<ToolchainKit::String> undef_symbols;
+	std::vector<ToolchainKit::String> dupl_symbols;
+	std::vector<ToolchainKit::String> resolve_symbols;
+
+	constexpr Int32 cPaddingOffset = 16;
+
+	// v4 offsets are relative here, the table size is known once the pool and the hash are built.
+	size_t previous_offset = kImageVersion == kPefVersion3 ? (command_headers.size() * sizeof(ToolchainKit::PEFCommandHeader)) + cPaddingOffset : 0UL;
+
+	std::vector<ToolchainKit::PEFCommandHeader> written_headers;
+	std::vector<SizeType>						written_indices; // in command_headers.
+	Bool										start_found = false;
+
+	auto page_up = [](SizeType at) {
+		return (at + kPageAlign - 1) & ~(kPageAlign - 1);
+	};
+
+	// page aligned: the code, then the data, each on its own pages, then .zero64 with no file bytes.
+	// offsets are from the first segment here, the headers go before it.
+	std::vector<CharType>				  code_segment;
+	std::vector<CharType>				  data_segment;
+	std::vector<ToolchainKit::PEFSegment> segments;
+	std::vector<SizeType>				  slice_offsets(command_slices.size(), 0UL);
+	std::vector<Int64>					  slice_folded(command_slices.size(), -1L); // the record it shares with.
+
+	if (kPageAlign)
+	{
+		SizeType zero_size = 0UL;
+
+		// identical code records share one copy. The bytes of an object with undefined symbols may
+		// hold references no relocation describes, so it is never folded. The relocations of a
+		// record are part of its key, the same bytes pointing at other symbols aren't the same code.
+		std::unordered_map<std::string, SizeType> folded_code; // the first record of these bytes.
+		std::vector<Bool>						  has_undefined(kObjectBytes.size(), false);
+		std::vector<std::vector<SizeType>>		  object_relocations(kObjectBytes.size());
+		std::unordered_map<std::string, Bool>	  referenced;
+		SizeType								  folded_count = 0UL;
+		SizeType								  folded_bytes = 0UL;
+
+		if (kFoldCode != kFoldNone)
+		{
+			for (size_t slice_index = 0UL; slice_index < command_slices.size(); ++slice_index)
+			{
+				ToolchainKit::String name = command_headers[slice_index].Name;
+
+				if (name.find(kLdDefineSymbol) == ToolchainKit::String::npos)
+					continue;
+
+				has_undefined[command_slices[slice_index].fObject] = true;
+
+				auto symbol = name.substr(name.find(kLdDefineSymbol) + strlen(kLdDefineSymbol));
+				referenced[ToolchainKit::Utils::pef_symbol_name(symbol.c_str())] = true;
+			}
+
+			for (auto& symbol : kKeepSymbols)
+				referenced[symbol] = true;
+
+			for (size_t relocation_index = 0UL; relocation_index < relocations.size(); ++relocation_index)
+			{
+				auto& relocation = relocations[relocation_index];
+
+				object_relocations[relocation.fObject].push_back(relocation_index);
+
+				// a pointer in a table or a rip relative lea takes the address, only a direct branch doesn't.
+				if (!Details::dynamic_linker_is_branch(kObjectBytes[relocation.fObject].fPefBlob, relocation))
+					referenced[relocation.fSymbol] = true;
+			}
+		}
+
+		for (size_t slice_index = 0UL; slice_index < command_slices.size(); ++slice_index)
+		{
+			auto& slice = command_slices[slice_index];
+			auto& blob	= kObjectBytes[slice.fObject].fPefBlob;
+
+			switch (command_headers[slice_index].Kind)
+			{
+			case kAENullType:
+				break;
+			case ToolchainKit::kPefData:
+				slice_offsets[slice_index] = data_segment.size();
+				data_segment.insert(data_segment.end(), blob.begin() + slice.fBegin, blob.begin() + slice.fEnd);
+				break;
+			case ToolchainKit::kPefZero:
+				slice_offsets[slice_index] = zero_size;
+				zero_size += slice.fEnd - slice.fBegin;
+				break;
+			default: {
+				Bool foldable = kFoldCode != kFoldNone && slice.fEnd > slice.fBegin && !has_undefined[slice.fObject];
+
+				// the entrypoint, a dylib's exports and what other objects name may have their address compared.
+				if (foldable && kFoldCode == kFoldSafe)
+				{
+					ToolchainKit::String name = command_headers[slice_index].Name;
+
+					foldable = is_executable && name.find(kPefStart) == ToolchainKit::String::npos &&
+							   !referenced.count(ToolchainKit::Utils::pef_symbol_name(name.c_str()));
+				}
 
-	abi_cmd_hdr.Size	 = abi.size();
-	abi_cmd_hdr.Offset = output_fc.tellp();
-	abi_cmd_hdr.Flags	 = 0;
-	abi_cmd_hdr.Kind	 = ToolchainKit::kPefLinkerID;
+				std::string bytes(blob.begin() + slice.fBegin, blob.begin() + slice.fEnd);
+				std::string key = bytes;
 
-	command_headers.push_back(abi_cmd_hdr);
+				for (auto relocation_index : object_relocations[slice.fObject])
+				{
+					auto& relocation = relocations[relocation_index];
 
-	ToolchainKit::PEFCommandHeader stack_cmd_hdr{0};
+					if (relocation.fOffset < slice.fBegin || relocation.fOffset >= slice.fEnd)
+						continue;
 
-	stack_cmd_hdr.Cpu	   = kArch;
-	stack_cmd_hdr.Flags  = 0;
-	stack_cmd_hdr.Size   = sizeof(uintptr_t);
-	stack_cmd_hdr.Offset = 0;
+					key += '\0' + std::to_string(relocation.fOffset - slice.fBegin) + ":" + std::to_string(relocation.fType) + ":" +
+						   std::to_string(relocation.fAddend) + ":" + relocation.fSymbol;
+				}
 
-	MemoryCopy(stack_cmd_hdr.Name, kLinkerStackSizeSymbol, strlen(kLinkerStackSizeSymbol));
+				if (foldable)
+				{
+					if (auto it = folded_code.find(key); it != folded_code.end())
+					{
+						slice_offsets[slice_index] = slice_offsets[it->second];
+						slice_folded[slice_index]  = it->second;
 
-	command_headers.push_back(stack_cmd_hdr);
+						++folded_count;
+						folded_bytes += bytes.size();
 
-	ToolchainKit::PEFCommandHeader uuid_cmd_hdr{};
+						if (kVerbose)
+							kStdOut << "ld64: icf: folded " << command_headers[slice_index].Name << "\n";
 
-	std::random_device rd;
+						break;
+					}
+				}
 
-	auto seedData = std::array<int, std::mt19937::state_size>{};
-	std::generate(std::begin(seedData), std::end(seedData), std::ref(rd));
-	std::seed_seq seq(std::begin(seedData), std::end(seedData));
-	std::mt19937  generator(seq);
+				slice_offsets[slice_index] = code_segment.size();
 
-	auto		gen		= uuids::uuid_random_generator{generator};
-	uuids::uuid id		= gen();
-	auto		uuidStr = uuids::to_string(id);
+				if (kFoldCode != kFoldNone && slice.fEnd > slice.fBegin && !has_undefined[slice.fObject])
+					folded_code.try_emplace(key, slice_index);
 
-	MemoryCopy(uuid_cmd_hdr.Name, "Container:GUID:4:", strlen("Container:GUID:4:"));
-	MemoryCopy(uuid_cmd_hdr.Name + strlen("Container:GUID:4:"), uuidStr.c_str(),
-		   uuidStr.size());
+				code_segment.insert(code_segment.end(), bytes.begin(), bytes.end());
+				break;
+			}
+			}
+		}
 
-	uuid_cmd_hdr.Size	  = strlen(uuid_cmd_hdr.Name);
-	uuid_cmd_hdr.Offset = output_fc.tellp();
-	uuid_cmd_hdr.Flags  = ToolchainKit::kPefLinkerID;
-	uuid_cmd_hdr.Kind	  = ToolchainKit::kPefZero;
+		if (kVerbose && kFoldCode != kFoldNone)
+			kStdOut << "ld64: icf: folded " << folded_count << " records, saved " << folded_bytes << " bytes.\n";
 
-	command_headers.push_back(uuid_cmd_hdr);
+		SizeType data_base = page_up(code_segment.size());
+		SizeType zero_base = page_up(data_base + data_segment.size());
 
-	// prepare a symbol vector.
-	std::vector<ToolchainKit::String> undef_symbols;
-	std::vector<ToolchainKit::String> dupl_symbols;
-	std::vector<ToolchainKit::String> resolve_symbols;
+		for (size_t slice_index = 0UL; slice_index < command_slices.size(); ++slice_index)
+		{
+			if (command_headers[slice_index].Kind == ToolchainKit::kPefData)
+				slice_offsets[slice_index] += data_base;
+			else if (command_headers[slice_index].Kind == ToolchainKit::kPefZero)
+				slice_offsets[slice_index] += zero_base;
+		}
 
-	constexpr Int32 cPaddingOffset = 16;
+		if (!code_segment.empty())
+			segments.push_back({ToolchainKit::kPefCode, ToolchainKit::kPefProtRead | ToolchainKit::kPefProtExec,
+								0UL, code_segment.size(), 0UL, code_segment.size()});
+
+		if (!data_segment.empty())
+			segments.push_back({ToolchainKit::kPefData, ToolchainKit::kPefProtRead | ToolchainKit::kPefProtWrite,
+								data_base, data_segment.size(), data_base, data_segment.size()});
+
+		if (zero_size)
+			segments.push_back({ToolchainKit::kPefZero, ToolchainKit::kPefProtRead | ToolchainKit::kPefProtWrite,
+								0UL, 0UL, zero_base, zero_size});
+	}
+
+	// incremental: each object code whole, in its reserved room, in order.
+	std::vector<UInt64> object_offsets(kObjectBytes.size(), 0UL);
+
+	if (kIncremental)
+	{
+		UInt64 object_offset = 0UL;
+
+		for (size_t object_index = 0UL; object_index < kObjectBytes.size(); ++object_index)
+		{
+			object_offsets[object_index] = object_offset;
+			object_offset += Details::dynamic_linker_reserve(kObjectBytes[object_index].fPefBlob.size());
+		}
+
+		for (size_t slice_index = 0UL; slice_index < command_slices.size(); ++slice_index)
+			slice_offsets[slice_index] = object_offsets[command_slices[slice_index].fObject] + command_slices[slice_index].fBegin;
+	}
+
+	// where each object code starts from the first byte after the headers when they are kept whole.
+	std::vector<UInt64> object_starts(kObjectBytes.size(), 0UL);
 
-	size_t previous_offset = (command_headers.size() * sizeof(ToolchainKit::PEFCommandHeader)) + cPaddingOffset;
+	if (kIncremental)
+	{
+		object_starts = object_offsets;
+	}
+	else
+	{
+		for (size_t object_index = 1UL; object_index < kObjectBytes.size(); ++object_index)
+			object_starts[object_index] = object_starts[object_index - 1] + kObjectBytes[object_index - 1].fPefBlob.size();
+	}
 
 	// Finally write down the command headers.
 	// And check for any duplications
@@ -646,8 +2899,30 @@ TOOLCHAINKIT_MODULE(DynamicLinker64PEF)
 			undef_symbols.emplace_back(symbol_name);
 		}
 
-		command_headers[commandHeaderIndex].Offset += previous_offset;
-		previous_offset += command_headers[commandHeaderIndex].Size;
+		if (auto slot = import_slots.find(commandHeaderIndex); slot != import_slots.end())
+		{
+			auto& record = command_slices[slot->second];
+
+			command_headers[commandHeaderIndex].Offset = kPageAlign ? slice_offsets[slot->second] : object_starts[record.fObject] + record.fBegin;
+		}
+		else if (kPageAlign || kIncremental)
+		{
+			// the containers past the records have no bytes in the image, the name is the content.
+			if (commandHeaderIndex < command_slices.size())
+			{
+				command_headers[commandHeaderIndex].Offset = slice_offsets[commandHeaderIndex];
+				command_headers[commandHeaderIndex].Size   = command_slices[commandHeaderIndex].fEnd - command_slices[commandHeaderIndex].fBegin;
+			}
+			else
+			{
+				command_headers[commandHeaderIndex].Offset = 0UL;
+			}
+		}
+		else
+		{
+			command_headers[commandHeaderIndex].Offset += previous_offset;
+			previous_offset += command_headers[commandHeaderIndex].Size;
+		}
 
 		ToolchainKit::String name = command_headers[commandHeaderIndex].Name;
 
@@ -658,12 +2933,7 @@ TOOLCHAINKIT_MODULE(DynamicLinker64PEF)
 			name.find(kPefCode64) != ToolchainKit::String::npos)
 		{
 			pef_container.Start = command_headers[commandHeaderIndex].Offset;
-			auto tellCurPos		= output_fc.tellp();
-
-			output_fc.seekp(0);
-			output_fc << pef_container;
-
-			output_fc.seekp(tellCurPos);
+			start_found			= true;
 		}
 
 		if (kVerbose)
@@ -672,7 +2942,8 @@ TOOLCHAINKIT_MODULE(DynamicLinker64PEF)
 			kStdOut << "ld64: Real address of command header content: " << command_headers[commandHeaderIndex].Offset << "\n";
 		}
 
-		output_fc << command_headers[commandHeaderIndex];
+		written_headers.push_back(command_headers[commandHeaderIndex]);
+		written_indices.push_back(commandHeaderIndex);
 
 		for (size_t sub_command_header_index = 0UL;
 			 sub_command_header_index < command_headers.size();
@@ -725,11 +2996,362 @@ TOOLCHAINKIT_MODULE(DynamicLinker64PEF)
 		return TOOLCHAINKIT_EXEC_ERROR;
 	}
 
+	// where the commands and the object code landed, for the incremental state.
+	std::unordered_map<ToolchainKit::String, SizeType> command_table;
+	SizeType										   image_data_start = 0UL;
+	SizeType										   guid_at			= 0UL; // the GUID in the file.
+
+	if (kImageVersion == kPefVersion3)
+	{
+		for (size_t written_index = 0UL; written_index < written_headers.size(); ++written_index)
+		{
+			if (written_indices[written_index] == uuid_index)
+				guid_at = SizeType(output_fc.tellp()) + uuidPrefix.size();
+
+			output_fc << written_headers[written_index];
+		}
+	}
+	else
+	{
+		// names go in a pool, the containers first and then the symbols, which only are hashed.
+		std::vector<ToolchainKit::PEFCommandHeaderV4> commands;
+		std::unordered_map<std::string, UInt32>		  string_offsets;
+		std::string									  strings;
+		SizeType									  symbol_base = 0UL;
+
+		for (auto pass = 0; pass < 2; ++pass)
+		{
+			for (auto& command_hdr : written_headers)
+			{
+				ToolchainKit::String name = command_hdr.Name;
+
+				Bool is_symbol = name.find("Container:") != 0 &&
+								 name.find(kLdDynamicSym) == ToolchainKit::String::npos;
+
+				if (is_symbol != (pass == 1))
+					continue;
+
+				auto [it, inserted] = string_offsets.try_emplace(name, strings.size());
+
+				if (inserted)
+				{
+					strings += name;
+					strings.push_back(0);
+				}
+
+				ToolchainKit::PEFCommandHeaderV4 command{};
+
+				command.Name   = it->second;
+				command.Cpu	   = command_hdr.Cpu;
+				command.SubCpu = command_hdr.SubCpu;
+				command.Flags  = command_hdr.Flags;
+				command.Kind   = command_hdr.Kind;
+				command.Offset = command_hdr.Offset;
+				command.Size   = command_hdr.Size;
+
+				commands.push_back(command);
+			}
+
+			if (pass == 0)
+				symbol_base = commands.size();
+		}
+
+		auto symbol_hash = ToolchainKit::Utils::pef_build_symbol_hash(commands, symbol_base, strings);
+
+		for (size_t command_index = 0UL; command_index < commands.size(); ++command_index)
+			command_table[strings.c_str() + commands[command_index].Name] = command_index;
+
+		ToolchainKit::PEFIndex pef_index{};
+
+		pef_index.StringsOffset = pef_container.HdrSz + commands.size() * sizeof(ToolchainKit::PEFCommandHeaderV4);
+		pef_index.StringsSize	= strings.size();
+		pef_index.HashOffset	= (pef_index.StringsOffset + pef_index.StringsSize + 7UL) & ~7UL;
+		pef_index.HashSize		= symbol_hash.size();
+
+		SizeType headers_end = pef_index.HashOffset + pef_index.HashSize;
+
+		if (kPageAlign)
+		{
+			pef_index.SegmentsOffset = (headers_end + 7UL) & ~7UL;
+			pef_index.SegmentCount	 = segments.size();
+			pef_index.Align			 = kPageAlign;
+
+			headers_end = pef_index.SegmentsOffset + segments.size() * sizeof(ToolchainKit::PEFSegment);
+		}
+
+		SizeType data_start = kPageAlign ? page_up(headers_end) : (headers_end + cPaddingOffset - 1) & ~SizeType(cPaddingOffset - 1);
+
+		for (auto& command : commands)
+			command.Offset += data_start;
+
+		image_data_start = data_start;
+
+		for (auto& segment : segments)
+		{
+			if (segment.FileSize)
+				segment.FileOffset += data_start;
+
+			segment.VirtualOffset += data_start;
+
+			if (kVerbose)
+				kStdOut << "ld64: segment kind " << segment.Kind << ", file " << segment.FileOffset << "+" << segment.FileSize
+						<< ", memory " << segment.VirtualOffset << "+" << segment.VirtualSize << "\n";
+		}
+
+		if (start_found)
+			pef_container.Start += data_start;
+
+		pef_container.Count = commands.size();
+
+		guid_at = pef_index.StringsOffset + string_offsets[command_headers[uuid_index].Name] + uuidPrefix.size();
+
+		output_fc.seekp(sizeof(ToolchainKit::PEFContainer));
+		output_fc.write(reinterpret_cast<const CharType*>(&pef_index), sizeof(ToolchainKit::PEFIndex));
+		output_fc.write(reinterpret_cast<const CharType*>(commands.data()), commands.size() * sizeof(ToolchainKit::PEFCommandHeaderV4));
+		output_fc.write(strings.data(), strings.size());
+
+		output_fc.seekp(pef_index.HashOffset);
+		output_fc.write(symbol_hash.data(), symbol_hash.size());
+
+		if (kPageAlign)
+		{
+			output_fc.seekp(pef_index.SegmentsOffset);
+			output_fc.write(reinterpret_cast<const CharType*>(segments.data()), segments.size() * sizeof(ToolchainKit::PEFSegment));
+		}
+
+		std::vector<CharType> padding(data_start - headers_end, 0);
+		output_fc.write(padding.data(), padding.size());
+
+		if (kVerbose)
+			kStdOut << "ld64: PEF v4, " << commands.size() << " commands, " << strings.size()
+					<< " bytes of names, " << (commands.size() - symbol_base) << " hashed symbols.\n";
+	}
+
+	// Start and Count are known now.
+	{
+		auto tellCurPos = output_fc.tellp();
+
+		output_fc.seekp(0);
+		output_fc << pef_container;
+
+		output_fc.seekp(tellCurPos);
+	}
+
+	UInt64 image_bytes_start = output_fc.tellp();
+
+	// relocate: resolve every field first, then patch the sections one relocation type at a time.
+	if (!relocations.empty())
+	{
+		ToolchainKit::TimeTraceScope trace_relocate("Relocate", kOutput);
+
+		// the image is loaded at its origin, addresses are offsets from the first byte of the file.
+		auto slice_address = [&](SizeType slice_index) -> UInt64 {
+			if (kPageAlign)
+				return image_bytes_start + slice_offsets[slice_index];
+
+			return image_bytes_start + object_starts[command_slices[slice_index].fObject] + command_slices[slice_index].fBegin;
+		};
+
+		std::unordered_map<ToolchainKit::String, SizeType> definitions;
+
+		for (size_t slice_index = 0UL; slice_index < command_slices.size(); ++slice_index)
+		{
+			ToolchainKit::String name = command_headers[slice_index].Name;
+
+			if (command_headers[slice_index].Kind != kAENullType && name.find(kLdDefineSymbol) == ToolchainKit::String::npos)
+				definitions.try_emplace(ToolchainKit::Utils::pef_symbol_name(name.c_str()), slice_index);
+		}
+
+		std::vector<Details::DynamicLinkerFixup> fixups;
+		Bool									 failed = false;
+
+		fixups.reserve(relocations.size());
+
+		for (auto& relocation : relocations)
+		{
+			auto it = definitions.find(relocation.fSymbol);
+
+			if (it == definitions.end())
+			{
+				kStdOut << "ld64: undefined symbol " << relocation.fSymbol << ", referenced by " << kObjectList[relocation.fObject] << "\n";
+				failed = true;
+
+				continue;
+			}
+
+			CharType* site	= nullptr;
+			UInt64	  place = 0UL;
+
+			if (kPageAlign)
+			{
+				// the record holding the field, records of an object are in order.
+				auto slice = std::upper_bound(command_slices.begin(), command_slices.end(), relocation, [](auto& relocation, auto& slice) {
+					return relocation.fObject < slice.fObject || (relocation.fObject == slice.fObject && relocation.fOffset < slice.fBegin);
+				});
+
+				if (slice == command_slices.begin() || (slice - 1)->fObject != relocation.fObject || (slice - 1)->fEnd <= relocation.fOffset)
+				{
+					kStdOut << "ld64: error: relocation for " << relocation.fSymbol << " is outside the records of " << kObjectList[relocation.fObject] << "\n";
+					failed = true;
+
+					continue;
+				}
+
+				SizeType slice_index = slice - command_slices.begin() - 1;
+				auto	 at			 = slice_offsets[slice_index] + relocation.fOffset - command_slices[slice_index].fBegin;
+
+				// a folded record has the fields of the record it shares with, patched there.
+				if (slice_folded[slice_index] >= 0)
+					continue;
+
+				if (command_headers[slice_index].Kind == ToolchainKit::kPefData)
+				{
+					site = data_segment.data() + at - page_up(code_segment.size());
+				}
+				else if (command_headers[slice_index].Kind == ToolchainKit::kPefZero)
+				{
+					kStdOut << "ld64: error: relocation for " << relocation.fSymbol << " in the .zero64 record " << command_headers[slice_index].Name << "\n";
+					failed = true;
+
+					continue;
+				}
+				else
+				{
+					site = code_segment.data() + at;
+				}
+
+				place = image_bytes_start + at;
+			}
+			else
+			{
+				site  = kObjectBytes[relocation.fObject].fPefBlob.data() + relocation.fOffset;
+				place = image_bytes_start + object_starts[relocation.fObject] + relocation.fOffset;
+			}
+
+			Int64 target = Int64(kLinkerDefaultOrigin + slice_address(it->second)) + relocation.fAddend;
+			Int64 value	 = 0L;
+
+			if (!Details::dynamic_linker_field(relocation.fType, target, place, value))
+			{
+				kStdOut << "ld64: error: " << relocation.fSymbol << " is out of reach of its relocation (type "
+						<< relocation.fType << ") in " << kObjectList[relocation.fObject] << "\n";
+				failed = true;
+
+				continue;
+			}
+
+			fixups.push_back({site, value, relocation.fType});
+		}
+
+		if (failed)
+			return TOOLCHAINKIT_EXEC_ERROR;
+
+		// a run of one type is a loop of plain stores.
+		std::stable_sort(fixups.begin(), fixups.end(), [](auto& lhs, auto& rhs) {
+			return lhs.fType < rhs.fType;
+		});
+
+		for (auto run = fixups.begin(); run != fixups.end();)
+		{
+			auto end = std::find_if(run, fixups.end(), [type = run->fType](auto& fixup) { return fixup.fType != type; });
+
+			switch (run->fType)
+			{
+			case ToolchainKit::kAERelocAbs64:
+				for (auto fixup = run; fixup != end; ++fixup)
+				{
+					UInt64 field = fixup->fValue;
+					memcpy(fixup->fSite, &field, sizeof(UInt64));
+				}
+				break;
+			case ToolchainKit::kAERelocAbs32:
+			case ToolchainKit::kAERelocRel32:
+				for (auto fixup = run; fixup != end; ++fixup)
+				{
+					UInt32 field = UInt32(fixup->fValue);
+					memcpy(fixup->fSite, &field, sizeof(UInt32));
+				}
+				break;
+			case ToolchainKit::kAERelocPowerBranch24:
+			case ToolchainKit::kAERelocPowerBranch24Abs:
+				for (auto fixup = run; fixup != end; ++fixup)
+				{
+					UInt32 word;
+					memcpy(&word, fixup->fSite, sizeof(UInt32));
+
+					word = (word & ~0x03FFFFFCU) | (UInt32(fixup->fValue) & 0x03FFFFFCU);
+					memcpy(fixup->fSite, &word, sizeof(UInt32));
+				}
+				break;
+			}
+
+			run = end;
+		}
+
+		if (kVerbose)
+			kStdOut << "ld64: relocated " << fixups.size() << " fields.\n";
+	}
+
 	// step 2.5: write program bytes.
 
-	for (auto& struct_of_blob : kObjectBytes)
+	if (kPageAlign)
+	{
+		output_fc.write(code_segment.data(), code_segment.size());
+
+		if (!data_segment.empty())
+		{
+			std::vector<CharType> padding(page_up(code_segment.size()) - code_segment.size(), 0);
+
+			output_fc.write(padding.data(), padding.size());
+			output_fc.write(data_segment.data(), data_segment.size());
+		}
+	}
+	else if (kIncremental)
+	{
+		for (auto& struct_of_blob : kObjectBytes)
+		{
+			std::vector<CharType> padding(Details::dynamic_linker_reserve(struct_of_blob.fPefBlob.size()) - struct_of_blob.fPefBlob.size(), 0);
+
+			output_fc.write(struct_of_blob.fPefBlob.data(), struct_of_blob.fPefBlob.size());
+			output_fc.write(padding.data(), padding.size());
+		}
+	}
+	else
+	{
+		for (auto& struct_of_blob : kObjectBytes)
+		{
+			output_fc.write(struct_of_blob.fPefBlob.data(), struct_of_blob.fPefBlob.size());
+		}
+	}
+
+	UInt64 image_size = output_fc.tellp();
+
+	// a deterministic GUID is the hash of the whole image, written with the nil GUID, so that
+	// the layout, the relocated fields and the format all tell two images apart.
+	if (kDeterministic)
 	{
-		output_fc.write(struct_of_blob.fPefBlob.data(), struct_of_blob.fPefBlob.size());
+		output_fc.flush();
+
+		std::ifstream		  file(kOutput, std::ifstream::binary);
+		std::vector<CharType> image{std::istreambuf_iterator<CharType>(file), std::istreambuf_iterator<CharType>()};
+
+		ToolchainKit::StreamHash content_hash;
+		content_hash.Update(image.data(), image.size());
+
+		auto digest = ToolchainKit::StreamHash::Hex(content_hash.Final());
+
+		uuids::uuid_name_generator gen{uuids::uuid_namespace_oid};
+
+		uuidStr = uuids::to_string(gen(digest));
+
+		output_fc.seekp(guid_at);
+		output_fc.write(uuidStr.c_str(), uuidStr.size());
+		output_fc.seekp(image_size);
+
+		MemoryCopy(command_headers[uuid_index].Name + uuidPrefix.size(), uuidStr.c_str(), uuidStr.size());
+
+		if (kVerbose)
+			kStdOut << "ld64: content hash: " << digest << "\n";
 	}
 
 	if (kVerbose)
@@ -767,6 +3389,86 @@ TOOLCHAINKIT_MODULE(DynamicLinker64PEF)
 		return TOOLCHAINKIT_EXEC_ERROR;
 	}
 
+	if (!kMapPath.empty() || !kSizeReportPath.empty())
+	{
+		Details::DynamicLinkerReport report{kOutput, kImageVersion, UInt32(archs), image_size, image_bytes_start, segments, {}, {}};
+
+		for (size_t object_index = 0UL; object_index < kObjectBytes.size(); ++object_index)
+			report.fObjects.push_back({kObjectList[object_index], object_reasons[object_index], 0UL});
+
+		// the records of undefined symbols own bytes too, the code following them in the source.
+		for (size_t slice_index = 0UL; slice_index < command_slices.size(); ++slice_index)
+		{
+			if (slice_folded[slice_index] < 0)
+				report.fObjects[command_slices[slice_index].fObject].fSize += command_slices[slice_index].fEnd - command_slices[slice_index].fBegin;
+		}
+
+		for (auto command_index : written_indices)
+		{
+			auto& command_hdr = command_headers[command_index];
+
+			Details::DynamicLinkerMapEntry entry{command_hdr.Name, command_hdr.Kind, command_hdr.Offset + image_data_start, command_hdr.Size, -1L, ""};
+
+			if (command_index < command_slices.size())
+			{
+				auto& slice = command_slices[command_index];
+
+				entry.fObject = slice.fObject;
+				entry.fSize	  = slice.fEnd - slice.fBegin;
+
+				if (!kPageAlign && !kIncremental)
+					entry.fOffset = image_bytes_start + object_starts[slice.fObject] + slice.fBegin;
+
+				if (slice_folded[command_index] >= 0)
+					entry.fFolded = command_headers[slice_folded[command_index]].Name;
+			}
+
+			report.fEntries.push_back(entry);
+		}
+
+		if (!kMapPath.empty() && !Details::dynamic_linker_write_map(kMapPath, report))
+			kStdOut << "ld64: warning: can't write " << kMapPath << "\n";
+
+		if (!kSizeReportPath.empty() && !Details::dynamic_linker_write_size_report(kSizeReportPath, report))
+			kStdOut << "ld64: warning: can't write " << kSizeReportPath << "\n";
+	}
+
+	if (kIncremental)
+	{
+		output_fc.close();
+
+		for (size_t object_index = 0UL; object_index < kObjectBytes.size(); ++object_index)
+		{
+			Details::DynamicLinkerStateObject object{};
+
+			object.fPath	= kObjectList[object_index];
+			object.fSize	= std::filesystem::file_size(object.fPath);
+			object.fTime	= Details::dynamic_linker_time(object.fPath);
+			object.fHash	= Details::dynamic_linker_hash(object.fPath);
+			object.fOffset	= image_data_start + object_offsets[object_index];
+			object.fReserve = Details::dynamic_linker_reserve(kObjectBytes[object_index].fPefBlob.size());
+
+			state.fObjects.push_back(object);
+		}
+
+		state.fRelocations = relocations;
+
+		for (size_t slice_index = 0UL; slice_index < command_slices.size(); ++slice_index)
+		{
+			ToolchainKit::String name = command_headers[slice_index].Name;
+			auto				 it	  = command_table.find(name);
+
+			state.fObjects[command_slices[slice_index].fObject].fRecords.push_back(
+				{command_headers[slice_index].Kind, it == command_table.end() ? -1L : Int64(it->second), name});
+		}
+
+		state.fOutputSize = std::filesystem::file_size(kOutput);
+		state.fOutputTime = Details::dynamic_linker_time(kOutput);
+
+		if (!Details::dynamic_linker_save_state(state_path, state))
+			kStdOut << "ld64: warning: can't write " << state_path << ", the next link is a full one.\n";
+	}
+
 	return EXIT_SUCCESS;
 }
 
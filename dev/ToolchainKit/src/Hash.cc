@@ -0,0 +1,163 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+/// @file Hash.cc
+/// @brief Fast streaming content hash.
+
+#include <ToolchainKit/Hash.h>
+
+namespace Details
+{
+	static constexpr UInt64 kHashPrime1 = 0x9E3779B185EBCA87ULL;
+	static constexpr UInt64 kHashPrime2 = 0xC2B2AE3D27D4EB4FULL;
+	static constexpr UInt64 kHashPrime3 = 0x165667B19E3779F9ULL;
+
+	static inline UInt64 hash_rotate(UInt64 value, Int32 bits)
+	{
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	static inline UInt64 hash_word(const UInt8* bytes)
+	{
+		UInt64 word = 0UL;
+
+		for (Int32 index = 7; index >= 0; --index)
+			word = (word << 8) | bytes[index];
+
+		return word;
+	}
+
+	static inline UInt64 hash_round(UInt64 lane, UInt64 word)
+	{
+		lane += word * kHashPrime2;
+		lane = hash_rotate(lane, 31);
+
+		return lane * kHashPrime1;
+	}
+
+	static inline UInt64 hash_avalanche(UInt64 value)
+	{
+		value ^= value >> 33;
+		value *= kHashPrime2;
+		value ^= value >> 29;
+		value *= kHashPrime3;
+		value ^= value >> 32;
+
+		return value;
+	}
+} // namespace Details
+
+namespace ToolchainKit
+{
+	StreamHash::StreamHash(UInt64 seed)
+	{
+		fLanes[0] = seed + Details::kHashPrime1;
+		fLanes[1] = seed ^ Details::kHashPrime2;
+	}
+
+	void StreamHash::Update(const void* data, SizeType size)
+	{
+		auto bytes = static_cast<const UInt8*>(data);
+
+		fLength += size;
+
+		// finish the word left over by the last update.
+		while (fTailSize > 0 && size > 0)
+		{
+			fTail[fTailSize++] = *bytes++;
+			--size;
+
+			if (fTailSize == sizeof(fTail))
+			{
+				fLanes[0] = Details::hash_round(fLanes[0], Details::hash_word(fTail));
+				fTailSize = 0UL;
+
+				std::swap(fLanes[0], fLanes[1]);
+			}
+		}
+
+		// two words at a time, one per lane.
+		for (; size >= 16; size -= 16, bytes += 16)
+		{
+			fLanes[0] = Details::hash_round(fLanes[0], Details::hash_word(bytes));
+			fLanes[1] = Details::hash_round(fLanes[1], Details::hash_word(bytes + 8));
+		}
+
+		for (; size >= 8; size -= 8, bytes += 8)
+		{
+			fLanes[0] = Details::hash_round(fLanes[0], Details::hash_word(bytes));
+			std::swap(fLanes[0], fLanes[1]);
+		}
+
+		while (size > 0)
+		{
+			fTail[fTailSize++] = *bytes++;
+			--size;
+		}
+	}
+
+	void StreamHash::Update(const std::string& text)
+	{
+		this->Update(UInt64(text.size()));
+		this->Update(text.data(), text.size());
+	}
+
+	void StreamHash::Update(UInt64 value)
+	{
+		UInt8 bytes[8];
+
+		for (auto& byte : bytes)
+		{
+			byte = value & 0xFF;
+			value >>= 8;
+		}
+
+		this->Update(bytes, sizeof(bytes));
+	}
+
+	HashDigest StreamHash::Final() const
+	{
+		UInt64 lanes[2] = {fLanes[0], fLanes[1]};
+
+		UInt8 tail[8] = {0};
+		memcpy(tail, fTail, fTailSize);
+
+		lanes[0] = Details::hash_round(lanes[0], Details::hash_word(tail) ^ fTailSize);
+		lanes[1] = Details::hash_round(lanes[1], fLength);
+
+		// let each lane see the other before the final mix.
+		lanes[0] += lanes[1];
+		lanes[1] += lanes[0];
+
+		lanes[0] = Details::hash_avalanche(lanes[0]);
+		lanes[1] = Details::hash_avalanche(lanes[1] ^ Details::hash_rotate(lanes[0], 17));
+
+		HashDigest digest;
+
+		for (SizeType index = 0UL; index < 8; ++index)
+		{
+			digest[index]	  = (lanes[0] >> (index * 8)) & 0xFF;
+			digest[index + 8] = (lanes[1] >> (index * 8)) & 0xFF;
+		}
+
+		return digest;
+	}
+
+	std::string StreamHash::Hex(const HashDigest& digest)
+	{
+		static const char* kHex = "0123456789abcdef";
+
+		std::string text;
+
+		for (auto byte : digest)
+		{
+			text += kHex[byte >> 4];
+			text += kHex[byte & 0xF];
+		}
+
+		return text;
+	}
+} // namespace ToolchainKit
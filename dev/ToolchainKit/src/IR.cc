@@ -0,0 +1,602 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+/// @file IR.cc
+/// @brief IR utilities: register allocation, printing, serialization and the compile entry point.
+
+#include <ToolchainKit/IR.h>
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace Details
+{
+	struct IRInterval final
+	{
+		Int64 fTemp{0};
+		Int64 fStart{-1};
+		Int64 fEnd{-1};
+	};
+
+	static void ir_touch(std::vector<IRInterval>& intervals, const ToolchainKit::IROperand& op, Int64 pos)
+	{
+		if (op.fKind != ToolchainKit::IROperand::kTemp)
+			return;
+
+		auto& interval = intervals[op.fValue];
+
+		if (interval.fStart < 0)
+			interval.fStart = pos;
+
+		interval.fEnd = std::max(interval.fEnd, pos);
+	}
+
+	static const CharType* kIRNames[ToolchainKit::kIROpcodeCount] = {
+		"const", "copy", "param", "add", "sub", "mul", "div", "mod", "and", "or",
+		"xor", "shl", "shr", "eq", "ne", "lt", "le", "gt", "ge", "neg", "not",
+		"load", "store", "call", "ret", "jump", "jz", "jnz", "label"};
+
+	static std::string ir_operand(const ToolchainKit::IROperand& op)
+	{
+		switch (op.fKind)
+		{
+		case ToolchainKit::IROperand::kTemp:
+			return "%" + std::to_string(op.fValue);
+		case ToolchainKit::IROperand::kImm:
+			return std::to_string(op.fValue);
+		case ToolchainKit::IROperand::kSym:
+			return "@" + op.fSymbol;
+		default:
+			return "";
+		}
+	}
+
+	/// @brief magic and version of ir_write, a blob of another version is not read.
+	static const CharType kIRBlobMagic[]  = "TKIR";
+	static const UInt64	  kIRBlobVersion = 1UL;
+
+	static void ir_put(std::string& out, UInt64 value)
+	{
+		do
+		{
+			UInt8 byte = value & 0x7F;
+			value >>= 7;
+
+			if (value)
+				byte |= 0x80;
+
+			out.push_back(static_cast<CharType>(byte));
+		} while (value);
+	}
+
+	static void ir_put_signed(std::string& out, Int64 value)
+	{
+		ir_put(out, (UInt64(value) << 1) ^ UInt64(value >> 63));
+	}
+
+	static void ir_put_string(std::string& out, const std::string& str)
+	{
+		ir_put(out, str.size());
+		out += str;
+	}
+
+	static void ir_put_operand(std::string& out, const ToolchainKit::IROperand& op)
+	{
+		ir_put(out, op.fKind);
+
+		if (op.fKind == ToolchainKit::IROperand::kSym)
+			ir_put_string(out, op.fSymbol);
+		else if (op.fKind != ToolchainKit::IROperand::kNone)
+			ir_put_signed(out, op.fValue);
+	}
+
+	/// @brief reads a blob, every read fails once one did.
+	struct IRBlobReader final
+	{
+		const std::string& fBlob;
+		SizeType		   fAt{0UL};
+		Bool			   fGood{true};
+
+		UInt64 Get()
+		{
+			UInt64 value = 0UL;
+
+			for (Int32 shift = 0; fGood && shift < 64; shift += 7)
+			{
+				if (fAt >= fBlob.size())
+					break;
+
+				UInt8 byte = fBlob[fAt++];
+				value |= UInt64(byte & 0x7F) << shift;
+
+				if (!(byte & 0x80))
+					return value;
+			}
+
+			fGood = false;
+			return 0UL;
+		}
+
+		Int64 GetSigned()
+		{
+			auto value = this->Get();
+			return Int64(value >> 1) ^ -Int64(value & 1);
+		}
+
+		std::string GetString()
+		{
+			auto size = this->Get();
+
+			if (!fGood || size > fBlob.size() - fAt)
+			{
+				fGood = false;
+				return "";
+			}
+
+			fAt += size;
+			return fBlob.substr(fAt - size, size);
+		}
+
+		/// @brief a count of items of at least one byte each, no more than what is left.
+		SizeType GetCount()
+		{
+			auto count = this->Get();
+
+			if (count > fBlob.size() - fAt)
+				fGood = false;
+
+			return fGood ? count : 0UL;
+		}
+
+		ToolchainKit::IROperand GetOperand()
+		{
+			ToolchainKit::IROperand op;
+
+			switch (this->Get())
+			{
+			case ToolchainKit::IROperand::kNone:
+				break;
+			case ToolchainKit::IROperand::kTemp:
+				op = ToolchainKit::IROperand::Temp(this->GetSigned());
+				break;
+			case ToolchainKit::IROperand::kImm:
+				op = ToolchainKit::IROperand::Imm(this->GetSigned());
+				break;
+			case ToolchainKit::IROperand::kSym:
+				op = ToolchainKit::IROperand::Sym(this->GetString());
+				break;
+			default:
+				fGood = false;
+				break;
+			}
+
+			return op;
+		}
+	};
+
+	/// @brief bytes a kIRDirective line carries.
+	static const SizeType kIRDirectiveBytes = 48UL;
+} // namespace Details
+
+namespace ToolchainKit
+{
+	std::vector<IRLocation> ir_allocate(const IRFunction& fn, SizeType pool, SizeType& slots)
+	{
+		std::vector<Details::IRInterval> intervals(fn.fTemps);
+		std::vector<Int64>				 labels(fn.fLabels, -1);
+		std::vector<Int64>				 calls;
+
+		for (Int64 temp = 0; temp < fn.fTemps; ++temp)
+			intervals[temp].fTemp = temp;
+
+		for (Int64 pos = 0; pos < (Int64)fn.fCode.size(); ++pos)
+		{
+			auto& instr = fn.fCode[pos];
+
+			Details::ir_touch(intervals, instr.fDst, pos);
+			Details::ir_touch(intervals, instr.fLhs, pos);
+			Details::ir_touch(intervals, instr.fRhs, pos);
+
+			for (auto& arg : instr.fArgs)
+				Details::ir_touch(intervals, arg, pos);
+
+			if (instr.fOp == kIRLabel)
+				labels[instr.fLabel] = pos;
+
+			if (instr.fOp == kIRCall)
+				calls.push_back(pos);
+		}
+
+		// a value live at the head of a loop stays live until its back edge.
+		Bool changed = true;
+
+		while (changed)
+		{
+			changed = false;
+
+			for (Int64 pos = 0; pos < (Int64)fn.fCode.size(); ++pos)
+			{
+				auto& instr = fn.fCode[pos];
+
+				if (instr.fOp != kIRJump && instr.fOp != kIRJumpIfZero && instr.fOp != kIRJumpNotZero)
+					continue;
+
+				auto head = labels[instr.fLabel];
+
+				if (head < 0 || head > pos)
+					continue;
+
+				for (auto& interval : intervals)
+				{
+					if (interval.fStart < 0 || interval.fEnd < head || interval.fStart > pos)
+						continue;
+
+					if (interval.fStart > head || interval.fEnd < pos)
+					{
+						interval.fStart = std::min(interval.fStart, head);
+						interval.fEnd	= std::max(interval.fEnd, pos);
+
+						changed = true;
+					}
+				}
+			}
+		}
+
+		std::vector<IRLocation> locations(fn.fTemps);
+
+		slots = 0UL;
+
+		std::vector<Details::IRInterval> order;
+
+		for (auto& interval : intervals)
+		{
+			if (interval.fStart < 0)
+				continue;
+
+			Bool across_call = std::any_of(calls.begin(), calls.end(), [&](Int64 call) {
+				return interval.fStart < call && interval.fEnd > call;
+			});
+
+			if (across_call)
+			{
+				locations[interval.fTemp].fSlot = slots++;
+				continue;
+			}
+
+			order.push_back(interval);
+		}
+
+		std::sort(order.begin(), order.end(), [](const Details::IRInterval& lhs, const Details::IRInterval& rhs) {
+			return lhs.fStart < rhs.fStart;
+		});
+
+		std::vector<Details::IRInterval> active;
+		std::vector<Bool>				 used(pool, false);
+
+		for (auto& interval : order)
+		{
+			// expire what ended before us.
+			for (auto it = active.begin(); it != active.end();)
+			{
+				if (it->fEnd < interval.fStart)
+				{
+					used[locations[it->fTemp].fReg] = false;
+					it								= active.erase(it);
+
+					continue;
+				}
+
+				++it;
+			}
+
+			auto free_reg = std::find(used.begin(), used.end(), false);
+
+			if (free_reg != used.end())
+			{
+				*free_reg						= true;
+				locations[interval.fTemp].fReg = free_reg - used.begin();
+
+				active.push_back(interval);
+				continue;
+			}
+
+			// spill whoever lives the longest.
+			auto longest = std::max_element(active.begin(), active.end(), [](const Details::IRInterval& lhs, const Details::IRInterval& rhs) {
+				return lhs.fEnd < rhs.fEnd;
+			});
+
+			if (longest != active.end() && longest->fEnd > interval.fEnd)
+			{
+				locations[interval.fTemp].fReg = locations[longest->fTemp].fReg;
+				locations[longest->fTemp].fReg = -1;
+				locations[longest->fTemp].fSlot = slots++;
+
+				*longest = interval;
+			}
+			else
+			{
+				locations[interval.fTemp].fSlot = slots++;
+			}
+		}
+
+		return locations;
+	}
+
+	std::string ir_dump(const IRModule& module)
+	{
+		std::stringstream out;
+
+		for (auto& global : module.fGlobals)
+		{
+			out << "global @" << global.fName << " = " << global.fValue << "\n";
+		}
+
+		for (auto& fn : module.fFunctions)
+		{
+			out << (fn.fExtern ? "declare @" : "define @") << fn.fName << "(" << fn.fParams << ")\n";
+
+			for (auto& instr : fn.fCode)
+			{
+				if (instr.fOp == kIRLabel)
+				{
+					out << "L" << instr.fLabel << ":\n";
+					continue;
+				}
+
+				out << "\t";
+
+				if (instr.fDst.fKind != IROperand::kNone)
+					out << Details::ir_operand(instr.fDst) << " = ";
+
+				out << Details::kIRNames[instr.fOp];
+
+				if (instr.fLhs.fKind != IROperand::kNone)
+					out << " " << Details::ir_operand(instr.fLhs);
+
+				if (instr.fRhs.fKind != IROperand::kNone)
+					out << ", " << Details::ir_operand(instr.fRhs);
+
+				for (auto& arg : instr.fArgs)
+					out << ", " << Details::ir_operand(arg);
+
+				if (instr.fLabel >= 0)
+					out << " L" << instr.fLabel;
+
+				out << "\n";
+			}
+		}
+
+		return out.str();
+	}
+
+	Bool ir_compile(const std::string& source, Int32 arch, std::string& assembly, std::string& error)
+	{
+		std::string ir;
+		return ir_compile(source, arch, assembly, ir, error);
+	}
+
+	Bool ir_compile(const std::string& source, Int32 arch, std::string& assembly, std::string& ir, std::string& error,
+					SizeType vector_size)
+	{
+		IRModule module;
+
+		if (!IRFrontendC().Parse(source, module, error))
+			return false;
+
+		ir = ir_write(module);
+
+		auto selector = ir_selector_for(arch);
+
+		if (!selector)
+		{
+			error = "no instruction selector for this target.";
+			return false;
+		}
+
+		selector->SetVectorSize(vector_size);
+
+		try
+		{
+			assembly = selector->Select(module);
+		}
+		catch (const std::runtime_error& err)
+		{
+			error = err.what();
+			return false;
+		}
+
+		return true;
+	}
+
+	std::string ir_write(const IRModule& module)
+	{
+		std::string out(Details::kIRBlobMagic);
+
+		Details::ir_put(out, Details::kIRBlobVersion);
+		Details::ir_put_string(out, module.fSource);
+
+		Details::ir_put(out, module.fGlobals.size());
+
+		for (auto& global : module.fGlobals)
+		{
+			Details::ir_put_string(out, global.fName);
+			Details::ir_put_signed(out, global.fValue);
+		}
+
+		Details::ir_put(out, module.fFunctions.size());
+
+		for (auto& fn : module.fFunctions)
+		{
+			Details::ir_put_string(out, fn.fName);
+			Details::ir_put(out, fn.fParams);
+			Details::ir_put(out, fn.fTemps);
+			Details::ir_put(out, fn.fLabels);
+			Details::ir_put(out, fn.fExtern);
+			Details::ir_put(out, fn.fCode.size());
+
+			for (auto& instr : fn.fCode)
+			{
+				Details::ir_put(out, instr.fOp);
+				Details::ir_put_operand(out, instr.fDst);
+				Details::ir_put_operand(out, instr.fLhs);
+				Details::ir_put_operand(out, instr.fRhs);
+				Details::ir_put_signed(out, instr.fLabel);
+				Details::ir_put(out, instr.fArgs.size());
+
+				for (auto& arg : instr.fArgs)
+					Details::ir_put_operand(out, arg);
+			}
+		}
+
+		return out;
+	}
+
+	Bool ir_read(const std::string& blob, IRModule& module)
+	{
+		auto magic_len = strlen(Details::kIRBlobMagic);
+
+		if (blob.compare(0, magic_len, Details::kIRBlobMagic) != 0)
+			return false;
+
+		Details::IRBlobReader reader{blob, magic_len};
+
+		if (reader.Get() != Details::kIRBlobVersion)
+			return false;
+
+		module		   = {};
+		module.fSource = reader.GetString();
+
+		module.fGlobals.resize(reader.GetCount());
+
+		for (auto& global : module.fGlobals)
+		{
+			global.fName  = reader.GetString();
+			global.fValue = reader.GetSigned();
+		}
+
+		module.fFunctions.resize(reader.GetCount());
+
+		for (auto& fn : module.fFunctions)
+		{
+			fn.fName   = reader.GetString();
+			fn.fParams = reader.Get();
+			fn.fTemps  = reader.Get();
+			fn.fLabels = reader.Get();
+			fn.fExtern = reader.Get() != 0;
+
+			fn.fCode.resize(reader.GetCount());
+
+			for (auto& instr : fn.fCode)
+			{
+				auto op = reader.Get();
+
+				if (op >= kIROpcodeCount)
+					return false;
+
+				instr.fOp	 = static_cast<IROpcode>(op);
+				instr.fDst	 = reader.GetOperand();
+				instr.fLhs	 = reader.GetOperand();
+				instr.fRhs	 = reader.GetOperand();
+				instr.fLabel = reader.GetSigned();
+
+				instr.fArgs.resize(reader.GetCount());
+
+				for (auto& arg : instr.fArgs)
+					arg = reader.GetOperand();
+
+				// the allocator and the selectors index by temp and label.
+				for (auto* operand : {&instr.fDst, &instr.fLhs, &instr.fRhs})
+				{
+					if (operand->fKind == IROperand::kTemp && (operand->fValue < 0 || operand->fValue >= fn.fTemps))
+						return false;
+				}
+
+				for (auto& arg : instr.fArgs)
+				{
+					if (arg.fKind == IROperand::kTemp && (arg.fValue < 0 || arg.fValue >= fn.fTemps))
+						return false;
+				}
+
+				if (instr.fLabel >= fn.fLabels)
+					return false;
+
+				if (!reader.fGood)
+					return false;
+			}
+		}
+
+		return reader.fGood && reader.fAt == blob.size();
+	}
+
+	std::string ir_directives(const std::string& blob)
+	{
+		static const CharType* cHex = "0123456789abcdef";
+
+		std::string out;
+
+		for (SizeType at = 0UL; at < blob.size(); at += Details::kIRDirectiveBytes)
+		{
+			out += kIRDirective " ";
+
+			for (SizeType index = at; index < std::min(blob.size(), at + Details::kIRDirectiveBytes); ++index)
+			{
+				out.push_back(cHex[UInt8(blob[index]) >> 4]);
+				out.push_back(cHex[UInt8(blob[index]) & 0xF]);
+			}
+
+			out += "\n";
+		}
+
+		return out;
+	}
+
+	Bool ir_read_directive(const std::string& line, std::string& blob)
+	{
+		auto at = line.find_first_not_of(" \t");
+
+		if (at == std::string::npos || line.compare(at, strlen(kIRDirective), kIRDirective) != 0)
+			return false;
+
+		at = line.find_first_not_of(" \t", at + strlen(kIRDirective));
+
+		if (at == std::string::npos)
+			return false;
+
+		auto end = line.find_first_of(" \t\r", at);
+
+		if (end == std::string::npos)
+			end = line.size();
+
+		if ((end - at) % 2 != 0)
+			return false;
+
+		auto nibble = [](CharType ch) -> Int32 {
+			if (ch >= '0' && ch <= '9')
+				return ch - '0';
+
+			if (ch >= 'a' && ch <= 'f')
+				return ch - 'a' + 10;
+
+			if (ch >= 'A' && ch <= 'F')
+				return ch - 'A' + 10;
+
+			return -1;
+		};
+
+		for (; at < end; at += 2)
+		{
+			auto high = nibble(line[at]);
+			auto low  = nibble(line[at + 1]);
+
+			if (high < 0 || low < 0)
+				return false;
+
+			blob.push_back(static_cast<CharType>((high << 4) | low));
+		}
+
+		return true;
+	}
+} // namespace ToolchainKit
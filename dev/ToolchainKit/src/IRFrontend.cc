@@ -0,0 +1,1123 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+/// @file IRFrontend.cc
+/// @brief C front end of the IR, a recursive descent parser over the
+/// preprocessed source.
+
+#include <ToolchainKit/IR.h>
+#include <ToolchainKit/ConstantFolder.h>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace Details
+{
+	struct IRToken final
+	{
+		enum
+		{
+			kIdent,
+			kNumber,
+			kString,
+			kPunct,
+			kEnd,
+		} fKind;
+
+		std::string fText;
+		Int64		fValue{0};
+		SizeType	fLine{0};
+	};
+
+	static std::vector<IRToken> ir_lex(const std::string& source)
+	{
+		static const std::vector<std::string> cPuncts = {
+			"<<=", ">>=", "<<", ">>", "<=", ">=", "==", "!=", "&&", "||", "++", "--",
+			"+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=", "->"};
+
+		std::vector<IRToken> tokens;
+		SizeType			 line = 1;
+
+		for (SizeType i = 0; i < source.size();)
+		{
+			auto ch = source[i];
+
+			if (ch == '\n')
+			{
+				++line;
+				++i;
+
+				continue;
+			}
+
+			if (isspace(ch))
+			{
+				++i;
+				continue;
+			}
+
+			// preprocessor leftovers and comments.
+			if (ch == '#' || source.compare(i, 2, "//") == 0)
+			{
+				while (i < source.size() && source[i] != '\n')
+					++i;
+
+				continue;
+			}
+
+			if (source.compare(i, 2, "/*") == 0)
+			{
+				auto end = source.find("*/", i + 2);
+				end		 = (end == std::string::npos) ? source.size() : end + 2;
+
+				line += std::count(source.begin() + i, source.begin() + end, '\n');
+				i = end;
+
+				continue;
+			}
+
+			IRToken tok;
+			tok.fLine = line;
+
+			if (isalpha(ch) || ch == '_')
+			{
+				auto start = i;
+
+				while (i < source.size() && (isalnum(source[i]) || source[i] == '_'))
+					++i;
+
+				tok.fKind = IRToken::kIdent;
+				tok.fText = source.substr(start, i - start);
+			}
+			else if (isdigit(ch))
+			{
+				auto start = i;
+
+				while (i < source.size() && isalnum(source[i]))
+					++i;
+
+				tok.fKind = IRToken::kNumber;
+				tok.fText = source.substr(start, i - start);
+
+				std::string digits = tok.fText;
+
+				while (!digits.empty() && strchr("uUlL", digits.back()))
+					digits.pop_back();
+
+				char* end	= nullptr;
+				tok.fValue = (Int64)strtoull(digits.c_str(), &end, 0);
+
+				if (*end != 0)
+					throw std::runtime_error("line " + std::to_string(line) + ": invalid number " + tok.fText);
+			}
+			else if (ch == '\'')
+			{
+				SizeType end = i + 1;
+
+				if (end < source.size() && source[end] == '\\')
+				{
+					static const std::unordered_map<char, char> cEscapes = {
+						{'n', '\n'}, {'t', '\t'}, {'r', '\r'}, {'0', '\0'}, {'\\', '\\'}, {'\'', '\''}};
+
+					auto it = cEscapes.find(source[end + 1]);
+
+					if (it == cEscapes.end())
+						throw std::runtime_error("line " + std::to_string(line) + ": unknown escape sequence");
+
+					tok.fValue = it->second;
+					end += 2;
+				}
+				else
+				{
+					tok.fValue = source[end++];
+				}
+
+				if (end >= source.size() || source[end] != '\'')
+					throw std::runtime_error("line " + std::to_string(line) + ": unterminated character");
+
+				tok.fKind = IRToken::kNumber;
+				tok.fText = source.substr(i, end + 1 - i);
+
+				i = end + 1;
+			}
+			else if (ch == '"')
+			{
+				auto start = i++;
+
+				while (i < source.size() && source[i] != '"')
+				{
+					if (source[i] == '\\')
+						++i;
+
+					++i;
+				}
+
+				++i;
+
+				tok.fKind = IRToken::kString;
+				tok.fText = source.substr(start, i - start);
+			}
+			else
+			{
+				tok.fKind = IRToken::kPunct;
+				tok.fText = std::string(1, ch);
+
+				for (auto& punct : cPuncts)
+				{
+					if (source.compare(i, punct.size(), punct) == 0)
+					{
+						tok.fText = punct;
+						break;
+					}
+				}
+
+				i += tok.fText.size();
+			}
+
+			tokens.push_back(tok);
+		}
+
+		IRToken end;
+		end.fKind = IRToken::kEnd;
+		end.fLine = line;
+
+		tokens.push_back(end);
+
+		return tokens;
+	}
+
+	/// @brief recursive descent parser, emits IR as it goes.
+	class IRParser final
+	{
+	public:
+		explicit IRParser(std::vector<IRToken> tokens, ToolchainKit::IRModule& module)
+			: fTokens(std::move(tokens)), fModule(module)
+		{
+		}
+
+		void Unit()
+		{
+			while (this->Peek().fKind != IRToken::kEnd)
+			{
+				this->TopLevel();
+			}
+		}
+
+	private:
+		using IROperand = ToolchainKit::IROperand;
+
+		[[noreturn]] void Fail(const std::string& reason)
+		{
+			throw std::runtime_error("line " + std::to_string(this->Peek().fLine) + ": " + reason);
+		}
+
+		const IRToken& Peek(SizeType ahead = 0)
+		{
+			return fTokens[std::min(fPos + ahead, fTokens.size() - 1)];
+		}
+
+		Bool Is(const char* text, SizeType ahead = 0)
+		{
+			auto& tok = this->Peek(ahead);
+			return tok.fKind != IRToken::kEnd && tok.fKind != IRToken::kString && tok.fText == text;
+		}
+
+		Bool Accept(const char* text)
+		{
+			if (!this->Is(text))
+				return false;
+
+			++fPos;
+			return true;
+		}
+
+		void Expect(const char* text)
+		{
+			if (!this->Accept(text))
+				this->Fail(std::string("expected '") + text + "' before '" + this->Peek().fText + "'");
+		}
+
+		std::string Ident()
+		{
+			if (this->Peek().fKind != IRToken::kIdent)
+				this->Fail("expected an identifier before '" + this->Peek().fText + "'");
+
+			return fTokens[fPos++].fText;
+		}
+
+		Bool IsTypeStart(SizeType ahead = 0)
+		{
+			static const std::vector<std::string> cTypeWords = {
+				"void", "char", "short", "int", "long", "unsigned", "signed", "const",
+				"static", "extern", "volatile", "register", "_Bool", "bool", "inline"};
+
+			auto& tok = this->Peek(ahead);
+
+			if (tok.fKind != IRToken::kIdent)
+				return false;
+
+			if (tok.fText == "struct" || tok.fText == "union" || tok.fText == "enum" || tok.fText == "typedef")
+				this->Fail(tok.fText + " is not supported by the IR pipeline yet");
+
+			return std::find(cTypeWords.begin(), cTypeWords.end(), tok.fText) != cTypeWords.end();
+		}
+
+		/// @brief every scalar is 64-bit wide in the IR, types only need to be skipped.
+		void Type()
+		{
+			if (!this->IsTypeStart())
+				this->Fail("expected a type before '" + this->Peek().fText + "'");
+
+			while (this->IsTypeStart())
+				++fPos;
+
+			while (this->Accept("*"))
+			{
+				this->Accept("const");
+			}
+		}
+
+		/////////////////////////////////////////////////////////////////////////////////////////
+
+		// @brief Declarations.
+
+		/////////////////////////////////////////////////////////////////////////////////////////
+
+		void TopLevel()
+		{
+			this->Type();
+
+			auto name = this->Ident();
+
+			if (this->Accept("("))
+			{
+				this->Function(name);
+				return;
+			}
+
+			while (true)
+			{
+				ToolchainKit::IRGlobal global;
+				global.fName = name;
+
+				if (this->Accept("="))
+				{
+					// globals need a constant, let the folder evaluate it.
+					std::string expr;
+					Int32		depth = 0;
+
+					while (this->Peek().fKind != IRToken::kEnd &&
+						   !(depth == 0 && (this->Is(",") || this->Is(";"))))
+					{
+						if (this->Is("("))
+							++depth;
+						if (this->Is(")"))
+							--depth;
+
+						expr += fTokens[fPos++].fText + " ";
+					}
+
+					if (!ToolchainKit::ConstantFolder::Evaluate(expr, {}, global.fValue, false))
+						this->Fail("initializer of " + name + " is not a constant");
+				}
+
+				fGlobals.push_back(name);
+				fModule.fGlobals.push_back(global);
+
+				if (!this->Accept(","))
+					break;
+
+				while (this->Accept("*"))
+					;
+
+				name = this->Ident();
+			}
+
+			this->Expect(";");
+		}
+
+		void Function(const std::string& name)
+		{
+			ToolchainKit::IRFunction fn;
+			fn.fName = name;
+
+			std::vector<std::string> params;
+
+			if (this->Is("void") && this->Is(")", 1))
+				++fPos;
+
+			while (!this->Accept(")"))
+			{
+				if (!params.empty())
+					this->Expect(",");
+
+				this->Type();
+
+				// prototypes may leave the parameter unnamed.
+				params.push_back(this->Peek().fKind == IRToken::kIdent ? this->Ident() : "");
+			}
+
+			fn.fParams = params.size();
+
+			auto existing = std::find_if(fModule.fFunctions.begin(), fModule.fFunctions.end(),
+										 [&](const ToolchainKit::IRFunction& other) { return other.fName == name; });
+
+			if (this->Accept(";"))
+			{
+				if (existing == fModule.fFunctions.end())
+				{
+					fn.fExtern = true;
+					fModule.fFunctions.push_back(fn);
+				}
+
+				return;
+			}
+
+			if (existing != fModule.fFunctions.end())
+			{
+				if (!existing->fExtern)
+					this->Fail("redefinition of " + name);
+
+				fModule.fFunctions.erase(existing);
+			}
+
+			fModule.fFunctions.push_back(fn);
+			fFunction = &fModule.fFunctions.back();
+
+			fScopes.emplace_back();
+
+			for (SizeType index = 0; index < params.size(); ++index)
+			{
+				auto temp = this->NewTemp();
+				this->Emit(ToolchainKit::kIRParam, temp, IROperand::Imm(index));
+
+				if (!params[index].empty())
+					fScopes.back()[params[index]] = temp.fValue;
+			}
+
+			this->Expect("{");
+			this->Block();
+
+			fScopes.pop_back();
+
+			if (fFunction->fCode.empty() || fFunction->fCode.back().fOp != ToolchainKit::kIRRet)
+				this->Emit(ToolchainKit::kIRRet, {}, IROperand::Imm(0));
+
+			fFunction = nullptr;
+		}
+
+		/////////////////////////////////////////////////////////////////////////////////////////
+
+		// @brief Statements.
+
+		/////////////////////////////////////////////////////////////////////////////////////////
+
+		/// @brief statements until the closing brace, the opening one is already eaten.
+		void Block()
+		{
+			fScopes.emplace_back();
+
+			while (!this->Accept("}"))
+			{
+				if (this->Peek().fKind == IRToken::kEnd)
+					this->Fail("expected '}' at end of input");
+
+				this->Statement();
+			}
+
+			fScopes.pop_back();
+		}
+
+		void Statement()
+		{
+			if (this->Accept("{"))
+			{
+				this->Block();
+				return;
+			}
+
+			if (this->IsTypeStart())
+			{
+				this->Local();
+				return;
+			}
+
+			if (this->Accept(";"))
+				return;
+
+			if (this->Accept("return"))
+			{
+				if (this->Accept(";"))
+				{
+					this->Emit(ToolchainKit::kIRRet, {}, IROperand::Imm(0));
+					return;
+				}
+
+				auto value = this->Expression();
+				this->Expect(";");
+
+				this->Emit(ToolchainKit::kIRRet, {}, value);
+				return;
+			}
+
+			if (this->Accept("if"))
+			{
+				this->Expect("(");
+				auto cond = this->Expression();
+				this->Expect(")");
+
+				auto else_label = this->NewLabel();
+				this->Jump(ToolchainKit::kIRJumpIfZero, else_label, cond);
+
+				this->Statement();
+
+				if (this->Accept("else"))
+				{
+					auto end_label = this->NewLabel();
+					this->Jump(ToolchainKit::kIRJump, end_label);
+
+					this->Label(else_label);
+					this->Statement();
+					this->Label(end_label);
+				}
+				else
+				{
+					this->Label(else_label);
+				}
+
+				return;
+			}
+
+			if (this->Accept("while"))
+			{
+				auto head = this->NewLabel();
+				auto end  = this->NewLabel();
+
+				this->Label(head);
+
+				this->Expect("(");
+				auto cond = this->Expression();
+				this->Expect(")");
+
+				this->Jump(ToolchainKit::kIRJumpIfZero, end, cond);
+
+				fLoops.push_back({end, head});
+				this->Statement();
+				fLoops.pop_back();
+
+				this->Jump(ToolchainKit::kIRJump, head);
+				this->Label(end);
+
+				return;
+			}
+
+			if (this->Accept("do"))
+			{
+				auto head = this->NewLabel();
+				auto next = this->NewLabel();
+				auto end  = this->NewLabel();
+
+				this->Label(head);
+
+				fLoops.push_back({end, next});
+				this->Statement();
+				fLoops.pop_back();
+
+				this->Label(next);
+
+				this->Expect("while");
+				this->Expect("(");
+				auto cond = this->Expression();
+				this->Expect(")");
+				this->Expect(";");
+
+				this->Jump(ToolchainKit::kIRJumpNotZero, head, cond);
+				this->Label(end);
+
+				return;
+			}
+
+			if (this->Accept("for"))
+			{
+				this->For();
+				return;
+			}
+
+			if (this->Is("break") || this->Is("continue"))
+			{
+				if (fLoops.empty())
+					this->Fail(this->Peek().fText + " outside of a loop");
+
+				auto target = this->Is("break") ? fLoops.back().first : fLoops.back().second;
+				++fPos;
+
+				this->Expect(";");
+				this->Jump(ToolchainKit::kIRJump, target);
+
+				return;
+			}
+
+			if (this->Is("switch") || this->Is("goto"))
+				this->Fail(this->Peek().fText + " is not supported by the IR pipeline yet");
+
+			this->Expression();
+			this->Expect(";");
+		}
+
+		void For()
+		{
+			this->Expect("(");
+
+			fScopes.emplace_back();
+
+			if (this->IsTypeStart())
+			{
+				this->Local();
+			}
+			else
+			{
+				if (!this->Is(";"))
+					this->Expression();
+
+				this->Expect(";");
+			}
+
+			auto head = this->NewLabel();
+			auto next = this->NewLabel();
+			auto end  = this->NewLabel();
+
+			this->Label(head);
+
+			if (!this->Is(";"))
+			{
+				auto cond = this->Expression();
+				this->Jump(ToolchainKit::kIRJumpIfZero, end, cond);
+			}
+
+			this->Expect(";");
+
+			// the step runs after the body, come back to it later.
+			auto  step	= fPos;
+			Int32 depth = 0;
+
+			while (!(depth == 0 && this->Is(")")))
+			{
+				if (this->Peek().fKind == IRToken::kEnd)
+					this->Fail("expected ')' at end of input");
+
+				if (this->Is("("))
+					++depth;
+				if (this->Is(")"))
+					--depth;
+
+				++fPos;
+			}
+
+			this->Expect(")");
+
+			fLoops.push_back({end, next});
+			this->Statement();
+			fLoops.pop_back();
+
+			this->Label(next);
+
+			auto after = fPos;
+
+			fPos = step;
+
+			if (!this->Is(")"))
+				this->Expression();
+
+			fPos = after;
+
+			this->Jump(ToolchainKit::kIRJump, head);
+			this->Label(end);
+
+			fScopes.pop_back();
+		}
+
+		void Local()
+		{
+			this->Type();
+
+			while (true)
+			{
+				while (this->Accept("*"))
+					;
+
+				auto name = this->Ident();
+				auto temp = this->NewTemp();
+
+				if (this->Is("["))
+					this->Fail("arrays are not supported by the IR pipeline yet");
+
+				if (this->Accept("="))
+					this->Emit(ToolchainKit::kIRCopy, temp, this->Assignment());
+				else
+					this->Emit(ToolchainKit::kIRConst, temp, IROperand::Imm(0));
+
+				// visible after its own initializer, like in C.
+				fScopes.back()[name] = temp.fValue;
+
+				if (!this->Accept(","))
+					break;
+			}
+
+			this->Expect(";");
+		}
+
+		/////////////////////////////////////////////////////////////////////////////////////////
+
+		// @brief Expressions.
+
+		/////////////////////////////////////////////////////////////////////////////////////////
+
+		IROperand Expression()
+		{
+			return this->Assignment();
+		}
+
+		IROperand Assignment()
+		{
+			static const std::unordered_map<std::string, ToolchainKit::IROpcode> cCompound = {
+				{"+=", ToolchainKit::kIRAdd}, {"-=", ToolchainKit::kIRSub}, {"*=", ToolchainKit::kIRMul}, {"/=", ToolchainKit::kIRDiv}, {"%=", ToolchainKit::kIRMod}, {"&=", ToolchainKit::kIRAnd}, {"|=", ToolchainKit::kIROr}, {"^=", ToolchainKit::kIRXor}, {"<<=", ToolchainKit::kIRShl}, {">>=", ToolchainKit::kIRShr}};
+
+			if (this->Peek().fKind == IRToken::kIdent && this->Peek(1).fKind == IRToken::kPunct)
+			{
+				auto& op = this->Peek(1).fText;
+
+				if (op == "=" || cCompound.count(op))
+				{
+					auto name = this->Ident();
+					++fPos;
+
+					auto value = this->Assignment();
+
+					if (op != "=")
+						value = this->Binary(cCompound.at(op), this->Variable(name), value);
+
+					return this->Assign(name, value);
+				}
+			}
+
+			return this->Ternary();
+		}
+
+		IROperand Ternary()
+		{
+			auto cond = this->LogicalOr();
+
+			if (!this->Accept("?"))
+				return cond;
+
+			auto result		= this->NewTemp();
+			auto else_label = this->NewLabel();
+			auto end_label	= this->NewLabel();
+
+			this->Jump(ToolchainKit::kIRJumpIfZero, else_label, cond);
+			this->Emit(ToolchainKit::kIRCopy, result, this->Expression());
+			this->Jump(ToolchainKit::kIRJump, end_label);
+
+			this->Expect(":");
+
+			this->Label(else_label);
+			this->Emit(ToolchainKit::kIRCopy, result, this->Ternary());
+			this->Label(end_label);
+
+			return result;
+		}
+
+		/// @brief || and && only evaluate their right side when needed.
+		IROperand ShortCircuit(Bool is_or, IROperand lhs)
+		{
+			auto result = this->NewTemp();
+			auto done	= this->NewLabel();
+			auto end	= this->NewLabel();
+
+			auto jump = is_or ? ToolchainKit::kIRJumpNotZero : ToolchainKit::kIRJumpIfZero;
+
+			this->Jump(jump, done, lhs);
+
+			auto rhs = is_or ? this->LogicalAnd() : this->BitOr();
+			this->Jump(jump, done, rhs);
+
+			this->Emit(ToolchainKit::kIRConst, result, IROperand::Imm(is_or ? 0 : 1));
+			this->Jump(ToolchainKit::kIRJump, end);
+
+			this->Label(done);
+			this->Emit(ToolchainKit::kIRConst, result, IROperand::Imm(is_or ? 1 : 0));
+			this->Label(end);
+
+			return result;
+		}
+
+		IROperand LogicalOr()
+		{
+			auto lhs = this->LogicalAnd();
+
+			while (this->Accept("||"))
+				lhs = this->ShortCircuit(true, lhs);
+
+			return lhs;
+		}
+
+		IROperand LogicalAnd()
+		{
+			auto lhs = this->BitOr();
+
+			while (this->Accept("&&"))
+				lhs = this->ShortCircuit(false, lhs);
+
+			return lhs;
+		}
+
+		IROperand BitOr()
+		{
+			auto lhs = this->BitXor();
+
+			while (!this->Is("||") && this->Accept("|"))
+				lhs = this->Binary(ToolchainKit::kIROr, lhs, this->BitXor());
+
+			return lhs;
+		}
+
+		IROperand BitXor()
+		{
+			auto lhs = this->BitAnd();
+
+			while (this->Accept("^"))
+				lhs = this->Binary(ToolchainKit::kIRXor, lhs, this->BitAnd());
+
+			return lhs;
+		}
+
+		IROperand BitAnd()
+		{
+			auto lhs = this->Equality();
+
+			while (this->Accept("&"))
+				lhs = this->Binary(ToolchainKit::kIRAnd, lhs, this->Equality());
+
+			return lhs;
+		}
+
+		IROperand Equality()
+		{
+			auto lhs = this->Relational();
+
+			while (true)
+			{
+				if (this->Accept("=="))
+					lhs = this->Binary(ToolchainKit::kIRCmpEq, lhs, this->Relational());
+				else if (this->Accept("!="))
+					lhs = this->Binary(ToolchainKit::kIRCmpNe, lhs, this->Relational());
+				else
+					return lhs;
+			}
+		}
+
+		IROperand Relational()
+		{
+			auto lhs = this->Shift();
+
+			while (true)
+			{
+				if (this->Accept("<"))
+					lhs = this->Binary(ToolchainKit::kIRCmpLt, lhs, this->Shift());
+				else if (this->Accept("<="))
+					lhs = this->Binary(ToolchainKit::kIRCmpLe, lhs, this->Shift());
+				else if (this->Accept(">"))
+					lhs = this->Binary(ToolchainKit::kIRCmpGt, lhs, this->Shift());
+				else if (this->Accept(">="))
+					lhs = this->Binary(ToolchainKit::kIRCmpGe, lhs, this->Shift());
+				else
+					return lhs;
+			}
+		}
+
+		IROperand Shift()
+		{
+			auto lhs = this->Additive();
+
+			while (true)
+			{
+				if (this->Accept("<<"))
+					lhs = this->Binary(ToolchainKit::kIRShl, lhs, this->Additive());
+				else if (this->Accept(">>"))
+					lhs = this->Binary(ToolchainKit::kIRShr, lhs, this->Additive());
+				else
+					return lhs;
+			}
+		}
+
+		IROperand Additive()
+		{
+			auto lhs = this->Multiplicative();
+
+			while (true)
+			{
+				if (this->Accept("+"))
+					lhs = this->Binary(ToolchainKit::kIRAdd, lhs, this->Multiplicative());
+				else if (this->Accept("-"))
+					lhs = this->Binary(ToolchainKit::kIRSub, lhs, this->Multiplicative());
+				else
+					return lhs;
+			}
+		}
+
+		IROperand Multiplicative()
+		{
+			auto lhs = this->Unary();
+
+			while (true)
+			{
+				if (this->Accept("*"))
+					lhs = this->Binary(ToolchainKit::kIRMul, lhs, this->Unary());
+				else if (this->Accept("/"))
+					lhs = this->Binary(ToolchainKit::kIRDiv, lhs, this->Unary());
+				else if (this->Accept("%"))
+					lhs = this->Binary(ToolchainKit::kIRMod, lhs, this->Unary());
+				else
+					return lhs;
+			}
+		}
+
+		IROperand Unary()
+		{
+			if (this->Accept("-"))
+				return this->Binary(ToolchainKit::kIRSub, IROperand::Imm(0), this->Unary());
+
+			if (this->Accept("+"))
+				return this->Unary();
+
+			if (this->Accept("!"))
+				return this->Binary(ToolchainKit::kIRCmpEq, this->Unary(), IROperand::Imm(0));
+
+			if (this->Accept("~"))
+				return this->Binary(ToolchainKit::kIRXor, this->Unary(), IROperand::Imm(-1));
+
+			if (this->Is("++") || this->Is("--"))
+			{
+				auto op = this->Is("++") ? ToolchainKit::kIRAdd : ToolchainKit::kIRSub;
+				++fPos;
+
+				auto name = this->Ident();
+				return this->Assign(name, this->Binary(op, this->Variable(name), IROperand::Imm(1)));
+			}
+
+			if (this->Is("*") || this->Is("&"))
+				this->Fail("pointers are not supported by the IR pipeline yet");
+
+			// a cast, every scalar is the same to us.
+			if (this->Is("(") && this->IsTypeStart(1))
+			{
+				++fPos;
+
+				this->Type();
+				this->Expect(")");
+
+				return this->Unary();
+			}
+
+			return this->Postfix();
+		}
+
+		IROperand Postfix()
+		{
+			auto& tok = this->Peek();
+
+			if (tok.fKind == IRToken::kNumber)
+			{
+				++fPos;
+				return IROperand::Imm(tok.fValue);
+			}
+
+			if (tok.fKind == IRToken::kString)
+				this->Fail("string literals are not supported by the IR pipeline yet");
+
+			if (this->Accept("("))
+			{
+				auto value = this->Expression();
+				this->Expect(")");
+
+				return value;
+			}
+
+			auto name = this->Ident();
+
+			if (this->Accept("("))
+			{
+				ToolchainKit::IRInstr call;
+				call.fOp  = ToolchainKit::kIRCall;
+				call.fDst = this->NewTemp();
+				call.fLhs = IROperand::Sym(name);
+
+				while (!this->Accept(")"))
+				{
+					if (!call.fArgs.empty())
+						this->Expect(",");
+
+					call.fArgs.push_back(this->Assignment());
+				}
+
+				fFunction->fCode.push_back(call);
+				return call.fDst;
+			}
+
+			if (this->Is("++") || this->Is("--"))
+			{
+				auto op = this->Is("++") ? ToolchainKit::kIRAdd : ToolchainKit::kIRSub;
+				++fPos;
+
+				auto old = this->NewTemp();
+				this->Emit(ToolchainKit::kIRCopy, old, this->Variable(name));
+				this->Assign(name, this->Binary(op, old, IROperand::Imm(1)));
+
+				return old;
+			}
+
+			if (this->Is("["))
+				this->Fail("arrays are not supported by the IR pipeline yet");
+
+			return this->Variable(name);
+		}
+
+		/////////////////////////////////////////////////////////////////////////////////////////
+
+		// @brief Emission helpers.
+
+		/////////////////////////////////////////////////////////////////////////////////////////
+
+		IROperand NewTemp()
+		{
+			return IROperand::Temp(fFunction->fTemps++);
+		}
+
+		Int64 NewLabel()
+		{
+			return fFunction->fLabels++;
+		}
+
+		void Emit(ToolchainKit::IROpcode op, IROperand dst, IROperand lhs, IROperand rhs = {})
+		{
+			if (!fFunction)
+				this->Fail("expression outside of a function");
+
+			ToolchainKit::IRInstr instr;
+			instr.fOp  = op;
+			instr.fDst = dst;
+			instr.fLhs = lhs;
+			instr.fRhs = rhs;
+
+			fFunction->fCode.push_back(instr);
+		}
+
+		void Jump(ToolchainKit::IROpcode op, Int64 label, IROperand cond = {})
+		{
+			ToolchainKit::IRInstr instr;
+			instr.fOp	 = op;
+			instr.fLhs	 = cond;
+			instr.fLabel = label;
+
+			fFunction->fCode.push_back(instr);
+		}
+
+		void Label(Int64 label)
+		{
+			ToolchainKit::IRInstr instr;
+			instr.fOp	 = ToolchainKit::kIRLabel;
+			instr.fLabel = label;
+
+			fFunction->fCode.push_back(instr);
+		}
+
+		/// @brief emit lhs op rhs, folded right away when both sides are known.
+		IROperand Binary(ToolchainKit::IROpcode op, IROperand lhs, IROperand rhs)
+		{
+			if (lhs.fKind == IROperand::kImm && rhs.fKind == IROperand::kImm)
+			{
+				static const CharType* cOps[] = {"+", "-", "*", "/", "%", "&", "|", "^", "<<", ">>",
+												 "==", "!=", "<", "<=", ">", ">="};
+
+				auto  expr	= std::to_string(lhs.fValue) + " " + cOps[op - ToolchainKit::kIRAdd] + " (" + std::to_string(rhs.fValue) + ")";
+				Int64 value = 0;
+
+				if (ToolchainKit::ConstantFolder::Evaluate(expr, {}, value, false))
+					return IROperand::Imm(value);
+			}
+
+			auto dst = this->NewTemp();
+			this->Emit(op, dst, lhs, rhs);
+
+			return dst;
+		}
+
+		IROperand Variable(const std::string& name)
+		{
+			for (auto scope = fScopes.rbegin(); scope != fScopes.rend(); ++scope)
+			{
+				if (auto it = scope->find(name); it != scope->end())
+					return IROperand::Temp(it->second);
+			}
+
+			if (std::find(fGlobals.begin(), fGlobals.end(), name) == fGlobals.end())
+				this->Fail("use of undeclared identifier " + name);
+
+			auto dst = this->NewTemp();
+			this->Emit(ToolchainKit::kIRLoad, dst, IROperand::Sym(name));
+
+			return dst;
+		}
+
+		IROperand Assign(const std::string& name, IROperand value)
+		{
+			for (auto scope = fScopes.rbegin(); scope != fScopes.rend(); ++scope)
+			{
+				if (auto it = scope->find(name); it != scope->end())
+				{
+					auto dst = IROperand::Temp(it->second);
+					this->Emit(ToolchainKit::kIRCopy, dst, value);
+
+					return dst;
+				}
+			}
+
+			if (std::find(fGlobals.begin(), fGlobals.end(), name) == fGlobals.end())
+				this->Fail("use of undeclared identifier " + name);
+
+			this->Emit(ToolchainKit::kIRStore, IROperand::Sym(name), value);
+			return value;
+		}
+
+	private:
+		std::vector<IRToken>								fTokens;
+		SizeType											fPos{0UL};
+		ToolchainKit::IRModule&								fModule;
+		ToolchainKit::IRFunction*							fFunction{nullptr};
+		std::vector<std::unordered_map<std::string, Int64>> fScopes;
+		std::vector<std::string>							fGlobals;
+		std::vector<std::pair<Int64, Int64>>				fLoops; // break, continue.
+	};
+} // namespace Details
+
+namespace ToolchainKit
+{
+	Bool IRFrontendC::Parse(const std::string& source, IRModule& module, std::string& error)
+	{
+		try
+		{
+			Details::IRParser parser(Details::ir_lex(source), module);
+			parser.Unit();
+		}
+		catch (const std::runtime_error& err)
+		{
+			error = err.what();
+			return false;
+		}
+
+		return true;
+	}
+} // namespace ToolchainKit
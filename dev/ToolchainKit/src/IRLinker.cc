@@ -0,0 +1,557 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+/// @file IRLinker.cc
+/// @brief Link time optimization over the IR of the objects: merging, inlining across
+/// modules, constant propagation, dead function removal and partitioning for the backend.
+
+#include <ToolchainKit/IR.h>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Details
+{
+	/// @brief callees up to that many instructions are inlined.
+	static const SizeType kIRInlineLimit = 32UL;
+
+	static Bool ir_calls(const ToolchainKit::IRFunction& fn, const std::string& name)
+	{
+		return std::any_of(fn.fCode.begin(), fn.fCode.end(), [&](const ToolchainKit::IRInstr& instr) {
+			return instr.fOp == ToolchainKit::kIRCall && instr.fLhs.fSymbol == name;
+		});
+	}
+
+	static ToolchainKit::IROperand ir_rebase(ToolchainKit::IROperand op, Int64 temps)
+	{
+		if (op.fKind == ToolchainKit::IROperand::kTemp)
+			op.fValue += temps;
+
+		return op;
+	}
+
+	/// @brief the body of callee in place of call, its temps and labels after the ones of caller.
+	static void ir_inline(ToolchainKit::IRFunction& caller, const ToolchainKit::IRFunction& callee,
+						  const ToolchainKit::IRInstr& call, std::vector<ToolchainKit::IRInstr>& code)
+	{
+		auto temps = caller.fTemps;
+		auto label = caller.fLabels;
+		auto done  = label + callee.fLabels;
+
+		caller.fTemps += callee.fTemps;
+		caller.fLabels += callee.fLabels + 1;
+
+		for (auto instr : callee.fCode)
+		{
+			instr.fDst = ir_rebase(instr.fDst, temps);
+			instr.fLhs = ir_rebase(instr.fLhs, temps);
+			instr.fRhs = ir_rebase(instr.fRhs, temps);
+
+			for (auto& arg : instr.fArgs)
+				arg = ir_rebase(arg, temps);
+
+			if (instr.fLabel >= 0)
+				instr.fLabel += label;
+
+			switch (instr.fOp)
+			{
+			case ToolchainKit::kIRParam:
+				// arguments are values of the caller, the callee can't change them.
+				instr.fOp  = ToolchainKit::kIRCopy;
+				instr.fLhs = call.fArgs[instr.fLhs.fValue];
+				break;
+			case ToolchainKit::kIRRet:
+				if (call.fDst.fKind != ToolchainKit::IROperand::kNone)
+				{
+					ToolchainKit::IRInstr copy;
+
+					copy.fOp  = ToolchainKit::kIRCopy;
+					copy.fDst = call.fDst;
+					copy.fLhs = instr.fLhs.fKind != ToolchainKit::IROperand::kNone ? instr.fLhs : ToolchainKit::IROperand::Imm(0);
+
+					code.push_back(copy);
+				}
+
+				instr		 = {};
+				instr.fOp	 = ToolchainKit::kIRJump;
+				instr.fLabel = done;
+				break;
+			default:
+				break;
+			}
+
+			code.push_back(instr);
+		}
+
+		ToolchainKit::IRInstr end;
+
+		end.fOp	   = ToolchainKit::kIRLabel;
+		end.fLabel = done;
+
+		code.push_back(end);
+	}
+
+	static Bool ir_fold(ToolchainKit::IROpcode op, Int64 lhs, Int64 rhs, Int64& value)
+	{
+		switch (op)
+		{
+		case ToolchainKit::kIRAdd:
+			value = Int64(UInt64(lhs) + UInt64(rhs));
+			return true;
+		case ToolchainKit::kIRSub:
+			value = Int64(UInt64(lhs) - UInt64(rhs));
+			return true;
+		case ToolchainKit::kIRMul:
+			value = Int64(UInt64(lhs) * UInt64(rhs));
+			return true;
+		case ToolchainKit::kIRDiv:
+		case ToolchainKit::kIRMod:
+			// left to trap at runtime as the program would.
+			if (rhs == 0 || (lhs == INT64_MIN && rhs == -1))
+				return false;
+
+			value = op == ToolchainKit::kIRDiv ? lhs / rhs : lhs % rhs;
+			return true;
+		case ToolchainKit::kIRAnd:
+			value = lhs & rhs;
+			return true;
+		case ToolchainKit::kIROr:
+			value = lhs | rhs;
+			return true;
+		case ToolchainKit::kIRXor:
+			value = lhs ^ rhs;
+			return true;
+		case ToolchainKit::kIRShl:
+		case ToolchainKit::kIRShr:
+			if (rhs < 0 || rhs > 63)
+				return false;
+
+			value = op == ToolchainKit::kIRShl ? Int64(UInt64(lhs) << rhs) : lhs >> rhs;
+			return true;
+		case ToolchainKit::kIRCmpEq:
+			value = lhs == rhs;
+			return true;
+		case ToolchainKit::kIRCmpNe:
+			value = lhs != rhs;
+			return true;
+		case ToolchainKit::kIRCmpLt:
+			value = lhs < rhs;
+			return true;
+		case ToolchainKit::kIRCmpLe:
+			value = lhs <= rhs;
+			return true;
+		case ToolchainKit::kIRCmpGt:
+			value = lhs > rhs;
+			return true;
+		case ToolchainKit::kIRCmpGe:
+			value = lhs >= rhs;
+			return true;
+		case ToolchainKit::kIRNeg:
+			value = Int64(0UL - UInt64(lhs));
+			return true;
+		case ToolchainKit::kIRNot:
+			value = ~lhs;
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	/// @brief Constants through a function, a block at a time: what is known is forgotten at labels.
+	/// @param constants globals no code writes, with their value.
+	static SizeType ir_propagate(ToolchainKit::IRFunction& fn, const std::unordered_map<std::string, Int64>& constants)
+	{
+		std::unordered_map<Int64, Int64> known;
+		std::vector<ToolchainKit::IRInstr> code;
+		SizeType						   folded = 0UL;
+
+		auto use = [&](ToolchainKit::IROperand& op) {
+			if (op.fKind != ToolchainKit::IROperand::kTemp)
+				return;
+
+			if (auto it = known.find(op.fValue); it != known.end())
+				op = ToolchainKit::IROperand::Imm(it->second);
+		};
+
+		for (auto instr : fn.fCode)
+		{
+			if (instr.fOp == ToolchainKit::kIRLabel)
+			{
+				known.clear();
+				code.push_back(instr);
+
+				continue;
+			}
+
+			if (instr.fOp != ToolchainKit::kIRParam)
+			{
+				use(instr.fLhs);
+				use(instr.fRhs);
+			}
+
+			for (auto& arg : instr.fArgs)
+				use(arg);
+
+			Int64 value = 0;
+
+			if (instr.fOp == ToolchainKit::kIRLoad && constants.count(instr.fLhs.fSymbol))
+			{
+				instr.fOp  = ToolchainKit::kIRConst;
+				instr.fLhs = ToolchainKit::IROperand::Imm(constants.at(instr.fLhs.fSymbol));
+
+				++folded;
+			}
+			else if (instr.fOp == ToolchainKit::kIRCopy && instr.fLhs.fKind == ToolchainKit::IROperand::kImm)
+			{
+				instr.fOp = ToolchainKit::kIRConst;
+			}
+			else if (instr.fOp >= ToolchainKit::kIRAdd && instr.fOp <= ToolchainKit::kIRNot &&
+					 instr.fLhs.fKind == ToolchainKit::IROperand::kImm &&
+					 (instr.fOp >= ToolchainKit::kIRNeg || instr.fRhs.fKind == ToolchainKit::IROperand::kImm) &&
+					 ir_fold(instr.fOp, instr.fLhs.fValue, instr.fRhs.fValue, value))
+			{
+				auto dst = instr.fDst;
+
+				instr	   = {};
+				instr.fOp  = ToolchainKit::kIRConst;
+				instr.fDst = dst;
+				instr.fLhs = ToolchainKit::IROperand::Imm(value);
+
+				++folded;
+			}
+			else if ((instr.fOp == ToolchainKit::kIRJumpIfZero || instr.fOp == ToolchainKit::kIRJumpNotZero) &&
+					 instr.fLhs.fKind == ToolchainKit::IROperand::kImm)
+			{
+				++folded;
+
+				if ((instr.fLhs.fValue == 0) != (instr.fOp == ToolchainKit::kIRJumpIfZero))
+					continue;
+
+				instr.fOp  = ToolchainKit::kIRJump;
+				instr.fLhs = {};
+			}
+
+			if (instr.fDst.fKind == ToolchainKit::IROperand::kTemp)
+			{
+				if (instr.fOp == ToolchainKit::kIRConst)
+					known[instr.fDst.fValue] = instr.fLhs.fValue;
+				else
+					known.erase(instr.fDst.fValue);
+			}
+
+			code.push_back(instr);
+		}
+
+		fn.fCode = std::move(code);
+
+		return folded;
+	}
+
+	/// @brief Drop what follows a jump or a return up to the next label, and jumps to the next instruction.
+	static void ir_clean(ToolchainKit::IRFunction& fn)
+	{
+		std::vector<ToolchainKit::IRInstr> code;
+		Bool							   reachable = true;
+
+		for (auto& instr : fn.fCode)
+		{
+			if (instr.fOp == ToolchainKit::kIRLabel)
+			{
+				reachable = true;
+
+				// a jump to the label right after it.
+				if (!code.empty() && code.back().fOp == ToolchainKit::kIRJump && code.back().fLabel == instr.fLabel)
+					code.pop_back();
+			}
+
+			if (!reachable)
+				continue;
+
+			code.push_back(instr);
+
+			if (instr.fOp == ToolchainKit::kIRJump || instr.fOp == ToolchainKit::kIRRet)
+				reachable = false;
+		}
+
+		// a label nothing jumps to only splits the blocks ir_propagate works on.
+		std::unordered_set<Int64> targets;
+
+		for (auto& instr : code)
+		{
+			if (instr.fOp != ToolchainKit::kIRLabel && instr.fLabel >= 0)
+				targets.insert(instr.fLabel);
+		}
+
+		std::erase_if(code, [&targets](const ToolchainKit::IRInstr& instr) {
+			return instr.fOp == ToolchainKit::kIRLabel && !targets.count(instr.fLabel);
+		});
+
+		fn.fCode = std::move(code);
+	}
+} // namespace Details
+
+namespace ToolchainKit
+{
+	Bool ir_merge(const std::vector<IRModule>& modules, IRModule& merged, std::string& error)
+	{
+		std::unordered_map<std::string, SizeType>	 functions;
+		std::unordered_map<std::string, std::string> defined_by;
+
+		merged = {};
+
+		for (auto& module : modules)
+		{
+			merged.fSource += merged.fSource.empty() ? module.fSource : " " + module.fSource;
+
+			for (auto& global : module.fGlobals)
+			{
+				if (auto [it, inserted] = defined_by.try_emplace(global.fName, module.fSource); !inserted)
+				{
+					error = global.fName + " is defined by both " + it->second + " and " + module.fSource;
+					return false;
+				}
+
+				merged.fGlobals.push_back(global);
+			}
+
+			for (auto& fn : module.fFunctions)
+			{
+				auto existing = functions.find(fn.fName);
+
+				if (fn.fExtern)
+				{
+					if (existing == functions.end())
+					{
+						functions[fn.fName] = merged.fFunctions.size();
+						merged.fFunctions.push_back(fn);
+					}
+
+					continue;
+				}
+
+				if (auto [it, inserted] = defined_by.try_emplace(fn.fName, module.fSource); !inserted)
+				{
+					error = fn.fName + " is defined by both " + it->second + " and " + module.fSource;
+					return false;
+				}
+
+				// the prototype gives way to the definition.
+				if (existing != functions.end())
+				{
+					merged.fFunctions[existing->second] = fn;
+					continue;
+				}
+
+				functions[fn.fName] = merged.fFunctions.size();
+				merged.fFunctions.push_back(fn);
+			}
+		}
+
+		return true;
+	}
+
+	IRLinkStats ir_optimize(IRModule& module, const std::vector<std::string>& roots)
+	{
+		IRLinkStats stats;
+
+		std::unordered_map<std::string, SizeType> index;
+
+		for (SizeType fn = 0; fn < module.fFunctions.size(); ++fn)
+			index[module.fFunctions[fn].fName] = fn;
+
+		// inline small callees, a caller is walked once so recursion ends there.
+		for (auto& caller : module.fFunctions)
+		{
+			if (caller.fExtern)
+				continue;
+
+			std::vector<IRInstr> code;
+
+			for (auto& instr : caller.fCode)
+			{
+				auto callee = instr.fOp == kIRCall ? index.find(instr.fLhs.fSymbol) : index.end();
+
+				if (callee == index.end())
+				{
+					code.push_back(instr);
+					continue;
+				}
+
+				auto& body = module.fFunctions[callee->second];
+
+				if (body.fExtern || &body == &caller || body.fCode.size() > Details::kIRInlineLimit ||
+					body.fParams != instr.fArgs.size() || Details::ir_calls(body, body.fName))
+				{
+					code.push_back(instr);
+					continue;
+				}
+
+				Details::ir_inline(caller, body, instr, code);
+
+				++stats.fInlined;
+			}
+
+			caller.fCode = std::move(code);
+		}
+
+		// a global only the module sees and never writes is a constant.
+		std::unordered_set<std::string> written(roots.begin(), roots.end());
+
+		for (auto& fn : module.fFunctions)
+		{
+			for (auto& instr : fn.fCode)
+			{
+				if (instr.fOp == kIRStore)
+					written.insert(instr.fDst.fSymbol);
+			}
+		}
+
+		std::unordered_map<std::string, Int64> constants;
+
+		for (auto& global : module.fGlobals)
+		{
+			if (!written.count(global.fName))
+				constants[global.fName] = global.fValue;
+		}
+
+		for (auto& fn : module.fFunctions)
+		{
+			if (fn.fExtern)
+				continue;
+
+			Details::ir_clean(fn);
+			stats.fFolded += Details::ir_propagate(fn, constants);
+			Details::ir_clean(fn);
+		}
+
+		// keep what the roots reach.
+		std::unordered_set<std::string> live(roots.begin(), roots.end());
+		std::vector<std::string>		pending(roots.begin(), roots.end());
+
+		while (!pending.empty())
+		{
+			auto name = pending.back();
+			pending.pop_back();
+
+			auto it = index.find(name);
+
+			if (it == index.end())
+				continue;
+
+			for (auto& instr : module.fFunctions[it->second].fCode)
+			{
+				auto reach = [&](const IROperand& op) {
+					if (op.fKind == IROperand::kSym && live.insert(op.fSymbol).second)
+						pending.push_back(op.fSymbol);
+				};
+
+				reach(instr.fDst);
+				reach(instr.fLhs);
+				reach(instr.fRhs);
+
+				for (auto& arg : instr.fArgs)
+					reach(arg);
+			}
+		}
+
+		std::vector<IRFunction> functions;
+
+		for (auto& fn : module.fFunctions)
+		{
+			if (live.count(fn.fName))
+			{
+				functions.push_back(std::move(fn));
+				continue;
+			}
+
+			if (!fn.fExtern)
+				++stats.fRemoved;
+		}
+
+		module.fFunctions = std::move(functions);
+
+		module.fGlobals.erase(std::remove_if(module.fGlobals.begin(), module.fGlobals.end(),
+											 [&](const IRGlobal& global) { return !live.count(global.fName); }),
+							  module.fGlobals.end());
+
+		return stats;
+	}
+
+	std::vector<IRModule> ir_partition(const IRModule& module, SizeType count)
+	{
+		std::vector<SizeType> defined;
+
+		for (SizeType fn = 0; fn < module.fFunctions.size(); ++fn)
+		{
+			if (!module.fFunctions[fn].fExtern)
+				defined.push_back(fn);
+		}
+
+		count = std::clamp<SizeType>(count, 1UL, std::max<SizeType>(defined.size(), 1UL));
+
+		// biggest first, each to the lightest partition.
+		std::stable_sort(defined.begin(), defined.end(), [&](SizeType lhs, SizeType rhs) {
+			return module.fFunctions[lhs].fCode.size() > module.fFunctions[rhs].fCode.size();
+		});
+
+		std::vector<std::vector<SizeType>> members(count);
+		std::vector<SizeType>			   weights(count, 0UL);
+
+		for (auto fn : defined)
+		{
+			auto lightest = std::min_element(weights.begin(), weights.end()) - weights.begin();
+
+			members[lightest].push_back(fn);
+			weights[lightest] += module.fFunctions[fn].fCode.size() + 1;
+		}
+
+		std::vector<IRModule> partitions(count);
+
+		for (SizeType part = 0; part < count; ++part)
+		{
+			auto& partition = partitions[part];
+
+			partition.fSource = module.fSource + ":" + std::to_string(part);
+
+			if (part == 0)
+				partition.fGlobals = module.fGlobals;
+
+			// module order, the output doesn't depend on the sort.
+			std::sort(members[part].begin(), members[part].end());
+
+			std::unordered_set<std::string> names;
+
+			for (auto fn : members[part])
+			{
+				partition.fFunctions.push_back(module.fFunctions[fn]);
+				names.insert(module.fFunctions[fn].fName);
+			}
+
+			for (auto& fn : module.fFunctions)
+			{
+				if (names.count(fn.fName))
+					continue;
+
+				Bool called = std::any_of(members[part].begin(), members[part].end(), [&](SizeType caller) {
+					return Details::ir_calls(module.fFunctions[caller], fn.fName);
+				});
+
+				if (!called)
+					continue;
+
+				IRFunction prototype;
+
+				prototype.fName	  = fn.fName;
+				prototype.fParams = fn.fParams;
+				prototype.fExtern = true;
+
+				partition.fFunctions.push_back(prototype);
+			}
+		}
+
+		return partitions;
+	}
+} // namespace ToolchainKit
@@ -0,0 +1,1062 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+/// @file IRSelector.cc
+/// @brief Instruction selection from the IR, one selector per target.
+/// Adding a target only takes a new IRSelectorBase subclass.
+
+#include <ToolchainKit/IR.h>
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace Details
+{
+	/// @brief shared plumbing: allocation, labels and the output stream.
+	class IRSelectorBase : public ToolchainKit::IRSelector
+	{
+	public:
+		std::string Select(const ToolchainKit::IRModule& module) override
+		{
+			fOut.str("");
+
+			for (auto& global : module.fGlobals)
+			{
+				this->Global(global);
+			}
+
+			for (auto& fn : module.fFunctions)
+			{
+				// resolved by the linker.
+				if (fn.fExtern)
+					continue;
+
+				fFunction  = &fn;
+				fLocations = ToolchainKit::ir_allocate(fn, this->Pool().size(), fSlots);
+
+				fSaved.clear();
+
+				for (SizeType reg = 0; reg < this->Pool().size(); ++reg)
+				{
+					if (std::any_of(fLocations.begin(), fLocations.end(), [&](const ToolchainKit::IRLocation& loc) {
+							return loc.fReg == (Int32)reg;
+						}))
+						fSaved.push_back(this->Pool()[reg]);
+				}
+
+				this->Prologue(fn);
+
+				for (auto& instr : fn.fCode)
+				{
+					this->Instr(instr);
+				}
+
+				fOut << "\n";
+			}
+
+			fFunction = nullptr;
+
+			return fOut.str();
+		}
+
+	protected:
+		/// @brief registers the allocator hands out, saved by the callee.
+		virtual const std::vector<std::string>& Pool() = 0;
+
+		virtual void Global(const ToolchainKit::IRGlobal& global)	   = 0;
+		virtual void Prologue(const ToolchainKit::IRFunction& fn)	   = 0;
+		virtual void Instr(const ToolchainKit::IRInstr& instr)		   = 0;
+
+		std::string LabelName(Int64 label)
+		{
+			return "__TOOLCHAINKIT_IR_" + fFunction->fName + "_L" + std::to_string(label);
+		}
+
+		/// @brief a label unique to the function, for selector-made branches.
+		std::string LocalLabel()
+		{
+			return "__TOOLCHAINKIT_IR_" + fFunction->fName + "_S" + std::to_string(fLocal++);
+		}
+
+		Bool InRegister(const ToolchainKit::IROperand& op)
+		{
+			return op.fKind == ToolchainKit::IROperand::kTemp && fLocations[op.fValue].fReg >= 0;
+		}
+
+		const std::string& Register(const ToolchainKit::IROperand& op)
+		{
+			return this->Pool()[fLocations[op.fValue].fReg];
+		}
+
+		Int32 Slot(const ToolchainKit::IROperand& op)
+		{
+			return fLocations[op.fValue].fSlot;
+		}
+
+		void Fail(const std::string& reason)
+		{
+			throw std::runtime_error(fFunction->fName + ": " + reason);
+		}
+
+	protected:
+		std::stringstream						 fOut;
+		const ToolchainKit::IRFunction*			 fFunction{nullptr};
+		std::vector<ToolchainKit::IRLocation>	 fLocations;
+		std::vector<std::string>				 fSaved;
+		SizeType								 fSlots{0UL};
+		SizeType								 fLocal{0UL};
+	};
+
+	static Bool ir_fits(Int64 value, Int32 bits)
+	{
+		return value >= -(1LL << (bits - 1)) && value < (1LL << (bits - 1));
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////
+
+	// @brief AMD64 selector, PEF calling convention: arguments in r8 to r15,
+	// result in rax. SSE2 is the baseline, AVX2 and AVX-512 widen the vectors.
+
+	/////////////////////////////////////////////////////////////////////////////////////////
+
+	class IRSelectorAMD64 final : public IRSelectorBase
+	{
+	public:
+		Int32 Arch() noexcept override
+		{
+			return ToolchainKit::AssemblyFactory::kArchAMD64;
+		}
+
+	protected:
+		const std::vector<std::string>& Pool() override
+		{
+			// rax, rcx, rdx and r11 are scratch, r8 to r15 carry arguments.
+			static const std::vector<std::string> cPool = {"rbx", "rsi", "rdi"};
+			return cPool;
+		}
+
+		void Global(const ToolchainKit::IRGlobal& global) override
+		{
+			fOut << "public_segment .data64 " << global.fName << "\n";
+			fOut << "\tdq " << global.fValue << "\n";
+		}
+
+		void Prologue(const ToolchainKit::IRFunction& fn) override
+		{
+			fOut << "public_segment .code64 " << fn.fName << "\n";
+			fOut << "\tpush rbp\n";
+			fOut << "\tmov rbp, rsp\n";
+
+			for (auto& reg : fSaved)
+				fOut << "\tpush " << reg << "\n";
+
+			// keep rsp 16-byte aligned at calls.
+			auto slots = fSlots + ((fSaved.size() + fSlots) % 2);
+
+			if (slots > 0)
+				fOut << "\tsub rsp, " << slots * 8 << "\n";
+		}
+
+		std::string Operand(const ToolchainKit::IROperand& op)
+		{
+			switch (op.fKind)
+			{
+			case ToolchainKit::IROperand::kImm:
+				return std::to_string(op.fValue);
+			case ToolchainKit::IROperand::kSym:
+				return "qword [" + op.fSymbol + "]";
+			case ToolchainKit::IROperand::kTemp:
+				if (this->InRegister(op))
+					return this->Register(op);
+
+				return "qword [rbp - " + std::to_string(8 * (fSaved.size() + this->Slot(op) + 1)) + "]";
+			default:
+				return "0";
+			}
+		}
+
+		Bool IsMemory(const ToolchainKit::IROperand& op)
+		{
+			return op.fKind == ToolchainKit::IROperand::kSym ||
+				   (op.fKind == ToolchainKit::IROperand::kTemp && !this->InRegister(op));
+		}
+
+		/// @brief operand usable as the source of an ALU instruction.
+		std::string Source(const ToolchainKit::IROperand& op, const char* scratch)
+		{
+			if (op.fKind == ToolchainKit::IROperand::kImm && !ir_fits(op.fValue, 32))
+			{
+				fOut << "\tmov " << scratch << ", " << op.fValue << "\n";
+				return scratch;
+			}
+
+			return this->Operand(op);
+		}
+
+		void Move(const ToolchainKit::IROperand& dst, const ToolchainKit::IROperand& src)
+		{
+			auto to	  = this->Operand(dst);
+			auto from = this->Operand(src);
+
+			if (to == from)
+				return;
+
+			if (this->IsMemory(dst) && (this->IsMemory(src) || (src.fKind == ToolchainKit::IROperand::kImm && !ir_fits(src.fValue, 32))))
+			{
+				fOut << "\tmov rax, " << from << "\n";
+				fOut << "\tmov " << to << ", rax\n";
+
+				return;
+			}
+
+			fOut << "\tmov " << to << ", " << from << "\n";
+		}
+
+		/// @brief add, sub and mul by 2, 3, 5 or 9 between registers, as a single lea.
+		Bool Address(const ToolchainKit::IRInstr& instr)
+		{
+			if (!this->InRegister(instr.fDst) || !this->InRegister(instr.fLhs))
+				return false;
+
+			auto  base = this->Register(instr.fLhs);
+			auto& rhs  = instr.fRhs;
+
+			std::string address;
+
+			if (instr.fOp == ToolchainKit::kIRAdd && this->InRegister(rhs))
+				address = base + " + " + this->Register(rhs);
+			else if ((instr.fOp == ToolchainKit::kIRAdd || instr.fOp == ToolchainKit::kIRSub) &&
+					 rhs.fKind == ToolchainKit::IROperand::kImm && ir_fits(rhs.fValue, 32) && ir_fits(-rhs.fValue, 32))
+			{
+				auto disp = instr.fOp == ToolchainKit::kIRAdd ? rhs.fValue : -rhs.fValue;
+				address	  = base + (disp < 0 ? " - " : " + ") + std::to_string(disp < 0 ? -disp : disp);
+			}
+			else if (instr.fOp == ToolchainKit::kIRMul && rhs.fKind == ToolchainKit::IROperand::kImm &&
+					 (rhs.fValue == 2 || rhs.fValue == 3 || rhs.fValue == 5 || rhs.fValue == 9))
+				address = base + " + " + base + " * " + std::to_string(rhs.fValue - 1);
+			else
+				return false;
+
+			fOut << "\tlea " << this->Register(instr.fDst) << ", [" << address << "]\n";
+
+			return true;
+		}
+
+		/// @brief the vector register num of the width in use, xmm for SSE2.
+		std::string Vector(Int32 num)
+		{
+			return (fVectorSize >= 64 ? "zmm" : (fVectorSize >= 32 ? "ymm" : "xmm")) + std::to_string(num);
+		}
+
+		/// @brief __builtin_memcpy and __builtin_memset: a loop of vector moves, then one of bytes.
+		/// rax is the destination, rdx the source or the byte, rcx the count; r11 keeps what they return.
+		Bool Builtin(const ToolchainKit::IRInstr& instr)
+		{
+			Bool copy = instr.fLhs.fSymbol == "__builtin_memcpy";
+
+			if (!copy && instr.fLhs.fSymbol != "__builtin_memset")
+				return false;
+
+			if (instr.fArgs.size() != 3)
+				this->Fail(instr.fLhs.fSymbol + " takes three arguments");
+
+			SizeType	width = fVectorSize >= 64 ? 64 : (fVectorSize >= 32 ? 32 : 16);
+			std::string move  = width == 64 ? "vmovdqu64" : (width == 32 ? "vmovdqu" : "movdqu");
+			std::string vec	  = this->Vector(0);
+
+			fOut << "\tmov rax, " << this->Operand(instr.fArgs[0]) << "\n";
+			fOut << "\tmov rdx, " << this->Operand(instr.fArgs[1]) << "\n";
+			fOut << "\tmov rcx, " << this->Operand(instr.fArgs[2]) << "\n";
+			fOut << "\tmov r11, rax\n";
+
+			// the byte in every lane.
+			if (!copy)
+			{
+				fOut << "\tmovzx edx, dl\n";
+				fOut << "\tmov r10, 0x0101010101010101\n";
+				fOut << "\timul rdx, r10\n";
+				fOut << "\tmovq xmm0, rdx\n";
+				fOut << (width == 16 ? "\tpunpcklqdq xmm0, xmm0\n" : "\tvpbroadcastq " + vec + ", xmm0\n");
+			}
+
+			auto loop = this->LocalLabel();
+			auto tail = this->LocalLabel();
+			auto done = this->LocalLabel();
+
+			fOut << loop << ":\n";
+			fOut << "\tcmp rcx, " << width << "\n";
+			fOut << "\tjb " << tail << "\n";
+
+			if (copy)
+			{
+				fOut << "\t" << move << " " << vec << ", [rdx]\n";
+				fOut << "\tadd rdx, " << width << "\n";
+			}
+
+			fOut << "\t" << move << " [rax], " << vec << "\n";
+			fOut << "\tadd rax, " << width << "\n";
+			fOut << "\tsub rcx, " << width << "\n";
+			fOut << "\tjmp " << loop << "\n";
+
+			fOut << tail << ":\n";
+			fOut << "\ttest rcx, rcx\n";
+			fOut << "\tjz " << done << "\n";
+
+			if (copy)
+			{
+				fOut << "\tmov r10b, byte [rdx]\n";
+				fOut << "\tmov byte [rax], r10b\n";
+				fOut << "\tinc rdx\n";
+			}
+			else
+			{
+				fOut << "\tmov byte [rax], dl\n";
+			}
+
+			fOut << "\tinc rax\n";
+			fOut << "\tdec rcx\n";
+			fOut << "\tjmp " << tail << "\n";
+
+			fOut << done << ":\n";
+
+			// no penalty for the SSE code after us.
+			if (width > 16)
+				fOut << "\tvzeroupper\n";
+
+			if (instr.fDst.fKind != ToolchainKit::IROperand::kNone)
+				fOut << "\tmov " << this->Operand(instr.fDst) << ", r11\n";
+
+			return true;
+		}
+
+		void Epilogue()
+		{
+			fOut << "\tlea rsp, [rbp - " << fSaved.size() * 8 << "]\n";
+
+			for (auto reg = fSaved.rbegin(); reg != fSaved.rend(); ++reg)
+				fOut << "\tpop " << *reg << "\n";
+
+			fOut << "\tpop rbp\n";
+			fOut << "\tret\n";
+		}
+
+		void Instr(const ToolchainKit::IRInstr& instr) override
+		{
+			static const std::vector<std::string> cArgs = {"r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"};
+
+			switch (instr.fOp)
+			{
+			case ToolchainKit::kIRConst:
+			case ToolchainKit::kIRCopy:
+			case ToolchainKit::kIRLoad:
+				this->Move(instr.fDst, instr.fLhs);
+				break;
+			case ToolchainKit::kIRStore:
+				this->Move(instr.fDst, instr.fLhs);
+				break;
+			case ToolchainKit::kIRParam:
+				if (instr.fLhs.fValue >= (Int64)cArgs.size())
+					this->Fail("too many parameters for the PEF calling convention");
+
+				fOut << "\tmov " << this->Operand(instr.fDst) << ", " << cArgs[instr.fLhs.fValue] << "\n";
+				break;
+			case ToolchainKit::kIRAdd:
+			case ToolchainKit::kIRSub:
+			case ToolchainKit::kIRAnd:
+			case ToolchainKit::kIROr:
+			case ToolchainKit::kIRXor: {
+				static const CharType* cNames[] = {"add", "sub", "", "", "", "and", "or", "xor"};
+
+				if (this->Address(instr))
+					break;
+
+				fOut << "\tmov rax, " << this->Operand(instr.fLhs) << "\n";
+				auto rhs = this->Source(instr.fRhs, "rdx");
+
+				fOut << "\t" << cNames[instr.fOp - ToolchainKit::kIRAdd] << " rax, " << rhs << "\n";
+				fOut << "\tmov " << this->Operand(instr.fDst) << ", rax\n";
+				break;
+			}
+			case ToolchainKit::kIRMul:
+				if (this->Address(instr))
+					break;
+
+				fOut << "\tmov rax, " << this->Operand(instr.fLhs) << "\n";
+				fOut << "\tmov rdx, " << this->Operand(instr.fRhs) << "\n";
+				fOut << "\timul rax, rdx\n";
+				fOut << "\tmov " << this->Operand(instr.fDst) << ", rax\n";
+				break;
+			case ToolchainKit::kIRDiv:
+			case ToolchainKit::kIRMod:
+				fOut << "\tmov rcx, " << this->Operand(instr.fRhs) << "\n";
+				fOut << "\tmov rax, " << this->Operand(instr.fLhs) << "\n";
+				fOut << "\tcqo\n";
+				fOut << "\tidiv rcx\n";
+				fOut << "\tmov " << this->Operand(instr.fDst) << (instr.fOp == ToolchainKit::kIRDiv ? ", rax\n" : ", rdx\n");
+				break;
+			case ToolchainKit::kIRShl:
+			case ToolchainKit::kIRShr:
+				fOut << "\tmov rcx, " << this->Operand(instr.fRhs) << "\n";
+				fOut << "\tmov rax, " << this->Operand(instr.fLhs) << "\n";
+				fOut << (instr.fOp == ToolchainKit::kIRShl ? "\tshl rax, cl\n" : "\tsar rax, cl\n");
+				fOut << "\tmov " << this->Operand(instr.fDst) << ", rax\n";
+				break;
+			case ToolchainKit::kIRCmpEq:
+			case ToolchainKit::kIRCmpNe:
+			case ToolchainKit::kIRCmpLt:
+			case ToolchainKit::kIRCmpLe:
+			case ToolchainKit::kIRCmpGt:
+			case ToolchainKit::kIRCmpGe: {
+				static const CharType* cSet[] = {"sete", "setne", "setl", "setle", "setg", "setge"};
+
+				auto rhs = this->Source(instr.fRhs, "rdx");
+
+				fOut << "\tmov rax, " << this->Operand(instr.fLhs) << "\n";
+				fOut << "\tcmp rax, " << rhs << "\n";
+				fOut << "\t" << cSet[instr.fOp - ToolchainKit::kIRCmpEq] << " al\n";
+				fOut << "\tmovzx rax, al\n";
+				fOut << "\tmov " << this->Operand(instr.fDst) << ", rax\n";
+				break;
+			}
+			case ToolchainKit::kIRNeg:
+			case ToolchainKit::kIRNot:
+				fOut << "\tmov rax, " << this->Operand(instr.fLhs) << "\n";
+				fOut << (instr.fOp == ToolchainKit::kIRNeg ? "\tneg rax\n" : "\tnot rax\n");
+				fOut << "\tmov " << this->Operand(instr.fDst) << ", rax\n";
+				break;
+			case ToolchainKit::kIRCall:
+				if (this->Builtin(instr))
+					break;
+
+				if (instr.fArgs.size() > cArgs.size())
+					this->Fail("too many arguments for the PEF calling convention");
+
+				for (SizeType arg = 0; arg < instr.fArgs.size(); ++arg)
+					fOut << "\tmov " << cArgs[arg] << ", " << this->Operand(instr.fArgs[arg]) << "\n";
+
+				fOut << "\tcall " << instr.fLhs.fSymbol << "\n";
+
+				if (instr.fDst.fKind != ToolchainKit::IROperand::kNone)
+					fOut << "\tmov " << this->Operand(instr.fDst) << ", rax\n";
+
+				break;
+			case ToolchainKit::kIRRet:
+				if (instr.fLhs.fKind != ToolchainKit::IROperand::kNone)
+					fOut << "\tmov rax, " << this->Operand(instr.fLhs) << "\n";
+
+				this->Epilogue();
+				break;
+			case ToolchainKit::kIRJump:
+				fOut << "\tjmp " << this->LabelName(instr.fLabel) << "\n";
+				break;
+			case ToolchainKit::kIRJumpIfZero:
+			case ToolchainKit::kIRJumpNotZero:
+				fOut << "\tmov rax, " << this->Operand(instr.fLhs) << "\n";
+				fOut << "\tcmp rax, 0\n";
+				fOut << (instr.fOp == ToolchainKit::kIRJumpIfZero ? "\tje " : "\tjne ") << this->LabelName(instr.fLabel) << "\n";
+				break;
+			case ToolchainKit::kIRLabel:
+				fOut << this->LabelName(instr.fLabel) << ":\n";
+				break;
+			default:
+				this->Fail("unknown IR opcode");
+			}
+		}
+	};
+
+	/////////////////////////////////////////////////////////////////////////////////////////
+
+	// @brief 64x0 selector: arguments in r6 to r9, result in r19, sp is r5.
+	// The 64x0 has no mul/div/logic unit, those go through runtime helpers.
+
+	/////////////////////////////////////////////////////////////////////////////////////////
+
+	class IRSelector64x0 final : public IRSelectorBase
+	{
+	public:
+		Int32 Arch() noexcept override
+		{
+			return ToolchainKit::AssemblyFactory::kArch64x0;
+		}
+
+	protected:
+		const std::vector<std::string>& Pool() override
+		{
+			// r10, r11 and r12 are scratch, r12 holds branch targets.
+			static const std::vector<std::string> cPool = {"r2", "r3", "r4", "r13", "r14", "r15", "r16"};
+			return cPool;
+		}
+
+		void Global(const ToolchainKit::IRGlobal& global) override
+		{
+			fOut << "public_segment .data64 " << global.fName << "\n";
+			fOut << "\t.quad " << global.fValue << "\n";
+		}
+
+		SizeType FrameSize()
+		{
+			return 8 * (fSaved.size() + fSlots);
+		}
+
+		void Prologue(const ToolchainKit::IRFunction& fn) override
+		{
+			fOut << "public_segment .code64 " << fn.fName << "\n";
+
+			if (this->FrameSize() == 0)
+				return;
+
+			fOut << "\tldw r12, " << this->FrameSize() << "\n";
+			fOut << "\tsub r5, r12\n";
+
+			for (SizeType reg = 0; reg < fSaved.size(); ++reg)
+				fOut << "\tstw " << fSaved[reg] << ", r5, " << reg * 8 << "\n";
+		}
+
+		void Epilogue()
+		{
+			if (this->FrameSize() > 0)
+			{
+				for (SizeType reg = 0; reg < fSaved.size(); ++reg)
+					fOut << "\tldw " << fSaved[reg] << ", r5, " << reg * 8 << "\n";
+
+				fOut << "\tldw r12, " << this->FrameSize() << "\n";
+				fOut << "\tadd r5, r12\n";
+			}
+
+			fOut << "\tjlr\n";
+		}
+
+		SizeType SlotOffset(const ToolchainKit::IROperand& op)
+		{
+			return 8 * (fSaved.size() + this->Slot(op));
+		}
+
+		/// @brief get op into a register, scratch if needed.
+		std::string Read(const ToolchainKit::IROperand& op, const char* scratch)
+		{
+			if (this->InRegister(op))
+				return this->Register(op);
+
+			if (op.fKind == ToolchainKit::IROperand::kImm)
+				fOut << "\tldw " << scratch << ", " << op.fValue << "\n";
+			else if (op.fKind == ToolchainKit::IROperand::kSym)
+				fOut << "\tldw " << scratch << ", " << op.fSymbol << "\n";
+			else
+				fOut << "\tldw " << scratch << ", r5, " << this->SlotOffset(op) << "\n";
+
+			return scratch;
+		}
+
+		void Write(const ToolchainKit::IROperand& dst, const std::string& reg)
+		{
+			if (dst.fKind == ToolchainKit::IROperand::kSym)
+			{
+				fOut << "\tstw " << reg << ", " << dst.fSymbol << "\n";
+				return;
+			}
+
+			if (this->InRegister(dst))
+			{
+				if (this->Register(dst) != reg)
+					fOut << "\tmv " << this->Register(dst) << ", " << reg << "\n";
+
+				return;
+			}
+
+			fOut << "\tstw " << reg << ", r5, " << this->SlotOffset(dst) << "\n";
+		}
+
+		void Branch(const char* cond, const std::string& lhs, const std::string& rhs, const std::string& label)
+		{
+			fOut << "\tlda r12, extern_segment " << label << "\n";
+			fOut << "\t" << cond << " " << lhs << ", " << rhs << ", r12\n";
+		}
+
+		void Instr(const ToolchainKit::IRInstr& instr) override
+		{
+			static const std::vector<std::string> cArgs = {"r6", "r7", "r8", "r9"};
+
+			switch (instr.fOp)
+			{
+			case ToolchainKit::kIRConst:
+			case ToolchainKit::kIRCopy:
+			case ToolchainKit::kIRLoad:
+			case ToolchainKit::kIRStore: {
+				if (this->InRegister(instr.fDst) && instr.fLhs.fKind == ToolchainKit::IROperand::kImm)
+				{
+					fOut << "\tldw " << this->Register(instr.fDst) << ", " << instr.fLhs.fValue << "\n";
+					break;
+				}
+
+				this->Write(instr.fDst, this->Read(instr.fLhs, "r10"));
+				break;
+			}
+			case ToolchainKit::kIRParam:
+				if (instr.fLhs.fValue >= (Int64)cArgs.size())
+					this->Fail("too many parameters for the 64x0 calling convention");
+
+				this->Write(instr.fDst, cArgs[instr.fLhs.fValue]);
+				break;
+			case ToolchainKit::kIRAdd:
+			case ToolchainKit::kIRSub: {
+				auto lhs = this->Read(instr.fLhs, "r10");
+				auto rhs = this->Read(instr.fRhs, "r11");
+
+				if (lhs != "r10")
+					fOut << "\tmv r10, " << lhs << "\n";
+
+				fOut << (instr.fOp == ToolchainKit::kIRAdd ? "\tadd r10, " : "\tsub r10, ") << rhs << "\n";
+				this->Write(instr.fDst, "r10");
+
+				break;
+			}
+			case ToolchainKit::kIRMul:
+			case ToolchainKit::kIRDiv:
+			case ToolchainKit::kIRMod:
+			case ToolchainKit::kIRAnd:
+			case ToolchainKit::kIROr:
+			case ToolchainKit::kIRXor:
+			case ToolchainKit::kIRShl:
+			case ToolchainKit::kIRShr: {
+				static const CharType* cHelpers[] = {"__ToolchainKitMul64", "__ToolchainKitDiv64", "__ToolchainKitMod64",
+													 "__ToolchainKitAnd64", "__ToolchainKitOr64", "__ToolchainKitXor64",
+													 "__ToolchainKitShl64", "__ToolchainKitShr64"};
+
+				auto lhs = this->Read(instr.fLhs, "r10");
+				auto rhs = this->Read(instr.fRhs, "r11");
+
+				fOut << "\tmv r6, " << lhs << "\n";
+				fOut << "\tmv r7, " << rhs << "\n";
+				fOut << "\tlda r19, " << cHelpers[instr.fOp - ToolchainKit::kIRMul] << "\n";
+				fOut << "\tjrl\n";
+
+				this->Write(instr.fDst, "r19");
+				break;
+			}
+			case ToolchainKit::kIRCmpEq:
+			case ToolchainKit::kIRCmpNe:
+			case ToolchainKit::kIRCmpLt:
+			case ToolchainKit::kIRCmpLe:
+			case ToolchainKit::kIRCmpGt:
+			case ToolchainKit::kIRCmpGe: {
+				static const CharType* cBranches[] = {"beq", "bne", "bl", "ble", "bg", "bge"};
+
+				auto yes = this->LocalLabel();
+				auto end = this->LocalLabel();
+
+				auto lhs = this->Read(instr.fLhs, "r10");
+				auto rhs = this->Read(instr.fRhs, "r11");
+
+				this->Branch(cBranches[instr.fOp - ToolchainKit::kIRCmpEq], lhs, rhs, yes);
+				fOut << "\tldw r10, 0\n";
+				this->Branch("beq", "r0", "r0", end);
+				fOut << "public_segment .code64 " << yes << "\n";
+				fOut << "\tldw r10, 1\n";
+				fOut << "public_segment .code64 " << end << "\n";
+
+				this->Write(instr.fDst, "r10");
+				break;
+			}
+			case ToolchainKit::kIRNeg: {
+				auto value = this->Read(instr.fLhs, "r11");
+
+				fOut << "\tldw r10, 0\n";
+				fOut << "\tsub r10, " << value << "\n";
+
+				this->Write(instr.fDst, "r10");
+				break;
+			}
+			case ToolchainKit::kIRNot: {
+				auto value = this->Read(instr.fLhs, "r10");
+
+				fOut << "\tmv r6, " << value << "\n";
+				fOut << "\tldw r7, -1\n";
+				fOut << "\tlda r19, __ToolchainKitXor64\n";
+				fOut << "\tjrl\n";
+
+				this->Write(instr.fDst, "r19");
+				break;
+			}
+			case ToolchainKit::kIRCall:
+				if (instr.fArgs.size() > cArgs.size())
+					this->Fail("too many arguments for the 64x0 calling convention");
+
+				for (SizeType arg = 0; arg < instr.fArgs.size(); ++arg)
+				{
+					if (instr.fArgs[arg].fKind == ToolchainKit::IROperand::kImm)
+					{
+						fOut << "\tldw " << cArgs[arg] << ", " << instr.fArgs[arg].fValue << "\n";
+						continue;
+					}
+
+					auto value = this->Read(instr.fArgs[arg], "r10");
+					fOut << "\tmv " << cArgs[arg] << ", " << value << "\n";
+				}
+
+				fOut << "\tlda r19, " << instr.fLhs.fSymbol << "\n";
+				fOut << "\tjrl\n";
+
+				if (instr.fDst.fKind != ToolchainKit::IROperand::kNone)
+					this->Write(instr.fDst, "r19");
+
+				break;
+			case ToolchainKit::kIRRet:
+				if (instr.fLhs.fKind == ToolchainKit::IROperand::kImm)
+					fOut << "\tldw r19, " << instr.fLhs.fValue << "\n";
+				else if (instr.fLhs.fKind != ToolchainKit::IROperand::kNone)
+				{
+					auto value = this->Read(instr.fLhs, "r10");
+					fOut << "\tmv r19, " << value << "\n";
+				}
+
+				this->Epilogue();
+				break;
+			case ToolchainKit::kIRJump:
+				this->Branch("beq", "r0", "r0", this->LabelName(instr.fLabel));
+				break;
+			case ToolchainKit::kIRJumpIfZero:
+			case ToolchainKit::kIRJumpNotZero:
+				this->Branch(instr.fOp == ToolchainKit::kIRJumpIfZero ? "beq" : "bne",
+							 this->Read(instr.fLhs, "r10"), "r0", this->LabelName(instr.fLabel));
+				break;
+			case ToolchainKit::kIRLabel:
+				fOut << "public_segment .code64 " << this->LabelName(instr.fLabel) << "\n";
+				break;
+			default:
+				this->Fail("unknown IR opcode");
+			}
+		}
+	};
+
+	/////////////////////////////////////////////////////////////////////////////////////////
+
+	// @brief POWER selector, 64-bit ELF ABI: arguments in r3 to r10, result
+	// in r3, r1 is the stack pointer.
+
+	/////////////////////////////////////////////////////////////////////////////////////////
+
+	class IRSelectorPower64 final : public IRSelectorBase
+	{
+	public:
+		Int32 Arch() noexcept override
+		{
+			return ToolchainKit::AssemblyFactory::kArchPowerPC;
+		}
+
+	protected:
+		const std::vector<std::string>& Pool() override
+		{
+			// r11, r12 and r0 are scratch.
+			static const std::vector<std::string> cPool = {"r14", "r15", "r16", "r17", "r18", "r19", "r20", "r21"};
+			return cPool;
+		}
+
+		void Global(const ToolchainKit::IRGlobal& global) override
+		{
+			fOut << "public_segment .data64 " << global.fName << "\n";
+			fOut << "\t.quad " << global.fValue << "\n";
+		}
+
+		/// @brief linkage area, saved registers then spill slots, 16-byte aligned.
+		SizeType FrameSize()
+		{
+			return (48 + 8 * (fSaved.size() + fSlots) + 15) & ~15UL;
+		}
+
+		void Prologue(const ToolchainKit::IRFunction& fn) override
+		{
+			fOut << "public_segment .code64 " << fn.fName << "\n";
+			fOut << "\tmflr r0\n";
+			fOut << "\tstd r0, 16(r1)\n";
+			fOut << "\tstdu r1, -" << this->FrameSize() << "(r1)\n";
+
+			for (SizeType reg = 0; reg < fSaved.size(); ++reg)
+				fOut << "\tstd " << fSaved[reg] << ", " << 48 + reg * 8 << "(r1)\n";
+		}
+
+		void Epilogue()
+		{
+			for (SizeType reg = 0; reg < fSaved.size(); ++reg)
+				fOut << "\tld " << fSaved[reg] << ", " << 48 + reg * 8 << "(r1)\n";
+
+			fOut << "\taddi r1, r1, " << this->FrameSize() << "\n";
+			fOut << "\tld r0, 16(r1)\n";
+			fOut << "\tmtlr r0\n";
+			fOut << "\tblr\n";
+		}
+
+		SizeType SlotOffset(const ToolchainKit::IROperand& op)
+		{
+			return 48 + 8 * (fSaved.size() + this->Slot(op));
+		}
+
+		void LoadImm(const std::string& reg, Int64 value)
+		{
+			if (ir_fits(value, 16))
+			{
+				fOut << "\tli " << reg << ", " << value << "\n";
+				return;
+			}
+
+			if (ir_fits(value, 32))
+			{
+				fOut << "\tlis " << reg << ", " << ((value >> 16) & 0xFFFF) << "\n";
+				fOut << "\tori " << reg << ", " << reg << ", " << (value & 0xFFFF) << "\n";
+
+				return;
+			}
+
+			fOut << "\tlis " << reg << ", " << ((value >> 48) & 0xFFFF) << "\n";
+			fOut << "\tori " << reg << ", " << reg << ", " << ((value >> 32) & 0xFFFF) << "\n";
+			fOut << "\tsldi " << reg << ", " << reg << ", 32\n";
+			fOut << "\toris " << reg << ", " << reg << ", " << ((value >> 16) & 0xFFFF) << "\n";
+			fOut << "\tori " << reg << ", " << reg << ", " << (value & 0xFFFF) << "\n";
+		}
+
+		std::string Read(const ToolchainKit::IROperand& op, const char* scratch)
+		{
+			if (this->InRegister(op))
+				return this->Register(op);
+
+			if (op.fKind == ToolchainKit::IROperand::kImm)
+			{
+				this->LoadImm(scratch, op.fValue);
+			}
+			else if (op.fKind == ToolchainKit::IROperand::kSym)
+			{
+				fOut << "\tlis " << scratch << ", " << op.fSymbol << "@ha\n";
+				fOut << "\tld " << scratch << ", " << op.fSymbol << "@l(" << scratch << ")\n";
+			}
+			else
+			{
+				fOut << "\tld " << scratch << ", " << this->SlotOffset(op) << "(r1)\n";
+			}
+
+			return scratch;
+		}
+
+		void Write(const ToolchainKit::IROperand& dst, const std::string& reg)
+		{
+			if (dst.fKind == ToolchainKit::IROperand::kSym)
+			{
+				fOut << "\tlis r12, " << dst.fSymbol << "@ha\n";
+				fOut << "\tstd " << reg << ", " << dst.fSymbol << "@l(r12)\n";
+
+				return;
+			}
+
+			if (this->InRegister(dst))
+			{
+				if (this->Register(dst) != reg)
+					fOut << "\tmr " << this->Register(dst) << ", " << reg << "\n";
+
+				return;
+			}
+
+			fOut << "\tstd " << reg << ", " << this->SlotOffset(dst) << "(r1)\n";
+		}
+
+		void Instr(const ToolchainKit::IRInstr& instr) override
+		{
+			switch (instr.fOp)
+			{
+			case ToolchainKit::kIRConst:
+			case ToolchainKit::kIRCopy:
+			case ToolchainKit::kIRLoad:
+			case ToolchainKit::kIRStore:
+				if (this->InRegister(instr.fDst) && instr.fLhs.fKind == ToolchainKit::IROperand::kImm)
+				{
+					this->LoadImm(this->Register(instr.fDst), instr.fLhs.fValue);
+					break;
+				}
+
+				this->Write(instr.fDst, this->Read(instr.fLhs, "r11"));
+				break;
+			case ToolchainKit::kIRParam:
+				if (instr.fLhs.fValue >= 8)
+					this->Fail("too many parameters for the POWER calling convention");
+
+				this->Write(instr.fDst, "r" + std::to_string(3 + instr.fLhs.fValue));
+				break;
+			case ToolchainKit::kIRAdd:
+				if (instr.fRhs.fKind == ToolchainKit::IROperand::kImm && ir_fits(instr.fRhs.fValue, 16))
+				{
+					auto lhs = this->Read(instr.fLhs, "r11");
+
+					fOut << "\taddi r11, " << lhs << ", " << instr.fRhs.fValue << "\n";
+					this->Write(instr.fDst, "r11");
+
+					break;
+				}
+
+				[[fallthrough]];
+			case ToolchainKit::kIRSub:
+			case ToolchainKit::kIRMul:
+			case ToolchainKit::kIRDiv:
+			case ToolchainKit::kIRAnd:
+			case ToolchainKit::kIROr:
+			case ToolchainKit::kIRXor:
+			case ToolchainKit::kIRShl:
+			case ToolchainKit::kIRShr: {
+				auto lhs = this->Read(instr.fLhs, "r11");
+				auto rhs = this->Read(instr.fRhs, "r12");
+
+				switch (instr.fOp)
+				{
+				case ToolchainKit::kIRAdd:
+					fOut << "\tadd r11, " << lhs << ", " << rhs << "\n";
+					break;
+				case ToolchainKit::kIRSub:
+					fOut << "\tsubf r11, " << rhs << ", " << lhs << "\n";
+					break;
+				case ToolchainKit::kIRMul:
+					fOut << "\tmulld r11, " << lhs << ", " << rhs << "\n";
+					break;
+				case ToolchainKit::kIRDiv:
+					fOut << "\tdivd r11, " << lhs << ", " << rhs << "\n";
+					break;
+				case ToolchainKit::kIRAnd:
+					fOut << "\tand r11, " << lhs << ", " << rhs << "\n";
+					break;
+				case ToolchainKit::kIROr:
+					fOut << "\tor r11, " << lhs << ", " << rhs << "\n";
+					break;
+				case ToolchainKit::kIRXor:
+					fOut << "\txor r11, " << lhs << ", " << rhs << "\n";
+					break;
+				case ToolchainKit::kIRShl:
+					fOut << "\tsld r11, " << lhs << ", " << rhs << "\n";
+					break;
+				default:
+					fOut << "\tsrad r11, " << lhs << ", " << rhs << "\n";
+					break;
+				}
+
+				this->Write(instr.fDst, "r11");
+				break;
+			}
+			case ToolchainKit::kIRMod: {
+				auto lhs = this->Read(instr.fLhs, "r11");
+				auto rhs = this->Read(instr.fRhs, "r12");
+
+				fOut << "\tdivd r0, " << lhs << ", " << rhs << "\n";
+				fOut << "\tmulld r0, r0, " << rhs << "\n";
+				fOut << "\tsubf r11, r0, " << lhs << "\n";
+
+				this->Write(instr.fDst, "r11");
+				break;
+			}
+			case ToolchainKit::kIRCmpEq:
+			case ToolchainKit::kIRCmpNe:
+			case ToolchainKit::kIRCmpLt:
+			case ToolchainKit::kIRCmpLe:
+			case ToolchainKit::kIRCmpGt:
+			case ToolchainKit::kIRCmpGe: {
+				static const CharType* cBranches[] = {"beq", "bne", "blt", "ble", "bgt", "bge"};
+
+				auto yes = this->LocalLabel();
+
+				auto lhs = this->Read(instr.fLhs, "r11");
+				auto rhs = this->Read(instr.fRhs, "r12");
+
+				fOut << "\tcmpd " << lhs << ", " << rhs << "\n";
+				fOut << "\tli r11, 1\n";
+				fOut << "\t" << cBranches[instr.fOp - ToolchainKit::kIRCmpEq] << " " << yes << "\n";
+				fOut << "\tli r11, 0\n";
+				fOut << "public_segment .code64 " << yes << "\n";
+
+				this->Write(instr.fDst, "r11");
+				break;
+			}
+			case ToolchainKit::kIRNeg: {
+				auto value = this->Read(instr.fLhs, "r11");
+
+				fOut << "\tneg r11, " << value << "\n";
+				this->Write(instr.fDst, "r11");
+
+				break;
+			}
+			case ToolchainKit::kIRNot: {
+				auto value = this->Read(instr.fLhs, "r11");
+
+				fOut << "\tnor r11, " << value << ", " << value << "\n";
+				this->Write(instr.fDst, "r11");
+
+				break;
+			}
+			case ToolchainKit::kIRCall:
+				if (instr.fArgs.size() > 8)
+					this->Fail("too many arguments for the POWER calling convention");
+
+				for (SizeType arg = 0; arg < instr.fArgs.size(); ++arg)
+				{
+					auto reg = "r" + std::to_string(3 + arg);
+
+					if (instr.fArgs[arg].fKind == ToolchainKit::IROperand::kImm)
+					{
+						this->LoadImm(reg, instr.fArgs[arg].fValue);
+						continue;
+					}
+
+					auto value = this->Read(instr.fArgs[arg], "r11");
+					fOut << "\tmr " << reg << ", " << value << "\n";
+				}
+
+				fOut << "\tbl " << instr.fLhs.fSymbol << "\n";
+
+				if (instr.fDst.fKind != ToolchainKit::IROperand::kNone)
+					this->Write(instr.fDst, "r3");
+
+				break;
+			case ToolchainKit::kIRRet:
+				if (instr.fLhs.fKind == ToolchainKit::IROperand::kImm)
+					this->LoadImm("r3", instr.fLhs.fValue);
+				else if (instr.fLhs.fKind != ToolchainKit::IROperand::kNone)
+				{
+					auto value = this->Read(instr.fLhs, "r11");
+					fOut << "\tmr r3, " << value << "\n";
+				}
+
+				this->Epilogue();
+				break;
+			case ToolchainKit::kIRJump:
+				fOut << "\tb " << this->LabelName(instr.fLabel) << "\n";
+				break;
+			case ToolchainKit::kIRJumpIfZero:
+			case ToolchainKit::kIRJumpNotZero: {
+				auto value = this->Read(instr.fLhs, "r11");
+
+				fOut << "\tcmpdi " << value << ", 0\n";
+				fOut << (instr.fOp == ToolchainKit::kIRJumpIfZero ? "\tbeq " : "\tbne ") << this->LabelName(instr.fLabel) << "\n";
+				break;
+			}
+			case ToolchainKit::kIRLabel:
+				fOut << "public_segment .code64 " << this->LabelName(instr.fLabel) << "\n";
+				break;
+			default:
+				this->Fail("unknown IR opcode");
+			}
+		}
+	};
+} // namespace Details
+
+namespace ToolchainKit
+{
+	std::unique_ptr<IRSelector> ir_selector_for(Int32 arch)
+	{
+		switch (arch)
+		{
+		case AssemblyFactory::kArchAMD64:
+			return std::make_unique<Details::IRSelectorAMD64>();
+		case AssemblyFactory::kArch64x0:
+			return std::make_unique<Details::IRSelector64x0>();
+		case AssemblyFactory::kArchPowerPC:
+			return std::make_unique<Details::IRSelectorPower64>();
+		default:
+			return nullptr;
+		}
+	}
+} // namespace ToolchainKit
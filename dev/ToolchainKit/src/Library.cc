@@ -0,0 +1,81 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+/// @file Library.cc
+/// @brief Static library index lookups.
+
+#include <ToolchainKit/NFC/Library.h>
+#include <ToolchainKit/NFC/PEF.h>
+
+namespace ToolchainKit
+{
+	Bool LibraryReader::Open(const std::string& path)
+	{
+		fFile = std::ifstream(path, std::ios::binary);
+
+		if (!fFile.read(reinterpret_cast<CharType*>(&fHeader), sizeof(LibraryHeader)) ||
+			memcmp(fHeader.fMagic, kLibMagic, kLibMagicLen) != 0 || fHeader.fVersion != kLibVersion ||
+			fHeader.fBucketCount == 0U)
+			return false;
+
+		// the tables are a few bytes a symbol, a bigger header is a corrupted one.
+		auto size = std::filesystem::file_size(path);
+
+		if (fHeader.fStringsSize > size || fHeader.fMemberCount > size / sizeof(LibraryMember) ||
+			fHeader.fSymbolCount > size / sizeof(LibrarySymbol) || fHeader.fBucketCount > size / sizeof(UInt32))
+			return false;
+
+		fMembers.resize(fHeader.fMemberCount);
+		fSymbols.resize(fHeader.fSymbolCount);
+		fBuckets.resize(fHeader.fBucketCount);
+		fStrings.resize(fHeader.fStringsSize);
+
+		fFile.read(reinterpret_cast<CharType*>(fMembers.data()), fMembers.size() * sizeof(LibraryMember));
+		fFile.read(reinterpret_cast<CharType*>(fSymbols.data()), fSymbols.size() * sizeof(LibrarySymbol));
+		fFile.read(reinterpret_cast<CharType*>(fBuckets.data()), fBuckets.size() * sizeof(UInt32));
+		fFile.read(fStrings.data(), fStrings.size());
+
+		if (!fFile.good())
+			return false;
+
+		for (auto& member : fMembers)
+		{
+			if (member.fName >= fStrings.size() || member.fOffset + member.fSize > size)
+				return false;
+		}
+
+		for (auto& symbol : fSymbols)
+		{
+			if (symbol.fName >= fStrings.size() || symbol.fMember >= fMembers.size())
+				return false;
+		}
+
+		// the pool ends with a NUL, every name does.
+		return fStrings.empty() || fStrings.back() == 0;
+	}
+
+	Int64 LibraryReader::Find(const std::string& symbol) const
+	{
+		auto hash = Utils::pef_hash(symbol.c_str());
+		auto at	  = fBuckets[hash % fHeader.fBucketCount];
+
+		if (at == kLibBucketEmpty)
+			return -1L;
+
+		for (; at < fSymbols.size() && fSymbols[at].fHash % fHeader.fBucketCount == hash % fHeader.fBucketCount; ++at)
+		{
+			if (fSymbols[at].fHash == hash && symbol == fStrings.c_str() + fSymbols[at].fName)
+				return fSymbols[at].fMember;
+		}
+
+		return -1L;
+	}
+
+	std::string LibraryReader::Name(UInt32 offset) const
+	{
+		return offset < fStrings.size() ? fStrings.c_str() + offset : "";
+	}
+} // namespace ToolchainKit
@@ -0,0 +1,270 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+	@file LibraryArchiver64.cc
+	@brief Static library archiver, packs AE objects and indexes their symbols.
+
+------------------------------------------- */
+
+#include <ToolchainKit/Defines.h>
+#include <ToolchainKit/NFC/ErrorID.h>
+#include <ToolchainKit/NFC/AE.h>
+#include <ToolchainKit/NFC/PEF.h>
+#include <ToolchainKit/NFC/Library.h>
+#include <ToolchainKit/Version.h>
+#include <algorithm>
+#include <iterator>
+#include <unordered_map>
+
+#define kArchiverVersionStr "ELMH 64-Bit Library Archiver %s, (c) Amlal EL Mahrouss 2024, all rights reserved.\n"
+
+#define kWhite	"\e[0;97m"
+#define kStdOut (std::cout << kWhite)
+
+#define kUndefinedSymbol ":UndefinedSymbol:"
+
+namespace Details
+{
+	struct archiver_member final
+	{
+		std::string			  fName;
+		std::vector<CharType> fBytes;
+	};
+
+	struct archiver_symbol final
+	{
+		std::string fName;
+		UInt32		fMember;
+		UInt32		fHash;
+	};
+
+	static Bool archiver_verbose = false;
+
+	/// @brief Print the members and the index of a library.
+	static Int32 archiver_list(const std::string& path)
+	{
+		ToolchainKit::LibraryReader library;
+
+		if (!library.Open(path))
+		{
+			kStdOut << "ar64: not a library: " << path << std::endl;
+			return TOOLCHAINKIT_EXEC_ERROR;
+		}
+
+		for (auto& member : library.Members())
+			kStdOut << "ar64: member " << library.Name(member.fName) << ", " << member.fSize << " bytes.\n";
+
+		for (auto& symbol : library.Symbols())
+			kStdOut << "ar64: symbol " << library.Name(symbol.fName) << " in "
+					<< library.Name(library.Members()[symbol.fMember].fName) << "\n";
+
+		return EXIT_SUCCESS;
+	}
+} // namespace Details
+
+/// @brief Library archiver entrypoint.
+TOOLCHAINKIT_MODULE(LibraryArchiver64)
+{
+	std::string				 output;
+	std::vector<std::string> inputs;
+
+	Details::archiver_verbose = false;
+
+	for (SizeType index_arg = 1; index_arg < SizeType(argc); ++index_arg)
+	{
+		if (strcmp(argv[index_arg], "--ar64:h") == 0 || strcmp(argv[index_arg], "--ar64:help") == 0)
+		{
+			printf(kWhite kArchiverVersionStr, kDistVersion);
+
+			kStdOut << "--ar64:output <file>: Write the library to file (" kPefLibExt ").\n";
+			kStdOut << "--ar64:list <file>: Print the members and the symbol index of a library.\n";
+			kStdOut << "--ar64:verbose: Trace what goes in.\n";
+
+			return EXIT_SUCCESS;
+		}
+		else if (strcmp(argv[index_arg], "--ar64:output") == 0 && index_arg + 1 < SizeType(argc))
+		{
+			output = argv[++index_arg];
+		}
+		else if (strcmp(argv[index_arg], "--ar64:list") == 0 && index_arg + 1 < SizeType(argc))
+		{
+			return Details::archiver_list(argv[++index_arg]);
+		}
+		else if (strcmp(argv[index_arg], "--ar64:verbose") == 0)
+		{
+			Details::archiver_verbose = true;
+		}
+		else if (argv[index_arg][0] == '-')
+		{
+			kStdOut << "ar64: unknown flag: " << argv[index_arg] << "\n";
+			return EXIT_FAILURE;
+		}
+		else
+		{
+			inputs.emplace_back(argv[index_arg]);
+		}
+	}
+
+	if (output.empty() || inputs.empty())
+	{
+		kStdOut << "ar64: needs --ar64:output <file> and objects." << std::endl;
+		return TOOLCHAINKIT_EXEC_ERROR;
+	}
+
+	std::vector<Details::archiver_member>		members;
+	std::vector<Details::archiver_symbol>		symbols;
+	std::unordered_map<std::string, SizeType> defined;
+	UInt32									  arch = ToolchainKit::kPefArchInvalid;
+
+	for (auto& input : inputs)
+	{
+		std::ifstream file(input, std::ios::binary);
+
+		ToolchainKit::AEHeader hdr{};
+		file >> hdr;
+
+		if (!file.good() || hdr.fMagic[0] != kAEMag0 || hdr.fMagic[1] != kAEMag1 ||
+			hdr.fSize != sizeof(ToolchainKit::AEHeader))
+		{
+			kStdOut << "ar64: not an object container: " << input << std::endl;
+			return TOOLCHAINKIT_EXEC_ERROR;
+		}
+
+		if (arch != ToolchainKit::kPefArchInvalid && arch != UInt32(hdr.fArch))
+		{
+			kStdOut << "ar64: object " << input << " is of another architecture than the library." << std::endl;
+			return TOOLCHAINKIT_FAT_ERROR;
+		}
+
+		arch = hdr.fArch;
+
+		std::vector<ToolchainKit::AERecordHeader> records;
+
+		if (!ToolchainKit::Utils::ae_read_records(file, hdr, records))
+		{
+			kStdOut << "ar64: bad records in object " << input << std::endl;
+			return TOOLCHAINKIT_EXEC_ERROR;
+		}
+
+		// index what the member defines, as ld64 matches it: without the segment prefix.
+		for (auto& record : records)
+		{
+			std::string name(record.fName, strnlen(record.fName, kAESymbolLen));
+
+			if (name.empty() || record.fKind == kAENullType || name.find(kUndefinedSymbol) != std::string::npos)
+				continue;
+
+			std::string symbol = ToolchainKit::Utils::pef_symbol_name(name.c_str());
+
+			if (!defined.try_emplace(symbol, members.size()).second)
+			{
+				if (Details::archiver_verbose)
+					kStdOut << "ar64: " << symbol << " of " << input << " is already defined, the first one is indexed.\n";
+
+				continue;
+			}
+
+			symbols.push_back({symbol, UInt32(members.size()), ToolchainKit::Utils::pef_hash(symbol.c_str())});
+		}
+
+		file.clear();
+		file.seekg(0);
+
+		Details::archiver_member member{std::filesystem::path(input).filename().string(), {}};
+		member.fBytes.assign(std::istreambuf_iterator<CharType>(file), std::istreambuf_iterator<CharType>());
+
+		if (Details::archiver_verbose)
+			kStdOut << "ar64: member " << member.fName << ", " << member.fBytes.size() << " bytes.\n";
+
+		members.push_back(std::move(member));
+	}
+
+	ToolchainKit::LibraryHeader hdr{};
+
+	memcpy(hdr.fMagic, kLibMagic, kLibMagicLen);
+
+	hdr.fVersion	 = kLibVersion;
+	hdr.fArch		 = arch;
+	hdr.fMemberCount = members.size();
+	hdr.fSymbolCount = symbols.size();
+	hdr.fBucketCount = symbols.size() / 4U + 1U;
+
+	// a bucket is a run of symbols.
+	std::stable_sort(symbols.begin(), symbols.end(), [&hdr](auto& lhs, auto& rhs) {
+		return lhs.fHash % hdr.fBucketCount < rhs.fHash % hdr.fBucketCount;
+	});
+
+	std::string									   strings;
+	std::unordered_map<std::string, UInt32> string_offsets;
+
+	auto intern = [&](const std::string& name) {
+		auto [it, inserted] = string_offsets.try_emplace(name, strings.size());
+
+		if (inserted)
+		{
+			strings += name;
+			strings.push_back(0);
+		}
+
+		return it->second;
+	};
+
+	std::vector<ToolchainKit::LibraryMember> member_table;
+	std::vector<ToolchainKit::LibrarySymbol> symbol_table;
+	std::vector<UInt32>						 buckets(hdr.fBucketCount, kLibBucketEmpty);
+
+	for (auto& member : members)
+		member_table.push_back({intern(member.fName), 0U, 0UL, member.fBytes.size()});
+
+	for (UInt32 index = 0U; index < symbols.size(); ++index)
+	{
+		symbol_table.push_back({intern(symbols[index].fName), symbols[index].fMember, symbols[index].fHash});
+
+		if (buckets[symbols[index].fHash % hdr.fBucketCount] == kLibBucketEmpty)
+			buckets[symbols[index].fHash % hdr.fBucketCount] = index;
+	}
+
+	hdr.fStringsSize = strings.size();
+
+	UInt64 offset = sizeof(ToolchainKit::LibraryHeader) + member_table.size() * sizeof(ToolchainKit::LibraryMember) +
+					symbol_table.size() * sizeof(ToolchainKit::LibrarySymbol) + buckets.size() * sizeof(UInt32) + strings.size();
+
+	for (auto& member : member_table)
+	{
+		offset		   = (offset + 7UL) & ~7UL;
+		member.fOffset = offset;
+		offset += member.fSize;
+	}
+
+	std::ofstream out(output, std::ios::binary);
+
+	out.write(reinterpret_cast<const CharType*>(&hdr), sizeof(ToolchainKit::LibraryHeader));
+	out.write(reinterpret_cast<const CharType*>(member_table.data()), member_table.size() * sizeof(ToolchainKit::LibraryMember));
+	out.write(reinterpret_cast<const CharType*>(symbol_table.data()), symbol_table.size() * sizeof(ToolchainKit::LibrarySymbol));
+	out.write(reinterpret_cast<const CharType*>(buckets.data()), buckets.size() * sizeof(UInt32));
+	out.write(strings.data(), strings.size());
+
+	for (size_t index = 0UL; index < members.size(); ++index)
+	{
+		std::vector<CharType> padding(member_table[index].fOffset - UInt64(out.tellp()), 0);
+
+		out.write(padding.data(), padding.size());
+		out.write(members[index].fBytes.data(), members[index].fBytes.size());
+	}
+
+	if (!out.good())
+	{
+		kStdOut << "ar64: can't write " << output << std::endl;
+
+		out.close();
+		std::filesystem::remove(output);
+
+		return TOOLCHAINKIT_EXEC_ERROR;
+	}
+
+	if (Details::archiver_verbose)
+		kStdOut << "ar64: wrote " << output << ", " << members.size() << " members, " << symbols.size() << " symbols.\n";
+
+	return EXIT_SUCCESS;
+}
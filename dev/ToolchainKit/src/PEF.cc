@@ -0,0 +1,193 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+/// @file PEF.cc
+/// @brief PEF v4 symbol hash section and fat slice index, built by ld64 and read by loaders.
+
+#include <ToolchainKit/NFC/PEF.h>
+#include <algorithm>
+
+#define kPefBloomShift (6U)
+
+namespace ToolchainKit::Utils
+{
+	std::vector<CharType> pef_build_symbol_hash(std::vector<PEFCommandHeaderV4>& commands, SizeType symbol_base, const std::string& strings)
+	{
+		UInt32 count = commands.size() - symbol_base;
+
+		PEFHashHeader hdr{};
+
+		hdr.SymbolBase	= symbol_base;
+		hdr.BucketCount = std::max<UInt32>(1U, count / 4U + 1U);
+		hdr.BloomCount	= 1U;
+		hdr.BloomShift	= kPefBloomShift;
+
+		// about eight symbols a bloom word, a power of two.
+		while (hdr.BloomCount * 8U < count)
+			hdr.BloomCount <<= 1;
+
+		std::vector<UInt32> hashes(commands.size());
+
+		for (SizeType index = symbol_base; index < commands.size(); ++index)
+			hashes[index] = pef_hash(pef_symbol_name(strings.c_str() + commands[index].Name));
+
+		// a bucket is a run of commands, sort them by bucket.
+		std::vector<SizeType> order(count);
+
+		for (SizeType index = 0UL; index < count; ++index)
+			order[index] = symbol_base + index;
+
+		std::stable_sort(order.begin(), order.end(), [&](SizeType lhs, SizeType rhs) {
+			return hashes[lhs] % hdr.BucketCount < hashes[rhs] % hdr.BucketCount;
+		});
+
+		std::vector<PEFCommandHeaderV4> sorted(commands.begin(), commands.begin() + symbol_base);
+		std::vector<UInt32>				sorted_hashes(count);
+
+		for (SizeType index = 0UL; index < count; ++index)
+		{
+			sorted.push_back(commands[order[index]]);
+			sorted_hashes[index] = hashes[order[index]];
+		}
+
+		commands = std::move(sorted);
+
+		std::vector<UInt64> bloom(hdr.BloomCount, 0UL);
+		std::vector<UInt32> buckets(hdr.BucketCount, kPefHashEmpty);
+		std::vector<UInt32> chains(count);
+
+		for (SizeType index = 0UL; index < count; ++index)
+		{
+			auto hash	= sorted_hashes[index];
+			auto bucket = hash % hdr.BucketCount;
+
+			bloom[(hash / 64U) % hdr.BloomCount] |= (1UL << (hash % 64U)) | (1UL << ((hash >> hdr.BloomShift) % 64U));
+
+			if (buckets[bucket] == kPefHashEmpty)
+				buckets[bucket] = symbol_base + index;
+
+			Bool last = index + 1 == count || sorted_hashes[index + 1] % hdr.BucketCount != bucket;
+
+			chains[index] = (hash & ~1U) | (last ? 1U : 0U);
+		}
+
+		std::vector<CharType> section(sizeof(PEFHashHeader));
+		memcpy(section.data(), &hdr, sizeof(PEFHashHeader));
+
+		auto append = [&section](const void* data, SizeType size) {
+			auto at = section.size();
+			section.resize(at + size);
+			memcpy(section.data() + at, data, size);
+		};
+
+		append(bloom.data(), bloom.size() * sizeof(UInt64));
+		append(buckets.data(), buckets.size() * sizeof(UInt32));
+		append(chains.data(), chains.size() * sizeof(UInt32));
+
+		return section;
+	}
+
+	Bool pef_find_symbol(const CharType* image, SizeType size, const CharType* name, PEFCommandHeaderV4& command)
+	{
+		if (size < sizeof(PEFContainer) + sizeof(PEFIndex))
+			return false;
+
+		PEFContainer container;
+		memcpy(&container, image, sizeof(PEFContainer));
+
+		if (container.Version != kPefVersion4 || container.HdrSz < sizeof(PEFContainer) + sizeof(PEFIndex))
+			return false;
+
+		PEFIndex index;
+		memcpy(&index, image + sizeof(PEFContainer), sizeof(PEFIndex));
+
+		auto commands_at = container.HdrSz;
+
+		if (commands_at + container.Count * sizeof(PEFCommandHeaderV4) > size ||
+			index.StringsOffset + index.StringsSize > size ||
+			index.HashOffset + index.HashSize > size ||
+			index.HashSize < sizeof(PEFHashHeader))
+			return false;
+
+		PEFHashHeader hdr;
+		memcpy(&hdr, image + index.HashOffset, sizeof(PEFHashHeader));
+
+		if (hdr.BucketCount == 0U || hdr.BloomCount == 0U || hdr.SymbolBase > container.Count ||
+			sizeof(PEFHashHeader) + hdr.BloomCount * sizeof(UInt64) + hdr.BucketCount * sizeof(UInt32) +
+					(container.Count - hdr.SymbolBase) * sizeof(UInt32) >
+				index.HashSize)
+			return false;
+
+		auto bloom_at  = index.HashOffset + sizeof(PEFHashHeader);
+		auto bucket_at = bloom_at + hdr.BloomCount * sizeof(UInt64);
+		auto chain_at  = bucket_at + hdr.BucketCount * sizeof(UInt32);
+
+		auto hash = pef_hash(name);
+
+		UInt64 word;
+		memcpy(&word, image + bloom_at + ((hash / 64U) % hdr.BloomCount) * sizeof(UInt64), sizeof(UInt64));
+
+		UInt64 mask = (1UL << (hash % 64U)) | (1UL << ((hash >> hdr.BloomShift) % 64U));
+
+		if ((word & mask) != mask)
+			return false;
+
+		UInt32 at;
+		memcpy(&at, image + bucket_at + (hash % hdr.BucketCount) * sizeof(UInt32), sizeof(UInt32));
+
+		if (at == kPefHashEmpty)
+			return false;
+
+		for (; at >= hdr.SymbolBase && at < container.Count; ++at)
+		{
+			UInt32 chain;
+			memcpy(&chain, image + chain_at + (at - hdr.SymbolBase) * sizeof(UInt32), sizeof(UInt32));
+
+			if ((chain | 1U) == (hash | 1U))
+			{
+				memcpy(&command, image + commands_at + at * sizeof(PEFCommandHeaderV4), sizeof(PEFCommandHeaderV4));
+
+				if (command.Name < index.StringsSize)
+				{
+					auto pool  = image + index.StringsOffset;
+					auto entry = pool + command.Name;
+
+					if (memchr(entry, 0, index.StringsSize - command.Name) &&
+						strcmp(pef_symbol_name(entry), name) == 0)
+						return true;
+				}
+			}
+
+			if (chain & 1U)
+				break;
+		}
+
+		return false;
+	}
+
+	Bool pef_find_slice(const CharType* image, SizeType size, UInt32 cpu, PEFFatSlice& slice)
+	{
+		if (size < sizeof(PEFFatHeader))
+			return false;
+
+		PEFFatHeader hdr;
+		memcpy(&hdr, image, sizeof(PEFFatHeader));
+
+		if (memcmp(hdr.Magic, kPefMagicFat, kPefMagicLen) != 0 ||
+			sizeof(PEFFatHeader) + hdr.Count * sizeof(PEFFatSlice) > size)
+			return false;
+
+		for (UInt32 index = 0U; index < hdr.Count; ++index)
+		{
+			memcpy(&slice, image + sizeof(PEFFatHeader) + index * sizeof(PEFFatSlice), sizeof(PEFFatSlice));
+
+			if (slice.Cpu == cpu)
+				return slice.Offset <= size && slice.Size <= size - slice.Offset;
+		}
+
+		return false;
+	}
+} // namespace ToolchainKit::Utils
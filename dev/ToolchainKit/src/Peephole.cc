@@ -0,0 +1,1070 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+/// @file Peephole.cc
+/// @brief Peephole optimizer over generated assembly.
+/// Every rule only looks at straight-line code, a label, a directive or a
+/// branch ends the window.
+
+#include <ToolchainKit/AAL/Peephole.h>
+#include <algorithm>
+
+namespace Details
+{
+	/// @brief trim spaces, tabs and carriage returns on both ends.
+	static std::string peephole_trim(const std::string& str)
+	{
+		auto first = str.find_first_not_of(" \t\r");
+
+		if (first == std::string::npos)
+			return "";
+
+		auto last = str.find_last_not_of(" \t\r");
+		return str.substr(first, last - first + 1);
+	}
+
+	/// @brief split operands on ',' while ignoring the ones inside brackets.
+	static std::vector<std::string> peephole_split(const std::string& str)
+	{
+		std::vector<std::string> out;
+		std::string				 cur;
+		Int32					 depth = 0;
+
+		for (auto ch : str)
+		{
+			if (ch == '[' || ch == '(')
+				++depth;
+			else if (ch == ']' || ch == ')')
+				--depth;
+
+			if (ch == ',' && depth == 0)
+			{
+				out.push_back(peephole_trim(cur));
+				cur.clear();
+
+				continue;
+			}
+
+			cur += ch;
+		}
+
+		if (!peephole_trim(cur).empty())
+			out.push_back(peephole_trim(cur));
+
+		return out;
+	}
+
+	static Bool peephole_is_imm(const std::string& op)
+	{
+		if (op.empty())
+			return false;
+
+		SizeType i = (op[0] == '-') ? 1 : 0;
+
+		if (i >= op.size())
+			return false;
+
+		if (op.size() > i + 2 && op[i] == '0' && (op[i + 1] == 'x' || op[i + 1] == 'X'))
+			return std::all_of(op.begin() + i + 2, op.end(), ::isxdigit);
+
+		return std::all_of(op.begin() + i, op.end(), ::isdigit);
+	}
+
+	static Int64 peephole_imm(const std::string& op)
+	{
+		return strtoll(op.c_str(), nullptr, 0);
+	}
+
+	/// @brief collect every identifier in an operand.
+	static std::vector<std::string> peephole_words(const std::string& op)
+	{
+		std::vector<std::string> words;
+		std::string				 cur;
+
+		for (auto ch : op)
+		{
+			if (isalnum(ch) || ch == '_')
+			{
+				cur += ch;
+				continue;
+			}
+
+			if (!cur.empty())
+				words.push_back(cur);
+
+			cur.clear();
+		}
+
+		if (!cur.empty())
+			words.push_back(cur);
+
+		return words;
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////
+
+	// @brief AMD64 target description.
+
+	/////////////////////////////////////////////////////////////////////////////////////////
+
+	struct PeepholeAMD64 final
+	{
+		/// @brief map a register to its 64-bit family, so that eax and rax alias.
+		static std::string Family(const std::string& reg)
+		{
+			static const std::vector<std::vector<std::string>> cFamilies = {
+				{"rax", "eax", "ax", "al", "ah"},
+				{"rbx", "ebx", "bx", "bl", "bh"},
+				{"rcx", "ecx", "cx", "cl", "ch"},
+				{"rdx", "edx", "dx", "dl", "dh"},
+				{"rsi", "esi", "si", "sil"},
+				{"rdi", "edi", "di", "dil"},
+				{"rbp", "ebp", "bp", "bpl"},
+				{"rsp", "esp", "sp", "spl"},
+			};
+
+			for (auto& family : cFamilies)
+			{
+				if (std::find(family.begin(), family.end(), reg) != family.end())
+					return family[0];
+			}
+
+			// r8 to r15, with their d, w and b suffixes.
+			if (reg.size() > 1 && reg[0] == 'r' && isdigit(reg[1]))
+			{
+				std::string base = "r";
+
+				for (SizeType i = 1; i < reg.size() && isdigit(reg[i]); ++i)
+					base += reg[i];
+
+				return base;
+			}
+
+			if (reg.starts_with("xmm") || reg.starts_with("ymm") || reg.starts_with("zmm"))
+				return "xmm" + reg.substr(3);
+
+			return "";
+		}
+
+		static Bool IsRegister(const std::string& op)
+		{
+			return !Family(op).empty();
+		}
+
+		static Bool IsMemory(const std::string& op)
+		{
+			return op.find('[') != std::string::npos;
+		}
+
+		static Bool IsControlFlow(const std::string& mnemonic)
+		{
+			return mnemonic[0] == 'j' || mnemonic == "call" || mnemonic.starts_with("ret") ||
+				   mnemonic.starts_with("int") || mnemonic == "iret" || mnemonic == "syscall" ||
+				   mnemonic == "hlt" || mnemonic == "loop";
+		}
+
+		/// @brief instructions whose register use is fully spelled out in the operands.
+		static Bool IsExplicit(const std::string& mnemonic)
+		{
+			static const std::vector<std::string> cExplicit = {
+				"mov", "movzx", "movsx", "lea", "add", "sub", "and", "or",
+				"xor", "cmp", "test", "inc", "dec", "neg", "not", "nop"};
+
+			return std::find(cExplicit.begin(), cExplicit.end(), mnemonic) != cExplicit.end();
+		}
+
+		/// @brief a branch reads them too, its target may test them.
+		static Bool ReadsFlags(const std::string& mnemonic)
+		{
+			return mnemonic[0] == 'j' || mnemonic.starts_with("set") || mnemonic.starts_with("cmov") ||
+				   mnemonic == "adc" || mnemonic == "sbb" || mnemonic.starts_with("pushf") ||
+				   mnemonic == "rcl" || mnemonic == "rcr" || mnemonic == "cmc" || mnemonic == "lahf" ||
+				   mnemonic.starts_with("loop");
+		}
+
+		/// @brief instructions after which the old flags are gone: a full write, or a call or return.
+		static Bool WritesFlags(const std::string& mnemonic)
+		{
+			static const std::vector<std::string> cWriters = {
+				"add", "sub", "and", "or", "xor", "cmp", "test", "neg", "call", "syscall", "hlt"};
+
+			return mnemonic.starts_with("ret") || std::find(cWriters.begin(), cWriters.end(), mnemonic) != cWriters.end();
+		}
+
+		/// @brief the width of reg in bits, 64 for the full registers.
+		static Int32 Width(const std::string& reg)
+		{
+			static const std::vector<std::string> cByte = {"al", "ah", "bl", "bh", "cl", "ch", "dl", "dh", "sil", "dil", "bpl", "spl"};
+			static const std::vector<std::string> cWord = {"ax", "bx", "cx", "dx", "si", "di", "bp", "sp"};
+
+			if (std::find(cByte.begin(), cByte.end(), reg) != cByte.end())
+				return 8;
+
+			if (std::find(cWord.begin(), cWord.end(), reg) != cWord.end())
+				return 16;
+
+			if (reg[0] == 'e')
+				return 32;
+
+			// r8d, r8w and r8b.
+			if (reg[0] == 'r' && !isdigit(reg.back()))
+				return reg.back() == 'd' ? 32 : (reg.back() == 'w' ? 16 : (reg.back() == 'b' ? 8 : 64));
+
+			return 64;
+		}
+
+		/// @brief mov eax, eax clears the upper half, only 64-bit moves are no-ops.
+		static Bool CanDropSelfMove(const std::string& reg)
+		{
+			return reg[0] == 'r' || reg.starts_with("xmm");
+		}
+
+		static Bool IsMove(const ToolchainKit::PeepholeInstr& instr)
+		{
+			return instr.fMnemonic == "mov" && instr.fOperands.size() == 2 &&
+				   IsRegister(instr.fOperands[0]) && IsRegister(instr.fOperands[1]);
+		}
+
+		static Bool IsLoadImm(const ToolchainKit::PeepholeInstr& instr)
+		{
+			return instr.fMnemonic == "mov" && instr.fOperands.size() == 2 &&
+				   IsRegister(instr.fOperands[0]) && peephole_is_imm(instr.fOperands[1]);
+		}
+
+		static void MakeLoadImm(ToolchainKit::PeepholeInstr& instr, const std::string& reg, Int64 value)
+		{
+			instr.fMnemonic = "mov";
+			instr.fOperands = {reg, std::to_string(value)};
+		}
+
+		/// @brief does instr overwrite reg without reading it?
+		static Bool WritesOnly(const ToolchainKit::PeepholeInstr& instr, const std::string& family)
+		{
+			if (instr.fMnemonic != "mov" && instr.fMnemonic != "lea" &&
+				instr.fMnemonic != "movzx" && instr.fMnemonic != "movsx")
+				return false;
+
+			if (instr.fOperands.size() != 2)
+				return false;
+
+			// only 64 and 32-bit writes kill the old value, a 32-bit one clears the upper half.
+			// r8w and r8b leave the rest of r8 as it was.
+			auto& dst = instr.fOperands[0];
+
+			if ((dst[0] != 'r' && dst[0] != 'e') || Width(dst) < 32)
+				return false;
+
+			return Family(dst) == family;
+		}
+
+		static Bool IsLoad(const ToolchainKit::PeepholeInstr& instr, std::string& reg, std::string& mem)
+		{
+			if (instr.fMnemonic != "mov" || instr.fOperands.size() != 2)
+				return false;
+
+			if (!IsRegister(instr.fOperands[0]) || !IsMemory(instr.fOperands[1]))
+				return false;
+
+			reg = instr.fOperands[0];
+			mem = instr.fOperands[1];
+
+			return true;
+		}
+
+		static Bool IsStore(const ToolchainKit::PeepholeInstr& instr, std::string& reg, std::string& mem)
+		{
+			if (instr.fMnemonic != "mov" || instr.fOperands.size() != 2)
+				return false;
+
+			if (!IsMemory(instr.fOperands[0]) || !IsRegister(instr.fOperands[1]))
+				return false;
+
+			reg = instr.fOperands[1];
+			mem = instr.fOperands[0];
+
+			return true;
+		}
+
+		/// @brief bits a load or a store moves, the width of its register.
+		static Int32 AccessWidth(const ToolchainKit::PeepholeInstr& instr)
+		{
+			return Width(IsMemory(instr.fOperands[0]) ? instr.fOperands[1] : instr.fOperands[0]);
+		}
+
+		/// @brief a 32-bit load clears the upper half, it isn't the register that was stored.
+		static Bool Extends(const ToolchainKit::PeepholeInstr& load)
+		{
+			return AccessWidth(load) == 32;
+		}
+
+		/// @brief mov r, a followed by add/sub r, b.
+		static Bool FoldArith(const ToolchainKit::PeepholeInstr& arith, const std::string& reg, Int64 value, Int64& out)
+		{
+			if (arith.fOperands.size() != 2 || arith.fOperands[0] != reg ||
+				!peephole_is_imm(arith.fOperands[1]))
+				return false;
+
+			if (arith.fMnemonic == "add")
+				out = value + peephole_imm(arith.fOperands[1]);
+			else if (arith.fMnemonic == "sub")
+				out = value - peephole_imm(arith.fOperands[1]);
+			else
+				return false;
+
+			// the sum wraps at the width of the register.
+			if (auto width = Width(reg); width < 64)
+				out = Int64(UInt64(out) & ((1UL << width) - 1));
+
+			return true;
+		}
+	};
+
+	/////////////////////////////////////////////////////////////////////////////////////////
+
+	// @brief 64x0 target description.
+
+	/////////////////////////////////////////////////////////////////////////////////////////
+
+	struct Peephole64x0 final
+	{
+		static std::string Family(const std::string& reg)
+		{
+			if (reg.size() < 2 || reg[0] != 'r')
+				return "";
+
+			for (SizeType i = 1; i < reg.size(); ++i)
+			{
+				if (!isdigit(reg[i]))
+					return "";
+			}
+
+			return reg;
+		}
+
+		static Bool IsRegister(const std::string& op)
+		{
+			return !Family(op).empty();
+		}
+
+		static Bool IsControlFlow(const std::string& mnemonic)
+		{
+			return mnemonic == "jlr" || mnemonic == "jrl" || mnemonic[0] == 'b' ||
+				   mnemonic == "sc" || mnemonic == "int";
+		}
+
+		static Bool IsExplicit(const std::string& mnemonic)
+		{
+			static const std::vector<std::string> cExplicit = {
+				"ldw", "stw", "lda", "sta", "mv", "add", "sub", "addc", "subc", "nop"};
+
+			return std::find(cExplicit.begin(), cExplicit.end(), mnemonic) != cExplicit.end();
+		}
+
+		static Bool ReadsFlags(const std::string& mnemonic)
+		{
+			return mnemonic == "addc" || mnemonic == "subc";
+		}
+
+		static Bool WritesFlags(const std::string& mnemonic)
+		{
+			return mnemonic == "add" || mnemonic == "sub";
+		}
+
+		static Bool CanDropSelfMove(const std::string&)
+		{
+			return true;
+		}
+
+		static Bool IsMove(const ToolchainKit::PeepholeInstr& instr)
+		{
+			return instr.fMnemonic == "mv" && instr.fOperands.size() == 2 &&
+				   IsRegister(instr.fOperands[0]) && IsRegister(instr.fOperands[1]);
+		}
+
+		static Bool IsLoadImm(const ToolchainKit::PeepholeInstr& instr)
+		{
+			return instr.fMnemonic == "ldw" && instr.fOperands.size() == 2 &&
+				   IsRegister(instr.fOperands[0]) && peephole_is_imm(instr.fOperands[1]);
+		}
+
+		static void MakeLoadImm(ToolchainKit::PeepholeInstr& instr, const std::string& reg, Int64 value)
+		{
+			instr.fMnemonic = "ldw";
+			instr.fOperands = {reg, std::to_string(value)};
+		}
+
+		static Bool WritesOnly(const ToolchainKit::PeepholeInstr& instr, const std::string& family)
+		{
+			if (instr.fMnemonic != "ldw" && instr.fMnemonic != "lda" && instr.fMnemonic != "mv")
+				return false;
+
+			return instr.fOperands.size() == 2 && instr.fOperands[0] == family;
+		}
+
+		/// @brief ldw r, sym, only symbols are memory, a number is loaded as is.
+		static Bool IsLoad(const ToolchainKit::PeepholeInstr& instr, std::string& reg, std::string& mem)
+		{
+			if (instr.fMnemonic != "ldw" || instr.fOperands.size() != 2)
+				return false;
+
+			if (!IsRegister(instr.fOperands[0]) || IsRegister(instr.fOperands[1]) ||
+				peephole_is_imm(instr.fOperands[1]))
+				return false;
+
+			reg = instr.fOperands[0];
+			mem = instr.fOperands[1];
+
+			return true;
+		}
+
+		static Bool IsStore(const ToolchainKit::PeepholeInstr& instr, std::string& reg, std::string& mem)
+		{
+			if (instr.fMnemonic != "stw" || instr.fOperands.size() != 2)
+				return false;
+
+			if (!IsRegister(instr.fOperands[0]) || IsRegister(instr.fOperands[1]) ||
+				peephole_is_imm(instr.fOperands[1]))
+				return false;
+
+			reg = instr.fOperands[0];
+			mem = instr.fOperands[1];
+
+			return true;
+		}
+
+		/// @brief ldw r, r2 and friends, left over once symbols are resolved to registers.
+		static Bool IsRegisterAccess(const ToolchainKit::PeepholeInstr& instr)
+		{
+			if (instr.fMnemonic != "ldw" && instr.fMnemonic != "stw" &&
+				instr.fMnemonic != "lda" && instr.fMnemonic != "sta")
+				return false;
+
+			return instr.fOperands.size() == 2 && IsRegister(instr.fOperands[0]) &&
+				   IsRegister(instr.fOperands[1]);
+		}
+
+		static void MakeMove(ToolchainKit::PeepholeInstr& instr)
+		{
+			instr.fMnemonic = "mv";
+		}
+
+		/// @brief ldw and stw move a whole word, the only width taken here.
+		static Int32 AccessWidth(const ToolchainKit::PeepholeInstr& instr)
+		{
+			return instr.fMnemonic == "ldw" || instr.fMnemonic == "stw" ? 64 : 0;
+		}
+
+		static Bool Extends(const ToolchainKit::PeepholeInstr&)
+		{
+			return false;
+		}
+
+		/// @brief add and sub only take registers on the 64x0.
+		static Bool FoldArith(const ToolchainKit::PeepholeInstr&, const std::string&, Int64, Int64&)
+		{
+			return false;
+		}
+	};
+
+	/////////////////////////////////////////////////////////////////////////////////////////
+
+	// @brief POWER target description.
+
+	/////////////////////////////////////////////////////////////////////////////////////////
+
+	struct PeepholePower64 final
+	{
+		static std::string Family(const std::string& reg)
+		{
+			return Peephole64x0::Family(reg);
+		}
+
+		static Bool IsRegister(const std::string& op)
+		{
+			return !Family(op).empty();
+		}
+
+		static Bool IsControlFlow(const std::string& mnemonic)
+		{
+			return mnemonic[0] == 'b' || mnemonic == "sc" || mnemonic == "rfid" ||
+				   mnemonic.starts_with("mt") || mnemonic.starts_with("mf");
+		}
+
+		static Bool IsExplicit(const std::string& mnemonic)
+		{
+			static const std::vector<std::string> cExplicit = {
+				"li", "lis", "mr", "addi", "add", "subf", "lwz", "ld", "stw", "std", "nop"};
+
+			return std::find(cExplicit.begin(), cExplicit.end(), mnemonic) != cExplicit.end();
+		}
+
+		/// @brief addi leaves cr0 alone, the fold never loses it.
+		static Bool ReadsFlags(const std::string&)
+		{
+			return false;
+		}
+
+		static Bool WritesFlags(const std::string&)
+		{
+			return true;
+		}
+
+		static Bool CanDropSelfMove(const std::string&)
+		{
+			return true;
+		}
+
+		static Bool IsMove(const ToolchainKit::PeepholeInstr& instr)
+		{
+			return instr.fMnemonic == "mr" && instr.fOperands.size() == 2 &&
+				   IsRegister(instr.fOperands[0]) && IsRegister(instr.fOperands[1]);
+		}
+
+		static Bool IsLoadImm(const ToolchainKit::PeepholeInstr& instr)
+		{
+			return instr.fMnemonic == "li" && instr.fOperands.size() == 2 &&
+				   IsRegister(instr.fOperands[0]) && peephole_is_imm(instr.fOperands[1]);
+		}
+
+		static void MakeLoadImm(ToolchainKit::PeepholeInstr& instr, const std::string& reg, Int64 value)
+		{
+			instr.fMnemonic = "li";
+			instr.fOperands = {reg, std::to_string(value)};
+		}
+
+		static Bool WritesOnly(const ToolchainKit::PeepholeInstr& instr, const std::string& family)
+		{
+			if (instr.fOperands.empty() || instr.fOperands[0] != family)
+				return false;
+
+			if (instr.fMnemonic == "li" || instr.fMnemonic == "lis" || instr.fMnemonic == "mr")
+				return instr.fOperands.size() == 2 && instr.fOperands[1] != family;
+
+			return false;
+		}
+
+		static Bool IsLoad(const ToolchainKit::PeepholeInstr& instr, std::string& reg, std::string& mem)
+		{
+			if ((instr.fMnemonic != "lwz" && instr.fMnemonic != "ld") || instr.fOperands.size() != 2)
+				return false;
+
+			reg = instr.fOperands[0];
+			mem = instr.fOperands[1];
+
+			return IsRegister(reg);
+		}
+
+		static Bool IsStore(const ToolchainKit::PeepholeInstr& instr, std::string& reg, std::string& mem)
+		{
+			if ((instr.fMnemonic != "stw" && instr.fMnemonic != "std") || instr.fOperands.size() != 2)
+				return false;
+
+			reg = instr.fOperands[0];
+			mem = instr.fOperands[1];
+
+			return IsRegister(reg);
+		}
+
+		/// @brief lwz and stw move a word, ld and std a doubleword.
+		static Int32 AccessWidth(const ToolchainKit::PeepholeInstr& instr)
+		{
+			return instr.fMnemonic == "lwz" || instr.fMnemonic == "stw" ? 32 : 64;
+		}
+
+		/// @brief lwz zero extends, the upper word of what was stored is lost.
+		static Bool Extends(const ToolchainKit::PeepholeInstr& load)
+		{
+			return load.fMnemonic == "lwz";
+		}
+
+		/// @brief li r, a followed by addi r, r, b.
+		static Bool FoldArith(const ToolchainKit::PeepholeInstr& arith, const std::string& reg, Int64 value, Int64& out)
+		{
+			if (arith.fMnemonic != "addi" || arith.fOperands.size() != 3 ||
+				arith.fOperands[0] != reg || arith.fOperands[1] != reg ||
+				!peephole_is_imm(arith.fOperands[2]))
+				return false;
+
+			out = value + peephole_imm(arith.fOperands[2]);
+
+			// li only takes a signed 16-bit immediate.
+			return out >= INT16_MIN && out <= INT16_MAX;
+		}
+	};
+
+	/////////////////////////////////////////////////////////////////////////////////////////
+
+	// @brief Rule helpers.
+
+	/////////////////////////////////////////////////////////////////////////////////////////
+
+	/// @brief index of the next live instruction, npos if a barrier comes first.
+	static SizeType peephole_next(ToolchainKit::PeepholeList& list, SizeType index)
+	{
+		for (SizeType next = index + 1; next < list.size(); ++next)
+		{
+			if (list[next].fDead)
+				continue;
+
+			if (list[next].fBarrier)
+				return std::string::npos;
+
+			if (list[next].fMnemonic.empty())
+				continue;
+
+			return next;
+		}
+
+		return std::string::npos;
+	}
+
+	template <typename Target>
+	static Bool peephole_mentions(const ToolchainKit::PeepholeInstr& instr, const std::string& family)
+	{
+		for (auto& op : instr.fOperands)
+		{
+			for (auto& word : peephole_words(op))
+			{
+				if (Target::Family(word) == family)
+					return true;
+			}
+		}
+
+		return false;
+	}
+
+	static void peephole_kill(ToolchainKit::PeepholeInstr& instr)
+	{
+		instr.fDead = true;
+	}
+
+	/// @brief a memory access between two registers, the target spells it as a move.
+	template <typename Target>
+	static Bool peephole_rule_reg_access(ToolchainKit::PeepholeList& list, SizeType index)
+	{
+		auto& instr = list[index];
+
+		if (!Target::IsRegisterAccess(instr))
+			return false;
+
+		Target::MakeMove(instr);
+		instr.fChanged = true;
+
+		return true;
+	}
+
+	/// @brief mov r, r
+	template <typename Target>
+	static Bool peephole_rule_self_move(ToolchainKit::PeepholeList& list, SizeType index)
+	{
+		auto& instr = list[index];
+
+		if (!Target::IsMove(instr) || instr.fOperands[0] != instr.fOperands[1])
+			return false;
+
+		if (!Target::CanDropSelfMove(instr.fOperands[0]))
+			return false;
+
+		peephole_kill(instr);
+		return true;
+	}
+
+	/// @brief mov a, b then mov b, a, the second one is redundant.
+	template <typename Target>
+	static Bool peephole_rule_swap_move(ToolchainKit::PeepholeList& list, SizeType index)
+	{
+		auto& instr = list[index];
+
+		if (!Target::IsMove(instr))
+			return false;
+
+		auto next = peephole_next(list, index);
+
+		if (next == std::string::npos || !Target::IsMove(list[next]))
+			return false;
+
+		if (list[next].fOperands[0] != instr.fOperands[1] ||
+			list[next].fOperands[1] != instr.fOperands[0])
+			return false;
+
+		peephole_kill(list[next]);
+		return true;
+	}
+
+	/// @brief store then load (or load then store) of the same register and slot.
+	template <typename Target>
+	static Bool peephole_rule_load_store(ToolchainKit::PeepholeList& list, SizeType index)
+	{
+		auto next = peephole_next(list, index);
+
+		if (next == std::string::npos)
+			return false;
+
+		std::string reg, mem, next_reg, next_mem;
+
+		auto& instr = list[index];
+		auto& after = list[next];
+
+		Bool store_load = Target::IsStore(instr, reg, mem) && Target::IsLoad(after, next_reg, next_mem);
+		Bool load_store = !store_load && Target::IsLoad(instr, reg, mem) && Target::IsStore(after, next_reg, next_mem);
+
+		if (!store_load && !load_store)
+			return false;
+
+		if (reg != next_reg || mem != next_mem || Target::AccessWidth(instr) != Target::AccessWidth(after))
+			return false;
+
+		// reading back a narrower word may change the register it was stored from.
+		if (store_load && Target::Extends(after))
+			return false;
+
+		// the address must not depend on the register we move.
+		for (auto& word : peephole_words(mem))
+		{
+			if (Target::Family(word) == Target::Family(reg))
+				return false;
+		}
+
+		peephole_kill(after);
+		return true;
+	}
+
+	/// @brief mov r, imm then mov r2, r becomes mov r2, imm.
+	template <typename Target>
+	static Bool peephole_rule_const_move(ToolchainKit::PeepholeList& list, SizeType index)
+	{
+		auto& instr = list[index];
+
+		if (!Target::IsLoadImm(instr))
+			return false;
+
+		auto next = peephole_next(list, index);
+
+		if (next == std::string::npos || !Target::IsMove(list[next]))
+			return false;
+
+		auto& after = list[next];
+
+		if (after.fOperands[1] != instr.fOperands[0] || after.fOperands[0] == instr.fOperands[0])
+			return false;
+
+		Target::MakeLoadImm(after, after.fOperands[0], peephole_imm(instr.fOperands[1]));
+		after.fChanged = true;
+
+		return true;
+	}
+
+	/// @brief mov r, a then add r, b becomes mov r, a + b.
+	template <typename Target>
+	static Bool peephole_rule_const_fold(ToolchainKit::PeepholeList& list, SizeType index)
+	{
+		auto& instr = list[index];
+
+		if (!Target::IsLoadImm(instr))
+			return false;
+
+		auto next = peephole_next(list, index);
+
+		if (next == std::string::npos)
+			return false;
+
+		Int64 folded = 0;
+
+		if (!Target::FoldArith(list[next], instr.fOperands[0], peephole_imm(instr.fOperands[1]), folded))
+			return false;
+
+		// the flags of the arithmetic would be lost, look for a reader up to the next write of them.
+		// a label doesn't stop the search, the code above falls through it with its flags.
+		for (SizeType after = next + 1; after < list.size(); ++after)
+		{
+			if (list[after].fDead || list[after].fMnemonic.empty())
+				continue;
+
+			if (Target::ReadsFlags(list[after].fMnemonic))
+				return false;
+
+			if (Target::WritesFlags(list[after].fMnemonic))
+				break;
+		}
+
+		Target::MakeLoadImm(list[next], instr.fOperands[0], folded);
+		list[next].fChanged = true;
+
+		peephole_kill(instr);
+		return true;
+	}
+
+	/// @brief a register written then overwritten before any read.
+	template <typename Target>
+	static Bool peephole_rule_dead_store(ToolchainKit::PeepholeList& list, SizeType index)
+	{
+		auto& instr = list[index];
+
+		if (instr.fOperands.empty() || !Target::IsRegister(instr.fOperands[0]))
+			return false;
+
+		auto family = Target::Family(instr.fOperands[0]);
+
+		if (!Target::WritesOnly(instr, family))
+			return false;
+
+		for (auto next = peephole_next(list, index); next != std::string::npos;
+			 next	   = peephole_next(list, next))
+		{
+			auto& after = list[next];
+
+			if (!Target::IsExplicit(after.fMnemonic))
+				return false;
+
+			if (!peephole_mentions<Target>(after, family))
+				continue;
+
+			if (!Target::WritesOnly(after, family))
+				return false;
+
+			// a full overwrite, but only if the value it writes doesn't read us.
+			for (SizeType op = 1; op < after.fOperands.size(); ++op)
+			{
+				for (auto& word : peephole_words(after.fOperands[op]))
+				{
+					if (Target::Family(word) == family)
+						return false;
+				}
+			}
+
+			peephole_kill(instr);
+			return true;
+		}
+
+		return false;
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////
+
+	// @brief Per-target rule tables.
+
+	/////////////////////////////////////////////////////////////////////////////////////////
+
+#define kPeepholeRuleDecl(NAME, TARGET) {.fName = #NAME, .fRule = &peephole_rule_##NAME<TARGET>}
+#define kPeepholeLoweringDecl(NAME, TARGET) \
+	{.fName = #NAME, .fRule = &peephole_rule_##NAME<TARGET>, .fLowering = true}
+
+	static const std::vector<ToolchainKit::PeepholeRule> kPeepholeRulesAMD64 = {
+		kPeepholeRuleDecl(self_move, PeepholeAMD64),
+		kPeepholeRuleDecl(swap_move, PeepholeAMD64),
+		kPeepholeRuleDecl(load_store, PeepholeAMD64),
+		kPeepholeRuleDecl(const_fold, PeepholeAMD64),
+		kPeepholeRuleDecl(const_move, PeepholeAMD64),
+		kPeepholeRuleDecl(dead_store, PeepholeAMD64),
+	};
+
+	static const std::vector<ToolchainKit::PeepholeRule> kPeepholeRules64x0 = {
+		kPeepholeLoweringDecl(reg_access, Peephole64x0),
+		kPeepholeRuleDecl(self_move, Peephole64x0),
+		kPeepholeRuleDecl(swap_move, Peephole64x0),
+		kPeepholeRuleDecl(load_store, Peephole64x0),
+		kPeepholeRuleDecl(const_move, Peephole64x0),
+		kPeepholeRuleDecl(dead_store, Peephole64x0),
+	};
+
+	static const std::vector<ToolchainKit::PeepholeRule> kPeepholeRulesPower64 = {
+		kPeepholeRuleDecl(self_move, PeepholePower64),
+		kPeepholeRuleDecl(swap_move, PeepholePower64),
+		kPeepholeRuleDecl(load_store, PeepholePower64),
+		kPeepholeRuleDecl(const_fold, PeepholePower64),
+		kPeepholeRuleDecl(const_move, PeepholePower64),
+		kPeepholeRuleDecl(dead_store, PeepholePower64),
+	};
+
+#undef kPeepholeLoweringDecl
+#undef kPeepholeRuleDecl
+
+	static Bool peephole_is_control_flow(Int32 arch, const std::string& mnemonic)
+	{
+		switch (arch)
+		{
+		case ToolchainKit::AssemblyFactory::kArchAMD64:
+			return PeepholeAMD64::IsControlFlow(mnemonic);
+		case ToolchainKit::AssemblyFactory::kArch64x0:
+		case ToolchainKit::AssemblyFactory::kArch32x0:
+			return Peephole64x0::IsControlFlow(mnemonic);
+		case ToolchainKit::AssemblyFactory::kArchPowerPC:
+			return PeepholePower64::IsControlFlow(mnemonic);
+		default:
+			return true;
+		}
+	}
+} // namespace Details
+
+namespace ToolchainKit
+{
+	PeepholeOptimizer::PeepholeOptimizer(Int32 arch) noexcept
+		: fArch(arch)
+	{
+		switch (arch)
+		{
+		case AssemblyFactory::kArchAMD64:
+			fRules = &Details::kPeepholeRulesAMD64;
+			break;
+		case AssemblyFactory::kArch64x0:
+		case AssemblyFactory::kArch32x0:
+			fRules = &Details::kPeepholeRules64x0;
+			break;
+		case AssemblyFactory::kArchPowerPC:
+			fRules = &Details::kPeepholeRulesPower64;
+			break;
+		default:
+			fRules = nullptr;
+			break;
+		}
+	}
+
+	PeepholeList PeepholeOptimizer::Parse(const std::string& text)
+	{
+		PeepholeList list;
+		SizeType	 start = 0UL;
+
+		while (start <= text.size())
+		{
+			auto end = text.find('\n', start);
+
+			if (end == std::string::npos)
+				end = text.size();
+
+			PeepholeInstr instr;
+			instr.fText = text.substr(start, end - start);
+
+			auto body = Details::peephole_trim(instr.fText);
+
+			instr.fIndent = instr.fText.substr(0, instr.fText.find_first_not_of(" \t"));
+
+			if (body.empty())
+			{
+				// keep blank lines, they are not instructions.
+			}
+			else if (body[0] == '#' || body[0] == '.' || body.find(':') != std::string::npos ||
+					 body.find('"') != std::string::npos || body.find("segment") != std::string::npos)
+			{
+				instr.fBarrier = true;
+			}
+			else if (body[0] == ';')
+			{
+				// AMD64 comment.
+			}
+			else
+			{
+				auto space = body.find_first_of(" \t");
+
+				instr.fMnemonic = body.substr(0, space);
+
+				std::transform(instr.fMnemonic.begin(), instr.fMnemonic.end(),
+							   instr.fMnemonic.begin(), ::tolower);
+
+				if (space != std::string::npos)
+					instr.fOperands = Details::peephole_split(body.substr(space + 1));
+
+				instr.fBarrier = Details::peephole_is_control_flow(fArch, instr.fMnemonic);
+			}
+
+			list.push_back(instr);
+
+			start = end + 1;
+		}
+
+		// the text ended with a new line, don't make up a last one.
+		if (!list.empty() && list.back().fText.empty() && !text.empty() && text.back() == '\n')
+			list.pop_back();
+
+		return list;
+	}
+
+	void PeepholeOptimizer::Optimize(PeepholeList& list)
+	{
+		this->Apply(list, false);
+	}
+
+	void PeepholeOptimizer::Lower(PeepholeList& list)
+	{
+		this->Apply(list, true);
+	}
+
+	void PeepholeOptimizer::Apply(PeepholeList& list, Bool lowering_only)
+	{
+		fRemoved = 0UL;
+
+		if (!fRules)
+			return;
+
+		Bool changed = true;
+
+		while (changed)
+		{
+			changed = false;
+
+			for (SizeType index = 0UL; index < list.size(); ++index)
+			{
+				if (list[index].fDead || list[index].fBarrier || list[index].fMnemonic.empty())
+					continue;
+
+				for (auto& rule : *fRules)
+				{
+					if (lowering_only && !rule.fLowering)
+						continue;
+
+					if (rule.fRule(list, index))
+					{
+						changed = true;
+						break;
+					}
+				}
+			}
+		}
+
+		fRemoved = std::count_if(list.begin(), list.end(),
+								 [](const PeepholeInstr& instr) { return instr.fDead; });
+	}
+
+	std::string PeepholeOptimizer::Emit(const PeepholeList& list)
+	{
+		std::string out;
+
+		for (auto& instr : list)
+		{
+			if (instr.fDead)
+				continue;
+
+			if (!instr.fChanged)
+			{
+				out += instr.fText;
+				out += '\n';
+
+				continue;
+			}
+
+			out += instr.fIndent;
+			out += instr.fMnemonic;
+
+			for (SizeType op = 0; op < instr.fOperands.size(); ++op)
+			{
+				out += (op == 0) ? " " : ", ";
+				out += instr.fOperands[op];
+			}
+
+			out += '\n';
+		}
+
+		return out;
+	}
+
+	std::string PeepholeOptimizer::Run(const std::string& text)
+	{
+		auto list = this->Parse(text);
+
+		this->Optimize(list);
+
+		return this->Emit(list);
+	}
+} // namespace ToolchainKit
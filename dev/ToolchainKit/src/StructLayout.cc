@@ -0,0 +1,233 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+/// @file StructLayout.cc
+/// @brief Struct layout engine.
+
+#include <ToolchainKit/StructLayout.h>
+#include <algorithm>
+#include <sstream>
+
+namespace Details
+{
+	static SizeType layout_align_up(SizeType value, SizeType align)
+	{
+		if (align < 2)
+			return value;
+
+		return (value + align - 1) / align * align;
+	}
+} // namespace Details
+
+namespace ToolchainKit
+{
+	const StructField* StructLayout::Find(const std::string& name) const
+	{
+		for (auto& field : fFields)
+		{
+			if (field.fName == name)
+				return &field;
+		}
+
+		return nullptr;
+	}
+
+	StructLayoutEngine::StructLayoutEngine()
+	{
+		this->AddScalar("char", 1, 1);
+		this->AddScalar("bool", 1, 1);
+		this->AddScalar("short", 2, 2);
+		this->AddScalar("short int", 2, 2);
+		this->AddScalar("int", 4, 4);
+		this->AddScalar("long", 8, 8);
+		this->AddScalar("long int", 8, 8);
+		this->AddScalar("long long", 8, 8);
+		this->AddScalar("float", 4, 4);
+		this->AddScalar("double", 8, 8);
+	}
+
+	void StructLayoutEngine::AddScalar(const std::string& type, SizeType size, SizeType align)
+	{
+		fScalars[type] = {size, align};
+	}
+
+	std::string StructLayoutEngine::Normalize(const std::string& type)
+	{
+		std::stringstream words(type);
+		std::string		  word;
+		std::string		  result;
+
+		while (words >> word)
+		{
+			if (word == "const" || word == "volatile" || word == "struct" ||
+				word == "class" || word == "signed" || word == "unsigned" ||
+				word == "static" || word == "mutable")
+				continue;
+
+			if (!result.empty())
+				result += " ";
+
+			result += word;
+		}
+
+		// plain 'unsigned' is an int.
+		if (result.empty() && type.find("unsigned") != std::string::npos)
+			result = "int";
+
+		return result;
+	}
+
+	Bool StructLayoutEngine::SizeOf(const std::string& type, SizeType& size, SizeType& align) const
+	{
+		auto name = StructLayoutEngine::Normalize(type);
+
+		if (name.empty())
+			return false;
+
+		if (name.back() == '*' || name.back() == '&')
+		{
+			size  = kPointerSize;
+			align = kPointerSize;
+
+			return true;
+		}
+
+		if (auto it = fScalars.find(name); it != fScalars.end())
+		{
+			size  = it->second.first;
+			align = it->second.second;
+
+			return true;
+		}
+
+		if (auto it = fLayouts.find(name); it != fLayouts.end())
+		{
+			size  = it->second.fSize;
+			align = it->second.fAlign;
+
+			return true;
+		}
+
+		return false;
+	}
+
+	const StructLayout* StructLayoutEngine::Define(const std::string& name, const std::vector<StructFieldDecl>& fields, const StructLayoutHints& hints, std::string& error)
+	{
+		struct Sized final
+		{
+			const StructFieldDecl* fDecl;
+			SizeType			   fSize;
+			SizeType			   fAlign;
+		};
+
+		std::vector<Sized> order;
+
+		for (auto& decl : fields)
+		{
+			SizeType size  = 0UL;
+			SizeType align = 1UL;
+
+			if (!this->SizeOf(decl.fType, size, align))
+			{
+				error = "unknown type '" + decl.fType + "' for member " + name + "::" + decl.fName;
+				return nullptr;
+			}
+
+			if (hints.fPack > 0)
+				align = std::min(align, hints.fPack);
+
+			// an explicit alignas wins over packing.
+			align = std::max(align, decl.fAlignAs);
+
+			order.push_back({&decl, size * decl.fCount, align});
+		}
+
+		// bases and vptr first, then the hot members, then the rest.
+		if (hints.fReorder || hints.fCacheLine)
+		{
+			auto rank = [](const Sized& field) {
+				return field.fDecl->fPinned ? 0 : (field.fDecl->fHot ? 1 : 2);
+			};
+
+			std::stable_sort(order.begin(), order.end(), [&](const Sized& lhs, const Sized& rhs) {
+				if (rank(lhs) != rank(rhs))
+					return rank(lhs) < rank(rhs);
+
+				// widest alignment first leaves no holes between members.
+				if (hints.fReorder && rank(lhs) != 0)
+					return lhs.fAlign > rhs.fAlign;
+
+				return false;
+			});
+		}
+
+		StructLayout layout;
+		layout.fName = name;
+
+		SizeType offset	  = 0UL;
+		Bool	 seen_hot = false;
+
+		for (auto& field : order)
+		{
+			// cold data starts on its own cache line, the hot one stays compact.
+			if (hints.fCacheLine && seen_hot && !field.fDecl->fHot && !field.fDecl->fPinned)
+			{
+				auto line = Details::layout_align_up(offset, kCacheLine);
+
+				layout.fPadding += line - offset;
+				offset = line;
+
+				seen_hot = false;
+			}
+
+			if (field.fDecl->fHot)
+				seen_hot = true;
+
+			auto at = Details::layout_align_up(offset, field.fAlign);
+
+			layout.fPadding += at - offset;
+
+			StructField out;
+			out.fName	= field.fDecl->fName;
+			out.fType	= field.fDecl->fType;
+			out.fOffset = at;
+			out.fSize	= field.fSize;
+			out.fAlign	= field.fAlign;
+			out.fCount	= field.fDecl->fCount;
+
+			layout.fFields.push_back(out);
+			layout.fAlign = std::max(layout.fAlign, field.fAlign);
+
+			offset = at + field.fSize;
+		}
+
+		layout.fAlign = std::max(layout.fAlign, hints.fAlignAs);
+
+		if (hints.fCacheLine)
+			layout.fAlign = std::max(layout.fAlign, kCacheLine);
+
+		// an empty struct still has an address of its own.
+		layout.fSize = Details::layout_align_up(std::max(offset, (SizeType)1UL), layout.fAlign);
+		layout.fPadding += layout.fSize - offset;
+
+		fLayouts[name] = layout;
+
+		return &fLayouts[name];
+	}
+
+	const StructLayout* StructLayoutEngine::Find(const std::string& name) const
+	{
+		if (auto it = fLayouts.find(StructLayoutEngine::Normalize(name)); it != fLayouts.end())
+			return &it->second;
+
+		return nullptr;
+	}
+
+	void StructLayoutEngine::Clear() noexcept
+	{
+		fLayouts.clear();
+	}
+} // namespace ToolchainKit
@@ -0,0 +1,154 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+/// @file SymbolTable.cc
+/// @brief Scoped symbol table and name interning.
+
+#include <ToolchainKit/SymbolTable.h>
+
+namespace ToolchainKit
+{
+	SymbolId SymbolInterner::Intern(const std::string& name)
+	{
+		if (auto it = fIds.find(name); it != fIds.end())
+			return it->second;
+
+		SymbolId id = fNames.size();
+
+		fNames.push_back(name);
+		fIds[name] = id;
+
+		return id;
+	}
+
+	Bool SymbolInterner::Lookup(const std::string& name, SymbolId& id) const
+	{
+		auto it = fIds.find(name);
+
+		if (it == fIds.end())
+			return false;
+
+		id = it->second;
+		return true;
+	}
+
+	const std::string& SymbolInterner::Name(SymbolId id) const
+	{
+		return fNames[id];
+	}
+
+	void SymbolInterner::Clear() noexcept
+	{
+		fNames.clear();
+		fIds.clear();
+	}
+
+	SymbolTable::SymbolTable()
+	{
+		this->Clear();
+	}
+
+	ScopeId SymbolTable::PushScope()
+	{
+		SymbolScope scope;
+		scope.fParent = fCurrent;
+
+		fScopes.push_back(scope);
+		fCurrent = fScopes.size() - 1;
+
+		return fCurrent;
+	}
+
+	ScopeId SymbolTable::PopScope() noexcept
+	{
+		if (fCurrent != kGlobalScope)
+			fCurrent = fScopes[fCurrent].fParent;
+
+		return fCurrent;
+	}
+
+	SizeType SymbolTable::Depth() const noexcept
+	{
+		SizeType depth = 0UL;
+
+		for (auto scope = fCurrent; scope != kGlobalScope; scope = fScopes[scope].fParent)
+			++depth;
+
+		return depth;
+	}
+
+	const SymbolEntry& SymbolTable::Declare(const std::string& name, const std::string& value)
+	{
+		auto  id	  = fInterner.Intern(name);
+		auto& symbols = fScopes[fCurrent].fSymbols;
+
+		if (auto it = symbols.find(id); it != symbols.end())
+			return fEntries[it->second];
+
+		SymbolEntry entry;
+		entry.fName	 = id;
+		entry.fScope = fCurrent;
+		entry.fValue = value;
+
+		symbols[id] = fEntries.size();
+		fEntries.push_back(entry);
+
+		return fEntries.back();
+	}
+
+	const SymbolEntry* SymbolTable::Find(const std::string& name) const
+	{
+		return this->Find(name, fCurrent);
+	}
+
+	const SymbolEntry* SymbolTable::Find(const std::string& name, ScopeId scope) const
+	{
+		SymbolId id = 0U;
+
+		if (!fInterner.Lookup(name, id))
+			return nullptr;
+
+		for (; scope != kNoScope; scope = fScopes[scope].fParent)
+		{
+			auto& symbols = fScopes[scope].fSymbols;
+
+			if (auto it = symbols.find(id); it != symbols.end())
+				return &fEntries[it->second];
+		}
+
+		return nullptr;
+	}
+
+	const SymbolEntry* SymbolTable::FindLocal(const std::string& name) const
+	{
+		SymbolId id = 0U;
+
+		if (!fInterner.Lookup(name, id))
+			return nullptr;
+
+		auto& symbols = fScopes[fCurrent].fSymbols;
+
+		if (auto it = symbols.find(id); it != symbols.end())
+			return &fEntries[it->second];
+
+		return nullptr;
+	}
+
+	const std::string& SymbolTable::Name(const SymbolEntry& entry) const
+	{
+		return fInterner.Name(entry.fName);
+	}
+
+	void SymbolTable::Clear()
+	{
+		fScopes.clear();
+		fEntries.clear();
+		fInterner.Clear();
+
+		fScopes.push_back(SymbolScope());
+		fCurrent = kGlobalScope;
+	}
+} // namespace ToolchainKit
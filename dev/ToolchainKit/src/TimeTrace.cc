@@ -0,0 +1,176 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+/// @file TimeTrace.cc
+/// @brief Chrome trace event writer.
+
+#include <ToolchainKit/TimeTrace.h>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+
+namespace Details
+{
+	struct time_trace_event final
+	{
+		const char* fName;
+		std::string fDetail;
+		UInt64		fStart;
+		UInt64		fEnd;
+		UInt32		fThread;
+	};
+
+	static std::vector<time_trace_event>	  kTraceEvents;
+	static std::string						  kTracePath;
+	static std::chrono::steady_clock::time_point kTraceOrigin;
+
+	// spans come from the linker slices threads too.
+	static std::mutex						  kTraceLock;
+	static std::vector<std::thread::id>		  kTraceThreads;
+
+	/// @brief A small tid for the viewer, the order threads first traced in.
+	static UInt32 time_trace_thread()
+	{
+		auto id = std::this_thread::get_id();
+
+		for (SizeType index = 0UL; index < kTraceThreads.size(); ++index)
+		{
+			if (kTraceThreads[index] == id)
+				return index;
+		}
+
+		kTraceThreads.push_back(id);
+		return kTraceThreads.size() - 1;
+	}
+
+	static std::string time_trace_escape(const std::string& text)
+	{
+		std::string out;
+
+		for (auto ch : text)
+		{
+			if (ch == '"' || ch == '\\')
+				out += '\\';
+
+			if (static_cast<unsigned char>(ch) < 0x20)
+				continue;
+
+			out += ch;
+		}
+
+		return out;
+	}
+} // namespace Details
+
+namespace ToolchainKit
+{
+	Bool TimeTrace::fEnabled = false;
+
+	void TimeTrace::Begin(const std::string& path)
+	{
+		Details::kTracePath	  = path;
+		Details::kTraceOrigin = std::chrono::steady_clock::now();
+		Details::kTraceEvents.clear();
+		Details::kTraceThreads.clear();
+
+		fEnabled = true;
+	}
+
+	Bool TimeTrace::End()
+	{
+		if (!fEnabled)
+			return true;
+
+		fEnabled = false;
+
+		std::ofstream out(Details::kTracePath);
+
+		if (!out.is_open())
+			return false;
+
+		auto pid = getpid();
+
+		out << "{\"traceEvents\":[\n";
+
+		for (SizeType index = 0UL; index < Details::kTraceEvents.size(); ++index)
+		{
+			auto& event = Details::kTraceEvents[index];
+
+			out << "{\"name\":\"" << event.fName << "\",\"cat\":\"toolchainkit\",\"ph\":\"X\""
+				<< ",\"ts\":" << event.fStart << ",\"dur\":" << (event.fEnd - event.fStart)
+				<< ",\"pid\":" << pid << ",\"tid\":" << event.fThread;
+
+			if (!event.fDetail.empty())
+				out << ",\"args\":{\"detail\":\"" << Details::time_trace_escape(event.fDetail) << "\"}";
+
+			out << "}" << (index + 1 < Details::kTraceEvents.size() ? ",\n" : "\n");
+		}
+
+		out << "],\"displayTimeUnit\":\"ms\"}\n";
+
+		Details::kTraceEvents.clear();
+
+		return out.good();
+	}
+
+	UInt64 TimeTrace::Now() noexcept
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - Details::kTraceOrigin).count();
+	}
+
+	void TimeTrace::Add(const char* name, const std::string& detail, UInt64 start, UInt64 end)
+	{
+		if (!fEnabled)
+			return;
+
+		std::lock_guard<std::mutex> lock(Details::kTraceLock);
+
+		Details::kTraceEvents.push_back({name, detail, start, end, Details::time_trace_thread()});
+	}
+
+	TimeTraceBatch::TimeTraceBatch(const char* name, const std::string& detail, SizeType size)
+		: fName(TimeTrace::Enabled() ? name : nullptr), fSize(size)
+	{
+		if (fName)
+		{
+			fDetail = detail;
+			fStart	= TimeTrace::Now();
+		}
+	}
+
+	TimeTraceBatch::~TimeTraceBatch()
+	{
+		if (fName && fCount > fFirst)
+			this->Flush();
+	}
+
+	void TimeTraceBatch::Flush()
+	{
+		auto now = TimeTrace::Now();
+
+		TimeTrace::Add(fName, fDetail + ", items " + std::to_string(fFirst) + " to " + std::to_string(fCount), fStart, now);
+
+		fFirst = fCount;
+		fStart = now;
+	}
+
+	Bool TimeTrace::Option(const char* arg, const char* prefix, const std::string& fallback)
+	{
+		std::string option = prefix;
+		option += "time-trace";
+
+		if (option != arg && strstr(arg, (option + "=").c_str()) != arg)
+			return false;
+
+		if (option == arg)
+			TimeTrace::Begin(fallback);
+		else
+			TimeTrace::Begin(arg + option.size() + 1);
+
+		return true;
+	}
+} // namespace ToolchainKit
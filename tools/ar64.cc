@@ -0,0 +1,22 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+#include <ToolchainKit/Defines.h>
+
+/// @file ar64.cc
+/// @brief Static library archiver for AE objects.
+
+TK_IMPORT_C int LibraryArchiver64(int argc, char const* argv[]);
+
+int main(int argc, char const* argv[])
+{
+	if (argc < 1)
+	{
+		return 1;
+	}
+
+	return LibraryArchiver64(argc, argv);
+}
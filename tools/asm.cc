@@ -9,6 +9,7 @@
 
 #include <ToolchainKit/Defines.h>
 #include <ToolchainKit/Version.h>
+#include <ToolchainKit/TimeTrace.h>
 #include <iostream>
 #include <cstring>
 #include <string>
@@ -39,9 +40,14 @@ int main(int argc, char const* argv[])
 			std::printf("asm.exe: Version: %s, Release: %s.\n", kDistVersion, kDistRelease);
 			std::printf("asm.exe: Designed by Amlal EL Mahrouss, Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved.\n");
 			std::printf("libToolchainKit.dylib: Designed by Amlal EL Mahrouss, Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved.\n");
+			std::printf("--asm:time-trace[=<path>]: write where the time goes as a Chrome trace, default is asm.trace.json.\n");
 
 			return 0;
 		}
+		else if (ToolchainKit::TimeTrace::Option(argv[index_arg], "--asm:", "asm.trace.json"))
+		{
+			continue;
+		}
 		else if (strstr(argv[index_arg], "--asm:x64"))
 		{
 			asm_type = kX64Assembler;
@@ -60,30 +66,26 @@ int main(int argc, char const* argv[])
 		}
 	}
 
+	int32_t code = 0;
+
 	switch (asm_type)
 	{
 	case kPOWER64Assembler: {
-		if (int32_t code = AssemblerMainPower64(arg_vec_cstr.size(), arg_vec_cstr.data()); code)
-		{
+		if (code = AssemblerMainPower64(arg_vec_cstr.size(), arg_vec_cstr.data()); code)
 			std::printf("asm.exe: frontend exited with code %i.\n", code);
-			return code;
-		}
+
 		break;
 	}
 	case k64X0Assembler: {
-		if (int32_t code = AssemblerMain64x0(arg_vec_cstr.size(), arg_vec_cstr.data()); code)
-		{
+		if (code = AssemblerMain64x0(arg_vec_cstr.size(), arg_vec_cstr.data()); code)
 			std::printf("asm.exe: frontend exited with code %i.\n", code);
-			return code;
-		}
+
 		break;
 	}
 	case kX64Assembler: {
-		if (int32_t code = AssemblerAMD64(arg_vec_cstr.size(), arg_vec_cstr.data()); code)
-		{
+		if (code = AssemblerAMD64(arg_vec_cstr.size(), arg_vec_cstr.data()); code)
 			std::printf("asm.exe: frontend exited with code %i.\n", code);
-			return code;
-		}
+
 		break;
 	}
 	default: {
@@ -91,5 +93,8 @@ int main(int argc, char const* argv[])
 	}
 	}
 
-	return 0;
+	if (!ToolchainKit::TimeTrace::End())
+		std::printf("asm.exe: can't write the time trace.\n");
+
+	return code;
 }
@@ -0,0 +1,523 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+/// @file bench.cc
+/// @brief ToolchainKit benchmarks, generates synthetic workloads and measures every stage on them.
+
+#include <ToolchainKit/Defines.h>
+#include <ToolchainKit/Version.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <filesystem>
+#include <vector>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+TK_IMPORT_C int CPlusPlusPreprocessorMain(int argc, char const* argv[]);
+TK_IMPORT_C int CompilerCPlusPlusX8664(int argc, char const* argv[]);
+TK_IMPORT_C int NewOSCompilerCLang64x0(int argc, char const* argv[]);
+TK_IMPORT_C int NewOSCompilerCLangPowerPC(int argc, char const* argv[]);
+TK_IMPORT_C int AssemblerAMD64(int argc, char const* argv[]);
+TK_IMPORT_C int AssemblerMain64x0(int argc, char const* argv[]);
+TK_IMPORT_C int AssemblerMainPower64(int argc, char const* argv[]);
+TK_IMPORT_C int DynamicLinker64PEF(int argc, char const* argv[]);
+
+typedef int (*bench_module_t)(int argc, char const* argv[]);
+
+namespace fs = std::filesystem;
+
+/// @brief workload size (--bench:lines, --bench:objects, --bench:headers).
+static size_t kBenchLines	= 10000UL;
+static size_t kBenchObjects = 256UL;
+static size_t kBenchHeaders = 8UL;
+static size_t kBenchRuns	= 3UL;
+static bool	  kBenchVerbose = false;
+
+/// @brief one stage of the toolchain and what it reads.
+struct bench_stage final
+{
+	const char*				 fName;
+	const char*				 fModule;
+	bench_module_t			 fMain;
+	std::vector<std::string> fArgs;
+	std::vector<std::string> fInputs;
+	bool					 fObjects{false};
+};
+
+struct bench_result final
+{
+	std::string fStage;
+	std::string fModule;
+	int32_t		fCode{0};
+	uint64_t	fLines{0UL};
+	uint64_t	fBytes{0UL};
+	uint64_t	fObjects{0UL};
+	double		fSeconds{0.0};
+	uint64_t	fPeakRss{0UL}; // KiB
+};
+
+/// @brief the front ends take digits in a name for something else than a function, spell the index out.
+static std::string bench_name(size_t index)
+{
+	std::string name;
+
+	do
+	{
+		name.insert(name.begin(), 'a' + index % 26);
+		index /= 26;
+	} while (index > 0);
+
+	return name;
+}
+
+/// @brief macro heavy headers, defines, function like macros and conditionals.
+static std::vector<std::string> bench_write_headers(const std::string& dir)
+{
+	std::vector<std::string> headers;
+
+	for (size_t header = 0; header < kBenchHeaders; ++header)
+	{
+		auto		  name = "bench_" + bench_name(header) + ".h";
+		std::ofstream out(dir + "/" + name);
+
+		out << "#ifndef __BENCH_" << bench_name(header) << "_H__\n";
+		out << "#define __BENCH_" << bench_name(header) << "_H__\n\n";
+
+		for (size_t macro = 0; macro < kBenchLines / kBenchHeaders / 8; ++macro)
+		{
+			auto id = bench_name(header) + "_" + bench_name(macro);
+
+			out << "#define BENCH_VALUE_" << id << " " << macro << "\n";
+			out << "#define BENCH_CALL_" << id << "(x) x\n";
+			out << "#ifdef BENCH_VALUE_" << id << "\n";
+			out << "#define BENCH_HAS_" << id << " 1\n";
+			out << "#else\n";
+			out << "#define BENCH_HAS_" << id << " 0\n";
+			out << "#endif\n\n";
+		}
+
+		out << "#endif // __BENCH_" << bench_name(header) << "_H__\n";
+
+		headers.push_back(dir + "/" + name);
+	}
+
+	return headers;
+}
+
+/// @brief C or C++ functions with a local each, five lines per function.
+static void bench_write_functions(const std::string& path, const std::vector<std::string>& headers)
+{
+	std::ofstream out(path);
+
+	for (auto& header : headers)
+		out << "#include \"" << header << "\"\n";
+
+	for (size_t fn = 0; fn < kBenchLines / 5; ++fn)
+	{
+		out << "int bench_" << bench_name(fn) << "()\n";
+		out << "{\n";
+		out << "\tint bench_var = " << fn % 4096 << ";\n";
+		out << "\treturn bench_var;\n";
+		out << "}\n";
+	}
+}
+
+/// @brief assembly, one segment per 64 lines.
+/// @param prologue the directives on top.
+/// @param body the instructions, cycled through.
+static void bench_write_assembly(const std::string& path, const std::string& prologue, const std::vector<std::string>& body, const std::string& ret, size_t lines)
+{
+	std::ofstream out(path);
+
+	out << prologue;
+
+	for (size_t line = 0; line < lines; ++line)
+	{
+		if (line % 64 == 0)
+		{
+			if (line > 0)
+				out << "\t" << ret << "\n";
+
+			out << "public_segment .code64 " << (line == 0 ? std::string("__ImageStart") : "__bench_" + bench_name(line / 64)) << "\n";
+		}
+
+		out << "\t" << body[line % body.size()] << "\n";
+	}
+
+	out << "\t" << ret << "\n";
+}
+
+static void bench_count(const std::string& path, bench_result& result)
+{
+	std::ifstream file(path, std::ios::binary);
+	std::string	  line;
+
+	while (std::getline(file, line))
+	{
+		++result.fLines;
+		result.fBytes += line.size() + 1;
+	}
+}
+
+/// @brief run a module in a child, so that its state and peak memory are its own.
+static bool bench_spawn(bench_module_t module, const std::vector<std::string>& args, int32_t& code, double& seconds, uint64_t& rss)
+{
+	std::cout.flush();
+	fflush(stdout);
+
+	auto start = std::chrono::steady_clock::now();
+	auto pid   = fork();
+
+	if (pid < 0)
+		return false;
+
+	if (pid == 0)
+	{
+		if (!kBenchVerbose)
+		{
+			int null = open("/dev/null", O_WRONLY);
+
+			dup2(null, STDOUT_FILENO);
+			dup2(null, STDERR_FILENO);
+		}
+
+		std::vector<const char*> argv;
+
+		for (auto& arg : args)
+			argv.push_back(arg.c_str());
+
+		argv.push_back(nullptr);
+
+		int child_code = 1;
+
+		// as in a fresh process, the encoders test errno after strtol.
+		errno = 0;
+
+		try
+		{
+			child_code = module(args.size(), argv.data());
+		}
+		catch (...)
+		{
+		}
+
+		std::cout.flush();
+		std::cerr.flush();
+		fflush(nullptr);
+
+		_exit(child_code);
+	}
+
+	int	   status = 0;
+	rusage usage{};
+
+	if (wait4(pid, &status, 0, &usage) < 0)
+		return false;
+
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+#ifdef __APPLE__
+	rss = usage.ru_maxrss / 1024;
+#else
+	rss = usage.ru_maxrss;
+#endif
+
+	code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+
+	return true;
+}
+
+static bench_result bench_measure(const bench_stage& stage)
+{
+	bench_result result;
+
+	result.fStage  = stage.fName;
+	result.fModule = stage.fModule;
+
+	for (auto& input : stage.fInputs)
+	{
+		if (stage.fObjects)
+		{
+			++result.fObjects;
+			result.fBytes += fs::file_size(input);
+		}
+		else
+		{
+			bench_count(input, result);
+		}
+	}
+
+	// best time of the runs, worst memory.
+	for (size_t run = 0; run < kBenchRuns; ++run)
+	{
+		int32_t	 code	 = 0;
+		double	 seconds = 0.0;
+		uint64_t rss	 = 0UL;
+
+		if (!bench_spawn(stage.fMain, stage.fArgs, code, seconds, rss))
+		{
+			result.fCode = -1;
+			break;
+		}
+
+		if (run == 0 || seconds < result.fSeconds)
+			result.fSeconds = seconds;
+
+		result.fPeakRss = std::max(result.fPeakRss, rss);
+		result.fCode	= code;
+
+		if (code)
+			break;
+	}
+
+	return result;
+}
+
+static double bench_rate(uint64_t count, double seconds)
+{
+	return seconds > 0.0 ? count / seconds : 0.0;
+}
+
+static void bench_write_json(std::ostream& out, const std::vector<bench_result>& results)
+{
+	out << "{\n";
+	out << "  \"version\": \"" << kDistVersion << "\",\n";
+	out << "  \"lines\": " << kBenchLines << ",\n";
+	out << "  \"objects\": " << kBenchObjects << ",\n";
+	out << "  \"runs\": " << kBenchRuns << ",\n";
+	out << "  \"results\": [\n";
+
+	for (size_t index = 0; index < results.size(); ++index)
+	{
+		auto& result = results[index];
+
+		out << "    {\"stage\": \"" << result.fStage << "\", \"module\": \"" << result.fModule << "\""
+			<< ", \"exit_code\": " << result.fCode
+			<< ", \"lines\": " << result.fLines
+			<< ", \"bytes\": " << result.fBytes
+			<< ", \"objects\": " << result.fObjects
+			<< ", \"seconds\": " << result.fSeconds
+			<< ", \"lines_per_second\": " << uint64_t(bench_rate(result.fLines, result.fSeconds))
+			<< ", \"bytes_per_second\": " << uint64_t(bench_rate(result.fBytes, result.fSeconds))
+			<< ", \"objects_per_second\": " << uint64_t(bench_rate(result.fObjects, result.fSeconds))
+			<< ", \"peak_rss_kib\": " << result.fPeakRss << "}"
+			<< (index + 1 < results.size() ? ",\n" : "\n");
+	}
+
+	out << "  ]\n";
+	out << "}\n";
+}
+
+static bool bench_selected(const std::vector<std::string>& only, const char* name)
+{
+	if (only.empty())
+		return true;
+
+	for (auto& stage : only)
+	{
+		if (stage == name)
+			return true;
+	}
+
+	return false;
+}
+
+int main(int argc, char const* argv[])
+{
+	std::string				 dir	= "bench.d";
+	std::string				 output = "bench.json";
+	std::vector<std::string> only;
+
+	for (int index_arg = 1; index_arg < argc; ++index_arg)
+	{
+		const char* arg = argv[index_arg];
+
+		if (strcmp(arg, "--bench:h") == 0)
+		{
+			std::printf("bench.exe: ToolchainKit Benchmarks.\n");
+			std::printf("bench.exe: Version: %s, Release: %s.\n", kDistVersion, kDistRelease);
+			std::printf("bench.exe: Designed by Amlal EL Mahrouss, Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved.\n");
+			std::printf("--bench:dir=<path>: where the workloads are generated, default is bench.d.\n");
+			std::printf("--bench:lines=<N>: lines of each source and assembly workload, default is 10000.\n");
+			std::printf("--bench:headers=<N>: macro headers included by the C and C++ workloads, default is 8.\n");
+			std::printf("--bench:objects=<N>: objects of the link workload, default is 256.\n");
+			std::printf("--bench:runs=<N>: runs of each stage, the best time is kept, default is 3.\n");
+			std::printf("--bench:stage=<name>: only run this stage, may be repeated.\n");
+			std::printf("--bench:output=<path>: where the JSON results go, - for stdout, default is bench.json.\n");
+			std::printf("--bench:verbose: show the output of the stages.\n");
+			std::printf("stages: preprocessor, cxx-amd64, c-64x0, c-power64, asm-amd64, asm-64x0, asm-power64, ld64.\n");
+
+			return 0;
+		}
+		else if (strstr(arg, "--bench:dir=") == arg)
+		{
+			dir = arg + strlen("--bench:dir=");
+		}
+		else if (strstr(arg, "--bench:lines=") == arg)
+		{
+			kBenchLines = std::strtoull(arg + strlen("--bench:lines="), nullptr, 10);
+		}
+		else if (strstr(arg, "--bench:headers=") == arg)
+		{
+			kBenchHeaders = std::max(1ULL, std::strtoull(arg + strlen("--bench:headers="), nullptr, 10));
+		}
+		else if (strstr(arg, "--bench:objects=") == arg)
+		{
+			kBenchObjects = std::max(1ULL, std::strtoull(arg + strlen("--bench:objects="), nullptr, 10));
+		}
+		else if (strstr(arg, "--bench:runs=") == arg)
+		{
+			kBenchRuns = std::max(1ULL, std::strtoull(arg + strlen("--bench:runs="), nullptr, 10));
+		}
+		else if (strstr(arg, "--bench:stage=") == arg)
+		{
+			only.push_back(arg + strlen("--bench:stage="));
+		}
+		else if (strstr(arg, "--bench:output=") == arg)
+		{
+			output = arg + strlen("--bench:output=");
+		}
+		else if (strcmp(arg, "--bench:verbose") == 0)
+		{
+			kBenchVerbose = true;
+		}
+		else
+		{
+			std::printf("bench.exe: unknown flag: %s.\n", arg);
+			return 1;
+		}
+	}
+
+	std::error_code err;
+	fs::create_directories(dir, err);
+
+	if (err)
+	{
+		std::printf("bench.exe: can't create %s.\n", dir.c_str());
+		return 1;
+	}
+
+	std::printf("bench.exe: generating the workloads in %s.\n", dir.c_str());
+
+	auto headers = bench_write_headers(dir);
+
+	bench_write_functions(dir + "/bench_pp.cc", headers);
+	bench_write_functions(dir + "/bench_cxx.cc", {});
+	bench_write_functions(dir + "/bench_64x0.c", {});
+	bench_write_functions(dir + "/bench_power64.c", {});
+
+	bench_write_assembly(dir + "/bench_amd64.asm", "#bits 64\n", {"mov rax, 5", "mov rbx, rax", "mov rcx, 4096", "nop"}, "ret", kBenchLines);
+	bench_write_assembly(dir + "/bench_64x0.64x", "", {"ldw r19, 5", "mv r19, r20", "nop"}, "jlr", kBenchLines);
+	bench_write_assembly(dir + "/bench_power64.s", "", {"li r3, 5", "addi r3, r3, 1", "mr r31, r3"}, "blr", kBenchLines);
+
+	// the link set is assembled up front, only ld64 is measured on it.
+	std::vector<std::string> objects;
+
+	if (bench_selected(only, "ld64"))
+	{
+		for (size_t object = 0; object < kBenchObjects; ++object)
+		{
+			auto source = dir + "/bench_link_" + bench_name(object) + ".asm";
+			auto body	= "mov rax, " + std::to_string(object % 4096);
+
+			{
+				std::ofstream out(source);
+
+				out << "#bits 64\n";
+				out << "public_segment .code64 " << (object == 0 ? std::string("__ImageStart") : "__bench_link_" + bench_name(object)) << "\n";
+
+				for (size_t line = 0; line < 16; ++line)
+					out << "\t" << (line % 2 ? "nop" : body) << "\n";
+
+				out << "\tret\n";
+			}
+
+			int32_t	 code	 = 0;
+			double	 seconds = 0.0;
+			uint64_t rss	 = 0UL;
+
+			if (!bench_spawn(AssemblerAMD64, {argv[0], source}, code, seconds, rss) || code)
+			{
+				std::printf("bench.exe: can't assemble %s, exit code %i.\n", source.c_str(), code);
+				return 1;
+			}
+
+			objects.push_back(fs::path(source).replace_extension(kObjectFileExt).string());
+		}
+	}
+
+	std::vector<std::string> link_args = {argv[0], "--ld64:amd64", "--ld64:output", dir + "/bench.exec"};
+	link_args.insert(link_args.end(), objects.begin(), objects.end());
+
+	std::vector<bench_stage> stages = {
+		{"preprocessor", "CPlusPlusPreprocessorMain", CPlusPlusPreprocessorMain, {argv[0], dir + "/bench_pp.cc"}, {}},
+		{"cxx-amd64", "CompilerCPlusPlusX8664", CompilerCPlusPlusX8664, {argv[0], dir + "/bench_cxx.cc"}, {dir + "/bench_cxx.cc"}},
+		{"c-64x0", "NewOSCompilerCLang64x0", NewOSCompilerCLang64x0, {argv[0], dir + "/bench_64x0.c"}, {dir + "/bench_64x0.c"}},
+		{"c-power64", "NewOSCompilerCLangPowerPC", NewOSCompilerCLangPowerPC, {argv[0], dir + "/bench_power64.c"}, {dir + "/bench_power64.c"}},
+		{"asm-amd64", "AssemblerAMD64", AssemblerAMD64, {argv[0], dir + "/bench_amd64.asm"}, {dir + "/bench_amd64.asm"}},
+		{"asm-64x0", "AssemblerMain64x0", AssemblerMain64x0, {argv[0], dir + "/bench_64x0.64x"}, {dir + "/bench_64x0.64x"}},
+		{"asm-power64", "AssemblerMainPower64", AssemblerMainPower64, {argv[0], dir + "/bench_power64.s"}, {dir + "/bench_power64.s"}},
+		{"ld64", "DynamicLinker64PEF", DynamicLinker64PEF, link_args, objects, true},
+	};
+
+	// the preprocessor reads the headers as well.
+	stages[0].fInputs = headers;
+	stages[0].fInputs.push_back(dir + "/bench_pp.cc");
+
+	std::vector<bench_result> results;
+	int32_t					  failed = 0;
+
+	for (auto& stage : stages)
+	{
+		if (!bench_selected(only, stage.fName))
+			continue;
+
+		auto result = bench_measure(stage);
+
+		std::printf("bench.exe: %-12s %8.3f s, %10llu lines/s, %12llu bytes/s, %8llu objects/s, %8llu KiB peak",
+					stage.fName,
+					result.fSeconds,
+					static_cast<unsigned long long>(bench_rate(result.fLines, result.fSeconds)),
+					static_cast<unsigned long long>(bench_rate(result.fBytes, result.fSeconds)),
+					static_cast<unsigned long long>(bench_rate(result.fObjects, result.fSeconds)),
+					static_cast<unsigned long long>(result.fPeakRss));
+
+		if (result.fCode)
+		{
+			std::printf(", exit code %i", result.fCode);
+			++failed;
+		}
+
+		std::printf(".\n");
+
+		results.push_back(result);
+	}
+
+	if (output == "-")
+	{
+		bench_write_json(std::cout, results);
+	}
+	else
+	{
+		std::ofstream out(output);
+
+		if (!out.is_open())
+		{
+			std::printf("bench.exe: can't write %s.\n", output.c_str());
+			return 1;
+		}
+
+		bench_write_json(out, results);
+	}
+
+	return failed ? 1 : 0;
+}
@@ -9,6 +9,9 @@
 
 #include <ToolchainKit/Defines.h>
 #include <ToolchainKit/Version.h>
+#include <ToolchainKit/Daemon.h>
+#include <ToolchainKit/CompilationCache.h>
+#include <ToolchainKit/TimeTrace.h>
 #include <iostream>
 #include <cstring>
 #include <vector>
@@ -17,71 +20,231 @@ TK_IMPORT_C int CPlusPlusPreprocessorMain(int argc, char const* argv[]);
 TK_IMPORT_C int CompilerCPlusPlusX8664(int argc, char const* argv[]);
 TK_IMPORT_C int AssemblerAMD64(int argc, char const* argv[]);
 
+typedef int (*cl_module_t)(int argc, char const* argv[]);
+
+/// @brief send the jobs to tkd (--cl:daemon).
+static bool kUseDaemon = false;
+
+/// @brief compilation cache options (--cl:cache).
+static bool		   kUseCache   = false;
+static bool		   kCacheStats = false;
+static std::string kCacheDir;
+static uint64_t	   kCacheLimit = ToolchainKit::CompilationCache::kDefaultLimit;
+
+static bool cl_is_source(const char* arg)
+{
+	return strstr(arg, ".cxx") ||
+		   strstr(arg, ".cpp") ||
+		   strstr(arg, ".cc") ||
+		   strstr(arg, ".c++") ||
+		   strstr(arg, ".C");
+}
+
+/// @brief read a --cl:cache option.
+/// @return false if arg isn't one.
+static bool cl_cache_option(const char* arg)
+{
+	if (strcmp(arg, "--cl:cache") == 0)
+	{
+		kUseCache = true;
+	}
+	else if (strstr(arg, "--cl:cache-dir=") == arg)
+	{
+		kUseCache = true;
+		kCacheDir = arg + strlen("--cl:cache-dir=");
+	}
+	else if (strstr(arg, "--cl:cache-size=") == arg)
+	{
+		kCacheLimit = std::strtoull(arg + strlen("--cl:cache-size="), nullptr, 10) * 1024UL * 1024UL;
+	}
+	else if (strcmp(arg, "--cl:cache-stats") == 0)
+	{
+		kCacheStats = true;
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
+}
+
+static void cl_print_cache_stats()
+{
+	ToolchainKit::CompilationCache cache(kCacheDir, kCacheLimit);
+
+	auto stats	  = cache.Stats();
+	auto lookups  = stats.fHits + stats.fMisses;
+	auto hit_rate = lookups ? (100.0 * stats.fHits / lookups) : 0.0;
+
+	std::printf("cl.exe: cache: %s\n", kCacheDir.c_str());
+	std::printf("cl.exe: cache: hits %llu, misses %llu, hit rate %.1f%%.\n", (unsigned long long)stats.fHits, (unsigned long long)stats.fMisses, hit_rate);
+	std::printf("cl.exe: cache: stores %llu, evictions %llu.\n", (unsigned long long)stats.fStores, (unsigned long long)stats.fEvictions);
+	std::printf("cl.exe: cache: %llu entries, %llu of %llu bytes.\n", (unsigned long long)stats.fEntries, (unsigned long long)stats.fBytes, (unsigned long long)kCacheLimit);
+}
+
+/// @brief run a module through tkd if asked to and it's up, here otherwise.
+static int cl_run(const char* name, cl_module_t module, int argc, char const* argv[])
+{
+	ToolchainKit::TimeTraceScope trace(name, argv[argc - 1]);
+
+	if (kUseDaemon)
+	{
+		std::vector<std::string> args(argv, argv + argc);
+		int32_t					 code = 0;
+
+		if (ToolchainKit::daemon_submit(ToolchainKit::daemon_socket_path(), name, args, code))
+			return code;
+	}
+
+	return module(argc, argv);
+}
+
 int main(int argc, char const* argv[])
 {
-	for (size_t index_arg = 0; index_arg < argc; ++index_arg)
+	bool has_sources = false;
+
+	for (int index_arg = 0; index_arg < argc; ++index_arg)
 	{
+		if (strcmp(argv[index_arg], "--cl:daemon") == 0)
+		{
+			kUseDaemon = true;
+			continue;
+		}
+
+		if (cl_cache_option(argv[index_arg]))
+			continue;
+
+		if (ToolchainKit::TimeTrace::Option(argv[index_arg], "--cl:", "cl.trace.json"))
+			continue;
+
+		if (index_arg > 0 && cl_is_source(argv[index_arg]))
+			has_sources = true;
+
 		if (strstr(argv[index_arg], "--cl:h"))
 		{
 			std::printf("cl.exe: Frontend C++ Compiler.\n");
 			std::printf("cl.exe: Version: %s, Release: %s.\n", kDistVersion, kDistRelease);
 			std::printf("cl.exe: Designed by Amlal EL Mahrouss, Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved.\n");
 			std::printf("libToolchainKit.dylib: Designed by Amlal EL Mahrouss, Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved.\n");
+			std::printf("--cl:daemon: run the passes in tkd when it is up.\n");
+			std::printf("--cl:cache: reuse the outputs of identical translation units.\n");
+			std::printf("--cl:cache-dir=<path>: cache directory, default is %s.\n", ToolchainKit::CompilationCache::DefaultDirectory().c_str());
+			std::printf("--cl:cache-size=<MiB>: cache size limit, least recently used entries go first.\n");
+			std::printf("--cl:cache-stats: print the cache statistics.\n");
+			std::printf("--cl:time-trace[=<path>]: write where the time goes as a Chrome trace, default is cl.trace.json.\n");
 
 			return 0;
 		}
 	}
 
-	if (auto code = CPlusPlusPreprocessorMain(argc, argv); code)
+	if (kCacheDir.empty())
+		kCacheDir = ToolchainKit::CompilationCache::DefaultDirectory();
+
+	if (kCacheStats && !has_sources)
+	{
+		cl_print_cache_stats();
+		return 0;
+	}
+
+	if (auto code = cl_run("CPlusPlusPreprocessorMain", CPlusPlusPreprocessorMain, argc, argv); code)
 	{
 		std::printf("cl.exe: frontend exited with code %i.\n", code);
+
+		ToolchainKit::TimeTrace::End();
 		return 1;
 	}
 	else
 	{
-		std::vector<std::string> args_list_cxx;
-		std::vector<std::string> args_list_asm;
+		std::vector<std::string> args_list_src;
+		std::vector<const char*> args_list_flags;
 
-		for (size_t index_arg = 0; index_arg < argc; ++index_arg)
+		for (int index_arg = 0; index_arg < argc; ++index_arg)
 		{
-			if (strstr(argv[index_arg], ".cxx") ||
-				strstr(argv[index_arg], ".cpp") ||
-				strstr(argv[index_arg], ".cc") ||
-				strstr(argv[index_arg], ".c++") ||
-				strstr(argv[index_arg], ".C"))
-			{
-				std::string arg = argv[index_arg];
-
-				arg += ".pp.masm";
-				args_list_asm.push_back(arg);
+			if (strcmp(argv[index_arg], "--cl:daemon") == 0)
+				continue;
 
-				arg = argv[index_arg];
-				arg += ".pp";
+			// driver options, the compiler pass doesn't know them.
+			if (strstr(argv[index_arg], "--cl:cache") == argv[index_arg] ||
+				strstr(argv[index_arg], "--cl:time-trace") == argv[index_arg])
+				continue;
 
-				args_list_cxx.push_back(arg);
+			// --cl: options belong to the compiler pass.
+			if (strstr(argv[index_arg], "--cl:") == argv[index_arg])
+			{
+				args_list_flags.push_back(argv[index_arg]);
+				continue;
 			}
+
+			if (cl_is_source(argv[index_arg]))
+				args_list_src.push_back(argv[index_arg]);
 		}
 
-		for (auto& cli : args_list_cxx)
+		std::unique_ptr<ToolchainKit::CompilationCache> cache;
+
+		if (kUseCache)
+			cache = std::make_unique<ToolchainKit::CompilationCache>(kCacheDir, kCacheLimit);
+
+		for (auto& src : args_list_src)
 		{
-			const char* arr_cli[] = {argv[0], cli.data()};
+			std::string cli_cxx = src + ".pp";
+			std::string cli_asm = src + ".pp.masm";
 
-			if (auto code = CompilerCPlusPlusX8664(2, arr_cli); code)
+			std::vector<ToolchainKit::CompilationCacheOutput> outputs = {
+				{".masm", cli_asm},
+				{kObjectFileExt, src + ".pp" kObjectFileExt},
+			};
+
+			// the preprocessed source already has the headers and macros in it.
+			std::string key;
+
+			if (cache)
 			{
-				std::printf("cl.exe: assembler exited with code %i.", code);
+				ToolchainKit::TimeTraceScope trace("CacheLookup", src);
+
+				std::vector<std::string> key_flags(args_list_flags.begin(), args_list_flags.end());
+				key_flags.push_back(cli_cxx);
+
+				key = ToolchainKit::CompilationCache::Key(cli_cxx, key_flags);
+
+				if (!key.empty() && cache->Fetch(key, outputs))
+				{
+					std::printf("cl.exe: cache hit: %s.\n", src.c_str());
+					continue;
+				}
 			}
-		}
 
-		for (auto& cli : args_list_asm)
-		{
-			const char* arr_cli[] = {argv[0], cli.data()};
+			std::vector<const char*> arr_cli = {argv[0]};
+
+			arr_cli.insert(arr_cli.end(), args_list_flags.begin(), args_list_flags.end());
+			arr_cli.push_back(cli_cxx.data());
+
+			auto code_cxx = cl_run("CompilerCPlusPlusX8664", CompilerCPlusPlusX8664, arr_cli.size(), arr_cli.data());
 
-			if (auto code = AssemblerAMD64(2, arr_cli); code)
+			if (code_cxx)
 			{
-				std::printf("cl.exe: assembler exited with code %i.", code);
+				std::printf("cl.exe: compiler exited with code %i.", code_cxx);
 			}
+
+			const char* arr_asm[] = {argv[0], cli_asm.data()};
+
+			auto code_asm = cl_run("AssemblerAMD64", AssemblerAMD64, 2, arr_asm);
+
+			if (code_asm)
+			{
+				std::printf("cl.exe: assembler exited with code %i.", code_asm);
+			}
+
+			if (cache && !key.empty() && !code_cxx && !code_asm)
+				cache->Store(key, outputs);
 		}
+
+		if (kCacheStats)
+			cl_print_cache_stats();
 	}
 
+	if (!ToolchainKit::TimeTrace::End())
+		std::printf("cl.exe: can't write the time trace.\n");
+
 	return 0;
 }
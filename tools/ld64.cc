@@ -18,5 +18,6 @@ int main(int argc, char const* argv[])
 		return 1;
 	}
 
+	// the module reads --ld64:time-trace, a link through tkd traces the same way.
 	return DynamicLinker64PEF(argc, argv);
 }
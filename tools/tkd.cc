@@ -0,0 +1,60 @@
+/* -------------------------------------------
+
+	Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved
+
+------------------------------------------- */
+
+/// @file tkd.cc
+/// @brief ToolchainKit daemon, keeps the toolchain warm between jobs.
+
+#include <ToolchainKit/Defines.h>
+#include <ToolchainKit/Version.h>
+#include <ToolchainKit/Daemon.h>
+#include <iostream>
+#include <cstring>
+
+int main(int argc, char const* argv[])
+{
+	std::string path	= ToolchainKit::daemon_socket_path();
+	bool		verbose = false;
+
+	for (int index_arg = 1; index_arg < argc; ++index_arg)
+	{
+		if (strcmp(argv[index_arg], "--tkd:h") == 0)
+		{
+			std::printf("tkd.exe: ToolchainKit Daemon.\n");
+			std::printf("tkd.exe: Version: %s, Release: %s.\n", kDistVersion, kDistRelease);
+			std::printf("tkd.exe: Designed by Amlal EL Mahrouss, Copyright (C) 2024, Amlal EL Mahrouss, all rights reserved.\n");
+			std::printf("--tkd:socket <path>: listen on path, default is %s.\n", path.c_str());
+			std::printf("--tkd:verbose: trace the jobs.\n");
+			std::printf("--tkd:stop: stop the running daemon.\n");
+
+			return 0;
+		}
+		else if (strcmp(argv[index_arg], "--tkd:socket") == 0 && index_arg + 1 < argc)
+		{
+			path = argv[++index_arg];
+		}
+		else if (strcmp(argv[index_arg], "--tkd:verbose") == 0)
+		{
+			verbose = true;
+		}
+		else if (strcmp(argv[index_arg], "--tkd:stop") == 0)
+		{
+			if (!ToolchainKit::daemon_stop(path))
+			{
+				std::printf("tkd.exe: no daemon on %s.\n", path.c_str());
+				return 1;
+			}
+
+			return 0;
+		}
+		else
+		{
+			std::printf("tkd.exe: unknown flag: %s.\n", argv[index_arg]);
+			return 1;
+		}
+	}
+
+	return ToolchainKit::daemon_serve(path, verbose);
+}